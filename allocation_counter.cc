@@ -0,0 +1,80 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocation_count{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+[[nodiscard]] void* CountedAllocate(size_t size, size_t alignment, bool abort_on_failure) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  // malloc() and posix_memalign() may return null for 0-byte requests, but
+  // operator new must return a unique pointer.
+  if (size == 0)
+    size = 1;
+  void* pointer = nullptr;
+  if (alignment <= alignof(std::max_align_t)) {
+    pointer = std::malloc(size);
+  } else if (posix_memalign(&pointer, alignment, size) != 0) {
+    pointer = nullptr;
+  }
+
+  // Exceptions are disabled, so running out of memory can't throw
+  // std::bad_alloc.
+  if (pointer == nullptr && abort_on_failure)
+    std::abort();
+  return pointer;
+}
+
+}  // namespace
+
+AllocationCount CurrentAllocationCount() {
+  return {
+    .allocation_count = allocation_count.load(std::memory_order_relaxed),
+    .allocated_bytes = allocated_bytes.load(std::memory_order_relaxed),
+  };
+}
+
+void* operator new(size_t size) {
+  return CountedAllocate(size, alignof(std::max_align_t), /*abort_on_failure=*/true);
+}
+void* operator new[](size_t size) {
+  return CountedAllocate(size, alignof(std::max_align_t), /*abort_on_failure=*/true);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, alignof(std::max_align_t), /*abort_on_failure=*/false);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, alignof(std::max_align_t), /*abort_on_failure=*/false);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, static_cast<size_t>(alignment), /*abort_on_failure=*/true);
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return CountedAllocate(size, static_cast<size_t>(alignment), /*abort_on_failure=*/true);
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, static_cast<size_t>(alignment), /*abort_on_failure=*/false);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return CountedAllocate(size, static_cast<size_t>(alignment), /*abort_on_failure=*/false);
+}
+
+// Both malloc() and posix_memalign() memory is released by free().
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
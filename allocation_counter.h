@@ -0,0 +1,21 @@
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+// Counts the heap allocations made with operator new.
+//
+// allocation_counter.cc replaces the global allocation functions of the
+// program it's linked into, so it must only be linked into programs that
+// report allocation counts, such as perf_suite and hello_triangle. Counting
+// uses relaxed atomics, which adds a few nanoseconds to each allocation.
+
+struct AllocationCount {
+  uint64_t allocation_count;
+  uint64_t allocated_bytes;
+};
+
+// The allocations made since the program started, by all threads.
+[[nodiscard]] AllocationCount CurrentAllocationCount();
+
+#endif  // ALLOCATION_COUNTER_H_
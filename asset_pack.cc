@@ -0,0 +1,198 @@
+#include "asset_pack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "asset_pack_format.h"
+#include "lz4_block.h"
+#include "task_pool.h"
+
+namespace {
+
+[[noreturn]] void AbortMalformedPack(const std::string& pack_path, const char* reason) {
+  std::cerr << "Malformed asset pack: " << pack_path << ": " << reason << std::endl;
+  std::abort();
+}
+
+// Decodes one block of `entry` into `destination`.
+void DecodeBlock(const std::string& pack_path, const AssetPackEntry& entry,
+                 const uint8_t* source, size_t source_size, uint8_t* destination,
+                 size_t size) {
+  switch (entry.compression) {
+    case AssetPackCompression::kNone:
+      assert(source_size == size);
+      std::memcpy(destination, source, size);
+      return;
+    case AssetPackCompression::kLz4:
+      if (!Lz4DecompressBlock(source, source_size, destination, size))
+        AbortMalformedPack(pack_path, "corrupt LZ4 block");
+      return;
+  }
+  AbortMalformedPack(pack_path, "unknown compression");
+}
+
+}  // namespace
+
+AssetPack::AssetPack(const char* pack_path) : pack_path_(pack_path) {
+  assert(pack_path != nullptr);
+
+  // The mapping stays valid after the descriptor is closed.
+  const int file_descriptor = open(pack_path, O_RDONLY | O_CLOEXEC);
+  if (file_descriptor < 0) {
+    std::cerr << "Failed to open asset pack: " << pack_path << std::endl;
+    std::abort();
+  }
+  struct stat file_stat;
+  if (fstat(file_descriptor, &file_stat) != 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(AssetPackHeader)) {
+    AbortMalformedPack(pack_path_, "truncated header");
+  }
+  mapped_size_ = static_cast<size_t>(file_stat.st_size);
+  void* mapping = mmap(nullptr, mapped_size_, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  close(file_descriptor);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Failed to map asset pack: " << pack_path << std::endl;
+    std::abort();
+  }
+  mapped_data_ = static_cast<const uint8_t*>(mapping);
+
+  AssetPackHeader header;
+  std::memcpy(&header, mapped_data_, sizeof(header));
+  if (std::memcmp(header.magic, kAssetPackMagic, sizeof(kAssetPackMagic)) != 0)
+    AbortMalformedPack(pack_path_, "unsupported format");
+  if (header.index_offset % alignof(AssetPackEntry) != 0 ||
+      header.index_offset > mapped_size_ ||
+      header.entry_count > (mapped_size_ - header.index_offset) / sizeof(AssetPackEntry)) {
+    AbortMalformedPack(pack_path_, "index out of bounds");
+  }
+  if (header.name_table_offset > mapped_size_ ||
+      header.name_table_size > mapped_size_ - header.name_table_offset) {
+    AbortMalformedPack(pack_path_, "name table out of bounds");
+  }
+  entries_ = reinterpret_cast<const AssetPackEntry*>(mapped_data_ + header.index_offset);
+  entry_count_ = header.entry_count;
+  names_ = reinterpret_cast<const char*>(mapped_data_ + header.name_table_offset);
+
+  // Checking the entries here keeps the bounds checks off the read paths.
+  // The block size tables are checked when they're read.
+  for (size_t i = 0; i < entry_count_; ++i) {
+    const AssetPackEntry& entry = entries_[i];
+    if (i > 0 && entry.name_hash < entries_[i - 1].name_hash)
+      AbortMalformedPack(pack_path_, "unsorted index");
+    if (entry.name_offset > header.name_table_size ||
+        entry.name_size > header.name_table_size - entry.name_offset) {
+      AbortMalformedPack(pack_path_, "entry name out of bounds");
+    }
+    if (entry.data_offset % kAssetPackDataAlignment != 0 || entry.data_offset > mapped_size_ ||
+        entry.stored_size > mapped_size_ - entry.data_offset) {
+      AbortMalformedPack(pack_path_, "entry data out of bounds");
+    }
+
+    switch (entry.compression) {
+      case AssetPackCompression::kNone:
+        if (entry.stored_size != entry.size || entry.block_count != 0)
+          AbortMalformedPack(pack_path_, "inconsistent uncompressed entry");
+        break;
+      case AssetPackCompression::kLz4:
+        if (entry.block_count !=
+                (entry.size + kAssetPackBlockSize - 1) / kAssetPackBlockSize ||
+            entry.stored_size < uint64_t{entry.block_count} * sizeof(uint32_t)) {
+          AbortMalformedPack(pack_path_, "inconsistent LZ4 entry");
+        }
+        break;
+      default:
+        AbortMalformedPack(pack_path_, "unknown compression");
+    }
+  }
+}
+
+AssetPack::~AssetPack() {
+  munmap(const_cast<uint8_t*>(mapped_data_), mapped_size_);
+}
+
+const AssetPackEntry* AssetPack::Find(std::string_view name) const {
+  const uint64_t name_hash = AssetPackHash(name.data(), name.size());
+  const AssetPackEntry* entries_end = entries_ + entry_count_;
+  const AssetPackEntry* entry = std::lower_bound(
+      entries_, entries_end, name_hash,
+      [](const AssetPackEntry& entry, uint64_t hash) { return entry.name_hash < hash; });
+  for (; entry != entries_end && entry->name_hash == name_hash; ++entry) {
+    if (std::string_view(names_ + entry->name_offset, entry->name_size) == name)
+      return entry;
+  }
+  return nullptr;
+}
+
+template <typename BlockFunction>
+void AssetPack::ForEachBlock(const AssetPackEntry& entry, uint8_t* destination,
+                             const BlockFunction& block_function) const {
+  assert(entry.data_offset + entry.stored_size <= mapped_size_);
+
+  const uint8_t* stored_data = StoredData(entry);
+  if (entry.compression == AssetPackCompression::kNone) {
+    // Copies are split like compressed blocks, so they're spread across
+    // threads too.
+    for (uint64_t offset = 0; offset < entry.size; offset += kAssetPackBlockSize) {
+      const size_t size = std::min<uint64_t>(kAssetPackBlockSize, entry.size - offset);
+      block_function(stored_data + offset, size, destination + offset, size);
+    }
+    return;
+  }
+
+  const uint64_t table_size = uint64_t{entry.block_count} * sizeof(uint32_t);
+  uint64_t source_offset = table_size;
+  for (uint32_t block = 0; block < entry.block_count; ++block) {
+    uint32_t source_size;
+    std::memcpy(&source_size, stored_data + block * sizeof(uint32_t), sizeof(source_size));
+    if (source_size > entry.stored_size - source_offset)
+      AbortMalformedPack(pack_path_, "LZ4 block out of bounds");
+
+    const uint64_t offset = uint64_t{block} * kAssetPackBlockSize;
+    const size_t size = std::min<uint64_t>(kAssetPackBlockSize, entry.size - offset);
+    block_function(stored_data + source_offset, source_size, destination + offset, size);
+    source_offset += source_size;
+  }
+}
+
+void AssetPack::Read(const AssetPackEntry& entry, void* destination) const {
+  assert(destination != nullptr || entry.size == 0);
+
+  ForEachBlock(entry, static_cast<uint8_t*>(destination),
+               [&](const uint8_t* source, size_t source_size, uint8_t* block_destination,
+                   size_t size) {
+                 DecodeBlock(pack_path_, entry, source, source_size, block_destination, size);
+               });
+}
+
+void AssetPack::ReadEntries(const std::vector<ReadRequest>& requests,
+                            TaskPool& task_pool) const {
+  for (const ReadRequest& request : requests) {
+    assert(request.entry != nullptr);
+    assert(request.destination != nullptr || request.entry->size == 0);
+
+    const AssetPackEntry& entry = *request.entry;
+    ForEachBlock(entry, static_cast<uint8_t*>(request.destination),
+                 [&](const uint8_t* source, size_t source_size, uint8_t* block_destination,
+                     size_t size) {
+                   task_pool.Post([this, &entry, source, source_size, block_destination,
+                                   size]() {
+                     DecodeBlock(pack_path_, entry, source, source_size, block_destination,
+                                 size);
+                   });
+                 });
+  }
+  task_pool.WaitIdle();
+}
@@ -0,0 +1,80 @@
+#ifndef ASSET_PACK_H_
+#define ASSET_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "asset_pack_format.h"
+
+class TaskPool;
+
+// Reads entries from a pack built by asset_pack_builder.
+//
+// The whole pack is mapped into memory when it's opened, so reading an entry
+// doesn't open files or issue reads. Entries are decompressed straight into
+// caller-provided memory, such as mapped staging buffers.
+//
+// Thread-safe, as the pack is read-only.
+class AssetPack {
+ public:
+  // Decompresses an entry into `destination`, which must hold `entry->size`
+  // bytes.
+  struct ReadRequest {
+    const AssetPackEntry* entry;
+    void* destination;
+  };
+
+  // Terminates the program if the pack can't be mapped or is malformed.
+  explicit AssetPack(const char* pack_path);
+
+  AssetPack(const AssetPack&) = delete;
+  AssetPack& operator=(const AssetPack&) = delete;
+
+  // Entries and stored data pointers must not be used afterwards.
+  ~AssetPack();
+
+  [[nodiscard]] size_t EntryCount() const { return entry_count_; }
+
+  // Returns null if the pack has no entry named `name`.
+  [[nodiscard]] const AssetPackEntry* Find(std::string_view name) const;
+
+  // The entry's data in the mapped file. kNone entries can be used in place,
+  // without a copy. Aligned to kAssetPackDataAlignment.
+  [[nodiscard]] const uint8_t* StoredData(const AssetPackEntry& entry) const {
+    return mapped_data_ + entry.data_offset;
+  }
+
+  // Decompresses the entry on the calling thread. `destination` must hold
+  // `entry.size` bytes.
+  //
+  // Terminates the program if the entry's data is malformed.
+  void Read(const AssetPackEntry& entry, void* destination) const;
+
+  // Decompresses the entries on `task_pool`'s threads, with one task per
+  // compressed block. Returns when all the entries are decompressed.
+  //
+  // Waits for `task_pool` to go idle, so it also waits for tasks posted by
+  // other callers. Terminates the program if an entry's data is malformed.
+  void ReadEntries(const std::vector<ReadRequest>& requests, TaskPool& task_pool) const;
+
+ private:
+  // Calls `block_function(source, source_size, destination, size)` for each
+  // block of the entry, after checking it's in bounds. kNone entries are
+  // split into blocks of the same size as kLz4 entries.
+  template <typename BlockFunction>
+  void ForEachBlock(const AssetPackEntry& entry, uint8_t* destination,
+                    const BlockFunction& block_function) const;
+
+  // Used in error messages.
+  const std::string pack_path_;
+  const uint8_t* mapped_data_ = nullptr;
+  size_t mapped_size_ = 0;
+  const AssetPackEntry* entries_ = nullptr;
+  size_t entry_count_ = 0;
+  const char* names_ = nullptr;
+};
+
+#endif  // ASSET_PACK_H_
@@ -0,0 +1,208 @@
+// Builds an asset pack for AssetPack.
+//
+// Usage: asset_pack_builder output_path input_path...
+//
+// Each input file becomes an entry named after the file, without its
+// directory. Entries are LZ4-compressed unless that doesn't save space.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "asset_pack_format.h"
+#include "lz4_block.h"
+
+namespace {
+
+struct InputEntry {
+  std::string name;
+  uint64_t name_hash;
+  // Index into the stored data list.
+  size_t data_index;
+};
+
+struct StoredData {
+  uint64_t content_hash;
+  uint64_t size;
+  AssetPackCompression compression;
+  uint32_t block_count;
+  // The uncompressed contents, kept to compare entries whose hashes match.
+  std::vector<uint8_t> contents;
+  std::vector<uint8_t> stored_bytes;
+  uint64_t offset = 0;
+};
+
+[[nodiscard]] std::vector<uint8_t> ReadInputFile(const char* path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Failed to open input: " << path << std::endl;
+    std::abort();
+  }
+
+  std::streamsize file_size = file.tellg();
+  std::vector<uint8_t> bytes(static_cast<size_t>(file_size));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(bytes.data()), file_size);
+  if (!file) {
+    std::cerr << "Failed to read input: " << path << std::endl;
+    std::abort();
+  }
+  return bytes;
+}
+
+[[nodiscard]] std::string_view FileName(std::string_view path) {
+  const size_t separator = path.find_last_of("/\\");
+  return (separator == std::string_view::npos) ? path : path.substr(separator + 1);
+}
+
+// Compresses the contents block by block, and falls back to storing them if
+// that doesn't save space.
+void Compress(StoredData& data) {
+  const std::vector<uint8_t>& contents = data.contents;
+  const auto block_count = static_cast<uint32_t>(
+      (contents.size() + kAssetPackBlockSize - 1) / kAssetPackBlockSize);
+
+  std::vector<uint8_t> stored_bytes(size_t{block_count} * sizeof(uint32_t));
+  for (uint32_t block = 0; block < block_count; ++block) {
+    const size_t offset = size_t{block} * kAssetPackBlockSize;
+    const size_t size = std::min<size_t>(kAssetPackBlockSize, contents.size() - offset);
+    const std::vector<uint8_t> compressed = Lz4CompressBlock(contents.data() + offset, size);
+
+    const auto compressed_size = static_cast<uint32_t>(compressed.size());
+    std::memcpy(stored_bytes.data() + block * sizeof(uint32_t), &compressed_size,
+                sizeof(compressed_size));
+    stored_bytes.insert(stored_bytes.end(), compressed.begin(), compressed.end());
+  }
+
+  if (stored_bytes.size() < contents.size()) {
+    data.compression = AssetPackCompression::kLz4;
+    data.block_count = block_count;
+    data.stored_bytes = std::move(stored_bytes);
+  } else {
+    data.compression = AssetPackCompression::kNone;
+    data.block_count = 0;
+    data.stored_bytes = contents;
+  }
+}
+
+[[nodiscard]] uint64_t AlignUp(uint64_t value) {
+  return (value + kAssetPackDataAlignment - 1) & ~(kAssetPackDataAlignment - 1);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " output_path input_path..." << std::endl;
+    return 1;
+  }
+  const char* output_path = argv[1];
+
+  std::vector<InputEntry> entries;
+  std::vector<StoredData> stored_data;
+  // Content hash to the indexes of the stored data with that hash.
+  std::unordered_map<uint64_t, std::vector<size_t>> data_by_hash;
+  uint64_t input_size = 0;
+  for (int i = 2; i < argc; ++i) {
+    const std::string name(FileName(argv[i]));
+    const uint64_t name_hash = AssetPackHash(name.data(), name.size());
+    for (const InputEntry& entry : entries) {
+      if (entry.name == name) {
+        std::cerr << "Duplicate entry name: " << name << std::endl;
+        return 1;
+      }
+    }
+
+    std::vector<uint8_t> contents = ReadInputFile(argv[i]);
+    input_size += contents.size();
+    const uint64_t content_hash = AssetPackHash(contents.data(), contents.size());
+    std::vector<size_t>& candidates = data_by_hash[content_hash];
+    auto duplicate = std::find_if(candidates.begin(), candidates.end(), [&](size_t index) {
+      return stored_data[index].contents == contents;
+    });
+    if (duplicate != candidates.end()) {
+      entries.push_back({ .name = name, .name_hash = name_hash, .data_index = *duplicate });
+      continue;
+    }
+
+    candidates.push_back(stored_data.size());
+    entries.push_back({ .name = name, .name_hash = name_hash, .data_index = stored_data.size() });
+    StoredData& data = stored_data.emplace_back();
+    data.content_hash = content_hash;
+    data.size = contents.size();
+    data.contents = std::move(contents);
+    Compress(data);
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const InputEntry& lhs, const InputEntry& rhs) {
+    if (lhs.name_hash != rhs.name_hash)
+      return lhs.name_hash < rhs.name_hash;
+    return lhs.name < rhs.name;
+  });
+
+  std::string name_table;
+  for (const InputEntry& entry : entries)
+    name_table += entry.name;
+
+  AssetPackHeader header = {};
+  std::memcpy(header.magic, kAssetPackMagic, sizeof(kAssetPackMagic));
+  header.entry_count = static_cast<uint32_t>(entries.size());
+  header.name_table_size = static_cast<uint32_t>(name_table.size());
+  header.index_offset = sizeof(AssetPackHeader);
+  header.name_table_offset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+
+  uint64_t data_end = header.name_table_offset + header.name_table_size;
+  for (StoredData& data : stored_data) {
+    data.offset = AlignUp(data_end);
+    data_end = data.offset + data.stored_bytes.size();
+  }
+
+  std::vector<AssetPackEntry> index;
+  index.reserve(entries.size());
+  uint32_t name_offset = 0;
+  for (const InputEntry& entry : entries) {
+    const StoredData& data = stored_data[entry.data_index];
+    index.push_back({
+      .name_hash = entry.name_hash,
+      .content_hash = data.content_hash,
+      .data_offset = data.offset,
+      .stored_size = data.stored_bytes.size(),
+      .size = data.size,
+      .name_offset = name_offset,
+      .name_size = static_cast<uint32_t>(entry.name.size()),
+      .compression = data.compression,
+      .block_count = data.block_count,
+    });
+    name_offset += static_cast<uint32_t>(entry.name.size());
+  }
+
+  std::ofstream file(output_path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(index.data()),
+             static_cast<std::streamsize>(index.size() * sizeof(AssetPackEntry)));
+  file.write(name_table.data(), static_cast<std::streamsize>(name_table.size()));
+  uint64_t position = header.name_table_offset + header.name_table_size;
+  for (const StoredData& data : stored_data) {
+    static const char kPadding[kAssetPackDataAlignment] = {};
+    file.write(kPadding, static_cast<std::streamsize>(data.offset - position));
+    file.write(reinterpret_cast<const char*>(data.stored_bytes.data()),
+               static_cast<std::streamsize>(data.stored_bytes.size()));
+    position = data.offset + data.stored_bytes.size();
+  }
+  if (!file.flush()) {
+    std::cerr << "Failed to write asset pack: " << output_path << std::endl;
+    return 1;
+  }
+
+  std::cout << output_path << ": " << entries.size() << " entries, " << input_size
+            << " bytes packed into " << position << " bytes\n";
+  return 0;
+}
@@ -0,0 +1,81 @@
+#ifndef ASSET_PACK_FORMAT_H_
+#define ASSET_PACK_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// The asset pack file format.
+//
+// A pack starts with an AssetPackHeader, followed by the index, the name
+// table and the entries' data. The index is an array of AssetPackEntry
+// records, sorted by name hash and then by name. Names are stored in the
+// name table without terminators. Entries with identical contents share
+// their data.
+//
+// Each entry's data starts at an offset aligned to kAssetPackDataAlignment,
+// so uncompressed entries can be copied to GPU buffers straight from the
+// mapped file. kLz4 entries are split into blocks of kAssetPackBlockSize
+// bytes, except for the last block, which may be shorter. Each block is
+// compressed on its own, so large entries can be decompressed in parallel.
+// The entry's data starts with the compressed size of each block, as
+// uint32_t, followed by the blocks.
+//
+// Integers are stored in little-endian order.
+
+// The last byte is the format version.
+inline constexpr char kAssetPackMagic[8] = {'V', 'K', 'A', 'S', 'S', 'E', 'T', 1};
+
+// Covers optimalBufferCopyOffsetAlignment and nonCoherentAtomSize on the
+// hardware we target.
+inline constexpr uint64_t kAssetPackDataAlignment = 256;
+
+inline constexpr uint32_t kAssetPackBlockSize = 256 * 1024;
+
+enum class AssetPackCompression : uint32_t {
+  kNone = 0,
+  // LZ4 block format. See lz4_block.h.
+  kLz4 = 1,
+};
+
+struct AssetPackHeader {
+  char magic[8];
+  uint32_t entry_count;
+  uint32_t name_table_size;
+  // Relative to the start of the file.
+  uint64_t index_offset;
+  uint64_t name_table_offset;
+};
+static_assert(sizeof(AssetPackHeader) == 32);
+
+struct AssetPackEntry {
+  // AssetPackHash() of the name.
+  uint64_t name_hash;
+  // AssetPackHash() of the uncompressed contents.
+  uint64_t content_hash;
+  // Relative to the start of the file.
+  uint64_t data_offset;
+  // The number of bytes at `data_offset`.
+  uint64_t stored_size;
+  // The uncompressed size.
+  uint64_t size;
+  // Relative to the start of the name table.
+  uint32_t name_offset;
+  uint32_t name_size;
+  AssetPackCompression compression;
+  // Zero for kNone entries.
+  uint32_t block_count;
+};
+static_assert(sizeof(AssetPackEntry) == 56);
+
+// 64-bit FNV-1a.
+[[nodiscard]] inline uint64_t AssetPackHash(const void* data, size_t size) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  uint64_t hash = 0xCBF29CE484222325;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3;
+  }
+  return hash;
+}
+
+#endif  // ASSET_PACK_FORMAT_H_
@@ -0,0 +1,92 @@
+#include "capture_stream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+void CaptureWriter::WriteVarint(uint64_t value) {
+  while (value >= 0x80) {
+    bytes_.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  bytes_.push_back(static_cast<uint8_t>(value));
+}
+
+void CaptureWriter::WriteSignedVarint(int64_t value) {
+  // Zigzag encoding maps small negative values to small unsigned values.
+  const uint64_t bits = static_cast<uint64_t>(value);
+  WriteVarint((bits << 1) ^ (value < 0 ? ~uint64_t{0} : 0));
+}
+
+void CaptureWriter::WriteFloat(float value) {
+  static_assert(sizeof(float) == sizeof(uint32_t));
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 4; ++i)
+    bytes_.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+}
+
+void CaptureWriter::WriteBytes(const void* data, size_t size) {
+  WriteVarint(size);
+  const uint8_t* byte_data = static_cast<const uint8_t*>(data);
+  bytes_.insert(bytes_.end(), byte_data, byte_data + size);
+}
+
+uint64_t CaptureReader::ReadVarint() {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (data_ == end_) {
+      has_error_ = true;
+      return 0;
+    }
+    const uint8_t byte = *data_++;
+    value |= uint64_t{byte & 0x7Fu} << shift;
+    if ((byte & 0x80) == 0)
+      return value;
+  }
+  has_error_ = true;
+  return 0;
+}
+
+uint32_t CaptureReader::ReadVarint32() {
+  const uint64_t value = ReadVarint();
+  if (value > std::numeric_limits<uint32_t>::max()) {
+    has_error_ = true;
+    return 0;
+  }
+  return static_cast<uint32_t>(value);
+}
+
+int64_t CaptureReader::ReadSignedVarint() {
+  const uint64_t bits = ReadVarint();
+  return static_cast<int64_t>((bits >> 1) ^ (~(bits & 1) + 1));
+}
+
+float CaptureReader::ReadFloat() {
+  if (end_ - data_ < 4) {
+    has_error_ = true;
+    return 0.0f;
+  }
+  uint32_t bits = 0;
+  for (int i = 0; i < 4; ++i)
+    bits |= uint32_t{*data_++} << (8 * i);
+
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+const uint8_t* CaptureReader::ReadBytes(size_t* size) {
+  const uint64_t byte_count = ReadVarint();
+  if (has_error_ || byte_count > static_cast<uint64_t>(end_ - data_)) {
+    has_error_ = true;
+    *size = 0;
+    return nullptr;
+  }
+
+  const uint8_t* bytes = data_;
+  data_ += byte_count;
+  *size = static_cast<size_t>(byte_count);
+  return bytes;
+}
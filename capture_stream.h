@@ -0,0 +1,67 @@
+#ifndef CAPTURE_STREAM_H_
+#define CAPTURE_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact binary encoding used by command stream captures.
+//
+// Integers are LEB128 varints, so the small values that dominate command
+// streams take one or two bytes. Signed integers are zigzag-encoded first.
+// Floats are stored as their 4 little-endian IEEE 754 bytes.
+class CaptureWriter {
+ public:
+  CaptureWriter() = default;
+
+  CaptureWriter(const CaptureWriter&) = delete;
+  CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+  void WriteVarint(uint64_t value);
+  void WriteSignedVarint(int64_t value);
+  void WriteFloat(float value);
+  // The size is written first, as a varint.
+  void WriteBytes(const void* data, size_t size);
+
+  // Appends data written by another writer, as-is.
+  void Append(const CaptureWriter& other) {
+    bytes_.insert(bytes_.end(), other.bytes_.begin(), other.bytes_.end());
+  }
+
+  [[nodiscard]] const std::vector<uint8_t>& Bytes() const { return bytes_; }
+  void Clear() { bytes_.clear(); }
+
+ private:
+  std::vector<uint8_t> bytes_;
+};
+
+// Decodes data written by CaptureWriter.
+//
+// Reading past the end, or an over-long varint, puts the reader in an error
+// state. Reads in the error state return zeros, so callers can check
+// HasError() once after decoding a whole record.
+class CaptureReader {
+ public:
+  // The data must outlive the reader.
+  explicit CaptureReader(const uint8_t* data, size_t size) : data_(data), end_(data + size) {}
+
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+
+  [[nodiscard]] uint64_t ReadVarint();
+  [[nodiscard]] uint32_t ReadVarint32();
+  [[nodiscard]] int64_t ReadSignedVarint();
+  [[nodiscard]] float ReadFloat();
+  // Returns a pointer into the reader's data, and stores the size in `size`.
+  [[nodiscard]] const uint8_t* ReadBytes(size_t* size);
+
+  [[nodiscard]] bool AtEnd() const { return data_ == end_; }
+  [[nodiscard]] bool HasError() const { return has_error_; }
+
+ private:
+  const uint8_t* data_;
+  const uint8_t* const end_;
+  bool has_error_ = false;
+};
+
+#endif  // CAPTURE_STREAM_H_
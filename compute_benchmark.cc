@@ -0,0 +1,302 @@
+// Measures VulkanComputeKernels throughput as the element count grows.
+//
+// Usage: compute_benchmark [max_log2_count] [iterations]
+//
+// Runs on a compute-only device, without a window system. Each kernel's
+// output is checked against a CPU implementation before it is timed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "asset_pack.h"
+#include "vulkan_compute_kernels.h"
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+
+namespace {
+
+constexpr int kMinLog2Count = 16;
+
+struct BoundBuffer {
+  vk::UniqueBuffer buffer;
+  vk::UniqueDeviceMemory memory;
+};
+
+[[nodiscard]] BoundBuffer CreateBoundBuffer(const VulkanDevice& device, vk::DeviceSize size,
+                                            vk::BufferUsageFlags usage,
+                                            vk::MemoryPropertyFlags properties) {
+  vk::Device device_handle = device.VulkanHandle();
+
+  vk::BufferCreateInfo create_info;
+  create_info
+      .setSize(size)
+      .setUsage(usage)
+      .setSharingMode(vk::SharingMode::eExclusive);
+  vk::ResultValue<vk::UniqueBuffer> create_result = device_handle.createBufferUnique(create_info);
+  VulkanCheckResult("vkCreateBuffer", create_result.result);
+  vk::UniqueBuffer buffer = std::move(create_result.value);
+
+  vk::MemoryRequirements requirements = device_handle.getBufferMemoryRequirements(buffer.get());
+  std::optional<uint32_t> memory_type =
+      device.FindMemoryType(requirements.memoryTypeBits, properties);
+  if (!memory_type.has_value()) {
+    std::cerr << "No memory type with " << vk::to_string(properties) << std::endl;
+    std::abort();
+  }
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info
+      .setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(*memory_type);
+  vk::ResultValue<vk::UniqueDeviceMemory> allocate_result =
+      device_handle.allocateMemoryUnique(allocate_info);
+  VulkanCheckResult("vkAllocateMemory", allocate_result.result);
+
+  VulkanCheckResult("vkBindBufferMemory",
+                    device_handle.bindBufferMemory(buffer.get(), allocate_result.value.get(), 0));
+  return {.buffer = std::move(buffer), .memory = std::move(allocate_result.value)};
+}
+
+// Orders transfers and kernel dispatches in both directions.
+void RecordBarrier(vk::CommandBuffer command_buffer) {
+  static constexpr vk::PipelineStageFlags kStages =
+      vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader;
+
+  vk::MemoryBarrier barrier;
+  barrier
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite |
+                        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+  command_buffer.pipelineBarrier(kStages, kStages, /*dependencyFlags=*/{}, barrier,
+                                 /*bufferMemoryBarriers=*/nullptr,
+                                 /*imageMemoryBarriers=*/nullptr);
+}
+
+// Runs the commands recorded by `record` on the compute queue, and returns the
+// wall-clock time until they complete.
+class CommandRunner {
+ public:
+  explicit CommandRunner(const VulkanDevice& device) : device_(device) {
+    vk::Device device_handle = device.VulkanHandle();
+
+    vk::CommandPoolCreateInfo command_pool_info;
+    command_pool_info
+        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+        .setQueueFamilyIndex(device.ComputeQueueFamilyIndex());
+    vk::ResultValue<vk::UniqueCommandPool> command_pool =
+        device_handle.createCommandPoolUnique(command_pool_info);
+    VulkanCheckResult("vkCreateCommandPool", command_pool.result);
+    command_pool_ = std::move(command_pool.value);
+
+    vk::CommandBufferAllocateInfo allocate_info;
+    allocate_info
+        .setCommandPool(command_pool_.get())
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(1);
+    vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+        device_handle.allocateCommandBuffersUnique(allocate_info);
+    VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+    command_buffer_ = std::move(allocate_result.value[0]);
+
+    vk::ResultValue<vk::UniqueFence> fence = device_handle.createFenceUnique({});
+    VulkanCheckResult("vkCreateFence", fence.result);
+    fence_ = std::move(fence.value);
+  }
+
+  template <typename RecordFunction>
+  std::chrono::steady_clock::duration Run(RecordFunction&& record) {
+    vk::CommandBuffer command_buffer = command_buffer_.get();
+    VulkanCheckResult("vkResetCommandBuffer", command_buffer.reset());
+    vk::CommandBufferBeginInfo begin_info;
+    begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info));
+    record(command_buffer);
+    VulkanCheckResult("vkEndCommandBuffer", command_buffer.end());
+
+    vk::SubmitInfo submit_info;
+    submit_info.setCommandBuffers(command_buffer);
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    VulkanCheckResult("vkQueueSubmit", device_.ComputeQueue().submit(submit_info, fence_.get()));
+
+    vk::Device device_handle = device_.VulkanHandle();
+    VulkanCheckResult("vkWaitForFences",
+                      device_handle.waitForFences(fence_.get(), /*waitAll=*/true,
+                                                  /*timeout=*/UINT64_MAX));
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start_time;
+    VulkanCheckResult("vkResetFences", device_handle.resetFences(fence_.get()));
+    return elapsed;
+  }
+
+ private:
+  const VulkanDevice& device_;
+  vk::UniqueCommandPool command_pool_;
+  vk::UniqueCommandBuffer command_buffer_;
+  vk::UniqueFence fence_;
+};
+
+[[nodiscard]] double GigabytesPerSecond(uint64_t byte_count,
+                                        std::chrono::steady_clock::duration elapsed) {
+  return static_cast<double>(byte_count) / std::chrono::duration<double>(elapsed).count() / 1e9;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int max_log2_count = (argc > 1) ? std::atoi(argv[1]) : 22;
+  int iterations = (argc > 2) ? std::atoi(argv[2]) : 20;
+  if (max_log2_count < kMinLog2Count || max_log2_count > 26 || iterations <= 0) {
+    std::cerr << "Invalid arguments" << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Compute Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateComputeDevice(vulkan_config);
+  AssetPack asset_pack("assets.pack");
+  VulkanComputeKernels kernels(device, &asset_pack);
+  CommandRunner runner(device);
+
+  // Work buffer layout: the pristine input, the kernels' working copy, the
+  // reduction output, and the kernels' scratch space.
+  const uint32_t max_count = uint32_t{1} << max_log2_count;
+  const uint32_t input_offset = 0;
+  const uint32_t work_offset = max_count;
+  const uint32_t sum_offset = 2 * max_count;
+  const uint32_t scratch_offset = sum_offset + 1;
+  const uint32_t scratch_size = std::max(VulkanComputeKernels::ScanScratchSize(max_count),
+                                         VulkanComputeKernels::RadixSortScratchSize(max_count));
+  const vk::DeviceSize work_size = vk::DeviceSize{scratch_offset + scratch_size} * 4;
+  if (work_size > device.Limits().maxStorageBufferRange) {
+    std::cerr << "The device's storage buffers can't hold 2^" << max_log2_count
+              << " elements" << std::endl;
+    return 1;
+  }
+
+  BoundBuffer work_buffer = CreateBoundBuffer(
+      device, work_size,
+      vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc |
+          vk::BufferUsageFlagBits::eTransferDst,
+      vk::MemoryPropertyFlagBits::eDeviceLocal);
+  BoundBuffer staging_buffer = CreateBoundBuffer(
+      device, vk::DeviceSize{max_count} * 4,
+      vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+  vk::ResultValue<void*> map_result = device.VulkanHandle().mapMemory(
+      staging_buffer.memory.get(), /*offset=*/0, VK_WHOLE_SIZE);
+  VulkanCheckResult("vkMapMemory", map_result.result);
+  uint32_t* staging_words = static_cast<uint32_t*>(map_result.value);
+
+  vk::Buffer work = work_buffer.buffer.get();
+  vk::Buffer staging = staging_buffer.buffer.get();
+  vk::DescriptorSet work_set = kernels.BindBuffer(work);
+
+  std::cout << device.Name() << ": subgroup size " << kernels.SubgroupSize() << ", "
+            << iterations << " iterations\n"
+            << std::setw(10) << "elements" << std::setw(14) << "reduce GB/s" << std::setw(14)
+            << "scan GB/s" << std::setw(14) << "sort GB/s" << "\n";
+
+  std::mt19937 random_engine(42);
+  for (int log2_count = kMinLog2Count; log2_count <= max_log2_count; log2_count += 2) {
+    const uint32_t count = uint32_t{1} << log2_count;
+    const vk::DeviceSize byte_count = vk::DeviceSize{count} * 4;
+
+    std::vector<uint32_t> input(count);
+    for (uint32_t& value : input)
+      value = random_engine();
+    std::memcpy(staging_words, input.data(), byte_count);
+
+    // Copies the result at `offset` to `result`, after `record` runs.
+    auto run_and_read = [&](uint32_t offset, uint32_t result_count, auto&& record) {
+      std::ignore = runner.Run([&](vk::CommandBuffer command_buffer) {
+        command_buffer.copyBuffer(staging, work, vk::BufferCopy(0, input_offset * 4, byte_count));
+        command_buffer.copyBuffer(staging, work, vk::BufferCopy(0, work_offset * 4, byte_count));
+        command_buffer.fillBuffer(work, vk::DeviceSize{sum_offset} * 4, 4, 0);
+        RecordBarrier(command_buffer);
+        record(command_buffer);
+        RecordBarrier(command_buffer);
+        command_buffer.copyBuffer(work, staging,
+                                  vk::BufferCopy(vk::DeviceSize{offset} * 4, 0,
+                                                 vk::DeviceSize{result_count} * 4));
+      });
+      return std::vector<uint32_t>(staging_words, staging_words + result_count);
+    };
+
+    std::vector<uint32_t> sum = run_and_read(sum_offset, 1, [&](vk::CommandBuffer cb) {
+      kernels.RecordReduce(cb, work_set, work_offset, count, sum_offset);
+    });
+    std::vector<uint32_t> scan = run_and_read(work_offset, count, [&](vk::CommandBuffer cb) {
+      kernels.RecordExclusiveScan(cb, work_set, work_offset, count, scratch_offset);
+    });
+    std::vector<uint32_t> sorted = run_and_read(work_offset, count, [&](vk::CommandBuffer cb) {
+      kernels.RecordRadixSort(cb, work_set, work_offset, count, scratch_offset);
+    });
+
+    std::vector<uint32_t> expected_scan(count);
+    std::exclusive_scan(input.begin(), input.end(), expected_scan.begin(), uint32_t{0});
+    std::vector<uint32_t> expected_sorted = input;
+    std::sort(expected_sorted.begin(), expected_sorted.end());
+    if (sum[0] != std::accumulate(input.begin(), input.end(), uint32_t{0}) ||
+        scan != expected_scan || sorted != expected_sorted) {
+      std::cerr << "Kernel output mismatch for " << count << " elements" << std::endl;
+      return 1;
+    }
+
+    std::chrono::steady_clock::duration reduce_time =
+        runner.Run([&](vk::CommandBuffer command_buffer) {
+          for (int i = 0; i < iterations; ++i) {
+            command_buffer.fillBuffer(work, vk::DeviceSize{sum_offset} * 4, 4, 0);
+            RecordBarrier(command_buffer);
+            kernels.RecordReduce(command_buffer, work_set, input_offset, count, sum_offset);
+            RecordBarrier(command_buffer);
+          }
+        });
+    // The working copy is already scanned. Scanning it again does the same
+    // work.
+    std::chrono::steady_clock::duration scan_time =
+        runner.Run([&](vk::CommandBuffer command_buffer) {
+          for (int i = 0; i < iterations; ++i) {
+            kernels.RecordExclusiveScan(command_buffer, work_set, work_offset, count,
+                                        scratch_offset);
+            RecordBarrier(command_buffer);
+          }
+        });
+    // Sorting sorted keys takes the same passes, but scatters more coherently,
+    // so each iteration restores the input first.
+    std::chrono::steady_clock::duration sort_time =
+        runner.Run([&](vk::CommandBuffer command_buffer) {
+          for (int i = 0; i < iterations; ++i) {
+            command_buffer.copyBuffer(
+                work, work, vk::BufferCopy(input_offset * 4, work_offset * 4, byte_count));
+            RecordBarrier(command_buffer);
+            kernels.RecordRadixSort(command_buffer, work_set, work_offset, count,
+                                    scratch_offset);
+            RecordBarrier(command_buffer);
+          }
+        });
+
+    // Reductions read each element once. Scans read and write each element.
+    // Sorts are reported as keys sorted per second, in bytes.
+    std::cout << std::setw(10) << count << std::fixed << std::setprecision(2)
+              << std::setw(14) << GigabytesPerSecond(byte_count * iterations, reduce_time)
+              << std::setw(14) << GigabytesPerSecond(2 * byte_count * iterations, scan_time)
+              << std::setw(14) << GigabytesPerSecond(byte_count * iterations, sort_time)
+              << "\n";
+  }
+  return 0;
+}
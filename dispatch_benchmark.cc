@@ -0,0 +1,116 @@
+// Compares command recording cost through the loader and through a device dispatch table.
+//
+// Usage: dispatch_benchmark [call_count]
+//
+// The default vulkan.hpp dispatcher calls the functions exported by the
+// Vulkan loader, which jump through a trampoline to reach the driver. A
+// per-device vk::DispatchLoaderDynamic calls the driver entry points directly.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <tuple>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+
+namespace {
+
+// Each run is repeated, and the fastest repetition is reported.
+constexpr int kRepetitionCount = 5;
+
+// Records `call_count` pairs of cheap state-setting commands. Returns the
+// recording time, excluding the command pool reset.
+template <typename Dispatch>
+[[nodiscard]] std::chrono::steady_clock::duration RecordStateCommands(
+    vk::Device device, vk::CommandPool command_pool, vk::CommandBuffer command_buffer,
+    int call_count, const Dispatch& dispatcher) {
+  VulkanCheckResult("vkResetCommandPool", device.resetCommandPool(command_pool, {}));
+
+  const vk::Viewport viewport(0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f);
+  const vk::Rect2D scissor(vk::Offset2D(0, 0), vk::Extent2D(1280, 720));
+
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info, dispatcher));
+  for (int i = 0; i < call_count; ++i) {
+    command_buffer.setViewport(/*firstViewport=*/0, viewport, dispatcher);
+    command_buffer.setScissor(/*firstScissor=*/0, scissor, dispatcher);
+  }
+  VulkanCheckResult("vkEndCommandBuffer", command_buffer.end(dispatcher));
+
+  return std::chrono::steady_clock::now() - start_time;
+}
+
+template <typename Dispatch>
+[[nodiscard]] double NanosecondsPerCall(vk::Device device, vk::CommandPool command_pool,
+                                        vk::CommandBuffer command_buffer, int call_count,
+                                        const Dispatch& dispatcher) {
+  std::chrono::steady_clock::duration best_duration = std::chrono::steady_clock::duration::max();
+  for (int repetition = 0; repetition < kRepetitionCount; ++repetition) {
+    best_duration = std::min(best_duration, RecordStateCommands(
+        device, command_pool, command_buffer, call_count, dispatcher));
+  }
+  return std::chrono::duration<double, std::nano>(best_duration).count() / (2.0 * call_count);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int call_count = (argc > 1) ? std::atoi(argv[1]) : 1'000'000;
+  if (call_count <= 0) {
+    std::cerr << "Invalid call count: " << call_count << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Dispatch Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+  vk::Device device_handle = device.VulkanHandle();
+
+  vk::CommandPoolCreateInfo command_pool_info;
+  command_pool_info
+      .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+      .setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+  vk::ResultValue<vk::UniqueCommandPool> command_pool =
+      device_handle.createCommandPoolUnique(command_pool_info);
+  VulkanCheckResult("vkCreateCommandPool", command_pool.result);
+
+  vk::CommandBufferAllocateInfo allocate_info;
+  allocate_info
+      .setCommandPool(command_pool.value.get())
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+      device_handle.allocateCommandBuffersUnique(allocate_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+  vk::CommandBuffer command_buffer = allocate_result.value[0].get();
+
+  // Warms up the driver's command buffer allocations.
+  std::ignore = RecordStateCommands(device_handle, command_pool.value.get(), command_buffer,
+                                    call_count, VULKAN_HPP_DEFAULT_DISPATCHER);
+
+  double loader_ns = NanosecondsPerCall(device_handle, command_pool.value.get(),
+                                        command_buffer, call_count,
+                                        VULKAN_HPP_DEFAULT_DISPATCHER);
+  double device_ns = NanosecondsPerCall(device_handle, command_pool.value.get(),
+                                        command_buffer, call_count, device.Dispatcher());
+
+  std::cout << device.Name() << ": " << 2 * static_cast<int64_t>(call_count)
+            << " commands per run\n"
+            << "  loader trampolines: " << loader_ns << " ns/call\n"
+            << "  device dispatch:    " << device_ns << " ns/call\n"
+            << "  speedup:            " << loader_ns / device_ns << "x\n";
+  return 0;
+}
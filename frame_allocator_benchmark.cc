@@ -0,0 +1,106 @@
+// Measures VulkanFrameAllocator throughput as recording threads are added.
+//
+// Usage: frame_allocator_benchmark [frame_count] [allocations_per_thread]
+//
+// Each thread allocates uniform-sized blocks and writes to them, like a
+// recording thread filling per-draw uniforms.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "task_pool.h"
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+
+namespace {
+
+constexpr int kFramesInFlight = 2;
+constexpr vk::DeviceSize kAllocationSize = 64;
+constexpr int kMaxThreadCount = 8;
+
+// A model-view-projection matrix is 64 bytes.
+constexpr float kUniformData[16] = {
+  1.0f, 0.0f, 0.0f, 0.0f,
+  0.0f, 1.0f, 0.0f, 0.0f,
+  0.0f, 0.0f, 1.0f, 0.0f,
+  0.0f, 0.0f, 0.0f, 1.0f,
+};
+
+// Returns the allocations per second.
+[[nodiscard]] double RunBenchmark(const VulkanDevice& device, int thread_count,
+                                  int frame_count, int allocations_per_thread) {
+  // Leaves room for the alignment padding, and for each thread's partly used
+  // chunk.
+  const vk::DeviceSize bytes_per_thread = vk::DeviceSize{256} * allocations_per_thread + 131072;
+  VulkanFrameAllocator allocator(device, kFramesInFlight, bytes_per_thread * thread_count,
+                                 vk::BufferUsageFlagBits::eUniformBuffer);
+  // Destroyed before the allocator, after waiting for the submitted frames.
+  VulkanFrameCommands frame_commands(device, kFramesInFlight, /*submission_thread_index=*/0);
+  TaskPool task_pool(thread_count);
+
+  std::vector<std::unique_ptr<VulkanFrameAllocator::Cursor>> cursors;
+  for (int i = 0; i < thread_count; ++i)
+    cursors.push_back(std::make_unique<VulkanFrameAllocator::Cursor>(allocator));
+
+  std::chrono::steady_clock::duration allocation_time{};
+  for (int frame = 0; frame < frame_count; ++frame) {
+    std::ignore = frame_commands.BeginFrame();
+    allocator.BeginFrame(frame_commands);
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    for (int i = 0; i < thread_count; ++i) {
+      task_pool.Post([&cursor = *cursors[i], allocations_per_thread]() {
+        for (int j = 0; j < allocations_per_thread; ++j) {
+          VulkanFrameAllocator::Allocation allocation = cursor.Allocate(kAllocationSize);
+          std::memcpy(allocation.data, kUniformData, sizeof(kUniformData));
+        }
+      });
+    }
+    task_pool.WaitIdle();
+    allocation_time += std::chrono::steady_clock::now() - start_time;
+
+    frame_commands.SubmitFrame({}, {}, {});
+  }
+
+  const double allocation_count =
+      static_cast<double>(frame_count) * thread_count * allocations_per_thread;
+  return allocation_count / std::chrono::duration<double>(allocation_time).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frame_count = (argc > 1) ? std::atoi(argv[1]) : 200;
+  int allocations_per_thread = (argc > 2) ? std::atoi(argv[2]) : 10'000;
+  if (frame_count <= 0 || allocations_per_thread <= 0) {
+    std::cerr << "Invalid arguments" << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Frame Allocator Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+
+  std::cout << device.Name() << ": " << allocations_per_thread << " allocations of "
+            << kAllocationSize << " bytes per thread per frame\n";
+  for (int thread_count = 1; thread_count <= kMaxThreadCount; thread_count *= 2) {
+    double allocations_per_second =
+        RunBenchmark(device, thread_count, frame_count, allocations_per_thread);
+    std::cout << "  " << thread_count << " threads: " << allocations_per_second / 1e6
+              << "M allocations/sec\n";
+  }
+  return 0;
+}
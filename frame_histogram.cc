@@ -0,0 +1,78 @@
+#include "frame_histogram.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+FrameHistogram::FrameHistogram() { counts_.fill(0); }
+
+FrameHistogram::~FrameHistogram() = default;
+
+size_t FrameHistogram::BucketIndex(uint64_t value_us) {
+  assert(value_us <= kMaxValueUs);
+
+  if (value_us < kSubBucketCount)
+    return static_cast<size_t>(value_us);
+
+  // Shifts the value into [kHalfSubBucketCount, kSubBucketCount), keeping its
+  // 7 most significant bits below the leading one.
+  uint32_t shift = 1;
+  while ((value_us >> shift) >= kSubBucketCount)
+    ++shift;
+  return static_cast<size_t>(kSubBucketCount + (shift - 1) * kHalfSubBucketCount +
+                             ((value_us >> shift) - kHalfSubBucketCount));
+}
+
+uint64_t FrameHistogram::BucketMaxValue(size_t index) {
+  assert(index < kBucketCount);
+
+  if (index < kSubBucketCount)
+    return index;
+  const uint32_t shift = static_cast<uint32_t>((index - kSubBucketCount) / kHalfSubBucketCount) + 1;
+  const uint64_t mantissa = (index - kSubBucketCount) % kHalfSubBucketCount + kHalfSubBucketCount;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void FrameHistogram::Record(uint64_t value_us) {
+  ++counts_[BucketIndex(std::min(value_us, kMaxValueUs))];
+  ++count_;
+}
+
+void FrameHistogram::Add(const FrameHistogram& other) {
+  for (size_t i = 0; i < kBucketCount; ++i)
+    counts_[i] += other.counts_[i];
+  count_ += other.count_;
+}
+
+void FrameHistogram::Subtract(const FrameHistogram& other) {
+  assert(count_ >= other.count_);
+
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    assert(counts_[i] >= other.counts_[i]);
+    counts_[i] -= other.counts_[i];
+  }
+  count_ -= other.count_;
+}
+
+void FrameHistogram::Reset() {
+  counts_.fill(0);
+  count_ = 0;
+}
+
+uint64_t FrameHistogram::ValueAtPercentile(double percentile) const {
+  assert(percentile >= 0 && percentile <= 100);
+
+  if (count_ == 0)
+    return 0;
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(count_))));
+  uint64_t seen_count = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    seen_count += counts_[i];
+    if (seen_count >= rank)
+      return std::min(BucketMaxValue(i), kMaxValueUs);
+  }
+  return kMaxValueUs;
+}
@@ -0,0 +1,60 @@
+#ifndef FRAME_HISTOGRAM_H_
+#define FRAME_HISTOGRAM_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// A histogram of durations with bounded relative error, in the style of
+// HdrHistogram.
+//
+// Durations are recorded in microseconds. Values below 256 us get exact
+// buckets, and larger values get 128 buckets per power of two, so reported
+// values are within 1% of the recorded ones. Recording is a few shifts and an
+// increment, and never allocates.
+class FrameHistogram {
+ public:
+  // Larger values are recorded as this value. About 16.7 seconds.
+  static constexpr uint64_t kMaxValueUs = (uint64_t{1} << 24) - 1;
+
+  FrameHistogram();
+
+  FrameHistogram(const FrameHistogram&) = default;
+  FrameHistogram& operator=(const FrameHistogram&) = default;
+
+  ~FrameHistogram();
+
+  void Record(uint64_t value_us);
+
+  // Adds the counts of `other` to this histogram.
+  void Add(const FrameHistogram& other);
+  // Removes the counts of `other`, which must have been added to this
+  // histogram, or recorded in it.
+  void Subtract(const FrameHistogram& other);
+
+  void Reset();
+
+  [[nodiscard]] uint64_t Count() const { return count_; }
+
+  // The smallest value that `percentile` percent of the recorded values are
+  // at or below. 100 gives the maximum. Zero if the histogram is empty.
+  [[nodiscard]] uint64_t ValueAtPercentile(double percentile) const;
+
+ private:
+  static constexpr uint32_t kSubBucketBits = 8;
+  static constexpr uint64_t kSubBucketCount = uint64_t{1} << kSubBucketBits;
+  static constexpr uint64_t kHalfSubBucketCount = kSubBucketCount / 2;
+  // Exact buckets below kSubBucketCount, then one group of
+  // kHalfSubBucketCount buckets for each power of two up to kMaxValueUs.
+  static constexpr size_t kBucketCount = kSubBucketCount + (24 - kSubBucketBits) *
+                                                               kHalfSubBucketCount;
+
+  [[nodiscard]] static size_t BucketIndex(uint64_t value_us);
+  // The largest value recorded in the bucket at `index`.
+  [[nodiscard]] static uint64_t BucketMaxValue(size_t index);
+
+  std::array<uint32_t, kBucketCount> counts_;
+  uint64_t count_ = 0;
+};
+
+#endif  // FRAME_HISTOGRAM_H_
@@ -0,0 +1,214 @@
+#include "frame_metrics.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+
+#include "frame_histogram.h"
+#include "frame_stats_segment.h"
+#include "vulkan_query_ring.h"
+
+namespace {
+
+[[nodiscard]] size_t MetricIndex(FrameMetric metric) { return static_cast<size_t>(metric); }
+
+[[nodiscard]] uint64_t MsToUs(double ms) {
+  return static_cast<uint64_t>(std::llround(std::max(ms, 0.0) * 1000.0));
+}
+
+[[nodiscard]] double UsToMs(uint64_t us) { return static_cast<double>(us) / 1000.0; }
+
+[[nodiscard]] FrameStatsWindow SummarizeWindow(
+    const std::array<FrameHistogram, kFrameMetricCount>& histograms) {
+  FrameStatsWindow window;
+  window.frame_count = histograms[0].Count();
+  for (size_t i = 0; i < kFrameMetricCount; ++i) {
+    window.metrics[i] = {
+      .p50_ms = UsToMs(histograms[i].ValueAtPercentile(50)),
+      .p95_ms = UsToMs(histograms[i].ValueAtPercentile(95)),
+      .p99_ms = UsToMs(histograms[i].ValueAtPercentile(99)),
+      .max_ms = UsToMs(histograms[i].ValueAtPercentile(100)),
+    };
+  }
+  return window;
+}
+
+// Copies `name` into `zone`, truncating it if needed.
+void SetZoneName(HitchZone& zone, const char* name) {
+  std::strncpy(zone.name, name, sizeof(zone.name) - 1);
+  zone.name[sizeof(zone.name) - 1] = '\0';
+}
+
+}  // namespace
+
+FrameMetrics::FrameMetrics(FrameStatsSegment* segment, int frames_in_flight,
+                           double hitch_threshold_ms)
+    : segment_(segment),
+      hitch_threshold_ms_(hitch_threshold_ms),
+      // GPU results arrive `frames_in_flight` frames after the frame ends.
+      pending_frames_(frames_in_flight + 1),
+      sub_windows_(kSubWindowCount) {
+  assert(frames_in_flight > 0);
+  assert(hitch_threshold_ms > 0);
+}
+
+FrameMetrics::~FrameMetrics() = default;
+
+double FrameMetrics::MsSinceFrameStart() const {
+  assert(current_frame_ != nullptr);
+  return std::chrono::duration<double, std::milli>(Clock::now() - frame_start_time_).count();
+}
+
+void FrameMetrics::BeginFrame(uint64_t frame_number) {
+  assert(current_frame_ == nullptr);
+  assert(frame_number != 0);
+
+  // A frame whose results never arrived is dropped.
+  current_frame_ = &pending_frames_[frame_number % pending_frames_.size()];
+  *current_frame_ = PendingFrame();
+  current_frame_->frame_number = frame_number;
+  frame_start_time_ = Clock::now();
+}
+
+void FrameMetrics::EndFrame(uint64_t allocation_count) {
+  assert(current_frame_ != nullptr);
+  assert(zone_depth_ == 0);
+
+  const double cpu_time_ms =
+      MsSinceFrameStart() -
+      current_frame_->metric_ms[MetricIndex(FrameMetric::kAcquireWait)] -
+      current_frame_->metric_ms[MetricIndex(FrameMetric::kPresentWait)];
+  current_frame_->metric_ms[MetricIndex(FrameMetric::kCpuFrame)] = cpu_time_ms;
+  current_frame_->allocation_count = allocation_count;
+  current_frame_ = nullptr;
+}
+
+size_t FrameMetrics::BeginZone(const char* name, double start_ms) {
+  assert(current_frame_ != nullptr);
+  assert(name != nullptr);
+
+  const uint32_t depth = zone_depth_++;
+  if (current_frame_->zone_count == kMaxHitchZones)
+    return kMaxHitchZones;
+  const size_t zone_index = current_frame_->zone_count++;
+  current_frame_->zones[zone_index] = {
+    .name = name,
+    .start_ms = start_ms,
+    .duration_ms = 0,
+    .depth = depth,
+  };
+  return zone_index;
+}
+
+void FrameMetrics::EndZone(size_t zone_index, double start_ms,
+                           std::optional<FrameMetric> wait_metric) {
+  assert(current_frame_ != nullptr);
+  assert(zone_depth_ > 0);
+
+  --zone_depth_;
+  const double duration_ms = MsSinceFrameStart() - start_ms;
+  if (zone_index < kMaxHitchZones)
+    current_frame_->zones[zone_index].duration_ms = duration_ms;
+  if (wait_metric.has_value()) {
+    assert(*wait_metric == FrameMetric::kAcquireWait ||
+           *wait_metric == FrameMetric::kPresentWait);
+    current_frame_->metric_ms[MetricIndex(*wait_metric)] += duration_ms;
+  }
+}
+
+void FrameMetrics::ReportGpuFrame(const VulkanQueryRing::FrameResults& results) {
+  PendingFrame& frame = pending_frames_[results.frame_number % pending_frames_.size()];
+  // The frame wasn't timed, or its slot is still recording.
+  if (frame.frame_number != results.frame_number || &frame == current_frame_)
+    return;
+
+  double gpu_time_ms = 0;
+  for (const VulkanQueryRing::PassResult& pass : results.passes)
+    gpu_time_ms += pass.gpu_time_ms;
+  frame.metric_ms[MetricIndex(FrameMetric::kGpuFrame)] = gpu_time_ms;
+
+  RecordFrame(frame);
+  // The hitch is whichever of the CPU, with its waits, and the GPU took
+  // longer.
+  const double cpu_wall_time_ms = frame.metric_ms[MetricIndex(FrameMetric::kCpuFrame)] +
+                                  frame.metric_ms[MetricIndex(FrameMetric::kAcquireWait)] +
+                                  frame.metric_ms[MetricIndex(FrameMetric::kPresentWait)];
+  if (std::max(cpu_wall_time_ms, gpu_time_ms) > hitch_threshold_ms_)
+    ReportHitch(frame, results);
+  frame.frame_number = 0;
+}
+
+void FrameMetrics::RecordFrame(const PendingFrame& frame) {
+  MetricHistograms& sub_window = sub_windows_[current_sub_window_];
+  for (size_t i = 0; i < kFrameMetricCount; ++i) {
+    const uint64_t value_us = MsToUs(frame.metric_ms[i]);
+    sub_window[i].Record(value_us);
+    long_window_[i].Record(value_us);
+  }
+  ++frame_count_;
+
+  if (sub_window[0].Count() == static_cast<uint64_t>(kSubWindowFrameCount))
+    RotateSubWindow();
+}
+
+void FrameMetrics::RotateSubWindow() {
+  if (segment_ != nullptr) {
+    segment_->PublishSnapshot({
+      .frame_count = frame_count_,
+      .hitch_count = hitch_count_,
+      .hitch_threshold_ms = hitch_threshold_ms_,
+      .short_window = SummarizeWindow(sub_windows_[current_sub_window_]),
+      .long_window = SummarizeWindow(long_window_),
+    });
+  }
+
+  // The oldest sub-window leaves the long window.
+  current_sub_window_ = (current_sub_window_ + 1) % sub_windows_.size();
+  MetricHistograms& oldest_sub_window = sub_windows_[current_sub_window_];
+  for (size_t i = 0; i < kFrameMetricCount; ++i) {
+    long_window_[i].Subtract(oldest_sub_window[i]);
+    oldest_sub_window[i].Reset();
+  }
+}
+
+void FrameMetrics::ReportHitch(const PendingFrame& frame,
+                               const VulkanQueryRing::FrameResults& results) {
+  ++hitch_count_;
+  if (segment_ == nullptr)
+    return;
+
+  HitchReport& report = hitch_report_;
+  report.index = 0;
+  report.frame_number = frame.frame_number;
+  report.metric_ms = frame.metric_ms;
+  report.allocation_count = frame.allocation_count;
+  report.zone_count = 0;
+  for (size_t i = 0; i < frame.zone_count; ++i) {
+    const Zone& zone = frame.zones[i];
+    HitchZone& report_zone = report.zones[report.zone_count++];
+    SetZoneName(report_zone, zone.name);
+    report_zone.start_ms = zone.start_ms;
+    report_zone.duration_ms = zone.duration_ms;
+    report_zone.depth = zone.depth;
+    report_zone.is_gpu_pass = 0;
+  }
+  // GPU passes run back to back, so their start times are cumulative.
+  double gpu_start_ms = 0;
+  for (const VulkanQueryRing::PassResult& pass : results.passes) {
+    if (report.zone_count == kMaxHitchZones)
+      break;
+    HitchZone& report_zone = report.zones[report.zone_count++];
+    SetZoneName(report_zone, pass.name);
+    report_zone.start_ms = gpu_start_ms;
+    report_zone.duration_ms = pass.gpu_time_ms;
+    report_zone.depth = 0;
+    report_zone.is_gpu_pass = 1;
+    gpu_start_ms += pass.gpu_time_ms;
+  }
+  segment_->PublishHitchReport(report);
+}
@@ -0,0 +1,138 @@
+#ifndef FRAME_METRICS_H_
+#define FRAME_METRICS_H_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "frame_histogram.h"
+#include "frame_stats_segment.h"
+#include "vulkan_query_ring.h"
+
+// Records frame timings into sliding-window histograms, and reports hitches.
+//
+// CPU timings are recorded while the frame is built. The GPU time arrives
+// with the frame's query results, `frames_in_flight` frames later, and the
+// frame is recorded once both are known. The percentiles are published to a
+// FrameStatsSegment once per sub-window, and frames whose CPU or GPU time
+// exceeds the hitch threshold get a hitch report with the frame's zones. All
+// storage is allocated upfront, so recording never allocates.
+//
+// Not thread-safe. Used on the render thread.
+class FrameMetrics {
+ public:
+  // The short window is the last sub-window, and the long window covers the
+  // last kSubWindowCount sub-windows.
+  static constexpr int kSubWindowFrameCount = 60;
+  static constexpr int kSubWindowCount = 10;
+
+  // Times a trace zone of the current frame. Zones may nest.
+  //
+  // Wait zones also add their time to `wait_metric`, and are left out of the
+  // frame's CPU time.
+  class ScopedZone {
+   public:
+    // `name` must outlive the FrameMetrics, such as a string literal.
+    explicit ScopedZone(FrameMetrics& metrics, const char* name,
+                        std::optional<FrameMetric> wait_metric = std::nullopt)
+        : metrics_(metrics),
+          wait_metric_(wait_metric),
+          start_ms_(metrics.MsSinceFrameStart()),
+          zone_index_(metrics.BeginZone(name, start_ms_)) {}
+
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+
+    ~ScopedZone() { metrics_.EndZone(zone_index_, start_ms_, wait_metric_); }
+
+   private:
+    FrameMetrics& metrics_;
+    const std::optional<FrameMetric> wait_metric_;
+    const double start_ms_;
+    const size_t zone_index_;
+  };
+
+  // `segment` may be null, in which case nothing is published.
+  // `frames_in_flight` must match the VulkanQueryRing whose results are
+  // passed to ReportGpuFrame().
+  explicit FrameMetrics(FrameStatsSegment* segment, int frames_in_flight,
+                        double hitch_threshold_ms);
+
+  FrameMetrics(const FrameMetrics&) = delete;
+  FrameMetrics& operator=(const FrameMetrics&) = delete;
+
+  ~FrameMetrics();
+
+  // Starts timing a frame. Called after VulkanFrameCommands::BeginFrame(), so
+  // waiting for a free frame slot isn't counted.
+  void BeginFrame(uint64_t frame_number);
+
+  // `allocation_count` is the number of heap allocations made during the
+  // frame, or zero if they aren't counted.
+  void EndFrame(uint64_t allocation_count);
+
+  // Called from the VulkanQueryRing's results callback.
+  void ReportGpuFrame(const VulkanQueryRing::FrameResults& results);
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Zone {
+    const char* name;
+    double start_ms;
+    double duration_ms;
+    uint32_t depth;
+  };
+
+  // A frame whose CPU work ended, waiting for its GPU results.
+  struct PendingFrame {
+    // Zero if the slot is free.
+    uint64_t frame_number = 0;
+    std::array<double, kFrameMetricCount> metric_ms = {};
+    uint64_t allocation_count = 0;
+    std::array<Zone, kMaxHitchZones> zones;
+    size_t zone_count = 0;
+  };
+
+  using MetricHistograms = std::array<FrameHistogram, kFrameMetricCount>;
+
+  // Returns the zone's index, which is kMaxHitchZones if the frame has too
+  // many zones to keep.
+  [[nodiscard]] size_t BeginZone(const char* name, double start_ms);
+  void EndZone(size_t zone_index, double start_ms, std::optional<FrameMetric> wait_metric);
+
+  [[nodiscard]] double MsSinceFrameStart() const;
+
+  // Adds a complete frame to the histograms.
+  void RecordFrame(const PendingFrame& frame);
+  void ReportHitch(const PendingFrame& frame, const VulkanQueryRing::FrameResults& results);
+  // Publishes the windows, then starts a new sub-window.
+  void RotateSubWindow();
+
+  FrameStatsSegment* const segment_;
+  const double hitch_threshold_ms_;
+
+  // Indexed by frame number modulo the size.
+  std::vector<PendingFrame> pending_frames_;
+  // Null outside BeginFrame() / EndFrame().
+  PendingFrame* current_frame_ = nullptr;
+  Clock::time_point frame_start_time_;
+  uint32_t zone_depth_ = 0;
+
+  // A ring of kSubWindowCount sub-windows.
+  std::vector<MetricHistograms> sub_windows_;
+  size_t current_sub_window_ = 0;
+  // The sum of `sub_windows_`.
+  MetricHistograms long_window_;
+
+  uint64_t frame_count_ = 0;
+  uint64_t hitch_count_ = 0;
+
+  // Reused across reports to avoid allocations.
+  HitchReport hitch_report_ = {};
+};
+
+#endif  // FRAME_METRICS_H_
@@ -0,0 +1,253 @@
+#include "frame_stats_segment.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+// "VKSTATS" followed by the layout version.
+constexpr uint64_t kMagic = 0x0153544154534B56;
+
+// Readers give up after this many attempts that raced with the writer.
+constexpr int kMaxReadAttempts = 64;
+
+// A value guarded by a sequence lock.
+//
+// The writer makes the sequence odd while it copies the value, so readers
+// can tell when their copy may be torn. The value is copied in 64-bit atomic
+// words, which works across processes because the atomics are lock-free.
+template <typename T>
+class SeqlockRecord {
+ public:
+  static_assert(std::is_trivially_copyable_v<T>);
+  static_assert(sizeof(T) % sizeof(uint64_t) == 0);
+  static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+  void Write(const T& value) {
+    uint64_t words[kWordCount];
+    std::memcpy(words, &value, sizeof(T));
+
+    const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWordCount; ++i)
+      words_[i].store(words[i], std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Returns false if the value was never written, or if the read raced with
+  // a write.
+  [[nodiscard]] bool TryRead(T& value) const {
+    const uint64_t sequence = sequence_.load(std::memory_order_acquire);
+    if (sequence == 0 || (sequence & 1) != 0)
+      return false;
+    uint64_t words[kWordCount];
+    for (size_t i = 0; i < kWordCount; ++i)
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != sequence)
+      return false;
+    std::memcpy(&value, words, sizeof(T));
+    return true;
+  }
+
+  // True once the value was written.
+  [[nodiscard]] bool IsWritten() const {
+    return sequence_.load(std::memory_order_acquire) != 0;
+  }
+
+ private:
+  static constexpr size_t kWordCount = sizeof(T) / sizeof(uint64_t);
+
+  std::atomic<uint64_t> sequence_{0};
+  std::atomic<uint64_t> words_[kWordCount] = {};
+};
+
+// Retries `try_read` while it races with the writer.
+template <typename TryRead>
+[[nodiscard]] bool ReadWithRetries(const TryRead& try_read) {
+  for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+    if (try_read())
+      return true;
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+}  // namespace
+
+struct FrameStatsSegment::Layout {
+  // Stored last by Create(), so readers never see a partial layout.
+  std::atomic<uint64_t> magic{0};
+  std::atomic<uint64_t> writer_process_id{0};
+  SeqlockRecord<FrameStatsSnapshot> snapshot;
+  std::atomic<uint64_t> hitch_report_count{0};
+  SeqlockRecord<HitchReport> hitch_reports[kHitchReportCapacity];
+};
+
+const char* FrameMetricName(FrameMetric metric) {
+  switch (metric) {
+    case FrameMetric::kCpuFrame:
+      return "cpu_frame";
+    case FrameMetric::kGpuFrame:
+      return "gpu_frame";
+    case FrameMetric::kAcquireWait:
+      return "acquire_wait";
+    case FrameMetric::kPresentWait:
+      return "present_wait";
+  }
+  return "unknown";
+}
+
+std::optional<FrameStatsSegment> FrameStatsSegment::Create(const char* name) {
+  assert(name != nullptr);
+
+  // A segment left behind by a crashed renderer may have an older layout.
+  shm_unlink(name);
+  const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    std::cerr << "Failed to create shared memory " << name << ": " << std::strerror(errno)
+              << std::endl;
+    return std::nullopt;
+  }
+  if (ftruncate(fd, sizeof(Layout)) != 0) {
+    std::cerr << "Failed to size shared memory " << name << ": " << std::strerror(errno)
+              << std::endl;
+    close(fd);
+    shm_unlink(name);
+    return std::nullopt;
+  }
+  void* address = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno)
+              << std::endl;
+    shm_unlink(name);
+    return std::nullopt;
+  }
+
+  Layout* layout = new (address) Layout();
+  layout->writer_process_id.store(static_cast<uint64_t>(getpid()), std::memory_order_relaxed);
+  layout->magic.store(kMagic, std::memory_order_release);
+  return FrameStatsSegment(layout, name);
+}
+
+std::optional<FrameStatsSegment> FrameStatsSegment::Open(const char* name) {
+  assert(name != nullptr);
+
+  const int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    std::cerr << "Failed to open shared memory " << name << ": " << std::strerror(errno)
+              << std::endl;
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(Layout)) {
+    std::cerr << "Shared memory " << name << " is not a frame stats segment" << std::endl;
+    close(fd);
+    return std::nullopt;
+  }
+  void* address = mmap(nullptr, sizeof(Layout), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    std::cerr << "Failed to map shared memory " << name << ": " << std::strerror(errno)
+              << std::endl;
+    return std::nullopt;
+  }
+
+  Layout* layout = static_cast<Layout*>(address);
+  if (layout->magic.load(std::memory_order_acquire) != kMagic) {
+    std::cerr << "Shared memory " << name << " has an unsupported layout" << std::endl;
+    munmap(address, sizeof(Layout));
+    return std::nullopt;
+  }
+  return FrameStatsSegment(layout, std::string());
+}
+
+FrameStatsSegment::FrameStatsSegment(Layout* layout, std::string owned_name)
+    : layout_(layout), owned_name_(std::move(owned_name)) {
+  assert(layout != nullptr);
+}
+
+FrameStatsSegment::FrameStatsSegment(FrameStatsSegment&& rhs) noexcept
+    : layout_(std::exchange(rhs.layout_, nullptr)), owned_name_(std::move(rhs.owned_name_)) {
+  rhs.owned_name_.clear();
+}
+
+FrameStatsSegment& FrameStatsSegment::operator=(FrameStatsSegment&& rhs) noexcept {
+  std::swap(layout_, rhs.layout_);
+  owned_name_.swap(rhs.owned_name_);
+  return *this;
+}
+
+FrameStatsSegment::~FrameStatsSegment() {
+  if (layout_ == nullptr)
+    return;
+  munmap(layout_, sizeof(Layout));
+  if (!owned_name_.empty())
+    shm_unlink(owned_name_.c_str());
+}
+
+uint64_t FrameStatsSegment::WriterProcessId() const {
+  assert(layout_ != nullptr);
+  return layout_->writer_process_id.load(std::memory_order_relaxed);
+}
+
+void FrameStatsSegment::PublishSnapshot(const FrameStatsSnapshot& snapshot) {
+  assert(layout_ != nullptr);
+  assert(!owned_name_.empty());
+
+  layout_->snapshot.Write(snapshot);
+}
+
+void FrameStatsSegment::PublishHitchReport(const HitchReport& report) {
+  assert(layout_ != nullptr);
+  assert(!owned_name_.empty());
+
+  const uint64_t index = layout_->hitch_report_count.load(std::memory_order_relaxed);
+  HitchReport indexed_report = report;
+  indexed_report.index = index;
+  layout_->hitch_reports[index % kHitchReportCapacity].Write(indexed_report);
+  layout_->hitch_report_count.store(index + 1, std::memory_order_release);
+}
+
+bool FrameStatsSegment::ReadSnapshot(FrameStatsSnapshot& snapshot) const {
+  assert(layout_ != nullptr);
+
+  if (!layout_->snapshot.IsWritten())
+    return false;
+  return ReadWithRetries([&]() { return layout_->snapshot.TryRead(snapshot); });
+}
+
+uint64_t FrameStatsSegment::HitchReportCount() const {
+  assert(layout_ != nullptr);
+  return layout_->hitch_report_count.load(std::memory_order_acquire);
+}
+
+bool FrameStatsSegment::ReadHitchReport(uint64_t index, HitchReport& report) const {
+  assert(layout_ != nullptr);
+
+  if (index >= HitchReportCount())
+    return false;
+  const SeqlockRecord<HitchReport>& record = layout_->hitch_reports[index % kHitchReportCapacity];
+  if (!ReadWithRetries([&]() { return record.TryRead(report); }))
+    return false;
+  // The slot may have been reused for a newer report.
+  return report.index == index;
+}
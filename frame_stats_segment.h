@@ -0,0 +1,130 @@
+#ifndef FRAME_STATS_SEGMENT_H_
+#define FRAME_STATS_SEGMENT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// The frame timings tracked by FrameMetrics.
+enum class FrameMetric : uint32_t {
+  // Time spent building and submitting the frame on the CPU, without waits.
+  kCpuFrame = 0,
+  // Time the frame's passes took on the GPU.
+  kGpuFrame = 1,
+  // Time spent acquiring swap chain images.
+  kAcquireWait = 2,
+  // Time spent in vkQueuePresentKHR().
+  kPresentWait = 3,
+};
+constexpr size_t kFrameMetricCount = 4;
+
+[[nodiscard]] const char* FrameMetricName(FrameMetric metric);
+
+struct FrameMetricSummary {
+  double p50_ms;
+  double p95_ms;
+  double p99_ms;
+  double max_ms;
+};
+
+// Summaries of the frames completed over a sliding window.
+struct FrameStatsWindow {
+  uint64_t frame_count;
+  // Indexed by FrameMetric.
+  std::array<FrameMetricSummary, kFrameMetricCount> metrics;
+};
+
+struct FrameStatsSnapshot {
+  // Frames whose GPU results arrived.
+  uint64_t frame_count;
+  uint64_t hitch_count;
+  double hitch_threshold_ms;
+  FrameStatsWindow short_window;
+  FrameStatsWindow long_window;
+};
+
+// A CPU trace zone, or a GPU pass, of a hitched frame.
+struct HitchZone {
+  char name[32];
+  // Relative to the start of the frame's CPU work, or of its GPU work.
+  double start_ms;
+  double duration_ms;
+  // Nesting depth. GPU passes are not nested.
+  uint32_t depth;
+  uint32_t is_gpu_pass;
+};
+
+// Zones past this limit are left out of hitch reports.
+constexpr size_t kMaxHitchZones = 32;
+
+// Describes a frame that exceeded the hitch threshold.
+struct HitchReport {
+  // Assigned by FrameStatsSegment::PublishHitchReport(), in publishing order.
+  uint64_t index;
+  uint64_t frame_number;
+  // Indexed by FrameMetric.
+  std::array<double, kFrameMetricCount> metric_ms;
+  // Heap allocations made while building the frame. Zero if not counted.
+  uint64_t allocation_count;
+  uint64_t zone_count;
+  std::array<HitchZone, kMaxHitchZones> zones;
+};
+
+// Frame statistics published through POSIX shared memory.
+//
+// The renderer creates the segment and publishes to it, and tools such as
+// vulkan_stats read it from other processes. Records are guarded by sequence
+// locks, so publishing never waits for readers, and readers retry when they
+// race with the writer. Each instance is used by a single thread.
+class FrameStatsSegment {
+ public:
+  static constexpr const char* kDefaultName = "/vulkan_tutorial_stats";
+  // Older hitch reports are overwritten.
+  static constexpr size_t kHitchReportCapacity = 16;
+
+  // Replaces any segment left behind with the same name. Returns nullopt,
+  // after logging the reason, if shared memory is unavailable.
+  [[nodiscard]] static std::optional<FrameStatsSegment> Create(const char* name);
+  // Returns nullopt, after logging the reason, if no renderer created the
+  // segment.
+  [[nodiscard]] static std::optional<FrameStatsSegment> Open(const char* name);
+
+  // Moving supported so instances can be returned.
+  FrameStatsSegment(const FrameStatsSegment&) = delete;
+  FrameStatsSegment(FrameStatsSegment&&) noexcept;
+  FrameStatsSegment& operator=(const FrameStatsSegment&) = delete;
+  FrameStatsSegment& operator=(FrameStatsSegment&&) noexcept;
+
+  // Unmaps the segment. The creator also removes its name.
+  ~FrameStatsSegment();
+
+  // The process that created the segment.
+  [[nodiscard]] uint64_t WriterProcessId() const;
+
+  // Writer methods. Only valid on segments returned by Create().
+  void PublishSnapshot(const FrameStatsSnapshot& snapshot);
+  void PublishHitchReport(const HitchReport& report);
+
+  // Returns false if nothing was published yet.
+  [[nodiscard]] bool ReadSnapshot(FrameStatsSnapshot& snapshot) const;
+
+  // The number of hitch reports published so far. Reports with indexes from
+  // HitchReportCount() - kHitchReportCapacity up are readable.
+  [[nodiscard]] uint64_t HitchReportCount() const;
+
+  // Returns false if the report was overwritten, or not published yet.
+  [[nodiscard]] bool ReadHitchReport(uint64_t index, HitchReport& report) const;
+
+ private:
+  struct Layout;
+
+  explicit FrameStatsSegment(Layout* layout, std::string owned_name);
+
+  Layout* layout_;
+  // Empty except on the creator, which removes the name when it's destroyed.
+  std::string owned_name_;
+};
+
+#endif  // FRAME_STATS_SEGMENT_H_
@@ -1,9 +1,14 @@
-#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <optional>
-#include <string_view>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <vulkan/vulkan.hpp>
@@ -11,30 +16,61 @@
 #include <vulkan/vulkan_handles.hpp>
 #include <vulkan/vulkan_structs.hpp>
 
+#include "allocation_counter.h"
+#include "frame_metrics.h"
+#include "frame_stats_segment.h"
+#include "render_thread.h"
+#include "resolution_controller.h"
+#include "startup_graph.h"
+#include "task_pool.h"
+#include "vulkan_capture_recorder.h"
 #include "vulkan_config.h"
+#include "vulkan_deletion_queue.h"
 #include "vulkan_device.h"
-#include "vulkan_errors.h"
 #include "vulkan_extension_list.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_instance.h"
 #include "vulkan_layer_list.h"
 #include "vulkan_physical_device_list.h"
+#include "vulkan_present_batch.h"
 #include "vulkan_presentation_context.h"
+#include "vulkan_query_ring.h"
+#include "vulkan_render_pass_cache.h"
+#include "vulkan_scaled_render_target.h"
+#include "vulkan_swap_chain.h"
 
 namespace {
 
 constexpr int kWindowWidth = 800;
 constexpr int kwindowHeight = 600;
-
-// Dispatches messages from the Vulkan validation layer to an application.
-VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugCallbackThunk(
-    VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
-    VkDebugUtilsMessageTypeFlagsEXT message_type,
-    const VkDebugUtilsMessengerCallbackDataEXT* message_data,
-    void *user_data);
+constexpr int kFramesInFlight = 2;
+// GPU statistics are printed for one frame out of this many.
+constexpr uint64_t kStatsReportInterval = 600;
+// Frames whose CPU or GPU work takes longer than this get a hitch report,
+// which vulkan_stats prints.
+constexpr double kHitchThresholdMs = 33.3;
+// Captures start after startup work settles down.
+constexpr uint64_t kFirstCapturedFrame = 120;
+constexpr uint64_t kCapturedFrameCount = 60;
+// Dynamic resolution keeps the GPU time of each frame near this budget. The
+// render scale goes down to the minimum in steps of 1/kResolutionStepCount.
+constexpr double kTargetGpuTimeMs = 8.0;
+constexpr double kMinResolutionScale = 0.5;
+constexpr int kResolutionStepCount = 8;
+// Scaled render targets are multisampled with up to this many samples.
+constexpr vk::SampleCountFlagBits kMaxSampleCount = vk::SampleCountFlagBits::e4;
+// The main thread wakes up at least this often while waiting for events.
+constexpr std::chrono::milliseconds kEventTimeout(500);
 
 class HelloTriangleApplication {
  public:
-  HelloTriangleApplication()
-    : presentation_context_(), vulkan_config_(presentation_context_) {}
+  // `window_count` windows share one logical device. Frames are captured to
+  // `capture_path` for vulkan_replay, unless the path is empty.
+  explicit HelloTriangleApplication(int window_count, std::string capture_path)
+    : start_time_(std::chrono::steady_clock::now()), window_count_(window_count),
+      capture_path_(std::move(capture_path)), background_tasks_(/*thread_count=*/1) {
+    assert(window_count > 0);
+  }
 
   HelloTriangleApplication(const HelloTriangleApplication&) = delete;
   HelloTriangleApplication& operator=(const HelloTriangleApplication&) = delete;
@@ -44,169 +80,496 @@ class HelloTriangleApplication {
   void Run() {
     InitVulkan();
 
-    surface_->MainLoop();
+    {
+      // Rendering happens on its own thread, so the main thread can sleep
+      // until window events arrive. Frames are only rendered when something
+      // changed, so an idle window doesn't use any CPU or GPU time.
+      RenderThread render_thread([this]() { return RenderFrame(); });
+      render_thread.Invalidate();
+
+      // Closing the first window quits the application.
+      surfaces_[0].EventLoop(kEventTimeout, [this, &render_thread]() {
+        bool needs_redraw = false;
+        for (VulkanPresentationSurface& surface : surfaces_) {
+          if (surface.TakeNeedsRedraw())
+            needs_redraw = true;
+        }
+        if (needs_redraw)
+          render_thread.Invalidate();
+      });
+    }
 
     TeardownVulkan();
   }
 
-  void OnVulkanDebugMessage(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
-                            VkDebugUtilsMessageTypeFlagsEXT message_type,
-                            const VkDebugUtilsMessengerCallbackDataEXT* message_data) {
-    if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT ||
-        message_type != VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT) {
-      std::cerr << "Vulkan validation message: " << message_data->pMessage << std::endl;
+ private:
+  // Windowing system calls must be made on the main thread. The other stages
+  // run on workers, so physical devices are probed while the windows open.
+  void InitVulkan() {
+    using Thread = StartupGraph::Thread;
+
+    StartupGraph::StageId glfw_init = startup_graph_.AddStage(
+        "glfw_init", Thread::kMain, {}, [this]() { presentation_context_.emplace(); });
+    StartupGraph::StageId config = startup_graph_.AddStage(
+        "config", Thread::kWorker, {glfw_init},
+        [this]() { vulkan_config_.emplace(*presentation_context_); });
+    StartupGraph::StageId instance = startup_graph_.AddStage(
+        "instance", Thread::kWorker, {config},
+        [this]() { instance_.emplace(*vulkan_config_, "Hello Triangle"); });
+    StartupGraph::StageId surfaces = startup_graph_.AddStage(
+        "surfaces", Thread::kMain, {instance}, [this]() { CreateSurfaces(); });
+    StartupGraph::StageId device_probe = startup_graph_.AddStage(
+        "device_probe", Thread::kWorker, {instance},
+        [this]() { physical_devices_.emplace(instance_->VulkanHandle()); });
+    StartupGraph::StageId device = startup_graph_.AddStage(
+        "device", Thread::kMain, {surfaces, device_probe}, [this]() { CreateDevice(); });
+    startup_graph_.AddStage(
+        "swap_chains", Thread::kMain, {device}, [this]() { CreateSwapChains(); });
+    startup_graph_.AddStage(
+        "frame_commands", Thread::kWorker, {device},
+        [this]() {
+          frame_commands_.emplace(*device_, kFramesInFlight, /*submission_thread_index=*/0);
+          stats_segment_ = FrameStatsSegment::Create(FrameStatsSegment::kDefaultName);
+          frame_metrics_.emplace(stats_segment_.has_value() ? &*stats_segment_ : nullptr,
+                                 kFramesInFlight, kHitchThresholdMs);
+          query_ring_.emplace(
+              *device_, kFramesInFlight, /*max_passes=*/2, /*max_draw_groups=*/0,
+              [this](const VulkanQueryRing::FrameResults& results) {
+                OnFrameResults(results);
+              });
+          if (!capture_path_.empty()) {
+            capture_recorder_.emplace(*device_, capture_path_, kFirstCapturedFrame,
+                                      kCapturedFrameCount);
+          }
+        });
+
+    startup_graph_.Run();
+  }
+
+  void TeardownVulkan() {
+    background_tasks_.WaitIdle();
+
+    frame_commands_.reset();
+    query_ring_.reset();
+    frame_metrics_.reset();
+    stats_segment_.reset();
+    capture_recorder_.reset();
+    render_targets_.clear();
+    deletion_queue_.reset();
+    render_pass_cache_.reset();
+    swap_chains_.clear();
+    device_.reset();
+    physical_devices_.reset();
+    surfaces_.clear();
+    instance_.reset();
+    vulkan_config_.reset();
+    presentation_context_.reset();
+  }
 
-      if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
-        std::abort();
+  void CreateSurfaces() {
+    assert(instance_);
+
+    surfaces_.reserve(window_count_);
+    for (int i = 0; i < window_count_; ++i) {
+      surfaces_.push_back(presentation_context_->CreateSurface(
+          instance_->VulkanHandle(), kWindowWidth, kwindowHeight));
     }
   }
 
- private:
-  void InitVulkan() {
-    VulkanLayerList layers;
-    layers.Print();
+  void CreateDevice() {
+    assert(physical_devices_);
 
-    VulkanExtensionList extensions;
-    extensions.Print();
+    std::vector<const VulkanPresentationSurface*> surfaces;
+    for (const VulkanPresentationSurface& surface : surfaces_)
+      surfaces.push_back(&surface);
+    device_ = physical_devices_->CreateLogicalDevice(*vulkan_config_, surfaces);
+  }
 
-    CreateVulkanInstance();
-    SetupVulkanDebugMessenger();
-    surface_ = presentation_context_.CreateSurface(instance_.get(), kWindowWidth, kwindowHeight);
-    SelectPhysicalDevice();
+  void CreateSwapChains() {
+    assert(device_);
+
+    swap_chains_.reserve(surfaces_.size());
+    for (const VulkanPresentationSurface& surface : surfaces_)
+      swap_chains_.emplace_back(*device_, surface, /*old_swap_chain=*/nullptr);
+    render_pass_cache_.emplace(*device_);
+    deletion_queue_.emplace();
+
+    // Swap chains are recreated with the same format, so the render targets
+    // outlive them.
+    const vk::SampleCountFlagBits samples = device_->FramebufferSampleCount(kMaxSampleCount);
+    const vk::Format depth_format = device_->FindDepthFormat();
+    std::cout << "Rendering with " << static_cast<uint32_t>(samples) << "x MSAA, depth format "
+              << vk::to_string(depth_format) << std::endl;
+    render_targets_.reserve(swap_chains_.size());
+    for (const VulkanSwapChain& swap_chain : swap_chains_) {
+      render_targets_.push_back(std::make_unique<VulkanScaledRenderTarget>(
+          *device_, *render_pass_cache_, *deletion_queue_, swap_chain.Format().format, samples,
+          depth_format));
+    }
   }
 
-  void TeardownVulkan() {
-    device_.reset();
-    surface_.reset();
-    TeardownVulkanDebugMessenger();
-    instance_.reset();
+  // Reports the startup timings, then runs the diagnostics that were deferred
+  // so they don't delay the first frame.
+  void OnFirstFramePresented() {
+    std::chrono::duration<double, std::milli> time_to_first_frame =
+        std::chrono::steady_clock::now() - start_time_;
+    startup_graph_.PrintTimings(std::cout);
+    std::cout << "Time to first frame: " << time_to_first_frame.count() << " ms" << std::endl;
+
+    background_tasks_.Post([this]() {
+      VulkanLayerList layers;
+      layers.Print();
+
+      VulkanExtensionList extensions;
+      extensions.Print();
+
+      physical_devices_->Print();
+    });
   }
 
-  void CreateVulkanInstance() {
-    vk::ApplicationInfo application_info;
-    application_info
-        .setPApplicationName("Hello Triangle")
-        .setApplicationVersion(VK_MAKE_VERSION(1, 0, 0))
-        .setPEngineName("No engine")
-        .setEngineVersion(VK_MAKE_VERSION(1, 0, 0))
-        .setApiVersion(VK_API_VERSION_1_1);
-
-    vk::StructureChain<vk::InstanceCreateInfo, vk::DebugUtilsMessengerCreateInfoEXT>
-        create_info_chain;
-    create_info_chain.get<vk::InstanceCreateInfo>()
-        .setFlags(vk::InstanceCreateFlagBits::eEnumeratePortabilityKHR)
-        .setPApplicationInfo(&application_info)
-        .setPEnabledLayerNames(vulkan_config_.RequiredLayers())
-        .setPEnabledExtensionNames(vulkan_config_.RequiredInstanceExtensions());
-
-    // This mildly duplicates SetupVulkanValidationCallback().
-    if (vulkan_config_.WantValidation()) {
-      create_info_chain.get<vk::DebugUtilsMessengerCreateInfoEXT>()
-          .setMessageSeverity(vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning |
-                              vk::DebugUtilsMessageSeverityFlagBitsEXT::eError)
-          .setMessageType(vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation |
-                          vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance)
-          .setPfnUserCallback(&VulkanDebugCallbackThunk)
-          .setPUserData(static_cast<void*>(this));
-    } else {
-      create_info_chain.unlink<vk::DebugUtilsMessengerCreateInfoEXT>();
+  // Runs on the render thread.
+  RenderThread::FrameOutcome RenderFrame() {
+    for (size_t i = 0; i < swap_chains_.size(); ++i) {
+      if (swap_chains_[i].IsOutOfDate())
+        RecreateSwapChain(i);
     }
 
-    vk::ResultValue<vk::UniqueInstance> create_result =
-        vk::createInstanceUnique(create_info_chain.get());
+    vk::CommandBuffer command_buffer = frame_commands_->BeginFrame();
+    frame_metrics_->BeginFrame(frame_commands_->FrameNumber());
+    const AllocationCount frame_start_allocations = CurrentAllocationCount();
+    deletion_queue_->Collect(frame_commands_->CompletedFrameNumber());
+    if (capture_recorder_)
+      capture_recorder_->BeginFrame(frame_commands_->FrameNumber());
+    query_ring_->BeginFrame(*frame_commands_, command_buffer);
+    query_ring_->BeginPass(command_buffer, "clear");
+
+    wait_semaphores_.clear();
+    wait_stages_.clear();
+    signal_semaphores_.clear();
+
+    // Each swap chain acquires without blocking, so a display that's slow to
+    // release images doesn't hold back the others. It gets skipped instead,
+    // and caught up in a retried frame.
+    bool skipped_swap_chain = false;
+    acquired_images_.clear();
+    {
+      FrameMetrics::ScopedZone clear_zone(*frame_metrics_, "clear");
+      for (size_t i = 0; i < swap_chains_.size(); ++i) {
+        VulkanSwapChain& swap_chain = swap_chains_[i];
+        std::optional<VulkanSwapChain::AcquiredImage> image;
+        {
+          FrameMetrics::ScopedZone acquire_zone(*frame_metrics_, "acquire",
+                                                FrameMetric::kAcquireWait);
+          image = swap_chain.AcquireNextImage(/*timeout_ns=*/0);
+        }
+        if (!image.has_value()) {
+          skipped_swap_chain = true;
+          continue;
+        }
+        acquired_images_.emplace_back(i, *image);
+
+        // Swap chains without transfer usage can't be upscaled into, so they
+        // are rendered at full resolution.
+        const bool is_scaled =
+            static_cast<bool>(swap_chain.ImageUsage() & vk::ImageUsageFlagBits::eTransferDst);
+        if (is_scaled) {
+          RecordClear(command_buffer,
+                      render_targets_[i]->BeginFrame(*frame_commands_, command_buffer,
+                                                     swap_chain.Extent(),
+                                                     resolution_controller_.Scale()));
+        } else {
+          RecordClear(command_buffer, swap_chain, image->view);
+        }
+        wait_semaphores_.push_back(image->acquired_semaphore);
+        wait_stages_.push_back(is_scaled ? vk::PipelineStageFlagBits::eTransfer
+                                         : vk::PipelineStageFlagBits::eColorAttachmentOutput);
+        signal_semaphores_.push_back(image->render_finished_semaphore);
+        present_batch_.Add(swap_chain, image->index, image->render_finished_semaphore);
+      }
+    }
+    query_ring_->EndPass(command_buffer);
+
+    // The final pass brings the scaled frames to the swap chains' resolution.
+    query_ring_->BeginPass(command_buffer, "upscale");
+    {
+      FrameMetrics::ScopedZone upscale_zone(*frame_metrics_, "upscale");
+      for (const auto& [swap_chain_index, image] : acquired_images_) {
+        const VulkanSwapChain& swap_chain = swap_chains_[swap_chain_index];
+        if (swap_chain.ImageUsage() & vk::ImageUsageFlagBits::eTransferDst) {
+          render_targets_[swap_chain_index]->RecordUpscale(
+              command_buffer, image.image, swap_chain.Extent(), vk::ImageLayout::ePresentSrcKHR);
+        }
+      }
+    }
+    query_ring_->EndPass(command_buffer);
 
-    VulkanCheckResult("vkCreateInstance", create_result.result);
-    instance_ = std::move(create_result.value);
+    bool is_presenting = !present_batch_.IsEmpty();
+    {
+      FrameMetrics::ScopedZone submit_zone(*frame_metrics_, "submit");
+      frame_commands_->SubmitFrame(wait_semaphores_, wait_stages_, signal_semaphores_);
+    }
+    {
+      FrameMetrics::ScopedZone present_zone(*frame_metrics_, "present",
+                                            FrameMetric::kPresentWait);
+      present_batch_.Present(device_->PresentationQueue(), device_->Dispatcher());
+    }
+    if (capture_recorder_)
+      capture_recorder_->EndFrame();
+    frame_metrics_->EndFrame(CurrentAllocationCount().allocation_count -
+                             frame_start_allocations.allocation_count);
+
+    if (is_presenting && !has_presented_) {
+      has_presented_ = true;
+      OnFirstFramePresented();
+    }
+
+    // The scene is static, except for captures, which need consecutive frames.
+    const bool is_capturing =
+        capture_recorder_ &&
+        frame_commands_->FrameNumber() < kFirstCapturedFrame + kCapturedFrameCount;
+    if (is_capturing)
+      return RenderThread::FrameOutcome::kAnimating;
+    // A skipped swap chain frees an image after its next vertical blank, or
+    // never while its window is minimized. Either way, no event announces it.
+    if (skipped_swap_chain)
+      return RenderThread::FrameOutcome::kRetry;
+    return RenderThread::FrameOutcome::kIdle;
   }
 
-  void SetupVulkanDebugMessenger() {
-    assert(instance_);
+  // Runs on the render thread, when a completed frame's queries are read.
+  void OnFrameResults(const VulkanQueryRing::FrameResults& results) {
+    frame_metrics_->ReportGpuFrame(results);
+
+    double gpu_time_ms = 0;
+    for (const VulkanQueryRing::PassResult& pass : results.passes)
+      gpu_time_ms += pass.gpu_time_ms;
+    resolution_controller_.ReportFrameTime(gpu_time_ms);
 
-    if (!vulkan_config_.WantValidation())
+    if (results.frame_number % kStatsReportInterval != 0)
       return;
 
-    // vkCreateDebugUtilsMessengerEXT() isn't available for static linking.
-    PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT = nullptr;
-    vkCreateDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(
-        vkGetInstanceProcAddr(instance_.get(), "vkCreateDebugUtilsMessengerEXT"));
-    if (!vkCreateDebugUtilsMessengerEXT) {
-      std::cerr << "Failed to dynamically locate vkCreateDebugUtilsMessengerEXT()" << std::endl;
-      std::abort();
-    }
-
-    VkDebugUtilsMessengerCreateInfoEXT create_info = {
-      .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
-      .pNext = nullptr,
-      .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT,
-      .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
-          VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
-      .pfnUserCallback = &VulkanDebugCallbackThunk,
-      .pUserData = static_cast<void*>(this),
-    };
-    VkResult result = vkCreateDebugUtilsMessengerEXT(
-        instance_.get(), &create_info, /*pAllocator=*/nullptr, &debug_messenger_);
-    if (result != VK_SUCCESS) {
-      std::cerr << "vkCreateDebugUtilsMessengerEXT() failed" << std::endl;
-      std::abort();
+    std::cout << "Frame " << results.frame_number << ": render scale "
+              << resolution_controller_.Scale() << ", smoothed GPU time "
+              << resolution_controller_.SmoothedFrameTimeMs() << " ms\n";
+    for (const VulkanQueryRing::PassResult& pass : results.passes) {
+      std::cout << "Frame " << results.frame_number << " pass " << pass.name << ": "
+                << pass.gpu_time_ms << " ms, " << pass.vertex_shader_invocations
+                << " vertex invocations, " << pass.clipping_primitives
+                << " clipping primitives, " << pass.fragment_shader_invocations
+                << " fragment invocations\n";
+    }
+    for (size_t i = 0; i < render_targets_.size(); ++i) {
+      VulkanScaledRenderTarget::TransientMemory memory =
+          render_targets_[i]->GetTransientMemory();
+      std::cout << "Frame " << results.frame_number << " window " << i
+                << " transient attachments: " << memory.allocated_size / 1024
+                << " KiB allocated, " << memory.committed_size / 1024 << " KiB committed"
+                << (memory.is_lazily_allocated ? " (lazily allocated)" : "") << "\n";
     }
   }
 
-  void TeardownVulkanDebugMessenger() {
-    assert(instance_);
+  // Clears a scaled render target's images, and resolves the multisampled
+  // color image. The resolved image ends up in eTransferSrcOptimal.
+  void RecordClear(vk::CommandBuffer command_buffer,
+                   const VulkanScaledRenderTarget::Attachments& attachments) {
+    // The transient images are cleared on load and never stored, so tiled
+    // GPUs never write them to memory.
+    constexpr VulkanAttachmentKey kTransientAttachment = {
+      .format = vk::Format::eUndefined,
+      .samples = vk::SampleCountFlagBits::e1,
+      .load_op = vk::AttachmentLoadOp::eClear,
+      .store_op = vk::AttachmentStoreOp::eDontCare,
+      .initial_layout = vk::ImageLayout::eUndefined,
+      .final_layout = vk::ImageLayout::eColorAttachmentOptimal,
+    };
+    const VulkanAttachmentKey resolved_attachment = {
+      .format = attachments.color.Format(),
+      .samples = vk::SampleCountFlagBits::e1,
+      .load_op = vk::AttachmentLoadOp::eClear,
+      .store_op = vk::AttachmentStoreOp::eStore,
+      .initial_layout = vk::ImageLayout::eColorAttachmentOptimal,
+      .final_layout = vk::ImageLayout::eTransferSrcOptimal,
+    };
 
-    assert(vulkan_config_.WantValidation() == (debug_messenger_ != VK_NULL_HANDLE));
-    if (debug_messenger_ == VK_NULL_HANDLE)
-      return;
+    VulkanRenderPassKey render_pass_key;
+    framebuffer_images_.clear();
+    if (attachments.multisampled_color.has_value()) {
+      const VulkanImage& multisampled_color = *attachments.multisampled_color;
+      VulkanAttachmentKey color_attachment = kTransientAttachment;
+      color_attachment.format = multisampled_color.Format();
+      color_attachment.samples = multisampled_color.Samples();
+      render_pass_key.color_attachments.push_back(color_attachment);
+      framebuffer_images_.push_back(&multisampled_color);
+
+      // The resolve overwrites the whole image, so its contents aren't loaded.
+      VulkanAttachmentKey resolve_attachment = resolved_attachment;
+      resolve_attachment.load_op = vk::AttachmentLoadOp::eDontCare;
+      render_pass_key.resolve_attachments.push_back(resolve_attachment);
+    } else {
+      render_pass_key.color_attachments.push_back(resolved_attachment);
+    }
+    framebuffer_images_.push_back(&attachments.color);
+    if (attachments.depth.has_value()) {
+      VulkanAttachmentKey depth_attachment = kTransientAttachment;
+      depth_attachment.format = attachments.depth->Format();
+      depth_attachment.samples = attachments.depth->Samples();
+      depth_attachment.final_layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+      render_pass_key.depth_attachment = depth_attachment;
+      framebuffer_images_.push_back(&*attachments.depth);
+    }
 
-    // vkDestroyDebugUtilsMessengerEXT() isn't available for static linking.
-    PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT = nullptr;
-    vkDestroyDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(
-        vkGetInstanceProcAddr(instance_.get(), "vkDestroyDebugUtilsMessengerEXT"));
-    if (!vkDestroyDebugUtilsMessengerEXT) {
-      std::cerr << "Failed to dynamically locate vkDestroyDebugUtilsMessengerEXT()" << std::endl;
-      std::abort();
+    VulkanFramebufferKey framebuffer_key;
+    for (const VulkanImage* image : framebuffer_images_) {
+      framebuffer_key.attachments.push_back(image->View());
+      if (capture_recorder_ && capture_recorder_->IsCapturing()) {
+        capture_recorder_->DescribeImageView(image->View(), image->Format(), image->Extent(),
+                                             image->Usage(), image->Samples());
+      }
     }
-    vkDestroyDebugUtilsMessengerEXT(instance_.get(), debug_messenger_, /*pAllocator=*/nullptr);
+    framebuffer_key.extent = attachments.color.Extent();
+    RecordClear(command_buffer, render_pass_key, framebuffer_key);
   }
 
-  void SelectPhysicalDevice() {
-    assert(instance_);
+  // Clears a swap chain image, and transitions it to ePresentSrcKHR.
+  void RecordClear(vk::CommandBuffer command_buffer, const VulkanSwapChain& swap_chain,
+                   vk::ImageView view) {
+    VulkanRenderPassKey render_pass_key;
+    render_pass_key.color_attachments.push_back({
+      .format = swap_chain.Format().format,
+      .samples = vk::SampleCountFlagBits::e1,
+      .load_op = vk::AttachmentLoadOp::eClear,
+      .store_op = vk::AttachmentStoreOp::eStore,
+      .initial_layout = vk::ImageLayout::eUndefined,
+      .final_layout = vk::ImageLayout::ePresentSrcKHR,
+    });
+
+    if (capture_recorder_ && capture_recorder_->IsCapturing()) {
+      capture_recorder_->DescribeImageView(view, swap_chain.Format().format,
+                                           swap_chain.Extent(), swap_chain.ImageUsage(),
+                                           vk::SampleCountFlagBits::e1);
+    }
 
-    VulkanPhysicalDeviceList devices(instance_.get());
-    devices.Print();
+    VulkanFramebufferKey framebuffer_key;
+    framebuffer_key.attachments.push_back(view);
+    framebuffer_key.extent = swap_chain.Extent();
+    RecordClear(command_buffer, render_pass_key, framebuffer_key);
+  }
 
-    device_ = devices.CreateLogicalDevice(vulkan_config_, *surface_);
+  // Records a render pass that clears all of its attachments. Color
+  // attachments are cleared to black, and depth attachments to 1.0.
+  //
+  // `framebuffer_key`'s render pass is filled in. When capturing, its image
+  // views must already be described.
+  void RecordClear(vk::CommandBuffer command_buffer, const VulkanRenderPassKey& render_pass_key,
+                   VulkanFramebufferKey& framebuffer_key) {
+    const vk::DispatchLoaderDynamic& dispatcher = device_->Dispatcher();
+
+    vk::RenderPass render_pass = render_pass_cache_->GetRenderPass(render_pass_key);
+    framebuffer_key.render_pass = render_pass;
+    vk::Framebuffer framebuffer = render_pass_cache_->GetFramebuffer(framebuffer_key);
+
+    // Clear values are indexed by attachment, and ignored for attachments that
+    // aren't cleared on load.
+    clear_values_.clear();
+    for (size_t i = 0; i < render_pass_key.color_attachments.size(); ++i) {
+      clear_values_.emplace_back(
+          vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
+    }
+    for (size_t i = 0; i < render_pass_key.resolve_attachments.size(); ++i)
+      clear_values_.emplace_back();
+    if (render_pass_key.depth_attachment.has_value())
+      clear_values_.emplace_back(vk::ClearDepthStencilValue(1.0f, 0));
+
+    const vk::Extent2D extent = framebuffer_key.extent;
+    vk::RenderPassBeginInfo begin_info;
+    begin_info
+        .setRenderPass(render_pass)
+        .setFramebuffer(framebuffer)
+        .setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), extent))
+        .setClearValues(clear_values_);
+
+    if (capture_recorder_ && capture_recorder_->IsCapturing()) {
+      capture_recorder_->DescribeRenderPass(render_pass, render_pass_key);
+      capture_recorder_->DescribeFramebuffer(framebuffer, framebuffer_key);
+      capture_recorder_->BeginRenderPass(command_buffer, begin_info);
+      capture_recorder_->EndRenderPass(command_buffer);
+      return;
+    }
+
+    command_buffer.beginRenderPass(begin_info, vk::SubpassContents::eInline, dispatcher);
+    command_buffer.endRenderPass(dispatcher);
   }
 
-  VulkanPresentationContext presentation_context_;
-  VulkanConfig vulkan_config_;
-  vk::UniqueInstance instance_;
-  VkDebugUtilsMessengerEXT debug_messenger_ = VK_NULL_HANDLE;
-  std::optional<VulkanPresentationSurface> surface_;
-  std::optional<VulkanDevice> device_;
-};
+  // Replaces a swap chain whose surface changed.
+  //
+  // Must be called before the next frame starts.
+  void RecreateSwapChain(size_t index) {
+    // The last started frame may still use the old swap chain's images.
+    const uint64_t last_use = frame_commands_->FrameNumber();
 
-VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugCallbackThunk(
-    VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
-    VkDebugUtilsMessageTypeFlagsEXT message_type,
-    const VkDebugUtilsMessengerCallbackDataEXT* message_data,
-    void *user_data) {
-  assert(user_data);
-  HelloTriangleApplication* app = static_cast<HelloTriangleApplication*>(user_data);
+    VulkanSwapChain& swap_chain = swap_chains_[index];
+    for (size_t i = 0; i < swap_chain.ImageCount(); ++i)
+      render_pass_cache_->EvictImageView(swap_chain.ImageView(i), *deletion_queue_, last_use);
 
-  app->OnVulkanDebugMessage(message_severity, message_type, message_data);
-  return VK_FALSE;
-}
+    VulkanSwapChain new_swap_chain(*device_, surfaces_[index], swap_chain.VulkanHandle());
+    deletion_queue_->Retire(last_use, std::move(swap_chain));
+    swap_chain = std::move(new_swap_chain);
+  }
 
+  const std::chrono::steady_clock::time_point start_time_;
+  const int window_count_;
+  const std::string capture_path_;
+  StartupGraph startup_graph_{/*worker_count=*/2};
+  std::optional<VulkanPresentationContext> presentation_context_;
+  std::optional<VulkanConfig> vulkan_config_;
+  std::optional<VulkanInstance> instance_;
+  std::vector<VulkanPresentationSurface> surfaces_;
+  std::optional<VulkanPhysicalDeviceList> physical_devices_;
+  std::optional<VulkanDevice> device_;
+  std::vector<VulkanSwapChain> swap_chains_;
+  std::optional<VulkanRenderPassCache> render_pass_cache_;
+  // Destroys the resources replaced by the render targets.
+  std::optional<VulkanDeletionQueue> deletion_queue_;
+  // Indexed by swap chain index. Pointers, because the targets reference the
+  // render pass cache and aren't movable.
+  std::vector<std::unique_ptr<VulkanScaledRenderTarget>> render_targets_;
+  ResolutionController resolution_controller_{kTargetGpuTimeMs, kMinResolutionScale,
+                                              kResolutionStepCount};
+  std::optional<VulkanFrameCommands> frame_commands_;
+  // Null if shared memory is unavailable, in which case metrics are only
+  // recorded locally.
+  std::optional<FrameStatsSegment> stats_segment_;
+  std::optional<FrameMetrics> frame_metrics_;
+  std::optional<VulkanQueryRing> query_ring_;
+  std::optional<VulkanCaptureRecorder> capture_recorder_;
+  VulkanPresentBatch present_batch_;
+
+  // Reused across frames to avoid allocations.
+  std::vector<vk::Semaphore> wait_semaphores_;
+  std::vector<vk::PipelineStageFlags> wait_stages_;
+  std::vector<vk::Semaphore> signal_semaphores_;
+  std::vector<vk::ClearValue> clear_values_;
+  // The images attached to a scaled render target's framebuffer, in order.
+  std::vector<const VulkanImage*> framebuffer_images_;
+  // Swap chain indexes and the images acquired from them.
+  std::vector<std::pair<size_t, VulkanSwapChain::AcquiredImage>> acquired_images_;
+
+  bool has_presented_ = false;
+
+  // Runs diagnostics that don't need to block rendering.
+  TaskPool background_tasks_;
+};
 
 }  // namespace
 
-int main() {
-  HelloTriangleApplication app;
+// Usage: hello_triangle [window_count] [capture_path]
+int main(int argc, char** argv) {
+  int window_count = (argc > 1) ? std::atoi(argv[1]) : 1;
+  if (window_count <= 0)
+    return 1;
+  std::string capture_path = (argc > 2) ? argv[2] : "";
+
+  HelloTriangleApplication app(window_count, std::move(capture_path));
 
   app.Run();
   return 0;
@@ -0,0 +1,159 @@
+#include "image_encoding.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+[[nodiscard]] constexpr std::array<uint32_t, 256> BuildCrc32Table() {
+  std::array<uint32_t, 256> table = {};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc & 1) ? (0xEDB88320u ^ (crc >> 1)) : (crc >> 1);
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> kCrc32Table = BuildCrc32Table();
+
+[[nodiscard]] uint32_t Crc32(const uint8_t* data, size_t size) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i)
+    crc = kCrc32Table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
+void AppendBigEndian32(std::vector<uint8_t>& output, uint32_t value) {
+  output.push_back(static_cast<uint8_t>(value >> 24));
+  output.push_back(static_cast<uint8_t>(value >> 16));
+  output.push_back(static_cast<uint8_t>(value >> 8));
+  output.push_back(static_cast<uint8_t>(value));
+}
+
+void AppendLittleEndian16(std::vector<uint8_t>& output, uint16_t value) {
+  output.push_back(static_cast<uint8_t>(value));
+  output.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+// Appends a PNG chunk. The CRC covers the chunk type and the chunk data.
+void AppendPngChunk(std::vector<uint8_t>& output, const char (&type)[5],
+                    const std::vector<uint8_t>& data) {
+  AppendBigEndian32(output, static_cast<uint32_t>(data.size()));
+
+  size_t crc_start = output.size();
+  output.insert(output.end(), type, type + 4);
+  output.insert(output.end(), data.begin(), data.end());
+
+  AppendBigEndian32(output, Crc32(output.data() + crc_start, output.size() - crc_start));
+}
+
+// Wraps `data` in a zlib stream made of uncompressed DEFLATE blocks.
+[[nodiscard]] std::vector<uint8_t> ZlibStore(const std::vector<uint8_t>& data) {
+  static constexpr size_t kMaxStoredBlockSize = 65535;
+
+  std::vector<uint8_t> output;
+  output.reserve(data.size() + (data.size() / kMaxStoredBlockSize + 1) * 5 + 6);
+
+  // CMF: 32K window, deflate. FLG: no dictionary, fastest compression, FCHECK.
+  output.push_back(0x78);
+  output.push_back(0x01);
+
+  size_t offset = 0;
+  do {
+    size_t block_size = std::min(kMaxStoredBlockSize, data.size() - offset);
+    bool is_final_block = (offset + block_size == data.size());
+
+    output.push_back(is_final_block ? 0x01 : 0x00);
+    AppendLittleEndian16(output, static_cast<uint16_t>(block_size));
+    AppendLittleEndian16(output, static_cast<uint16_t>(~block_size));
+    output.insert(output.end(), data.begin() + offset, data.begin() + offset + block_size);
+
+    offset += block_size;
+  } while (offset < data.size());
+
+  uint32_t adler_a = 1, adler_b = 0;
+  for (uint8_t byte : data) {
+    adler_a = (adler_a + byte) % 65521;
+    adler_b = (adler_b + adler_a) % 65521;
+  }
+  AppendBigEndian32(output, (adler_b << 16) | adler_a);
+
+  return output;
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodeRaw(const uint8_t* pixels, uint32_t width, uint32_t height) {
+  assert(pixels != nullptr);
+
+  return std::vector<uint8_t>(pixels, pixels + size_t{width} * height * 4);
+}
+
+std::vector<uint8_t> EncodePpm(const uint8_t* pixels, uint32_t width, uint32_t height,
+                               PixelLayout layout) {
+  assert(pixels != nullptr);
+
+  std::string header =
+      "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+  size_t pixel_count = size_t{width} * height;
+
+  std::vector<uint8_t> output;
+  output.reserve(header.size() + pixel_count * 3);
+  output.insert(output.end(), header.begin(), header.end());
+
+  const bool swap_red_blue = (layout == PixelLayout::kBgra8);
+  for (size_t i = 0; i < pixel_count; ++i) {
+    const uint8_t* pixel = pixels + i * 4;
+    output.push_back(swap_red_blue ? pixel[2] : pixel[0]);
+    output.push_back(pixel[1]);
+    output.push_back(swap_red_blue ? pixel[0] : pixel[2]);
+  }
+  return output;
+}
+
+std::vector<uint8_t> EncodePng(const uint8_t* pixels, uint32_t width, uint32_t height,
+                               PixelLayout layout) {
+  assert(pixels != nullptr);
+
+  static constexpr uint8_t kPngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+  std::vector<uint8_t> header;
+  AppendBigEndian32(header, width);
+  AppendBigEndian32(header, height);
+  header.push_back(8);  // Bit depth.
+  header.push_back(6);  // Color type: RGBA.
+  header.push_back(0);  // Compression method: DEFLATE.
+  header.push_back(0);  // Filter method: adaptive.
+  header.push_back(0);  // Interlace method: none.
+
+  // Each scanline is preceded by its filter type. Filter type 0 is "None".
+  const size_t row_size = size_t{width} * 4;
+  const bool swap_red_blue = (layout == PixelLayout::kBgra8);
+  std::vector<uint8_t> scanlines;
+  scanlines.reserve((row_size + 1) * height);
+  for (uint32_t y = 0; y < height; ++y) {
+    scanlines.push_back(0);
+    const uint8_t* row = pixels + y * row_size;
+    if (!swap_red_blue) {
+      scanlines.insert(scanlines.end(), row, row + row_size);
+      continue;
+    }
+    for (uint32_t x = 0; x < width; ++x) {
+      const uint8_t* pixel = row + x * 4;
+      scanlines.insert(scanlines.end(), {pixel[2], pixel[1], pixel[0], pixel[3]});
+    }
+  }
+
+  std::vector<uint8_t> output(std::begin(kPngSignature), std::end(kPngSignature));
+  AppendPngChunk(output, "IHDR", header);
+  AppendPngChunk(output, "IDAT", ZlibStore(scanlines));
+  AppendPngChunk(output, "IEND", {});
+  return output;
+}
@@ -0,0 +1,30 @@
+#ifndef IMAGE_ENCODING_H_
+#define IMAGE_ENCODING_H_
+
+#include <cstdint>
+#include <vector>
+
+// Memory layout of the pixels handed to the encoders.
+//
+// Both layouts use 4 bytes per pixel, and rows are tightly packed.
+enum class PixelLayout {
+  kRgba8,
+  kBgra8,
+};
+
+// Copies the pixels as-is. Useful when the consumer does its own encoding.
+[[nodiscard]] std::vector<uint8_t> EncodeRaw(const uint8_t* pixels, uint32_t width,
+                                             uint32_t height);
+
+// Binary (P6) PPM. The alpha channel is dropped.
+[[nodiscard]] std::vector<uint8_t> EncodePpm(const uint8_t* pixels, uint32_t width,
+                                             uint32_t height, PixelLayout layout);
+
+// RGBA PNG.
+//
+// The image data is stored in uncompressed DEFLATE blocks. This trades file
+// size for encoding speed, and avoids a zlib dependency.
+[[nodiscard]] std::vector<uint8_t> EncodePng(const uint8_t* pixels, uint32_t width,
+                                             uint32_t height, PixelLayout layout);
+
+#endif  // IMAGE_ENCODING_H_
@@ -0,0 +1,135 @@
+#ifndef INTERN_TABLE_H_
+#define INTERN_TABLE_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Maps each distinct key to one value, which is created on first use.
+//
+// Lookups of existing keys don't take locks, so many threads can share a
+// table. Inserts are serialized by a mutex. Entries are never removed, so
+// references to values remain valid until the table is destroyed.
+//
+// The table uses open addressing with linear probing. When it becomes half
+// full, the slots are copied to a twice larger array. Readers may still be
+// probing the old array, so old arrays are kept until the table is destroyed.
+// This at most doubles the memory used by slots.
+template <typename Key, typename Value, typename Hash>
+class InternTable {
+ public:
+  InternTable() {
+    auto slots = std::make_unique<Slots>(kInitialCapacity);
+    slots_.store(slots.get(), std::memory_order_relaxed);
+    all_slots_.push_back(std::move(slots));
+  }
+
+  InternTable(const InternTable&) = delete;
+  InternTable& operator=(const InternTable&) = delete;
+
+  ~InternTable() = default;
+
+  // Returns the value for `key`, calling `create()` if the key is new.
+  //
+  // `create` runs with the table's mutex held, so it must not use the table.
+  template <typename CreateFunction>
+  const Value& FindOrInsert(const Key& key, CreateFunction&& create) {
+    const size_t hash = Hash()(key);
+
+    const Entry* entry = Find(*slots_.load(std::memory_order_acquire), key, hash);
+    if (entry != nullptr)
+      return entry->value;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Another thread may have inserted the key after the lock-free lookup.
+    Slots* slots = slots_.load(std::memory_order_relaxed);
+    entry = Find(*slots, key, hash);
+    if (entry != nullptr)
+      return entry->value;
+
+    entries_.push_back(std::make_unique<Entry>(Entry{hash, key, create()}));
+    entry = entries_.back().get();
+    if (2 * entries_.size() > slots->capacity)
+      Grow(*slots);
+    else
+      Insert(*slots, *entry);
+    return entry->value;
+  }
+
+  [[nodiscard]] size_t Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 64;
+
+  struct Entry {
+    size_t hash;
+    Key key;
+    Value value;
+  };
+
+  struct Slots {
+    // `capacity` must be a power of two.
+    explicit Slots(size_t capacity)
+        : capacity(capacity), entries(std::make_unique<std::atomic<const Entry*>[]>(capacity)) {
+      assert((capacity & (capacity - 1)) == 0);
+      for (size_t i = 0; i < capacity; ++i)
+        entries[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    const size_t capacity;
+    std::unique_ptr<std::atomic<const Entry*>[]> entries;
+  };
+
+  [[nodiscard]] static const Entry* Find(const Slots& slots, const Key& key, size_t hash) {
+    const size_t mask = slots.capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      const Entry* entry = slots.entries[i].load(std::memory_order_acquire);
+      if (entry == nullptr)
+        return nullptr;
+      if (entry->hash == hash && entry->key == key)
+        return entry;
+    }
+  }
+
+  // Must be called with `mutex_` held.
+  static void Insert(Slots& slots, const Entry& entry) {
+    const size_t mask = slots.capacity - 1;
+    size_t i = entry.hash & mask;
+    while (slots.entries[i].load(std::memory_order_relaxed) != nullptr)
+      i = (i + 1) & mask;
+
+    // Publishes the fully constructed entry to lock-free readers.
+    slots.entries[i].store(&entry, std::memory_order_release);
+  }
+
+  // Must be called with `mutex_` held.
+  void Grow(const Slots& slots) {
+    auto new_slots = std::make_unique<Slots>(2 * slots.capacity);
+    for (const std::unique_ptr<Entry>& entry : entries_)
+      Insert(*new_slots, *entry);
+
+    Slots* published_slots = new_slots.get();
+    all_slots_.push_back(std::move(new_slots));
+    slots_.store(published_slots, std::memory_order_release);
+  }
+
+  // The slots used by new lookups.
+  std::atomic<Slots*> slots_;
+
+  mutable std::mutex mutex_;
+
+  // Guarded by `mutex_`.
+  std::vector<std::unique_ptr<Entry>> entries_;
+  // Includes the slots that lock-free readers may still be probing.
+  std::vector<std::unique_ptr<Slots>> all_slots_;
+};
+
+#endif  // INTERN_TABLE_H_
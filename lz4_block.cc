@@ -0,0 +1,173 @@
+#include "lz4_block.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr size_t kMinMatchLength = 4;
+// The format requires the last 5 bytes of a block to be literals, and the
+// last match to start at least 12 bytes before the block's end.
+constexpr size_t kLastLiteralsSize = 5;
+constexpr size_t kMatchStartLimit = 12;
+constexpr size_t kMaxOffset = 65535;
+
+constexpr int kHashLog2 = 16;
+
+[[nodiscard]] uint32_t Load32(const uint8_t* bytes) {
+  uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+[[nodiscard]] uint32_t HashSequence(uint32_t sequence) {
+  // Knuth's multiplicative hash, also used by the reference implementation.
+  return (sequence * 2654435761u) >> (32 - kHashLog2);
+}
+
+// Lengths that don't fit in a token's 4 bits continue in 255-valued bytes.
+void WriteLengthTail(size_t length, std::vector<uint8_t>& output) {
+  for (; length >= 255; length -= 255)
+    output.push_back(255);
+  output.push_back(static_cast<uint8_t>(length));
+}
+
+void WriteSequence(const uint8_t* literals, size_t literal_length, size_t offset,
+                   size_t match_length, std::vector<uint8_t>& output) {
+  assert(offset > 0 && offset <= kMaxOffset);
+  assert(match_length >= kMinMatchLength);
+
+  const size_t match_code = match_length - kMinMatchLength;
+  const auto token = static_cast<uint8_t>(((literal_length < 15 ? literal_length : 15) << 4) |
+                                          (match_code < 15 ? match_code : 15));
+  output.push_back(token);
+  if (literal_length >= 15)
+    WriteLengthTail(literal_length - 15, output);
+  output.insert(output.end(), literals, literals + literal_length);
+  output.push_back(static_cast<uint8_t>(offset));
+  output.push_back(static_cast<uint8_t>(offset >> 8));
+  if (match_code >= 15)
+    WriteLengthTail(match_code - 15, output);
+}
+
+// The last sequence of a block only has literals.
+void WriteLastLiterals(const uint8_t* literals, size_t literal_length,
+                       std::vector<uint8_t>& output) {
+  output.push_back(static_cast<uint8_t>((literal_length < 15 ? literal_length : 15) << 4));
+  if (literal_length >= 15)
+    WriteLengthTail(literal_length - 15, output);
+  output.insert(output.end(), literals, literals + literal_length);
+}
+
+// Reads the rest of a length that starts with 15 in its token. Returns false
+// if the input ends first.
+[[nodiscard]] bool ReadLengthTail(const uint8_t* input, size_t input_size, size_t& position,
+                                  size_t& length) {
+  uint8_t byte;
+  do {
+    if (position == input_size)
+      return false;
+    byte = input[position++];
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}  // namespace
+
+std::vector<uint8_t> Lz4CompressBlock(const uint8_t* input, size_t size) {
+  assert(input != nullptr || size == 0);
+
+  std::vector<uint8_t> output;
+  output.reserve(size + size / 255 + 16);
+
+  size_t anchor = 0;
+  if (size > kMatchStartLimit) {
+    // Positions plus 1, so 0 marks empty slots.
+    std::vector<uint32_t> hash_table(size_t{1} << kHashLog2, 0);
+    const size_t match_start_limit = size - kMatchStartLimit;
+    const size_t match_end_limit = size - kLastLiteralsSize;
+
+    size_t position = 0;
+    while (position <= match_start_limit) {
+      const uint32_t sequence = Load32(input + position);
+      uint32_t& slot = hash_table[HashSequence(sequence)];
+      const size_t candidate = slot;
+      slot = static_cast<uint32_t>(position + 1);
+      if (candidate == 0 || position - (candidate - 1) > kMaxOffset ||
+          Load32(input + candidate - 1) != sequence) {
+        ++position;
+        continue;
+      }
+
+      const size_t match_start = candidate - 1;
+      size_t match_length = kMinMatchLength;
+      while (position + match_length < match_end_limit &&
+             input[match_start + match_length] == input[position + match_length]) {
+        ++match_length;
+      }
+      WriteSequence(input + anchor, position - anchor, position - match_start, match_length,
+                    output);
+      position += match_length;
+      anchor = position;
+    }
+  }
+  WriteLastLiterals(input + anchor, size - anchor, output);
+  return output;
+}
+
+bool Lz4DecompressBlock(const uint8_t* input, size_t input_size, uint8_t* output,
+                        size_t output_size) {
+  size_t input_position = 0;
+  size_t output_position = 0;
+  while (input_position < input_size) {
+    const uint8_t token = input[input_position++];
+
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 &&
+        !ReadLengthTail(input, input_size, input_position, literal_length)) {
+      return false;
+    }
+    if (literal_length > input_size - input_position ||
+        literal_length > output_size - output_position) {
+      return false;
+    }
+    std::memcpy(output + output_position, input + input_position, literal_length);
+    input_position += literal_length;
+    output_position += literal_length;
+
+    // The last sequence ends after its literals.
+    if (input_position == input_size)
+      break;
+
+    if (input_size - input_position < 2)
+      return false;
+    const size_t offset = input[input_position] | (size_t{input[input_position + 1]} << 8);
+    input_position += 2;
+    if (offset == 0 || offset > output_position)
+      return false;
+
+    size_t match_length = token & 15;
+    if (match_length == 15 && !ReadLengthTail(input, input_size, input_position, match_length))
+      return false;
+    match_length += kMinMatchLength;
+    if (match_length > output_size - output_position)
+      return false;
+
+    // Overlapping matches repeat the bytes they just wrote, so they are
+    // copied one byte at a time.
+    uint8_t* destination = output + output_position;
+    const uint8_t* source = destination - offset;
+    if (offset >= match_length) {
+      std::memcpy(destination, source, match_length);
+    } else {
+      for (size_t i = 0; i < match_length; ++i)
+        destination[i] = source[i];
+    }
+    output_position += match_length;
+  }
+  return output_position == output_size;
+}
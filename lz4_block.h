@@ -0,0 +1,26 @@
+#ifndef LZ4_BLOCK_H_
+#define LZ4_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression in the LZ4 block format.
+//
+// The blocks are compatible with the reference implementation's
+// LZ4_decompress_safe(), without the frame format's headers and checksums.
+// Implemented here to avoid a liblz4 dependency. The compressor is a greedy
+// single-probe matcher, which is fast and compresses about as well as the
+// reference implementation's default level.
+
+// Compresses `size` bytes from `input` into a single block.
+[[nodiscard]] std::vector<uint8_t> Lz4CompressBlock(const uint8_t* input, size_t size);
+
+// Decompresses a block whose contents are exactly `output_size` bytes.
+//
+// Returns false if the block is malformed or doesn't decompress to exactly
+// `output_size` bytes. Never reads or writes out of bounds.
+[[nodiscard]] bool Lz4DecompressBlock(const uint8_t* input, size_t input_size,
+                                      uint8_t* output, size_t output_size);
+
+#endif  // LZ4_BLOCK_H_
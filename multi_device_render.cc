@@ -0,0 +1,302 @@
+// Renders offscreen frames on all the suitable Vulkan devices at once.
+//
+// Usage: multi_device_render [job_count]
+//
+// Every frame is an independent job, scheduled on the device expected to
+// finish it first. The frames are copied back to host memory and checked.
+// Prints each device's share of the jobs and its measured throughput.
+//
+// Machines with a single GPU can exercise the scheduler by loading additional
+// drivers, such as lavapipe or the Vulkan mock ICD, via VK_ICD_FILENAMES. The
+// mock ICD doesn't execute commands, so its frames fail the pixel check.
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_image.h"
+#include "vulkan_instance.h"
+#include "vulkan_multi_device_scheduler.h"
+#include "vulkan_physical_device_list.h"
+
+namespace {
+
+constexpr vk::Extent2D kFrameExtent(640, 360);
+constexpr vk::Format kFrameFormat = vk::Format::eR8G8B8A8Unorm;
+constexpr vk::DeviceSize kFrameSize =
+    vk::DeviceSize{kFrameExtent.width} * kFrameExtent.height * 4;
+
+// The resources used by the jobs scheduled on one device.
+//
+// Only used on the device's worker thread.
+struct DeviceJobResources {
+  VulkanImage render_target;
+  vk::UniqueBuffer readback_buffer;
+  vk::UniqueDeviceMemory readback_memory;
+  const uint8_t* mapped_pixels;
+  vk::UniqueCommandPool command_pool;
+  vk::UniqueCommandBuffer command_buffer;
+  vk::UniqueFence completed_fence;
+};
+
+[[nodiscard]] DeviceJobResources CreateDeviceJobResources(const VulkanDevice& device) {
+  vk::Device logical_device = device.VulkanHandle();
+
+  vk::BufferCreateInfo buffer_info;
+  buffer_info
+      .setSize(kFrameSize)
+      .setUsage(vk::BufferUsageFlagBits::eTransferDst)
+      .setSharingMode(vk::SharingMode::eExclusive);
+  vk::ResultValue<vk::UniqueBuffer> buffer = logical_device.createBufferUnique(buffer_info);
+  VulkanCheckResult("vkCreateBuffer", buffer.result);
+
+  // Coherent memory avoids an invalidation before the pixels are read.
+  vk::MemoryRequirements requirements =
+      logical_device.getBufferMemoryRequirements(buffer.value.get());
+  std::optional<uint32_t> memory_type = device.FindMemoryType(
+      requirements.memoryTypeBits,
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+  if (!memory_type.has_value()) {
+    std::cerr << "No host-coherent memory type on " << device.Name() << std::endl;
+    std::abort();
+  }
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info
+      .setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(*memory_type);
+  vk::ResultValue<vk::UniqueDeviceMemory> memory =
+      logical_device.allocateMemoryUnique(allocate_info);
+  VulkanCheckResult("vkAllocateMemory", memory.result);
+  VulkanCheckResult("vkBindBufferMemory",
+                    logical_device.bindBufferMemory(buffer.value.get(), memory.value.get(), 0));
+  vk::ResultValue<void*> mapped = logical_device.mapMemory(memory.value.get(), 0, kFrameSize);
+  VulkanCheckResult("vkMapMemory", mapped.result);
+
+  vk::CommandPoolCreateInfo command_pool_info;
+  command_pool_info
+      .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+      .setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+  vk::ResultValue<vk::UniqueCommandPool> command_pool =
+      logical_device.createCommandPoolUnique(command_pool_info);
+  VulkanCheckResult("vkCreateCommandPool", command_pool.result);
+
+  vk::CommandBufferAllocateInfo command_buffer_info;
+  command_buffer_info
+      .setCommandPool(command_pool.value.get())
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> command_buffers =
+      logical_device.allocateCommandBuffersUnique(command_buffer_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", command_buffers.result);
+
+  vk::ResultValue<vk::UniqueFence> fence =
+      logical_device.createFenceUnique(vk::FenceCreateInfo());
+  VulkanCheckResult("vkCreateFence", fence.result);
+
+  return DeviceJobResources{
+    .render_target = VulkanImage(
+        device, kFrameExtent, kFrameFormat,
+        vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst),
+    .readback_buffer = std::move(buffer.value),
+    .readback_memory = std::move(memory.value),
+    .mapped_pixels = static_cast<const uint8_t*>(mapped.value),
+    .command_pool = std::move(command_pool.value),
+    .command_buffer = std::move(command_buffers.value[0]),
+    .completed_fence = std::move(fence.value),
+  };
+}
+
+// The color a frame is cleared to. Each frame gets a different color.
+[[nodiscard]] std::array<uint8_t, 4> FrameColor(uint64_t frame_number) {
+  return {static_cast<uint8_t>(frame_number), static_cast<uint8_t>(frame_number >> 8),
+          static_cast<uint8_t>(frame_number >> 16), 255};
+}
+
+// Stand-in for a render pass. Clears the image, then copies it to the readback buffer.
+void RecordFrame(DeviceJobResources& resources, uint64_t frame_number) {
+  vk::CommandBuffer command_buffer = resources.command_buffer.get();
+  vk::Image image = resources.render_target.VulkanHandle();
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info));
+
+  const vk::ImageSubresourceRange color_range(
+      vk::ImageAspectFlagBits::eColor, /*baseMipLevel=*/0, /*levelCount=*/1,
+      /*baseArrayLayer=*/0, /*layerCount=*/1);
+
+  vk::ImageMemoryBarrier to_transfer_destination;
+  to_transfer_destination
+      .setSrcAccessMask({})
+      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setOldLayout(vk::ImageLayout::eUndefined)
+      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image)
+      .setSubresourceRange(color_range);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      to_transfer_destination);
+
+  std::array<uint8_t, 4> color = FrameColor(frame_number);
+  vk::ClearColorValue clear_color(std::array<float, 4>{
+      color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f, color[3] / 255.0f});
+  command_buffer.clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, clear_color,
+                                 color_range);
+
+  vk::ImageMemoryBarrier to_transfer_source;
+  to_transfer_source
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+      .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image)
+      .setSubresourceRange(color_range);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      to_transfer_source);
+
+  vk::BufferImageCopy copy_region;
+  copy_region
+      .setBufferOffset(0)
+      .setBufferRowLength(0)
+      .setBufferImageHeight(0)
+      .setImageSubresource(vk::ImageSubresourceLayers(
+          vk::ImageAspectFlagBits::eColor, /*mipLevel=*/0, /*baseArrayLayer=*/0,
+          /*layerCount=*/1))
+      .setImageOffset(vk::Offset3D(0, 0, 0))
+      .setImageExtent(vk::Extent3D(kFrameExtent.width, kFrameExtent.height, 1));
+  command_buffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal,
+                                   resources.readback_buffer.get(), copy_region);
+
+  // Makes the copied pixels visible to host reads after the fence wait.
+  vk::MemoryBarrier to_host;
+  to_host
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eHostRead);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+      /*dependencyFlags=*/{}, to_host, /*bufferMemoryBarriers=*/nullptr,
+      /*imageMemoryBarriers=*/nullptr);
+
+  VulkanCheckResult("vkEndCommandBuffer", command_buffer.end());
+}
+
+[[nodiscard]] std::vector<uint8_t> RenderFrame(const VulkanDevice& device,
+                                               DeviceJobResources& resources,
+                                               uint64_t frame_number) {
+  vk::Device logical_device = device.VulkanHandle();
+
+  RecordFrame(resources, frame_number);
+
+  vk::CommandBuffer command_buffer = resources.command_buffer.get();
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  // Each device has a single worker thread, so jobs use submission thread 0's queue.
+  VulkanCheckResult("vkQueueSubmit",
+                    device.SubmissionQueue(/*thread_index=*/0)
+                        .submit(submit_info, resources.completed_fence.get()));
+
+  vk::Fence completed_fence = resources.completed_fence.get();
+  VulkanCheckResult("vkWaitForFences",
+                    logical_device.waitForFences(completed_fence, /*waitAll=*/true,
+                                                 /*timeout=*/UINT64_MAX));
+  VulkanCheckResult("vkResetFences", logical_device.resetFences(completed_fence));
+
+  std::vector<uint8_t> pixels(kFrameSize);
+  std::memcpy(pixels.data(), resources.mapped_pixels, pixels.size());
+  return pixels;
+}
+
+[[nodiscard]] bool IsFrameCorrect(uint64_t frame_number, const std::vector<uint8_t>& pixels) {
+  if (pixels.size() != kFrameSize)
+    return false;
+
+  std::array<uint8_t, 4> color = FrameColor(frame_number);
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    if (std::memcmp(&pixels[i], color.data(), color.size()) != 0)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int job_count = (argc > 1) ? std::atoi(argv[1]) : 256;
+  if (job_count <= 0) {
+    std::cerr << "Invalid job count: " << job_count << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Multi-Device Render");
+  std::vector<VulkanDevice> devices =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevices(vulkan_config);
+  if (devices.empty()) {
+    std::cerr << "No suitable Vulkan device attached" << std::endl;
+    return 1;
+  }
+
+  std::vector<DeviceJobResources> device_resources;
+  device_resources.reserve(devices.size());
+  for (const VulkanDevice& device : devices)
+    device_resources.push_back(CreateDeviceJobResources(device));
+
+  std::mutex results_mutex;
+  uint64_t incorrect_frame_count = 0;
+
+  {
+    VulkanMultiDeviceScheduler scheduler(
+        devices,
+        [&](uint64_t job_id, size_t /*device_index*/, std::vector<uint8_t> result) {
+          if (IsFrameCorrect(job_id, result))
+            return;
+          std::lock_guard<std::mutex> lock(results_mutex);
+          ++incorrect_frame_count;
+        });
+
+    // Job IDs are assigned sequentially, so they double as frame numbers.
+    for (int i = 0; i < job_count; ++i) {
+      uint64_t frame_number = static_cast<uint64_t>(i);
+      uint64_t job_id = scheduler.Submit(
+          [&device_resources, frame_number](size_t device_index, VulkanDevice& device) {
+            return RenderFrame(device, device_resources[device_index], frame_number);
+          });
+      assert(job_id == frame_number);
+      static_cast<void>(job_id);
+    }
+    scheduler.WaitIdle();
+
+    std::vector<VulkanMultiDeviceScheduler::DeviceStats> stats = scheduler.GetStats();
+    std::cout << job_count << " frames at " << kFrameExtent.width << "x" << kFrameExtent.height
+              << " on " << devices.size() << " devices\n";
+    for (size_t i = 0; i < stats.size(); ++i) {
+      std::cout << "  [" << i << "] " << stats[i].name << ": " << stats[i].completed_job_count
+                << " frames, " << stats[i].jobs_per_second << " frames/sec\n";
+    }
+  }
+
+  if (incorrect_frame_count != 0) {
+    std::cerr << incorrect_frame_count << " frames had incorrect pixels" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,310 @@
+#include "perf_baseline.h"
+
+#include <cassert>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Reads the subset of JSON used by baselines. Escape sequences in strings
+// are limited to \" and \\.
+class JsonReader {
+ public:
+  explicit JsonReader(std::string text) : text_(std::move(text)) {}
+
+  // Calls `read_member(key)` for each member of an object, which must read
+  // the member's value. Returns false if the object or a value is malformed.
+  template <typename ReadMember>
+  [[nodiscard]] bool ReadObject(const ReadMember& read_member) {
+    if (!Consume('{'))
+      return false;
+    if (Consume('}'))
+      return true;
+    do {
+      std::string key;
+      if (!ReadString(key) || !Consume(':') || !read_member(key))
+        return false;
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  [[nodiscard]] bool ReadString(std::string& value) {
+    if (!Consume('"'))
+      return false;
+    value.clear();
+    while (position_ < text_.size() && text_[position_] != '"') {
+      if (text_[position_] == '\\') {
+        ++position_;
+        if (position_ == text_.size() || (text_[position_] != '"' && text_[position_] != '\\'))
+          return false;
+      }
+      value.push_back(text_[position_++]);
+    }
+    if (position_ == text_.size())
+      return false;
+    ++position_;
+    return true;
+  }
+
+  [[nodiscard]] bool ReadBool(bool& value) {
+    SkipWhitespace();
+    for (bool literal_value : {true, false}) {
+      const char* literal = literal_value ? "true" : "false";
+      if (text_.compare(position_, std::char_traits<char>::length(literal), literal) == 0) {
+        position_ += std::char_traits<char>::length(literal);
+        value = literal_value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  [[nodiscard]] bool ReadNumber(double& value) {
+    SkipWhitespace();
+    const char* start = text_.c_str() + position_;
+    char* end;
+    value = std::strtod(start, &end);
+    if (end == start)
+      return false;
+    position_ += static_cast<size_t>(end - start);
+    return true;
+  }
+
+  // Skips a value of any type.
+  [[nodiscard]] bool SkipValue() {
+    SkipWhitespace();
+    if (position_ == text_.size())
+      return false;
+    switch (text_[position_]) {
+      case '{':
+        return ReadObject([this](const std::string&) { return SkipValue(); });
+      case '[':
+        ++position_;
+        if (Consume(']'))
+          return true;
+        do {
+          if (!SkipValue())
+            return false;
+        } while (Consume(','));
+        return Consume(']');
+      case '"': {
+        std::string ignored;
+        return ReadString(ignored);
+      }
+      default:
+        break;
+    }
+    for (const char* literal : {"true", "false", "null"}) {
+      if (text_.compare(position_, std::char_traits<char>::length(literal), literal) == 0) {
+        position_ += std::char_traits<char>::length(literal);
+        return true;
+      }
+    }
+    double ignored;
+    return ReadNumber(ignored);
+  }
+
+  // True if only whitespace is left.
+  [[nodiscard]] bool AtEnd() {
+    SkipWhitespace();
+    return position_ == text_.size();
+  }
+
+ private:
+  void SkipWhitespace() {
+    while (position_ < text_.size() &&
+           std::isspace(static_cast<unsigned char>(text_[position_]))) {
+      ++position_;
+    }
+  }
+
+  // Consumes `c` if it's the next non-whitespace character.
+  [[nodiscard]] bool Consume(char c) {
+    SkipWhitespace();
+    if (position_ == text_.size() || text_[position_] != c)
+      return false;
+    ++position_;
+    return true;
+  }
+
+  const std::string text_;
+  size_t position_ = 0;
+};
+
+// The value is optional, because unmeasured baselines omit it.
+[[nodiscard]] bool ReadBaselineEntry(JsonReader& reader, const std::string& metric,
+                                     PerfBaseline::Entry& entry) {
+  entry = { .metric = metric, .value = -1.0, .tolerance = -1.0 };
+  bool has_value = false;
+  return reader.ReadObject([&](const std::string& key) {
+    if (key == "value") {
+      has_value = true;
+      return reader.ReadNumber(entry.value);
+    }
+    if (key == "tolerance")
+      return reader.ReadNumber(entry.tolerance);
+    return reader.SkipValue();
+  }) && (!has_value || entry.value >= 0.0) && entry.tolerance >= 0.0;
+}
+
+// Quotes `value` as a JSON string.
+[[nodiscard]] std::string Quote(const std::string& value) {
+  std::string quoted = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\')
+      quoted.push_back('\\');
+    quoted.push_back(c);
+  }
+  quoted.push_back('"');
+  return quoted;
+}
+
+[[nodiscard]] std::string FormatPercent(double fraction) {
+  std::ostringstream stream;
+  stream << std::showpos << std::fixed << std::setprecision(1) << fraction * 100.0 << "%";
+  return stream.str();
+}
+
+}  // namespace
+
+bool ReadPerfBaseline(const char* path, PerfBaseline& baseline) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Failed to open baseline: " << path << std::endl;
+    return false;
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+
+  baseline = {};
+  JsonReader reader(contents.str());
+  const bool parsed = reader.ReadObject([&](const std::string& key) {
+    if (key == "device")
+      return reader.ReadString(baseline.device);
+    if (key == "measured")
+      return reader.ReadBool(baseline.is_measured);
+    if (key == "metrics") {
+      return reader.ReadObject([&](const std::string& metric) {
+        return ReadBaselineEntry(reader, metric, baseline.entries.emplace_back());
+      });
+    }
+    return reader.SkipValue();
+  });
+  if (!parsed || !reader.AtEnd()) {
+    std::cerr << "Malformed baseline: " << path << std::endl;
+    return false;
+  }
+  if (baseline.is_measured) {
+    for (const PerfBaseline::Entry& entry : baseline.entries) {
+      if (entry.value < 0.0) {
+        std::cerr << "Measured baseline without a value for " << entry.metric << ": " << path
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool WritePerfBaseline(const char* path, const PerfBaseline& baseline) {
+  std::ofstream file(path, std::ios::trunc);
+  file << "{\n"
+       << "  \"device\": " << Quote(baseline.device) << ",\n"
+       << "  \"measured\": " << (baseline.is_measured ? "true" : "false") << ",\n"
+       << "  \"metrics\": {";
+  file << std::setprecision(9);
+  for (size_t i = 0; i < baseline.entries.size(); ++i) {
+    const PerfBaseline::Entry& entry = baseline.entries[i];
+    file << (i == 0 ? "\n" : ",\n") << "    " << Quote(entry.metric) << ": { ";
+    if (baseline.is_measured)
+      file << "\"value\": " << entry.value << ", ";
+    file << "\"tolerance\": " << entry.tolerance << " }";
+  }
+  file << "\n  }\n}\n";
+  if (!file.flush()) {
+    std::cerr << "Failed to write baseline: " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int ComparePerfBaseline(const PerfBaseline& baseline, const std::vector<PerfMetric>& metrics,
+                        std::ostream& output) {
+  assert(baseline.is_measured);
+
+  constexpr int kNameWidth = 24;
+  constexpr int kNumberWidth = 14;
+  constexpr int kPercentWidth = 10;
+  output << std::left << std::setw(kNameWidth) << "metric" << std::right
+         << std::setw(kNumberWidth) << "baseline" << std::setw(kNumberWidth) << "measured"
+         << std::setw(kPercentWidth) << "change" << std::setw(kPercentWidth) << "limit"
+         << "  status\n";
+
+  int regression_count = 0;
+  auto print_row = [&](const std::string& name, const PerfBaseline::Entry* entry,
+                       const PerfMetric* metric) {
+    output << std::left << std::setw(kNameWidth) << name << std::right << std::setw(kNumberWidth);
+    if (entry != nullptr)
+      output << entry->value;
+    else
+      output << "-";
+    output << std::setw(kNumberWidth);
+    if (metric != nullptr)
+      output << metric->value;
+    else
+      output << "-";
+
+    const char* status;
+    std::string change = "-";
+    std::string limit = "-";
+    if (entry == nullptr) {
+      status = "new";
+    } else if (metric == nullptr) {
+      status = "MISSING";
+      ++regression_count;
+    } else {
+      // Zero baselines, such as steady-state allocation counts, only allow
+      // zero.
+      const double change_fraction =
+          (entry->value > 0.0) ? metric->value / entry->value - 1.0
+                               : (metric->value > 0.0 ? 1.0 : 0.0);
+      change = FormatPercent(change_fraction);
+      limit = FormatPercent(entry->tolerance);
+      if (change_fraction > entry->tolerance) {
+        status = "REGRESSED";
+        ++regression_count;
+      } else if (change_fraction < -entry->tolerance) {
+        status = "improved";
+      } else {
+        status = "ok";
+      }
+    }
+    output << std::setw(kPercentWidth) << change << std::setw(kPercentWidth) << limit << "  "
+           << status << "\n";
+  };
+
+  for (const PerfBaseline::Entry& entry : baseline.entries) {
+    const PerfMetric* metric = nullptr;
+    for (const PerfMetric& candidate : metrics) {
+      if (candidate.name == entry.metric)
+        metric = &candidate;
+    }
+    print_row(entry.metric, &entry, metric);
+  }
+  for (const PerfMetric& metric : metrics) {
+    bool has_entry = false;
+    for (const PerfBaseline::Entry& entry : baseline.entries)
+      has_entry = has_entry || entry.metric == metric.name;
+    if (!has_entry)
+      print_row(metric.name, nullptr, &metric);
+  }
+  return regression_count;
+}
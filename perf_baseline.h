@@ -0,0 +1,63 @@
+#ifndef PERF_BASELINE_H_
+#define PERF_BASELINE_H_
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// A performance measurement, where lower values are better.
+struct PerfMetric {
+  std::string name;
+  double value;
+};
+
+// The expected performance of a perf_suite scene on a reference device.
+//
+// Stored as JSON, in perf_baselines/ in the source tree:
+//
+//   {
+//     "device": "llvmpipe",
+//     "measured": true,
+//     "metrics": {
+//       "cpu_frame_ms": { "value": 0.25, "tolerance": 0.5 },
+//       ...
+//     }
+//   }
+//
+// Measurements on devices whose name doesn't contain `device` aren't
+// comparable with the baseline.
+//
+// An unmeasured baseline only lists the metrics and their tolerances, and
+// omits the values. Nothing is compared with it until `perf_suite --update`
+// fills in the values from a run on the reference device.
+struct PerfBaseline {
+  struct Entry {
+    std::string metric;
+    // Negative in unmeasured baselines.
+    double value;
+    // The allowed increase, relative to `value`. 0.1 allows 10% more.
+    double tolerance;
+  };
+
+  std::string device;
+  bool is_measured = false;
+  std::vector<Entry> entries;
+};
+
+// Returns false, after logging the reason, if the file can't be read or
+// isn't a baseline.
+[[nodiscard]] bool ReadPerfBaseline(const char* path, PerfBaseline& baseline);
+
+[[nodiscard]] bool WritePerfBaseline(const char* path, const PerfBaseline& baseline);
+
+// Prints a table comparing the metrics with the baseline, and returns the
+// number of regressions. `baseline` must be measured.
+//
+// A metric regresses if it exceeds its baseline value by more than the
+// tolerance, or if a baseline metric wasn't measured. Metrics without a
+// baseline are printed but never regress.
+[[nodiscard]] int ComparePerfBaseline(const PerfBaseline& baseline,
+                                      const std::vector<PerfMetric>& metrics,
+                                      std::ostream& output);
+
+#endif  // PERF_BASELINE_H_
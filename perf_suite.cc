@@ -0,0 +1,351 @@
+// Measures a fixed scene and compares the results with a stored baseline.
+//
+// Usage: perf_suite scene baseline_path [--update]
+//
+// Scenes render headlessly into an offscreen image:
+//   clear: clears the image, measuring the frame loop's fixed overhead
+//   sprites: draws a deterministic VulkanSpriteBatch workload
+//
+// Exits with 1 if a metric regressed, and with 77 (the conventional skip code)
+// if the device doesn't match the baseline's or the baseline is unmeasured.
+// --update rewrites the baseline with the measured values, keeping the
+// tolerances.
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "allocation_counter.h"
+#include "asset_pack.h"
+#include "perf_baseline.h"
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_image.h"
+#include "vulkan_instance.h"
+#include "vulkan_object_cache.h"
+#include "vulkan_physical_device_list.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_render_pass_cache.h"
+#include "vulkan_shader_variant_cache.h"
+#include "vulkan_sprite_batch.h"
+
+namespace {
+
+constexpr vk::Extent2D kFrameExtent(1280, 720);
+constexpr vk::Format kFrameFormat = vk::Format::eR8G8B8A8Unorm;
+constexpr vk::Extent2D kTextureExtent(64, 64);
+constexpr int kFramesInFlight = 2;
+constexpr int kWarmupFrameCount = 20;
+constexpr int kMeasuredFrameCount = 200;
+constexpr int kSpriteCount = 20'000;
+constexpr int kLayerCount = 4;
+
+// The conventional exit code for a skipped test.
+constexpr int kSkipExitCode = 77;
+
+constexpr vk::ImageSubresourceRange kColorRange(
+    vk::ImageAspectFlagBits::eColor, /*baseMipLevel=*/0, /*levelCount=*/1,
+    /*baseArrayLayer=*/0, /*layerCount=*/1);
+
+using Clock = std::chrono::steady_clock;
+
+[[nodiscard]] double ElapsedMs(Clock::time_point start_time, Clock::time_point end_time) {
+  return std::chrono::duration<double, std::milli>(end_time - start_time).count();
+}
+
+// Clears the texture and leaves it in eShaderReadOnlyOptimal.
+void RecordTextureSetup(vk::CommandBuffer command_buffer, const VulkanImage& texture) {
+  vk::ImageMemoryBarrier barrier;
+  barrier
+      .setSrcAccessMask({})
+      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setOldLayout(vk::ImageLayout::eUndefined)
+      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(texture.VulkanHandle())
+      .setSubresourceRange(kColorRange);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      barrier);
+
+  vk::ClearColorValue clear_color(std::array<float, 4>{1.0f, 1.0f, 1.0f, 1.0f});
+  command_buffer.clearColorImage(texture.VulkanHandle(), vk::ImageLayout::eTransferDstOptimal,
+                                 clear_color, kColorRange);
+
+  barrier
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+      .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      barrier);
+}
+
+// The same sprites every run, so measurements are comparable.
+[[nodiscard]] std::vector<VulkanSpriteBatch::Sprite> GenerateSprites(
+    uint32_t opaque_pipeline, uint32_t blended_pipeline, uint32_t texture) {
+  std::mt19937 random(/*seed=*/42);
+  std::uniform_real_distribution<float> x_distribution(0.0f, kFrameExtent.width - 64.0f);
+  std::uniform_real_distribution<float> y_distribution(0.0f, kFrameExtent.height - 64.0f);
+  std::uniform_real_distribution<float> size_distribution(8.0f, 64.0f);
+  std::uniform_int_distribution<int> layer_distribution(0, kLayerCount - 1);
+
+  std::vector<VulkanSpriteBatch::Sprite> sprites(kSpriteCount);
+  for (int i = 0; i < kSpriteCount; ++i) {
+    VulkanSpriteBatch::Sprite& sprite = sprites[i];
+    sprite.x = x_distribution(random);
+    sprite.y = y_distribution(random);
+    sprite.width = size_distribution(random);
+    sprite.height = size_distribution(random);
+    sprite.layer = static_cast<uint8_t>(layer_distribution(random));
+    sprite.pipeline = (sprite.layer == 0) ? opaque_pipeline : blended_pipeline;
+    sprite.texture = texture;
+    sprite.color = (sprite.layer == 0) ? 0xFFFFFFFF : 0xC0FFFFFF;
+    sprite.depth = static_cast<float>(i);
+  }
+  return sprites;
+}
+
+// The resources used by the sprites scene.
+//
+// The pipeline manager references the batch's shaders, so it's destroyed
+// first.
+struct SpriteScene {
+  SpriteScene(const VulkanDevice& device, vk::RenderPass render_pass)
+      : texture_image(device, kTextureExtent, kFrameFormat,
+                      vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst),
+        object_cache(device),
+        asset_pack("assets.pack"),
+        shader_cache(device, &asset_pack),
+        sprite_batch(device, &asset_pack, shader_cache, /*max_texture_count=*/1),
+        pipeline_manager(device, /*worker_count=*/1),
+        // Instances are under 64 bytes.
+        vertex_allocator(device, kFramesInFlight, vk::DeviceSize{64} * kSpriteCount,
+                         vk::BufferUsageFlagBits::eVertexBuffer),
+        vertex_cursor(vertex_allocator) {
+    vk::Sampler sampler = object_cache.GetSampler(vk::SamplerCreateInfo()
+        .setMagFilter(vk::Filter::eLinear)
+        .setMinFilter(vk::Filter::eLinear)
+        .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+        .setMaxLod(VK_LOD_CLAMP_NONE));
+    const uint32_t opaque_pipeline = sprite_batch.AddPipeline(pipeline_manager.GetPipeline(
+        sprite_batch.PipelineState(render_pass, vk::SampleCountFlagBits::e1,
+                                   /*blend_enabled=*/false, /*alpha_test_enabled=*/false)));
+    const uint32_t blended_pipeline = sprite_batch.AddPipeline(pipeline_manager.GetPipeline(
+        sprite_batch.PipelineState(render_pass, vk::SampleCountFlagBits::e1,
+                                   /*blend_enabled=*/true, /*alpha_test_enabled=*/false)));
+    const uint32_t texture = sprite_batch.AddTexture(texture_image.View(), sampler);
+    sprites = GenerateSprites(opaque_pipeline, blended_pipeline, texture);
+  }
+
+  VulkanImage texture_image;
+  VulkanObjectCache object_cache;
+  AssetPack asset_pack;
+  VulkanShaderVariantCache shader_cache;
+  VulkanSpriteBatch sprite_batch;
+  VulkanPipelineManager pipeline_manager;
+  VulkanFrameAllocator vertex_allocator;
+  VulkanFrameAllocator::Cursor vertex_cursor;
+  std::vector<VulkanSpriteBatch::Sprite> sprites;
+};
+
+// The device memory used by the process, summed over all heaps. Zero
+// without VK_EXT_memory_budget.
+[[nodiscard]] vk::DeviceSize DeviceMemoryUsage(const VulkanDevice& device) {
+  if (!device.HasMemoryBudget())
+    return 0;
+  vk::DeviceSize usage = 0;
+  for (const VulkanDevice::HeapBudget& heap_budget : device.QueryMemoryBudget())
+    usage += heap_budget.usage;
+  return usage;
+}
+
+// The process's peak resident set size.
+[[nodiscard]] double PeakHostBytes() {
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+  // Linux reports kilobytes.
+  return static_cast<double>(usage.ru_maxrss) * 1024.0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const Clock::time_point process_start_time = Clock::now();
+  const AllocationCount process_start_allocations = CurrentAllocationCount();
+
+  const bool update_baseline = (argc == 4 && std::strcmp(argv[3], "--update") == 0);
+  if ((argc != 3 && !update_baseline) ||
+      (std::strcmp(argv[1], "clear") != 0 && std::strcmp(argv[1], "sprites") != 0)) {
+    std::cerr << "Usage: perf_suite {clear|sprites} baseline_path [--update]" << std::endl;
+    return 1;
+  }
+  const std::string scene_name = argv[1];
+  const char* baseline_path = argv[2];
+  PerfBaseline baseline;
+  if (!ReadPerfBaseline(baseline_path, baseline))
+    return 1;
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Perf Suite");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+  if (std::strstr(device.Name(), baseline.device.c_str()) == nullptr) {
+    std::cout << "Skipping: the baseline was measured on " << baseline.device << ", not "
+              << device.Name() << std::endl;
+    return kSkipExitCode;
+  }
+  if (!baseline.is_measured && !update_baseline) {
+    std::cout << "Skipping: the baseline has no values yet. Fill them in with --update on "
+              << baseline.device << std::endl;
+    return kSkipExitCode;
+  }
+
+  VulkanImage render_target(device, kFrameExtent, kFrameFormat,
+                            vk::ImageUsageFlagBits::eColorAttachment);
+  VulkanRenderPassCache render_pass_cache(device);
+  VulkanRenderPassKey render_pass_key;
+  render_pass_key.color_attachments.push_back({
+    .format = kFrameFormat,
+    .samples = vk::SampleCountFlagBits::e1,
+    .load_op = vk::AttachmentLoadOp::eClear,
+    .store_op = vk::AttachmentStoreOp::eStore,
+    .initial_layout = vk::ImageLayout::eUndefined,
+    .final_layout = vk::ImageLayout::eColorAttachmentOptimal,
+  });
+  vk::RenderPass render_pass = render_pass_cache.GetRenderPass(render_pass_key);
+  VulkanFramebufferKey framebuffer_key;
+  framebuffer_key.render_pass = render_pass;
+  framebuffer_key.attachments.push_back(render_target.View());
+  framebuffer_key.extent = kFrameExtent;
+  vk::Framebuffer framebuffer = render_pass_cache.GetFramebuffer(framebuffer_key);
+
+  std::optional<SpriteScene> sprite_scene;
+  if (scene_name == "sprites")
+    sprite_scene.emplace(device, render_pass);
+  // Destroyed first, after waiting for the submitted frames.
+  VulkanFrameCommands frame_commands(device, kFramesInFlight, /*submission_thread_index=*/0);
+
+  double startup_ms = 0.0;
+  double startup_allocations = 0.0;
+  double cpu_time_ms = 0.0;
+  uint64_t frame_allocations = 0;
+  vk::DeviceSize peak_device_bytes = 0;
+  Clock::time_point measure_start_time;
+  for (int frame = 0; frame < kWarmupFrameCount + kMeasuredFrameCount; ++frame) {
+    if (frame == kWarmupFrameCount)
+      measure_start_time = Clock::now();
+
+    vk::CommandBuffer command_buffer = frame_commands.BeginFrame();
+    // BeginFrame() waits for the GPU, which cpu_frame_ms leaves out.
+    const Clock::time_point record_start_time = Clock::now();
+    const AllocationCount record_start_allocations = CurrentAllocationCount();
+    if (sprite_scene.has_value()) {
+      sprite_scene->vertex_allocator.BeginFrame(frame_commands);
+      if (frame == 0)
+        RecordTextureSetup(command_buffer, sprite_scene->texture_image);
+    }
+
+    vk::ClearValue clear_value(
+        vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
+    vk::RenderPassBeginInfo begin_info;
+    begin_info
+        .setRenderPass(render_pass)
+        .setFramebuffer(framebuffer)
+        .setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), kFrameExtent))
+        .setClearValues(clear_value);
+    command_buffer.beginRenderPass(begin_info, vk::SubpassContents::eInline,
+                                   device.Dispatcher());
+    if (sprite_scene.has_value()) {
+      for (const VulkanSpriteBatch::Sprite& sprite : sprite_scene->sprites)
+        sprite_scene->sprite_batch.Add(sprite);
+      sprite_scene->sprite_batch.Record(command_buffer, sprite_scene->vertex_cursor,
+                                        kFrameExtent);
+    }
+    command_buffer.endRenderPass(device.Dispatcher());
+    frame_commands.SubmitFrame({}, {}, {});
+    const Clock::time_point record_end_time = Clock::now();
+    const AllocationCount record_end_allocations = CurrentAllocationCount();
+
+    if (frame == 0) {
+      // Startup ends when the first frame is rendered.
+      frame_commands.WaitForFrame(frame_commands.FrameNumber());
+      startup_ms = ElapsedMs(process_start_time, Clock::now());
+      startup_allocations = static_cast<double>(record_end_allocations.allocation_count -
+                                                process_start_allocations.allocation_count);
+    }
+    if (frame >= kWarmupFrameCount) {
+      cpu_time_ms += ElapsedMs(record_start_time, record_end_time);
+      frame_allocations +=
+          record_end_allocations.allocation_count - record_start_allocations.allocation_count;
+    }
+    peak_device_bytes = std::max(peak_device_bytes, DeviceMemoryUsage(device));
+  }
+  frame_commands.WaitForFrame(frame_commands.FrameNumber());
+  const double frame_time_ms = ElapsedMs(measure_start_time, Clock::now());
+
+  std::vector<PerfMetric> metrics = {
+    { .name = "startup_ms", .value = startup_ms },
+    { .name = "startup_allocations", .value = startup_allocations },
+    { .name = "cpu_frame_ms", .value = cpu_time_ms / kMeasuredFrameCount },
+    { .name = "frame_ms", .value = frame_time_ms / kMeasuredFrameCount },
+    { .name = "allocations_per_frame",
+      .value = static_cast<double>(frame_allocations) / kMeasuredFrameCount },
+    { .name = "peak_host_bytes", .value = PeakHostBytes() },
+  };
+  if (device.HasMemoryBudget()) {
+    metrics.push_back(
+        { .name = "peak_device_bytes", .value = static_cast<double>(peak_device_bytes) });
+  }
+
+  std::cout << scene_name << " on " << device.Name() << ", " << kMeasuredFrameCount
+            << " frames\n";
+  const int regression_count =
+      baseline.is_measured ? ComparePerfBaseline(baseline, metrics, std::cout) : 0;
+
+  if (update_baseline) {
+    PerfBaseline updated_baseline;
+    updated_baseline.device = baseline.device;
+    updated_baseline.is_measured = true;
+    for (const PerfMetric& metric : metrics) {
+      // New metrics start with a 10% tolerance.
+      double tolerance = 0.1;
+      for (const PerfBaseline::Entry& entry : baseline.entries) {
+        if (entry.metric == metric.name)
+          tolerance = entry.tolerance;
+      }
+      updated_baseline.entries.push_back(
+          { .metric = metric.name, .value = metric.value, .tolerance = tolerance });
+    }
+    if (!WritePerfBaseline(baseline_path, updated_baseline))
+      return 1;
+    std::cout << "Updated " << baseline_path << std::endl;
+    return 0;
+  }
+
+  if (regression_count != 0) {
+    std::cout << regression_count << " metrics regressed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,227 @@
+// Measures sustained offscreen render + readback throughput.
+//
+// Usage: readback_benchmark [frame_count] [raw|ppm|png] [thread_count] [output_path]
+//
+// The frames are split across `thread_count` submission threads. Each thread
+// renders and reads back its frames on its own graphics queue, so comparing
+// thread counts shows how submissions scale across queues. When `output_path`
+// is given, the last frame of the first thread is written there.
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_image.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+#include "vulkan_readback.h"
+
+namespace {
+
+constexpr vk::Extent2D kFrameExtent(1280, 720);
+constexpr vk::Format kFrameFormat = vk::Format::eR8G8B8A8Unorm;
+constexpr int kRingSlotCount = 8;
+constexpr int kEncoderThreadCount = 4;
+
+[[nodiscard]] VulkanReadbackRing::Encoding ParseEncoding(std::string_view name) {
+  if (name == "raw")
+    return VulkanReadbackRing::Encoding::kRaw;
+  if (name == "ppm")
+    return VulkanReadbackRing::Encoding::kPpm;
+  if (name == "png")
+    return VulkanReadbackRing::Encoding::kPng;
+
+  std::cerr << "Unknown encoding: " << name << std::endl;
+  std::abort();
+}
+
+// Stand-in for a render pass. Clears the image and leaves it in eTransferDstOptimal.
+//
+// The command buffer is recorded once and submitted for every frame.
+[[nodiscard]] vk::UniqueCommandBuffer RecordRenderCommands(
+    const VulkanDevice& device, vk::CommandPool command_pool, vk::Image image) {
+  vk::CommandBufferAllocateInfo allocate_info;
+  allocate_info
+      .setCommandPool(command_pool)
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+      device.VulkanHandle().allocateCommandBuffersUnique(allocate_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+  vk::UniqueCommandBuffer command_buffer = std::move(allocate_result.value[0]);
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer->begin(begin_info));
+
+  const vk::ImageSubresourceRange color_range(
+      vk::ImageAspectFlagBits::eColor, /*baseMipLevel=*/0, /*levelCount=*/1,
+      /*baseArrayLayer=*/0, /*layerCount=*/1);
+
+  // The previous frame's readback must finish reading before the image is cleared.
+  vk::ImageMemoryBarrier to_transfer_destination;
+  to_transfer_destination
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setOldLayout(vk::ImageLayout::eUndefined)
+      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image)
+      .setSubresourceRange(color_range);
+  command_buffer->pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      to_transfer_destination);
+
+  vk::ClearColorValue clear_color(std::array<float, 4>{0.2f, 0.4f, 0.8f, 1.0f});
+  command_buffer->clearColorImage(image, vk::ImageLayout::eTransferDstOptimal, clear_color,
+                                  color_range);
+
+  VulkanCheckResult("vkEndCommandBuffer", command_buffer->end());
+  return command_buffer;
+}
+
+struct ThreadResult {
+  VulkanReadbackRing::Stats stats;
+  uint64_t encoded_byte_count = 0;
+  std::vector<uint8_t> last_frame;
+};
+
+// Renders and reads back `frame_count` frames on the queue of the submission
+// thread at `thread_index`. Runs on that submission thread.
+[[nodiscard]] ThreadResult RunSubmissionThread(
+    VulkanDevice& device, size_t thread_index, int frame_count,
+    VulkanReadbackRing::Encoding encoding, int encoder_thread_count) {
+  VulkanImage render_target(device, kFrameExtent, kFrameFormat,
+                            vk::ImageUsageFlagBits::eColorAttachment |
+                                vk::ImageUsageFlagBits::eTransferSrc |
+                                vk::ImageUsageFlagBits::eTransferDst);
+
+  vk::CommandPoolCreateInfo command_pool_info;
+  command_pool_info.setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+  vk::ResultValue<vk::UniqueCommandPool> command_pool =
+      device.VulkanHandle().createCommandPoolUnique(command_pool_info);
+  VulkanCheckResult("vkCreateCommandPool", command_pool.result);
+  vk::UniqueCommandBuffer render_commands = RecordRenderCommands(
+      device, command_pool.value.get(), render_target.VulkanHandle());
+
+  std::mutex result_mutex;
+  ThreadResult result;
+  uint64_t last_frame_number = 0;
+
+  VulkanReadbackRing readback_ring(
+      device, thread_index, kFrameExtent, kFrameFormat, kRingSlotCount, encoder_thread_count,
+      encoding, [&](uint64_t frame_number, std::vector<uint8_t> encoded_frame) {
+        std::lock_guard<std::mutex> lock(result_mutex);
+        result.encoded_byte_count += encoded_frame.size();
+        if (frame_number > last_frame_number) {
+          last_frame_number = frame_number;
+          result.last_frame = std::move(encoded_frame);
+        }
+      });
+
+  // The readback ring submits to the same queue, so its copies are ordered
+  // after the render commands.
+  vk::Queue queue = device.SubmissionQueue(thread_index);
+  vk::CommandBuffer render_command_buffer = render_commands.get();
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(render_command_buffer);
+  for (int frame = 0; frame < frame_count; ++frame) {
+    VulkanCheckResult("vkQueueSubmit", queue.submit(submit_info));
+    readback_ring.ReadbackImage(render_target.VulkanHandle(),
+                                vk::ImageLayout::eTransferDstOptimal);
+  }
+  // The consumer isn't called after WaitIdle() returns.
+  readback_ring.WaitIdle();
+  result.stats = readback_ring.GetStats();
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frame_count = (argc > 1) ? std::atoi(argv[1]) : 600;
+  VulkanReadbackRing::Encoding encoding =
+      ParseEncoding((argc > 2) ? argv[2] : "raw");
+  int thread_count = (argc > 3) ? std::atoi(argv[3]) : 1;
+  const char* output_path = (argc > 4) ? argv[4] : nullptr;
+  if (frame_count <= 0) {
+    std::cerr << "Invalid frame count: " << frame_count << std::endl;
+    return 1;
+  }
+  if (thread_count <= 0) {
+    std::cerr << "Invalid thread count: " << thread_count << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Readback Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+
+  // The readback rings submit without locking, so threads can't share queues.
+  if (!device.HasDedicatedSubmissionQueues(thread_count)) {
+    thread_count = static_cast<int>(device.GraphicsQueueCount());
+    std::cerr << "The device has " << thread_count << " graphics queues. Using "
+              << thread_count << " submission threads" << std::endl;
+  }
+  const int thread_frame_count = std::max(frame_count / thread_count, 1);
+  const int encoder_thread_count = std::max(kEncoderThreadCount / thread_count, 1);
+
+  std::vector<ThreadResult> results(thread_count);
+  auto start_time = std::chrono::steady_clock::now();
+  {
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count);
+    for (int i = 0; i < thread_count; ++i) {
+      threads.emplace_back([&, i]() {
+        results[i] = RunSubmissionThread(device, i, thread_frame_count, encoding,
+                                         encoder_thread_count);
+      });
+    }
+    for (std::thread& thread : threads)
+      thread.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+  uint64_t completed_frame_count = 0;
+  uint64_t encoded_byte_count = 0;
+  for (const ThreadResult& result : results) {
+    completed_frame_count += result.stats.completed_frame_count;
+    encoded_byte_count += result.encoded_byte_count;
+  }
+  std::cout << completed_frame_count << " frames at " << kFrameExtent.width << "x"
+            << kFrameExtent.height << " on " << thread_count << " queues\n"
+            << "  " << completed_frame_count / elapsed.count() << " frames/sec\n"
+            << "  " << encoded_byte_count / completed_frame_count << " encoded bytes/frame\n";
+  for (int i = 0; i < thread_count; ++i) {
+    const VulkanReadbackRing::Stats& stats = results[i].stats;
+    std::cout << "  thread " << i << ": " << stats.frames_per_second << " frames/sec, "
+              << stats.stall_count << " ring stalls\n";
+  }
+
+  if (output_path != nullptr) {
+    const std::vector<uint8_t>& last_frame = results[0].last_frame;
+    std::ofstream output(output_path, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(last_frame.data()),
+                 static_cast<std::streamsize>(last_frame.size()));
+  }
+  return 0;
+}
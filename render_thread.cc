@@ -0,0 +1,79 @@
+#include "render_thread.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+RenderThread::RenderThread(RenderFunction render_frame)
+    : render_frame_(std::move(render_frame)), thread_(&RenderThread::ThreadMain, this) {
+  assert(render_frame_);
+}
+
+RenderThread::~RenderThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  invalidated_.notify_one();
+  thread_.join();
+}
+
+void RenderThread::Invalidate() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_invalidated_ = true;
+  }
+  invalidated_.notify_one();
+}
+
+RenderThread::Stats RenderThread::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {
+    .rendered_frame_count = rendered_frame_count_,
+    .idle_count = idle_count_,
+    .retry_count = retry_count_,
+  };
+}
+
+void RenderThread::ThreadMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Zero unless the last frame asked for a retry.
+  std::chrono::milliseconds retry_delay{0};
+  auto is_woken = [this]() { return is_invalidated_ || shutting_down_; };
+  while (true) {
+    if (!is_invalidated_ && !shutting_down_) {
+      if (retry_delay.count() != 0) {
+        invalidated_.wait_for(lock, retry_delay, is_woken);
+      } else {
+        if (rendered_frame_count_ > 0)
+          ++idle_count_;
+        invalidated_.wait(lock, is_woken);
+      }
+    }
+    if (shutting_down_)
+      return;
+
+    is_invalidated_ = false;
+    lock.unlock();
+    const FrameOutcome outcome = render_frame_();
+    lock.lock();
+
+    ++rendered_frame_count_;
+    switch (outcome) {
+      case FrameOutcome::kIdle:
+        retry_delay = std::chrono::milliseconds(0);
+        break;
+      case FrameOutcome::kAnimating:
+        retry_delay = std::chrono::milliseconds(0);
+        is_invalidated_ = true;
+        break;
+      case FrameOutcome::kRetry:
+        retry_delay = std::clamp(retry_delay * 2, kMinRetryDelay, kMaxRetryDelay);
+        ++retry_count_;
+        break;
+    }
+  }
+}
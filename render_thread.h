@@ -0,0 +1,84 @@
+#ifndef RENDER_THREAD_H_
+#define RENDER_THREAD_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Renders frames on a dedicated thread, and idles while nothing changes.
+//
+// The render thread owns all the frame work, including queue submission and
+// presentation, so the main thread is free to block waiting for window
+// events. Frames are only rendered while the scene is invalidated or
+// animating, or at backed-off intervals while a frame waits on the display.
+// A static scene doesn't use any CPU or GPU time.
+class RenderThread {
+ public:
+  struct Stats {
+    uint64_t rendered_frame_count;
+    // The number of times the thread went idle after rendering frames.
+    uint64_t idle_count;
+    // The number of frames that asked to be retried.
+    uint64_t retry_count;
+  };
+
+  // What the thread does after a frame.
+  enum class FrameOutcome {
+    // The scene is static. The next frame waits for Invalidate().
+    kIdle,
+    // The scene is animating. The next frame is rendered right away.
+    kAnimating,
+    // The frame couldn't render everything yet, for example because a swap
+    // chain had no free image. The next frame is rendered after a delay, or
+    // on Invalidate(). The delay doubles while frames keep asking for
+    // retries, so a window that never frees images costs little.
+    kRetry,
+  };
+
+  // The delays between retried frames.
+  static constexpr std::chrono::milliseconds kMinRetryDelay{2};
+  static constexpr std::chrono::milliseconds kMaxRetryDelay{128};
+
+  // Renders a frame.
+  using RenderFunction = std::function<FrameOutcome()>;
+
+  // The thread starts out idle. Call Invalidate() to render the first frame.
+  explicit RenderThread(RenderFunction render_frame);
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  // Finishes the frame in progress, then joins the render thread.
+  ~RenderThread();
+
+  // Requests a frame, waking up the thread if it's idle. Thread-safe.
+  //
+  // Invalidations that arrive while a frame renders cause one more frame.
+  void Invalidate();
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  void ThreadMain();
+
+  const RenderFunction render_frame_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable invalidated_;
+
+  // Guarded by `mutex_`.
+  bool is_invalidated_ = false;
+  bool shutting_down_ = false;
+  uint64_t rendered_frame_count_ = 0;
+  uint64_t idle_count_ = 0;
+  uint64_t retry_count_ = 0;
+
+  // Must be the last member, so the thread starts after the state above is
+  // initialized.
+  std::thread thread_;
+};
+
+#endif  // RENDER_THREAD_H_
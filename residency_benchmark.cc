@@ -0,0 +1,203 @@
+// Drives VulkanResidencyManager through an over-subscribed device-local heap.
+//
+// Usage: residency_benchmark [buffer_mib]
+//
+// Fills most of the device-local heap with managed buffers, then allocates
+// unmanaged memory on top, like another app starting up. The manager must
+// demote buffers until the heap's usage drops below its target. Freeing the
+// unmanaged memory must promote buffers back. Exits with an error if either
+// step doesn't happen.
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkan_config.h"
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+#include "vulkan_residency_manager.h"
+
+namespace {
+
+constexpr int kFramesInFlight = 2;
+constexpr int kPriorityCount = 4;
+
+// Managed buffers fill the heap up to this share of its budget.
+constexpr vk::DeviceSize kFillPercent = 80;
+
+// The unmanaged memory's share of the budget. Adding it to the filled heap
+// goes above kDemoteAbovePercent. Removing it after the demotions goes below
+// kPromoteBelowPercent.
+constexpr vk::DeviceSize kPressurePercent = 25;
+
+constexpr double kBytesPerMib = 1024.0 * 1024.0;
+
+static_assert(kFillPercent + kPressurePercent >
+              VulkanResidencyManager::kDemoteAbovePercent);
+static_assert(VulkanResidencyManager::kDemoteTargetPercent - kPressurePercent <
+              VulkanResidencyManager::kPromoteBelowPercent);
+
+struct MoveTotals {
+  uint64_t demoted_buffer_count = 0;
+  uint64_t promoted_buffer_count = 0;
+};
+
+[[nodiscard]] double UsagePercent(const VulkanDevice& device, uint32_t heap_index) {
+  std::vector<VulkanDevice::HeapBudget> heap_budgets = device.QueryMemoryBudget();
+  return 100.0 * static_cast<double>(heap_budgets[heap_index].usage) /
+         static_cast<double>(heap_budgets[heap_index].budget);
+}
+
+// Runs frames that use all the buffers, and reports the frames that moved any.
+void RunFrames(VulkanFrameCommands& frame_commands, VulkanDeletionQueue& deletion_queue,
+               VulkanResidencyManager& manager,
+               const std::vector<VulkanResidencyManager::BufferId>& buffer_ids,
+               int frame_count, MoveTotals& totals) {
+  for (int frame = 0; frame < frame_count; ++frame) {
+    std::ignore = frame_commands.BeginFrame();
+    deletion_queue.Collect(frame_commands.CompletedFrameNumber());
+    manager.BeginFrame(frame_commands);
+    for (VulkanResidencyManager::BufferId buffer_id : buffer_ids)
+      manager.MarkUsed(buffer_id);
+    frame_commands.SubmitFrame({}, {}, {});
+
+    const VulkanResidencyManager::FrameStats& stats = manager.LastFrameStats();
+    totals.demoted_buffer_count += stats.demoted_buffer_count;
+    totals.promoted_buffer_count += stats.promoted_buffer_count;
+    if (stats.demoted_buffer_count == 0 && stats.promoted_buffer_count == 0)
+      continue;
+
+    const VulkanResidencyManager::HeapStats& heap = stats.heaps[manager.DeviceLocalHeapIndex()];
+    std::cout << "  frame " << stats.frame_number << ": "
+              << 100.0 * static_cast<double>(heap.usage) / static_cast<double>(heap.budget)
+              << "% of budget, " << heap.managed_bytes / kBytesPerMib << " MiB managed, demoted "
+              << stats.demoted_buffer_count << " buffers (" << stats.demoted_bytes / kBytesPerMib
+              << " MiB), promoted " << stats.promoted_buffer_count << " buffers ("
+              << stats.promoted_bytes / kBytesPerMib << " MiB)\n";
+  }
+}
+
+// Allocates unmanaged device-local memory, in `chunk_size` pieces.
+//
+// Stops early if the device runs out of memory.
+[[nodiscard]] std::vector<vk::UniqueDeviceMemory> AllocatePressure(const VulkanDevice& device,
+                                                                   vk::DeviceSize total_size,
+                                                                   vk::DeviceSize chunk_size) {
+  std::optional<uint32_t> memory_type =
+      device.FindMemoryType(~uint32_t{0}, vk::MemoryPropertyFlagBits::eDeviceLocal);
+  if (!memory_type.has_value()) {
+    std::cerr << "No device-local memory type" << std::endl;
+    std::abort();
+  }
+
+  std::vector<vk::UniqueDeviceMemory> allocations;
+  for (vk::DeviceSize allocated_size = 0; allocated_size < total_size;
+       allocated_size += chunk_size) {
+    vk::MemoryAllocateInfo allocate_info;
+    allocate_info
+        .setAllocationSize(chunk_size)
+        .setMemoryTypeIndex(*memory_type);
+    vk::ResultValue<vk::UniqueDeviceMemory> allocate_result =
+        device.VulkanHandle().allocateMemoryUnique(allocate_info);
+    if (allocate_result.result == vk::Result::eErrorOutOfDeviceMemory)
+      break;
+    VulkanCheckResult("vkAllocateMemory", allocate_result.result);
+    allocations.push_back(std::move(allocate_result.value));
+  }
+  return allocations;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int buffer_mib = (argc > 1) ? std::atoi(argv[1]) : 64;
+  if (buffer_mib <= 0) {
+    std::cerr << "Invalid arguments" << std::endl;
+    return 1;
+  }
+  const vk::DeviceSize buffer_size = vk::DeviceSize{1024} * 1024 * buffer_mib;
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Residency Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+
+  // Unmanaged allocations only show up in the heap usage reported by
+  // VK_EXT_memory_budget.
+  if (!device.HasMemoryBudget()) {
+    std::cerr << device.Name() << ": skipped, VK_EXT_memory_budget is not supported"
+              << std::endl;
+    return 0;
+  }
+  // Destroyed in reverse order, so the frames complete before the manager and
+  // the deletion queue free the buffers.
+  VulkanDeletionQueue deletion_queue;
+  VulkanResidencyManager manager(device, deletion_queue, /*submission_thread_index=*/0);
+  VulkanFrameCommands frame_commands(device, kFramesInFlight, /*submission_thread_index=*/0);
+  if (!manager.CanMoveBuffers()) {
+    std::cerr << device.Name() << ": skipped, all host-visible memory is device-local"
+              << std::endl;
+    return 0;
+  }
+  const uint32_t heap_index = manager.DeviceLocalHeapIndex();
+  const vk::DeviceSize budget = device.QueryMemoryBudget()[heap_index].budget;
+  std::cout << device.Name() << ": " << budget / kBytesPerMib
+            << " MiB device-local budget, " << buffer_mib << " MiB buffers\n";
+
+  std::vector<VulkanResidencyManager::BufferId> buffer_ids;
+  while (UsagePercent(device, heap_index) < kFillPercent) {
+    const int priority = static_cast<int>(buffer_ids.size() % kPriorityCount);
+    VulkanResidencyManager::BufferId buffer_id =
+        manager.CreateBuffer(buffer_size, vk::BufferUsageFlagBits::eStorageBuffer, priority);
+    buffer_ids.push_back(buffer_id);
+    if (!manager.IsDeviceLocal(buffer_id))
+      break;
+  }
+  std::cout << "Filled " << UsagePercent(device, heap_index) << "% of the budget with "
+            << buffer_ids.size() << " buffers\n";
+
+  MoveTotals totals;
+  std::vector<vk::UniqueDeviceMemory> pressure =
+      AllocatePressure(device, budget * kPressurePercent / 100, buffer_size);
+  std::cout << "Allocated " << pressure.size() * buffer_size / kBytesPerMib
+            << " MiB of unmanaged memory\n";
+  // Demoted buffers' memory is freed once the frames that used them complete.
+  RunFrames(frame_commands, deletion_queue, manager, buffer_ids, kFramesInFlight + 2, totals);
+  const double demoted_usage_percent = UsagePercent(device, heap_index);
+  std::cout << "After demotion: " << demoted_usage_percent << "% of budget\n";
+
+  pressure.clear();
+  std::cout << "Freed the unmanaged memory\n";
+  RunFrames(frame_commands, deletion_queue, manager, buffer_ids, kFramesInFlight + 2, totals);
+  const double promoted_usage_percent = UsagePercent(device, heap_index);
+  size_t device_local_count = 0;
+  for (VulkanResidencyManager::BufferId buffer_id : buffer_ids) {
+    if (manager.IsDeviceLocal(buffer_id))
+      ++device_local_count;
+  }
+  std::cout << "After promotion: " << promoted_usage_percent << "% of budget, "
+            << device_local_count << " of " << buffer_ids.size() << " buffers device-local\n";
+
+  bool passed = true;
+  if (totals.demoted_buffer_count == 0 ||
+      demoted_usage_percent > VulkanResidencyManager::kDemoteTargetPercent) {
+    std::cerr << "FAILED: usage not demoted below "
+              << VulkanResidencyManager::kDemoteTargetPercent << "% of budget" << std::endl;
+    passed = false;
+  }
+  if (totals.promoted_buffer_count == 0) {
+    std::cerr << "FAILED: no buffers promoted after the usage dropped" << std::endl;
+    passed = false;
+  }
+  return passed ? 0 : 1;
+}
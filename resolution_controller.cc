@@ -0,0 +1,72 @@
+#include "resolution_controller.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+// Weight of each report in the smoothed frame time.
+constexpr double kSmoothingFactor = 0.1;
+
+// Reports ignored after a scale change, while the smoothed frame time catches
+// up with the new resolution. Also covers the frames in flight that were
+// recorded at the old scale.
+constexpr int kSettleReportCount = 30;
+
+// Scaling up requires headroom for this fraction of a step beyond the next
+// step.
+constexpr double kScaleUpMargin = 0.5;
+
+}  // namespace
+
+ResolutionController::ResolutionController(double target_frame_time_ms, double min_scale,
+                                           int step_count)
+    : target_frame_time_ms_(target_frame_time_ms),
+      step_count_(step_count),
+      min_step_(std::max(1, static_cast<int>(std::ceil(min_scale * step_count)))),
+      step_(step_count) {
+  assert(target_frame_time_ms > 0);
+  assert(min_scale > 0 && min_scale <= 1);
+  assert(step_count > 0);
+}
+
+ResolutionController::~ResolutionController() = default;
+
+void ResolutionController::ReportFrameTime(double gpu_time_ms) {
+  if (gpu_time_ms <= 0)
+    return;
+
+  if (smoothed_frame_time_ms_ == 0) {
+    smoothed_frame_time_ms_ = gpu_time_ms;
+  } else {
+    smoothed_frame_time_ms_ += kSmoothingFactor * (gpu_time_ms - smoothed_frame_time_ms_);
+  }
+
+  if (settle_reports_ > 0) {
+    --settle_reports_;
+    return;
+  }
+
+  // The scale that would put the frame time on target.
+  const double ideal_steps =
+      step_ * std::sqrt(target_frame_time_ms_ / smoothed_frame_time_ms_);
+
+  int new_step = step_;
+  if (ideal_steps < step_) {
+    new_step = std::max(min_step_, static_cast<int>(std::floor(ideal_steps)));
+  } else if (ideal_steps >= step_ + 1 + kScaleUpMargin) {
+    // Scaling up one step at a time avoids overshooting the budget.
+    new_step = std::min(step_count_, step_ + 1);
+  }
+  if (new_step == step_)
+    return;
+
+  // The frame time at the new scale, assuming it's proportional to the
+  // pixel count, so the next decisions start from a good estimate.
+  const double area_ratio = static_cast<double>(new_step * new_step) / (step_ * step_);
+  smoothed_frame_time_ms_ *= area_ratio;
+  step_ = new_step;
+  settle_reports_ = kSettleReportCount;
+  ++change_count_;
+}
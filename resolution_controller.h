@@ -0,0 +1,51 @@
+#ifndef RESOLUTION_CONTROLLER_H_
+#define RESOLUTION_CONTROLLER_H_
+
+#include <cstdint>
+
+// Picks a render resolution scale that keeps GPU frame time within a budget.
+//
+// GPU time is assumed to be proportional to the number of rendered pixels,
+// which is the square of the scale. The scale is quantized to steps of
+// 1 / `step_count`, so render targets are only reallocated when the scale
+// crosses a step. After each change, the controller waits for the frame time
+// to settle before changing the scale again. Scaling up also requires a
+// margin, so the scale doesn't oscillate around a step boundary.
+class ResolutionController {
+ public:
+  // `min_scale` must be in (0, 1]. `step_count` must be positive.
+  explicit ResolutionController(double target_frame_time_ms, double min_scale, int step_count);
+
+  ResolutionController(const ResolutionController&) = delete;
+  ResolutionController& operator=(const ResolutionController&) = delete;
+
+  ~ResolutionController();
+
+  // Updates the scale with a completed frame's GPU time.
+  //
+  // Zero times, reported by queues without timestamps, are ignored.
+  void ReportFrameTime(double gpu_time_ms);
+
+  // The scale applied to each render target dimension, in (0, 1].
+  [[nodiscard]] double Scale() const { return static_cast<double>(step_) / step_count_; }
+
+  // The smoothed GPU time used for the last decision. Zero before the first
+  // report.
+  [[nodiscard]] double SmoothedFrameTimeMs() const { return smoothed_frame_time_ms_; }
+
+  // The number of times the scale changed.
+  [[nodiscard]] uint64_t ChangeCount() const { return change_count_; }
+
+ private:
+  const double target_frame_time_ms_;
+  const int step_count_;
+  const int min_step_;
+
+  int step_;
+  double smoothed_frame_time_ms_ = 0.0;
+  // Reports left before the scale may change again.
+  int settle_reports_ = 0;
+  uint64_t change_count_ = 0;
+};
+
+#endif  // RESOLUTION_CONTROLLER_H_
@@ -0,0 +1,42 @@
+// Declarations shared by the compute kernels in vulkan_compute_kernels.cc.
+//
+// Every kernel runs 256 invocations per workgroup, and operates on 32-bit
+// words in a single storage buffer. Offsets and counts are in words.
+
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+
+layout(local_size_x = 256) in;
+
+// Must match VulkanComputeKernels::Params.
+layout(push_constant) uniform Params {
+  uint count;
+  uint input_offset;
+  uint output_offset;
+  uint aux_offset;
+  uint shift;
+} params;
+
+layout(std430, set = 0, binding = 0) buffer Words {
+  uint words[];
+};
+
+// Set by VulkanComputeKernels to the device's subgroup size, which matches
+// gl_SubgroupSize in these SPIR-V 1.3 modules. Sizes the shared arrays that
+// hold a value per subgroup, so they match gl_NumSubgroups.
+layout(constant_id = 0) const uint kSubgroupSize = 32;
+const uint kMaxSubgroupCount = 256 / kSubgroupSize;
+
+// The lanes in the subgroup whose `digit` matches this invocation's digit.
+//
+// Each of the digit's 8 bits takes one ballot, instead of one shared memory
+// atomic per invocation. Invalid invocations match no lanes.
+uvec4 MatchDigit(uint digit, bool is_valid) {
+  uvec4 matches = subgroupBallot(is_valid);
+  for (uint bit = 0; bit < 8; ++bit) {
+    bool is_set = ((digit >> bit) & 1) != 0;
+    uvec4 votes = subgroupBallot(is_set);
+    matches &= is_set ? votes : ~votes;
+  }
+  return matches;
+}
@@ -0,0 +1,38 @@
+#version 450
+
+// Samples the sprite's texture for VulkanSpriteBatch.
+//
+// Built by spirv_shader_variants(), with these features:
+//   BINDLESS: samples the sprite's texture from the batch's texture array, so
+//     sprites with different textures share draws. Otherwise, samples the
+//     texture bound for the current draw.
+//   ALPHA_TEST: discards fragments whose alpha is below 0.5, so cutouts can
+//     be drawn without blending.
+
+#if BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform sampler2D sprite_textures[];
+#else
+layout(set = 0, binding = 0) uniform sampler2D sprite_texture;
+#endif
+
+layout(location = 0) in vec2 frag_texture_coordinates;
+layout(location = 1) in vec4 frag_color;
+layout(location = 2) flat in uint frag_texture_index;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+#if BINDLESS
+  vec4 texel =
+      texture(sprite_textures[nonuniformEXT(frag_texture_index)], frag_texture_coordinates);
+#else
+  vec4 texel = texture(sprite_texture, frag_texture_coordinates);
+#endif
+  out_color = frag_color * texel;
+#if ALPHA_TEST
+  if (out_color.a < 0.5)
+    discard;
+#endif
+}
@@ -0,0 +1,30 @@
+#version 450
+
+// Draws one VulkanSpriteBatch sprite per instance, as a 4-vertex triangle
+// strip.
+
+// Must match VulkanSpriteBatch::Instance.
+layout(location = 0) in vec4 rect;  // x, y, width, height in pixels.
+layout(location = 1) in vec4 texture_rect;  // u0, v0, u1, v1.
+layout(location = 2) in vec4 color;
+layout(location = 3) in uint texture_index;
+
+// Must match VulkanSpriteBatch::PushConstants.
+layout(push_constant) uniform PushConstants {
+  // 2 / framebuffer size, which maps pixels to normalized device coordinates.
+  vec2 pixel_scale;
+} push_constants;
+
+layout(location = 0) out vec2 frag_texture_coordinates;
+layout(location = 1) out vec4 frag_color;
+layout(location = 2) flat out uint frag_texture_index;
+
+void main() {
+  vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+  vec2 position = rect.xy + corner * rect.zw;
+  gl_Position = vec4(position * push_constants.pixel_scale - 1.0, 0.0, 1.0);
+
+  frag_texture_coordinates = mix(texture_rect.xy, texture_rect.zw, corner);
+  frag_color = color;
+  frag_texture_index = texture_index;
+}
@@ -0,0 +1,261 @@
+// Measures VulkanSpriteBatch's CPU cost on a UI-like workload.
+//
+// Usage: sprite_batch_benchmark [frame_count] [sprite_count]
+//
+// Each frame draws `sprite_count` sprites spread over several layers and
+// textures, plus a few lines of text, into an offscreen image.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "asset_pack.h"
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_image.h"
+#include "vulkan_instance.h"
+#include "vulkan_object_cache.h"
+#include "vulkan_physical_device_list.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_render_pass_cache.h"
+#include "vulkan_shader_variant_cache.h"
+#include "vulkan_sprite_batch.h"
+
+namespace {
+
+constexpr vk::Extent2D kFrameExtent(1920, 1080);
+constexpr vk::Format kFrameFormat = vk::Format::eR8G8B8A8Unorm;
+constexpr vk::Extent2D kTextureExtent(64, 64);
+constexpr int kFramesInFlight = 2;
+constexpr uint32_t kTextureCount = 64;
+constexpr int kLayerCount = 4;
+constexpr int kTextLineCount = 40;
+
+constexpr vk::ImageSubresourceRange kColorRange(
+    vk::ImageAspectFlagBits::eColor, /*baseMipLevel=*/0, /*levelCount=*/1,
+    /*baseArrayLayer=*/0, /*layerCount=*/1);
+
+// Clears each texture to its own color, and leaves the textures in
+// eShaderReadOnlyOptimal.
+void RecordTextureSetup(vk::CommandBuffer command_buffer,
+                        const std::vector<VulkanImage>& textures) {
+  std::vector<vk::ImageMemoryBarrier> barriers(textures.size());
+  for (size_t i = 0; i < textures.size(); ++i) {
+    barriers[i]
+        .setSrcAccessMask({})
+        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+        .setImage(textures[i].VulkanHandle())
+        .setSubresourceRange(kColorRange);
+  }
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      barriers);
+
+  for (size_t i = 0; i < textures.size(); ++i) {
+    const float shade = static_cast<float>(i + 1) / static_cast<float>(textures.size());
+    vk::ClearColorValue clear_color(std::array<float, 4>{shade, 1.0f - shade, 0.5f, 1.0f});
+    command_buffer.clearColorImage(textures[i].VulkanHandle(),
+                                   vk::ImageLayout::eTransferDstOptimal, clear_color,
+                                   kColorRange);
+  }
+
+  for (vk::ImageMemoryBarrier& barrier : barriers) {
+    barrier
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+        .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+        .setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+  }
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      barriers);
+}
+
+// Opaque panels go in the bottom layer, and blended widgets above them.
+[[nodiscard]] std::vector<VulkanSpriteBatch::Sprite> GenerateSprites(
+    int sprite_count, uint32_t opaque_pipeline, uint32_t blended_pipeline,
+    const std::vector<uint32_t>& textures) {
+  std::mt19937 random(/*seed=*/42);
+  std::uniform_real_distribution<float> x_distribution(0.0f, kFrameExtent.width - 64.0f);
+  std::uniform_real_distribution<float> y_distribution(0.0f, kFrameExtent.height - 64.0f);
+  std::uniform_real_distribution<float> size_distribution(8.0f, 64.0f);
+  std::uniform_int_distribution<int> layer_distribution(0, kLayerCount - 1);
+  std::uniform_int_distribution<size_t> texture_distribution(0, textures.size() - 1);
+
+  std::vector<VulkanSpriteBatch::Sprite> sprites(sprite_count);
+  for (int i = 0; i < sprite_count; ++i) {
+    VulkanSpriteBatch::Sprite& sprite = sprites[i];
+    sprite.x = x_distribution(random);
+    sprite.y = y_distribution(random);
+    sprite.width = size_distribution(random);
+    sprite.height = size_distribution(random);
+    sprite.layer = static_cast<uint8_t>(layer_distribution(random));
+    sprite.pipeline = (sprite.layer == 0) ? opaque_pipeline : blended_pipeline;
+    sprite.texture = textures[texture_distribution(random)];
+    sprite.color = (sprite.layer == 0) ? 0xFFFFFFFF : 0xC0FFFFFF;
+    sprite.depth = static_cast<float>(i);
+  }
+  return sprites;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frame_count = (argc > 1) ? std::atoi(argv[1]) : 600;
+  int sprite_count = (argc > 2) ? std::atoi(argv[2]) : 50'000;
+  if (frame_count <= 0 || sprite_count <= 0) {
+    std::cerr << "Invalid arguments" << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Sprite Batch Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+
+  VulkanImage render_target(device, kFrameExtent, kFrameFormat,
+                            vk::ImageUsageFlagBits::eColorAttachment);
+  std::vector<VulkanImage> texture_images;
+  texture_images.reserve(kTextureCount);
+  for (uint32_t i = 0; i < kTextureCount; ++i) {
+    texture_images.emplace_back(
+        device, kTextureExtent, kFrameFormat,
+        vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst);
+  }
+
+  VulkanObjectCache object_cache(device);
+  vk::Sampler sampler = object_cache.GetSampler(vk::SamplerCreateInfo()
+      .setMagFilter(vk::Filter::eLinear)
+      .setMinFilter(vk::Filter::eLinear)
+      .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+      .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+      .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+      .setMaxLod(VK_LOD_CLAMP_NONE));
+
+  VulkanRenderPassCache render_pass_cache(device);
+  VulkanRenderPassKey render_pass_key;
+  render_pass_key.color_attachments.push_back({
+    .format = kFrameFormat,
+    .samples = vk::SampleCountFlagBits::e1,
+    .load_op = vk::AttachmentLoadOp::eClear,
+    .store_op = vk::AttachmentStoreOp::eStore,
+    .initial_layout = vk::ImageLayout::eUndefined,
+    .final_layout = vk::ImageLayout::eColorAttachmentOptimal,
+  });
+  vk::RenderPass render_pass = render_pass_cache.GetRenderPass(render_pass_key);
+  VulkanFramebufferKey framebuffer_key;
+  framebuffer_key.render_pass = render_pass;
+  framebuffer_key.attachments.push_back(render_target.View());
+  framebuffer_key.extent = kFrameExtent;
+  vk::Framebuffer framebuffer = render_pass_cache.GetFramebuffer(framebuffer_key);
+
+  // The pipeline manager references the batch's shaders, so it's destroyed
+  // first.
+  AssetPack asset_pack("assets.pack");
+  VulkanShaderVariantCache shader_cache(device, &asset_pack);
+  VulkanSpriteBatch sprite_batch(device, &asset_pack, shader_cache, kTextureCount);
+  VulkanPipelineManager pipeline_manager(device, /*worker_count=*/1);
+  const uint32_t opaque_pipeline = sprite_batch.AddPipeline(pipeline_manager.GetPipeline(
+      sprite_batch.PipelineState(render_pass, vk::SampleCountFlagBits::e1,
+                                 /*blend_enabled=*/false, /*alpha_test_enabled=*/false)));
+  const uint32_t blended_pipeline = sprite_batch.AddPipeline(pipeline_manager.GetPipeline(
+      sprite_batch.PipelineState(render_pass, vk::SampleCountFlagBits::e1,
+                                 /*blend_enabled=*/true, /*alpha_test_enabled=*/false)));
+  std::vector<uint32_t> textures;
+  for (const VulkanImage& texture_image : texture_images)
+    textures.push_back(sprite_batch.AddTexture(texture_image.View(), sampler));
+
+  // A 16x6 grid of glyphs, starting at the space character.
+  const VulkanSpriteBatch::MonospaceFont font = {
+    .texture = textures[0],
+    .pipeline = blended_pipeline,
+    .first_character = ' ',
+    .column_count = 16,
+    .row_count = 6,
+    .glyph_width = 8.0f,
+    .glyph_height = 16.0f,
+  };
+  const std::vector<VulkanSpriteBatch::Sprite> sprites =
+      GenerateSprites(sprite_count, opaque_pipeline, blended_pipeline, textures);
+
+  // Instances are under 64 bytes. The text adds a few thousand glyphs.
+  VulkanFrameAllocator vertex_allocator(device, kFramesInFlight,
+                                        vk::DeviceSize{64} * (sprite_count + 8192),
+                                        vk::BufferUsageFlagBits::eVertexBuffer);
+  VulkanFrameAllocator::Cursor vertex_cursor(vertex_allocator);
+  // Destroyed first, after waiting for the submitted frames.
+  VulkanFrameCommands frame_commands(device, kFramesInFlight, /*submission_thread_index=*/0);
+
+  VulkanSpriteBatch::Stats total_stats = {};
+  std::chrono::steady_clock::duration cpu_time{};
+  for (int frame = 0; frame < frame_count; ++frame) {
+    vk::CommandBuffer command_buffer = frame_commands.BeginFrame();
+    vertex_allocator.BeginFrame(frame_commands);
+    if (frame == 0)
+      RecordTextureSetup(command_buffer, texture_images);
+
+    vk::ClearValue clear_value(
+        vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
+    vk::RenderPassBeginInfo begin_info;
+    begin_info
+        .setRenderPass(render_pass)
+        .setFramebuffer(framebuffer)
+        .setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), kFrameExtent))
+        .setClearValues(clear_value);
+    command_buffer.beginRenderPass(begin_info, vk::SubpassContents::eInline,
+                                   device.Dispatcher());
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    for (const VulkanSpriteBatch::Sprite& sprite : sprites)
+      sprite_batch.Add(sprite);
+    const std::string text = "Frame " + std::to_string(frame) +
+                             ": the quick brown fox jumps over the lazy dog";
+    for (int line = 0; line < kTextLineCount; ++line) {
+      sprite_batch.AddText(font, text, /*x=*/8.0f, /*y=*/8.0f + line * font.glyph_height,
+                           /*layer=*/kLayerCount, /*depth=*/0.0f, /*color=*/0xFFFFFFFF);
+    }
+    sprite_batch.Record(command_buffer, vertex_cursor, kFrameExtent);
+    cpu_time += std::chrono::steady_clock::now() - start_time;
+
+    command_buffer.endRenderPass(device.Dispatcher());
+    frame_commands.SubmitFrame({}, {}, {});
+
+    VulkanSpriteBatch::Stats stats = sprite_batch.GetStats();
+    total_stats.sprite_count += stats.sprite_count;
+    total_stats.draw_count += stats.draw_count;
+    total_stats.pipeline_bind_count += stats.pipeline_bind_count;
+    total_stats.descriptor_set_bind_count += stats.descriptor_set_bind_count;
+    total_stats.sort_pass_count += stats.sort_pass_count;
+    total_stats.sort_time_ms += stats.sort_time_ms;
+  }
+
+  const double frames = frame_count;
+  std::cout << device.Name() << ", "
+            << (sprite_batch.IsBindless() ? "bindless textures" : "descriptor set per texture")
+            << ", " << shader_cache.GetStats().module_count << " shader variants loaded\n"
+            << "  " << total_stats.sprite_count / frames << " sprites/frame\n"
+            << "  " << total_stats.draw_count / frames << " draws/frame\n"
+            << "  " << total_stats.pipeline_bind_count / frames << " pipeline binds/frame\n"
+            << "  " << total_stats.descriptor_set_bind_count / frames
+            << " descriptor set binds/frame\n"
+            << "  " << total_stats.sort_pass_count / frames << " sort passes/frame\n"
+            << "  " << total_stats.sort_time_ms / frames << " ms/frame sorting\n"
+            << "  " << std::chrono::duration<double, std::milli>(cpu_time).count() / frames
+            << " ms/frame CPU, including sorting\n";
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include "startup_graph.h"
+
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "task_pool.h"
+
+namespace {
+
+[[nodiscard]] double ToMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+StartupGraph::StartupGraph(int worker_count) : worker_count_(worker_count) {
+  assert(worker_count > 0);
+}
+
+StartupGraph::~StartupGraph() = default;
+
+StartupGraph::StageId StartupGraph::AddStage(const char* name, Thread thread,
+                                             std::vector<StageId> dependencies,
+                                             std::function<void()> run) {
+  assert(name != nullptr);
+  assert(run);
+  assert(!has_run_);
+
+  StageId stage_id = static_cast<StageId>(stages_.size());
+  for (StageId dependency : dependencies) {
+    assert(dependency >= 0 && dependency < stage_id);
+    stages_[dependency].dependents.push_back(stage_id);
+  }
+
+  stages_.push_back({
+    .name = name,
+    .thread = thread,
+    .run = std::move(run),
+    .dependents = {},
+    .pending_dependency_count = static_cast<int>(dependencies.size()),
+  });
+  return stage_id;
+}
+
+void StartupGraph::Run() {
+  assert(!has_run_);
+  has_run_ = true;
+
+  timings_.resize(stages_.size());
+  run_start_time_ = std::chrono::steady_clock::now();
+  task_pool_ = std::make_unique<TaskPool>(worker_count_);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (StageId stage_id = 0; stage_id < static_cast<StageId>(stages_.size()); ++stage_id) {
+    if (stages_[stage_id].pending_dependency_count == 0)
+      DispatchStage(stage_id);
+  }
+
+  while (completed_stage_count_ < static_cast<int>(stages_.size())) {
+    if (ready_main_thread_stages_.empty()) {
+      main_thread_wakeup_.wait(lock);
+      continue;
+    }
+
+    StageId stage_id = ready_main_thread_stages_.front();
+    ready_main_thread_stages_.pop_front();
+    lock.unlock();
+    RunStage(stage_id);
+    lock.lock();
+  }
+  lock.unlock();
+
+  task_pool_.reset();
+  total_duration_ = std::chrono::steady_clock::now() - run_start_time_;
+}
+
+void StartupGraph::PrintTimings(std::ostream& stream) const {
+  assert(has_run_);
+
+  stream << "Startup stages:\n";
+  for (size_t i = 0; i < stages_.size(); ++i) {
+    const StageTiming& timing = timings_[i];
+    stream << "  " << std::setw(16) << std::left << timing.name << std::right
+           << (timing.thread == Thread::kMain ? " main   " : " worker ") << std::fixed
+           << std::setprecision(2) << std::setw(8) << ToMilliseconds(timing.start)
+           << " ms +" << std::setw(8) << ToMilliseconds(timing.duration) << " ms\n";
+  }
+  stream << "  total " << ToMilliseconds(total_duration_) << " ms\n";
+}
+
+void StartupGraph::RunStage(StageId stage_id) {
+  Stage& stage = stages_[stage_id];
+
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+  stage.run();
+  std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+
+  // Each stage runs once, so its timing is only written by one thread.
+  timings_[stage_id] = {
+    .name = stage.name,
+    .thread = stage.thread,
+    .start = start_time - run_start_time_,
+    .duration = end_time - start_time,
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (StageId dependent : stage.dependents) {
+      --stages_[dependent].pending_dependency_count;
+      if (stages_[dependent].pending_dependency_count == 0)
+        DispatchStage(dependent);
+    }
+    ++completed_stage_count_;
+  }
+  main_thread_wakeup_.notify_one();
+}
+
+void StartupGraph::DispatchStage(StageId stage_id) {
+  if (stages_[stage_id].thread == Thread::kMain) {
+    ready_main_thread_stages_.push_back(stage_id);
+    return;
+  }
+  task_pool_->Post([this, stage_id]() { RunStage(stage_id); });
+}
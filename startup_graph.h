@@ -0,0 +1,106 @@
+#ifndef STARTUP_GRAPH_H_
+#define STARTUP_GRAPH_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "task_pool.h"
+
+// Runs initialization stages concurrently, as allowed by their dependencies.
+//
+// Each stage runs either on the thread that calls Run(), or on a worker
+// thread. Stages that use the windowing system must run on the main thread.
+// Run() records each stage's start time and duration.
+class StartupGraph {
+ public:
+  using StageId = int;
+
+  enum class Thread {
+    kMain,
+    kWorker,
+  };
+
+  struct StageTiming {
+    const char* name;
+    Thread thread;
+    // Relative to the Run() call.
+    std::chrono::steady_clock::duration start;
+    std::chrono::steady_clock::duration duration;
+  };
+
+  // `worker_count` must be positive.
+  explicit StartupGraph(int worker_count);
+
+  StartupGraph(const StartupGraph&) = delete;
+  StartupGraph& operator=(const StartupGraph&) = delete;
+
+  ~StartupGraph();
+
+  // Adds a stage that starts after all its dependencies complete.
+  //
+  // `name` must point to a string that outlives the graph. Dependencies must
+  // be stages added earlier, which rules out cycles.
+  StageId AddStage(const char* name, Thread thread, std::vector<StageId> dependencies,
+                   std::function<void()> run);
+
+  // Runs all the stages. Returns after they all complete.
+  //
+  // Must be called at most once.
+  void Run();
+
+  // Indexed by StageId. Only valid after Run() returns.
+  [[nodiscard]] const std::vector<StageTiming>& Timings() const { return timings_; }
+
+  // The time between the Run() call and its return.
+  [[nodiscard]] std::chrono::steady_clock::duration TotalDuration() const {
+    return total_duration_;
+  }
+
+  // Writes a human-readable report of the stage timings.
+  void PrintTimings(std::ostream& stream) const;
+
+ private:
+  struct Stage {
+    const char* name;
+    Thread thread;
+    std::function<void()> run;
+    std::vector<StageId> dependents;
+
+    // Guarded by `mutex_` during Run().
+    int pending_dependency_count;
+  };
+
+  // Runs on the main thread, or on a worker thread.
+  void RunStage(StageId stage_id);
+
+  // Starts the stage, or queues it up for the main thread.
+  //
+  // Must be called with `mutex_` held.
+  void DispatchStage(StageId stage_id);
+
+  const int worker_count_;
+  std::vector<Stage> stages_;
+  std::vector<StageTiming> timings_;
+  std::chrono::steady_clock::time_point run_start_time_;
+  std::chrono::steady_clock::duration total_duration_{};
+  bool has_run_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable main_thread_wakeup_;
+
+  // Guarded by `mutex_` during Run().
+  std::deque<StageId> ready_main_thread_stages_;
+  int completed_stage_count_ = 0;
+
+  // Only set during Run(). Destroyed first, so the workers don't outlive the
+  // state they use.
+  std::unique_ptr<TaskPool> task_pool_;
+};
+
+#endif  // STARTUP_GRAPH_H_
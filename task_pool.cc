@@ -0,0 +1,67 @@
+#include "task_pool.h"
+
+#include <cassert>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+TaskPool::TaskPool(int thread_count) {
+  assert(thread_count > 0);
+
+  threads_.reserve(thread_count);
+  for (int i = 0; i < thread_count; ++i)
+    threads_.emplace_back(&TaskPool::WorkerMain, this);
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  task_available_.notify_all();
+
+  for (std::thread& thread : threads_)
+    thread.join();
+  assert(tasks_.empty());
+}
+
+void TaskPool::Post(std::function<void()> task) {
+  assert(task);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  task_available_.notify_one();
+}
+
+void TaskPool::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this]() { return tasks_.empty() && running_task_count_ == 0; });
+}
+
+void TaskPool::WorkerMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    task_available_.wait(lock, [this]() { return !tasks_.empty() || shutting_down_; });
+
+    // Pending tasks are drained before shutting down.
+    if (tasks_.empty()) {
+      assert(shutting_down_);
+      return;
+    }
+
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    ++running_task_count_;
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    --running_task_count_;
+    if (tasks_.empty() && running_task_count_ == 0)
+      idle_.notify_all();
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef TASK_POOL_H_
+#define TASK_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs tasks on a fixed set of worker threads.
+//
+// Tasks are started in the order they are posted. Tasks may post other tasks.
+class TaskPool {
+ public:
+  // `thread_count` must be positive.
+  explicit TaskPool(int thread_count);
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  // Runs all the posted tasks to completion, then joins the worker threads.
+  ~TaskPool();
+
+  [[nodiscard]] int ThreadCount() const { return static_cast<int>(threads_.size()); }
+
+  // Queues a task to be run on one of the worker threads.
+  void Post(std::function<void()> task);
+
+  // Blocks until all posted tasks have completed.
+  void WaitIdle();
+
+ private:
+  void WorkerMain();
+
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  std::condition_variable idle_;
+
+  // Guarded by `mutex_`.
+  std::deque<std::function<void()>> tasks_;
+  int running_task_count_ = 0;
+  bool shutting_down_ = false;
+
+  // Must be the last member, so the worker threads start after the state above
+  // is initialized.
+  std::vector<std::thread> threads_;
+};
+
+#endif  // TASK_POOL_H_
@@ -0,0 +1,162 @@
+// Measures TransformHierarchy updates on large scene graphs.
+//
+// Usage: transform_benchmark [frame_count]
+//
+// Each scene is a forest of a few deep trees. Frames either move every root,
+// which recomputes every node, or move 1% of the nodes at random, which
+// recomputes their subtrees. Every frame writes all the world matrices into
+// a mapped instance buffer.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <vulkan/vulkan.hpp>
+
+#include "transform_hierarchy.h"
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+
+namespace {
+
+constexpr int kFramesInFlight = 2;
+constexpr int kRootCount = 16;
+constexpr int kBranchingFactor = 8;
+constexpr size_t kNodeCounts[] = {100'000, 1'000'000};
+
+[[nodiscard]] TransformHierarchy::Transform RandomTransform(std::mt19937& random) {
+  std::uniform_real_distribution<float> offset_distribution(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> angle_distribution(-3.14159f, 3.14159f);
+  return {
+    .translation = glm::vec3(offset_distribution(random), offset_distribution(random),
+                             offset_distribution(random)),
+    .rotation = glm::angleAxis(angle_distribution(random), glm::vec3(0.0f, 1.0f, 0.0f)),
+    .scale = glm::vec3(0.9f),
+  };
+}
+
+// Adds `node_count` nodes breadth-first, so each tree fills up one level at
+// a time. Every node gets an instance matrix.
+[[nodiscard]] std::vector<TransformHierarchy::NodeId> BuildScene(
+    TransformHierarchy& hierarchy, size_t node_count) {
+  std::mt19937 random(/*seed=*/42);
+  std::vector<TransformHierarchy::NodeId> nodes;
+  nodes.reserve(node_count);
+  std::deque<TransformHierarchy::NodeId> unexpanded;
+  for (int i = 0; i < kRootCount && nodes.size() < node_count; ++i) {
+    nodes.push_back(hierarchy.AddRoot(RandomTransform(random),
+                                      static_cast<uint32_t>(nodes.size())));
+    unexpanded.push_back(nodes.back());
+  }
+  while (nodes.size() < node_count) {
+    const TransformHierarchy::NodeId parent = unexpanded.front();
+    unexpanded.pop_front();
+    for (int i = 0; i < kBranchingFactor && nodes.size() < node_count; ++i) {
+      nodes.push_back(hierarchy.AddChild(parent, RandomTransform(random),
+                                         static_cast<uint32_t>(nodes.size())));
+      unexpanded.push_back(nodes.back());
+    }
+  }
+  return nodes;
+}
+
+struct Result {
+  double update_ms;
+  double updated_nodes;
+};
+
+// Runs `frame_count` updates, each after moving `moved_nodes`. Returns the
+// per-frame averages.
+[[nodiscard]] Result RunFrames(const VulkanDevice& device, TransformHierarchy& hierarchy,
+                               const std::vector<TransformHierarchy::NodeId>& moved_nodes,
+                               int frame_count) {
+  const vk::DeviceSize instance_bytes = sizeof(glm::mat4) * hierarchy.NodeCount();
+  VulkanFrameAllocator instance_allocator(device, kFramesInFlight, instance_bytes,
+                                          vk::BufferUsageFlagBits::eVertexBuffer);
+  VulkanFrameAllocator::Cursor instance_cursor(instance_allocator);
+  // Destroyed first, after waiting for the submitted frames.
+  VulkanFrameCommands frame_commands(device, kFramesInFlight, /*submission_thread_index=*/0);
+
+  std::mt19937 random(/*seed=*/7);
+  double update_ms = 0.0;
+  uint64_t updated_nodes = 0;
+  for (int frame = 0; frame < frame_count; ++frame) {
+    // The frame records no commands.
+    static_cast<void>(frame_commands.BeginFrame());
+    instance_allocator.BeginFrame(frame_commands);
+
+    for (TransformHierarchy::NodeId node : moved_nodes)
+      hierarchy.SetLocalTransform(node, RandomTransform(random));
+    VulkanFrameAllocator::Allocation instances = instance_cursor.Allocate(instance_bytes);
+    hierarchy.Update(static_cast<glm::mat4*>(instances.data));
+
+    // The GPU doesn't read the matrices, but submitting recycles the
+    // allocator's regions like a real frame.
+    frame_commands.SubmitFrame({}, {}, {});
+
+    TransformHierarchy::Stats stats = hierarchy.GetStats();
+    update_ms += stats.update_time_ms;
+    updated_nodes += stats.updated_node_count;
+  }
+  return {
+    .update_ms = update_ms / frame_count,
+    .updated_nodes = static_cast<double>(updated_nodes) / frame_count,
+  };
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int frame_count = (argc > 1) ? std::atoi(argv[1]) : 100;
+  if (frame_count <= 0) {
+    std::cerr << "Invalid arguments" << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Transform Benchmark");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+
+  const int max_thread_count =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::vector<int> thread_counts = {1};
+  if (max_thread_count > 1)
+    thread_counts.push_back(max_thread_count);
+
+  std::cout << device.Name() << "\n";
+  for (size_t node_count : kNodeCounts) {
+    for (int thread_count : thread_counts) {
+      TransformHierarchy hierarchy(thread_count);
+      const std::vector<TransformHierarchy::NodeId> nodes = BuildScene(hierarchy, node_count);
+
+      const std::vector<TransformHierarchy::NodeId> roots(nodes.begin(),
+                                                          nodes.begin() + kRootCount);
+      std::vector<TransformHierarchy::NodeId> sampled_nodes;
+      std::sample(nodes.begin(), nodes.end(), std::back_inserter(sampled_nodes),
+                  node_count / 100, std::mt19937(/*seed=*/1));
+
+      const Result all_dirty = RunFrames(device, hierarchy, roots, frame_count);
+      const Result some_dirty = RunFrames(device, hierarchy, sampled_nodes, frame_count);
+      std::cout << node_count << " nodes, " << thread_count << " threads\n"
+                << "  " << all_dirty.update_ms << " ms/update, all nodes moved\n"
+                << "  " << some_dirty.update_ms << " ms/update, 1% of nodes moved ("
+                << some_dirty.updated_nodes << " nodes recomputed)\n";
+    }
+  }
+  return 0;
+}
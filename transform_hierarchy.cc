@@ -0,0 +1,195 @@
+#include "transform_hierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+namespace {
+
+// Levels are split into chunks of this many nodes. Large enough to amortize
+// posting a task, and small enough to balance the load across threads.
+constexpr size_t kChunkNodeCount = 4096;
+
+[[nodiscard]] glm::mat4 LocalMatrix(const glm::vec4& translation, const glm::quat& rotation,
+                                    const glm::vec4& scale) {
+  glm::mat4 matrix = glm::mat4_cast(rotation);
+  matrix[0] *= scale.x;
+  matrix[1] *= scale.y;
+  matrix[2] *= scale.z;
+  matrix[3] = translation;
+  return matrix;
+}
+
+}  // namespace
+
+TransformHierarchy::TransformHierarchy(int thread_count) : task_pool_(thread_count) {
+}
+
+TransformHierarchy::~TransformHierarchy() = default;
+
+TransformHierarchy::NodeId TransformHierarchy::AddRoot(const Transform& local_transform,
+                                                       uint32_t instance_index) {
+  return AddNode(0, 0, local_transform, instance_index);
+}
+
+TransformHierarchy::NodeId TransformHierarchy::AddChild(NodeId parent,
+                                                        const Transform& local_transform,
+                                                        uint32_t instance_index) {
+  assert(parent.depth < levels_.size());
+  assert(parent.index < levels_[parent.depth].world_matrices.size());
+  return AddNode(parent.depth + 1, parent.index, local_transform, instance_index);
+}
+
+TransformHierarchy::NodeId TransformHierarchy::AddNode(uint32_t depth, uint32_t parent_index,
+                                                       const Transform& local_transform,
+                                                       uint32_t instance_index) {
+  assert(depth <= levels_.size());
+  if (depth == levels_.size())
+    levels_.emplace_back();
+
+  Level& level = levels_[depth];
+  const auto index = static_cast<uint32_t>(level.world_matrices.size());
+  if (depth > 0)
+    level.parents.push_back(parent_index);
+  level.translations.emplace_back(local_transform.translation, 1.0f);
+  level.rotations.push_back(local_transform.rotation);
+  level.scales.emplace_back(local_transform.scale, 0.0f);
+  level.world_matrices.emplace_back(1.0f);
+  level.instance_indexes.push_back(instance_index);
+  level.dirty.push_back(1);
+  level.has_dirty = true;
+
+  ++node_count_;
+  return { .depth = depth, .index = index };
+}
+
+void TransformHierarchy::SetLocalTransform(NodeId node, const Transform& local_transform) {
+  assert(node.depth < levels_.size());
+  Level& level = levels_[node.depth];
+  assert(node.index < level.world_matrices.size());
+
+  level.translations[node.index] = glm::vec4(local_transform.translation, 1.0f);
+  level.rotations[node.index] = local_transform.rotation;
+  level.scales[node.index] = glm::vec4(local_transform.scale, 0.0f);
+  level.dirty[node.index] = 1;
+  level.has_dirty = true;
+}
+
+template <typename RangeFunction>
+size_t TransformHierarchy::ParallelSum(size_t count, const RangeFunction& range_function) {
+  const size_t chunk_count = (count + kChunkNodeCount - 1) / kChunkNodeCount;
+  if (chunk_count <= 1 || task_pool_.ThreadCount() == 1)
+    return range_function(0, count);
+
+  // Each chunk writes its own result, so the tasks don't share state.
+  chunk_results_.assign(chunk_count, 0);
+  for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+    task_pool_.Post([this, &range_function, chunk, count]() {
+      const size_t begin = chunk * kChunkNodeCount;
+      const size_t end = std::min(begin + kChunkNodeCount, count);
+      chunk_results_[chunk] = range_function(begin, end);
+    });
+  }
+  task_pool_.WaitIdle();
+  return std::accumulate(chunk_results_.begin(), chunk_results_.end(), size_t{0});
+}
+
+void TransformHierarchy::Update(glm::mat4* instance_matrices) {
+  assert(reinterpret_cast<uintptr_t>(instance_matrices) % alignof(glm::mat4) == 0);
+
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+  stats_ = { .node_count = node_count_ };
+
+  // Whether the previous level has nodes whose world matrix changed. Their
+  // dirty flags are kept until this level reads them.
+  bool parent_level_changed = false;
+  for (uint32_t depth = 0; depth < levels_.size(); ++depth) {
+    Level& level = levels_[depth];
+    size_t updated_node_count = 0;
+    if (level.has_dirty || parent_level_changed) {
+      updated_node_count = ParallelSum(
+          level.world_matrices.size(), [&](size_t begin, size_t end) {
+            return UpdateRange(depth, begin, end, parent_level_changed);
+          });
+    } else {
+      ++stats_.skipped_level_count;
+    }
+
+    if (parent_level_changed) {
+      Level& parent_level = levels_[depth - 1];
+      std::fill(parent_level.dirty.begin(), parent_level.dirty.end(), 0);
+    }
+    level.has_dirty = false;
+    parent_level_changed = updated_node_count > 0;
+    stats_.updated_node_count += updated_node_count;
+  }
+  if (parent_level_changed) {
+    std::vector<uint8_t>& dirty = levels_.back().dirty;
+    std::fill(dirty.begin(), dirty.end(), 0);
+  }
+
+  if (instance_matrices != nullptr) {
+    for (const Level& level : levels_) {
+      stats_.written_instance_count += ParallelSum(
+          level.world_matrices.size(), [&](size_t begin, size_t end) {
+            return WriteInstanceRange(level, begin, end, instance_matrices);
+          });
+    }
+  }
+
+  stats_.update_time_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start_time).count();
+}
+
+size_t TransformHierarchy::UpdateRange(uint32_t depth, size_t begin, size_t end,
+                                       bool parent_level_changed) {
+  Level& level = levels_[depth];
+  size_t updated_node_count = 0;
+
+  if (depth == 0) {
+    for (size_t i = begin; i < end; ++i) {
+      if (!level.dirty[i])
+        continue;
+      level.world_matrices[i] =
+          LocalMatrix(level.translations[i], level.rotations[i], level.scales[i]);
+      ++updated_node_count;
+    }
+    return updated_node_count;
+  }
+
+  const Level& parent_level = levels_[depth - 1];
+  for (size_t i = begin; i < end; ++i) {
+    const uint32_t parent = level.parents[i];
+    if (!level.dirty[i]) {
+      if (!parent_level_changed || !parent_level.dirty[parent])
+        continue;
+      // Children read this flag after the level is done.
+      level.dirty[i] = 1;
+    }
+    level.world_matrices[i] = parent_level.world_matrices[parent] *
+        LocalMatrix(level.translations[i], level.rotations[i], level.scales[i]);
+    ++updated_node_count;
+  }
+  return updated_node_count;
+}
+
+size_t TransformHierarchy::WriteInstanceRange(const Level& level, size_t begin, size_t end,
+                                              glm::mat4* instance_matrices) const {
+  size_t written_count = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const uint32_t instance_index = level.instance_indexes[i];
+    if (instance_index == kNoInstance)
+      continue;
+    instance_matrices[instance_index] = level.world_matrices[i];
+    ++written_count;
+  }
+  return written_count;
+}
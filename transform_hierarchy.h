@@ -0,0 +1,142 @@
+#ifndef TRANSFORM_HIERARCHY_H_
+#define TRANSFORM_HIERARCHY_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "task_pool.h"
+
+// A scene graph of translation-rotation-scale transforms.
+//
+// Nodes are stored in structure-of-arrays form, grouped into levels by their
+// depth in the hierarchy. Updates walk the levels in order, so every parent's
+// world matrix is computed before its children's, and each level is split
+// across the worker threads. Only the nodes whose local transform changed,
+// and their descendants, are recomputed.
+//
+// gl_deps builds glm with GLM_FORCE_INTRINSICS and 16-byte aligned types, so
+// the matrix math uses SIMD instructions.
+//
+// Nodes can't be removed. Not thread-safe, except for the internal
+// parallelism of Update().
+class TransformHierarchy {
+ public:
+  // Stable for the lifetime of the hierarchy.
+  struct NodeId {
+    uint32_t depth;
+    // The node's index in its level.
+    uint32_t index;
+  };
+
+  struct Transform {
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+  };
+
+  // Covers the last Update() call.
+  struct Stats {
+    uint64_t node_count;
+    // Nodes whose world matrix was recomputed.
+    uint64_t updated_node_count;
+    // Levels without changes, which were skipped without reading their nodes.
+    uint64_t skipped_level_count;
+    uint64_t written_instance_count;
+    double update_time_ms;
+  };
+
+  // Nodes without an instance matrix.
+  static constexpr uint32_t kNoInstance = ~uint32_t{0};
+
+  // `thread_count` must be positive.
+  explicit TransformHierarchy(int thread_count);
+
+  TransformHierarchy(const TransformHierarchy&) = delete;
+  TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+  ~TransformHierarchy();
+
+  // `instance_index` selects the node's matrix in the instance buffers
+  // passed to Update(), or is kNoInstance.
+  NodeId AddRoot(const Transform& local_transform, uint32_t instance_index);
+  NodeId AddChild(NodeId parent, const Transform& local_transform, uint32_t instance_index);
+
+  // The node's world matrix is recomputed by the next Update().
+  void SetLocalTransform(NodeId node, const Transform& local_transform);
+
+  // Valid after the Update() following the node's last change.
+  [[nodiscard]] const glm::mat4& WorldMatrix(NodeId node) const {
+    assert(node.depth < levels_.size());
+    assert(node.index < levels_[node.depth].world_matrices.size());
+    return levels_[node.depth].world_matrices[node.index];
+  }
+
+  // Recomputes the world matrices of the changed nodes.
+  //
+  // Then, if `instance_matrices` isn't null, writes every instanced node's
+  // world matrix to its instance index. All the matrices are written, not
+  // just the recomputed ones, because instance buffers are usually per-frame
+  // VulkanFrameAllocator regions that don't keep earlier frames' data.
+  // `instance_matrices` is usually mapped device memory, and must be aligned
+  // to 16 bytes.
+  void Update(glm::mat4* instance_matrices);
+
+  [[nodiscard]] size_t NodeCount() const { return node_count_; }
+
+  [[nodiscard]] Stats GetStats() const { return stats_; }
+
+ private:
+  // The nodes at one depth.
+  struct Level {
+    // Indexes into the previous level. Empty for the roots.
+    std::vector<uint32_t> parents;
+    // Stored as vec4s, which are 16-byte aligned. The translations' w
+    // components are 1, so they are the local matrices' last columns.
+    std::vector<glm::vec4> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec4> scales;
+    std::vector<glm::mat4> world_matrices;
+    std::vector<uint32_t> instance_indexes;
+    // Set when the local transform changes. During Update(), also set when
+    // the parent's world matrix changed, so the next level can read it.
+    std::vector<uint8_t> dirty;
+    // True if any `dirty` entry is set outside Update().
+    bool has_dirty = false;
+  };
+
+  NodeId AddNode(uint32_t depth, uint32_t parent_index, const Transform& local_transform,
+                 uint32_t instance_index);
+
+  // Recomputes the dirty nodes in [begin, end) of the level at `depth`.
+  // Returns the number of recomputed nodes.
+  size_t UpdateRange(uint32_t depth, size_t begin, size_t end, bool parent_level_changed);
+
+  // Copies the world matrices of the instanced nodes in [begin, end) of
+  // `level`. Returns the number of copied matrices.
+  size_t WriteInstanceRange(const Level& level, size_t begin, size_t end,
+                            glm::mat4* instance_matrices) const;
+
+  // Runs `range_function(begin, end)` on chunks of `[0, count)`, and returns
+  // the sum of the results. Small ranges run on the calling thread.
+  template <typename RangeFunction>
+  size_t ParallelSum(size_t count, const RangeFunction& range_function);
+
+  std::vector<Level> levels_;
+  size_t node_count_ = 0;
+  Stats stats_ = {};
+
+  // Reused across updates to avoid allocations.
+  std::vector<size_t> chunk_results_;
+
+  // Destroyed first, so the workers don't outlive the state they use.
+  TaskPool task_pool_;
+};
+
+#endif  // TRANSFORM_HIERARCHY_H_
@@ -0,0 +1,87 @@
+#ifndef VULKAN_CAPTURE_FORMAT_H_
+#define VULKAN_CAPTURE_FORMAT_H_
+
+#include <cstdint>
+
+// The command stream capture file format.
+//
+// A capture starts with kVulkanCaptureMagic, followed by records. Each record
+// is an opcode varint followed by the opcode's fields, encoded by
+// CaptureWriter. Resources are identified by IDs assigned by the recorder.
+// Resource records appear before the first command that uses them. Commands
+// only appear between kBeginFrame and kEndFrame records.
+//
+// The fields of each record are listed next to its opcode. Enums and flags
+// are stored as varints of their Vulkan values.
+
+// The last byte is the format version.
+inline constexpr char kVulkanCaptureMagic[8] = {'V', 'K', 'C', 'A', 'P', 'T', 'R', 2};
+
+enum class VulkanCaptureOp : uint32_t {
+  // Resources.
+
+  // id, size, usage, contents (bytes).
+  kBuffer = 1,
+  // id, format, width, height, usage, samples. Describes an image view
+  // covering a whole 2D image.
+  kImageView = 2,
+  // id, SPIR-V code (bytes).
+  kShaderModule = 3,
+  // id, color attachment count, color attachments, resolve attachment count,
+  // resolve attachments, has depth attachment (0 or 1), depth attachment.
+  // Each attachment is stored as format, samples, load op, store op, initial
+  // layout and final layout.
+  kRenderPass = 4,
+  // id, render pass id, attachment count, image view ids, width, height,
+  // layers.
+  kFramebuffer = 5,
+  // id, range count, then stages, offset and size for each push constant
+  // range.
+  kPipelineLayout = 6,
+  // id, then the fields of VulkanPipelineState in declaration order. Vectors
+  // are prefixed by their size. Handles are stored as resource ids.
+  kGraphicsPipeline = 7,
+
+  // Frame boundaries.
+
+  // frame number.
+  kBeginFrame = 16,
+  kEndFrame = 17,
+
+  // Commands.
+
+  // render pass id, framebuffer id, x (signed), y (signed), width, height,
+  // clear value count, then 4 floats per clear value. Depth and stencil clear
+  // values are stored as the bits of the vk::ClearValue union.
+  kBeginRenderPass = 32,
+  kEndRenderPass = 33,
+  // pipeline id.
+  kBindPipeline = 34,
+  // x, y, width, height, min depth, max depth (floats).
+  kSetViewport = 35,
+  // x (signed), y (signed), width, height.
+  kSetScissor = 36,
+  // pipeline layout id, stages, offset, data (bytes).
+  kPushConstants = 37,
+  // first binding, binding count, then buffer id and offset for each binding.
+  kBindVertexBuffers = 38,
+  // buffer id, offset, index type.
+  kBindIndexBuffer = 39,
+  // vertex count, instance count, first vertex, first instance.
+  kDraw = 40,
+  // index count, instance count, first index, vertex offset (signed), first
+  // instance.
+  kDrawIndexed = 41,
+  // source buffer id, destination buffer id, region count, then source
+  // offset, destination offset and size for each region.
+  kCopyBuffer = 42,
+  // buffer id, offset, size, data.
+  kFillBuffer = 43,
+  // source stages, destination stages, source access, destination access.
+  kMemoryBarrier = 44,
+  // buffer id, offset, data (bytes). A host write to mapped buffer memory,
+  // made before the frame's commands were submitted.
+  kWriteBuffer = 45,
+};
+
+#endif  // VULKAN_CAPTURE_FORMAT_H_
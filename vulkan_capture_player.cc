@@ -0,0 +1,618 @@
+#include "vulkan_capture_player.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "capture_stream.h"
+#include "vulkan_capture_format.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_image.h"
+#include "vulkan_object_cache.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_render_pass_cache.h"
+
+namespace {
+
+constexpr int kPipelineWorkerCount = 2;
+
+// The largest update allowed by vkCmdUpdateBuffer().
+constexpr size_t kMaxBufferUpdateSize = 65536;
+
+[[noreturn]] void AbortMalformedCapture(const char* reason) {
+  std::cerr << "Malformed capture: " << reason << std::endl;
+  std::abort();
+}
+
+[[nodiscard]] std::vector<uint8_t> ReadCaptureFile(const char* capture_path) {
+  std::ifstream file(capture_path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Failed to open capture: " << capture_path << std::endl;
+    std::abort();
+  }
+
+  std::streamsize file_size = file.tellg();
+  if (file_size < static_cast<std::streamsize>(sizeof(kVulkanCaptureMagic))) {
+    std::cerr << "Invalid capture size: " << capture_path << std::endl;
+    std::abort();
+  }
+
+  std::vector<uint8_t> bytes(static_cast<size_t>(file_size));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(bytes.data()), file_size);
+  if (!file ||
+      std::memcmp(bytes.data(), kVulkanCaptureMagic, sizeof(kVulkanCaptureMagic)) != 0) {
+    std::cerr << "Invalid capture: " << capture_path << std::endl;
+    std::abort();
+  }
+  return bytes;
+}
+
+template <typename Enum>
+[[nodiscard]] Enum ReadEnum(CaptureReader& reader) {
+  return static_cast<Enum>(reader.ReadVarint32());
+}
+
+template <typename Flags>
+[[nodiscard]] Flags ReadFlags(CaptureReader& reader) {
+  return Flags(static_cast<typename Flags::MaskType>(reader.ReadVarint32()));
+}
+
+[[nodiscard]] uint32_t FindBufferMemoryType(const VulkanDevice& device,
+                                            uint32_t memory_type_bits) {
+  constexpr vk::MemoryPropertyFlags kHostVisibleCoherent =
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+  std::optional<uint32_t> memory_type = device.FindMemoryType(
+      memory_type_bits, kHostVisibleCoherent | vk::MemoryPropertyFlagBits::eDeviceLocal);
+  if (memory_type.has_value())
+    return *memory_type;
+
+  memory_type = device.FindMemoryType(memory_type_bits, kHostVisibleCoherent);
+  if (memory_type.has_value())
+    return *memory_type;
+
+  std::cerr << "No host-coherent memory type for replayed buffers" << std::endl;
+  std::abort();
+}
+
+}  // namespace
+
+VulkanCapturePlayer::VulkanCapturePlayer(const VulkanDevice& device, const char* capture_path)
+    : device_(device),
+      object_cache_(device),
+      render_pass_cache_(device),
+      pipeline_manager_(device, kPipelineWorkerCount) {
+  assert(capture_path != nullptr);
+
+  vk::CommandPoolCreateInfo command_pool_info;
+  command_pool_info.setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+  vk::ResultValue<vk::UniqueCommandPool> command_pool_result =
+      device.VulkanHandle().createCommandPoolUnique(command_pool_info);
+  VulkanCheckResult("vkCreateCommandPool", command_pool_result.result);
+  command_pool_ = std::move(command_pool_result.value);
+
+  const std::vector<uint8_t> capture = ReadCaptureFile(capture_path);
+  CaptureReader reader(capture.data() + sizeof(kVulkanCaptureMagic),
+                       capture.size() - sizeof(kVulkanCaptureMagic));
+  while (!reader.AtEnd()) {
+    const VulkanCaptureOp op = ReadEnum<VulkanCaptureOp>(reader);
+    if (op == VulkanCaptureOp::kBeginFrame) {
+      std::ignore = reader.ReadVarint();  // The frame number is informational.
+      RecordFrame(reader);
+      continue;
+    }
+
+    const uint32_t id = reader.ReadVarint32();
+    if (id == 0)
+      AbortMalformedCapture("resource without an ID");
+
+    switch (op) {
+      case VulkanCaptureOp::kBuffer:
+        CreateBuffer(id, reader);
+        break;
+      case VulkanCaptureOp::kImageView:
+        CreateImageView(id, reader);
+        break;
+      case VulkanCaptureOp::kShaderModule:
+        CreateShaderModule(id, reader);
+        break;
+      case VulkanCaptureOp::kRenderPass:
+        CreateRenderPass(id, reader);
+        break;
+      case VulkanCaptureOp::kFramebuffer:
+        CreateFramebuffer(id, reader);
+        break;
+      case VulkanCaptureOp::kPipelineLayout:
+        CreatePipelineLayout(id, reader);
+        break;
+      case VulkanCaptureOp::kGraphicsPipeline:
+        CreateGraphicsPipeline(id, reader);
+        break;
+      default:
+        AbortMalformedCapture("command outside a frame");
+    }
+    if (reader.HasError())
+      AbortMalformedCapture("truncated resource");
+  }
+
+  command_buffer_handles_.reserve(command_buffers_.size());
+  for (const vk::UniqueCommandBuffer& command_buffer : command_buffers_)
+    command_buffer_handles_.push_back(command_buffer.get());
+}
+
+VulkanCapturePlayer::~VulkanCapturePlayer() = default;
+
+void VulkanCapturePlayer::CreateBuffer(uint32_t id, CaptureReader& reader) {
+  const vk::DeviceSize size = reader.ReadVarint();
+  const vk::BufferUsageFlags usage = ReadFlags<vk::BufferUsageFlags>(reader);
+  size_t contents_size;
+  const uint8_t* contents = reader.ReadBytes(&contents_size);
+  if (reader.HasError() || size == 0 || (contents_size != 0 && contents_size != size))
+    AbortMalformedCapture("invalid buffer");
+
+  // Captured host writes become transfers.
+  vk::BufferCreateInfo create_info;
+  create_info
+      .setSize(size)
+      .setUsage(usage | vk::BufferUsageFlagBits::eTransferDst)
+      .setSharingMode(vk::SharingMode::eExclusive);
+  vk::Device device = device_.VulkanHandle();
+  vk::ResultValue<vk::UniqueBuffer> create_result = device.createBufferUnique(create_info);
+  VulkanCheckResult("vkCreateBuffer", create_result.result);
+  Buffer buffer;
+  buffer.buffer = std::move(create_result.value);
+
+  vk::MemoryRequirements requirements = device.getBufferMemoryRequirements(buffer.buffer.get());
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info
+      .setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(FindBufferMemoryType(device_, requirements.memoryTypeBits));
+  vk::ResultValue<vk::UniqueDeviceMemory> allocate_result =
+      device.allocateMemoryUnique(allocate_info);
+  VulkanCheckResult("vkAllocateMemory", allocate_result.result);
+  buffer.memory = std::move(allocate_result.value);
+  VulkanCheckResult("vkBindBufferMemory",
+                    device.bindBufferMemory(buffer.buffer.get(), buffer.memory.get(), 0));
+
+  vk::ResultValue<void*> map_result = device.mapMemory(buffer.memory.get(), /*offset=*/0, size);
+  VulkanCheckResult("vkMapMemory", map_result.result);
+  if (contents_size != 0) {
+    std::memcpy(map_result.value, contents, contents_size);
+  } else {
+    std::memset(map_result.value, 0, size);
+  }
+  device.unmapMemory(buffer.memory.get());
+
+  if (!buffers_.try_emplace(id, std::move(buffer)).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+void VulkanCapturePlayer::CreateImageView(uint32_t id, CaptureReader& reader) {
+  const vk::Format format = ReadEnum<vk::Format>(reader);
+  vk::Extent2D extent;
+  extent.width = reader.ReadVarint32();
+  extent.height = reader.ReadVarint32();
+  const vk::ImageUsageFlags usage = ReadFlags<vk::ImageUsageFlags>(reader);
+  const vk::SampleCountFlagBits samples = ReadEnum<vk::SampleCountFlagBits>(reader);
+  if (reader.HasError() || extent.width == 0 || extent.height == 0)
+    AbortMalformedCapture("invalid image view");
+
+  if (!images_.try_emplace(id, device_, extent, format, usage, samples).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+void VulkanCapturePlayer::CreateShaderModule(uint32_t id, CaptureReader& reader) {
+  size_t code_size;
+  const uint8_t* code = reader.ReadBytes(&code_size);
+  if (reader.HasError() || code_size == 0 || code_size % sizeof(uint32_t) != 0)
+    AbortMalformedCapture("invalid shader module");
+
+  // The capture's bytes aren't aligned for SPIR-V words.
+  std::vector<uint32_t> code_words(code_size / sizeof(uint32_t));
+  std::memcpy(code_words.data(), code, code_size);
+  vk::ShaderModuleCreateInfo create_info;
+  create_info.setCode(code_words);
+
+  vk::ResultValue<vk::UniqueShaderModule> create_result =
+      device_.VulkanHandle().createShaderModuleUnique(create_info);
+  VulkanCheckResult("vkCreateShaderModule", create_result.result);
+  if (!shader_modules_.try_emplace(id, std::move(create_result.value)).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+void VulkanCapturePlayer::CreateRenderPass(uint32_t id, CaptureReader& reader) {
+  auto read_attachment = [&reader]() {
+    VulkanAttachmentKey attachment;
+    attachment.format = ReadEnum<vk::Format>(reader);
+    attachment.samples = ReadEnum<vk::SampleCountFlagBits>(reader);
+    attachment.load_op = ReadEnum<vk::AttachmentLoadOp>(reader);
+    attachment.store_op = ReadEnum<vk::AttachmentStoreOp>(reader);
+
+    // The replayed images are never presented, and their layouts between
+    // render passes are unknown.
+    std::ignore = ReadEnum<vk::ImageLayout>(reader);
+    attachment.initial_layout = vk::ImageLayout::eUndefined;
+    attachment.final_layout = ReadEnum<vk::ImageLayout>(reader);
+    if (attachment.final_layout == vk::ImageLayout::ePresentSrcKHR)
+      attachment.final_layout = vk::ImageLayout::eColorAttachmentOptimal;
+    return attachment;
+  };
+
+  VulkanRenderPassKey key;
+  const uint32_t color_count = reader.ReadVarint32();
+  for (uint32_t i = 0; i < color_count && !reader.HasError(); ++i)
+    key.color_attachments.push_back(read_attachment());
+  const uint32_t resolve_count = reader.ReadVarint32();
+  for (uint32_t i = 0; i < resolve_count && !reader.HasError(); ++i)
+    key.resolve_attachments.push_back(read_attachment());
+  const uint32_t has_depth = reader.ReadVarint32();
+  if (has_depth == 1 && !reader.HasError())
+    key.depth_attachment = read_attachment();
+  if (reader.HasError() || key.color_attachments.empty() || has_depth > 1 ||
+      (resolve_count != 0 && resolve_count != color_count)) {
+    AbortMalformedCapture("invalid render pass");
+  }
+
+  if (!render_passes_.try_emplace(id, render_pass_cache_.GetRenderPass(key)).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+void VulkanCapturePlayer::CreateFramebuffer(uint32_t id, CaptureReader& reader) {
+  VulkanFramebufferKey key;
+  key.render_pass = FindRenderPass(reader.ReadVarint32());
+  const uint32_t attachment_count = reader.ReadVarint32();
+  for (uint32_t i = 0; i < attachment_count && !reader.HasError(); ++i)
+    key.attachments.push_back(FindImageView(reader.ReadVarint32()));
+  key.extent.width = reader.ReadVarint32();
+  key.extent.height = reader.ReadVarint32();
+  key.layers = reader.ReadVarint32();
+  if (reader.HasError())
+    AbortMalformedCapture("invalid framebuffer");
+
+  if (!framebuffers_.try_emplace(id, render_pass_cache_.GetFramebuffer(key)).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+void VulkanCapturePlayer::CreatePipelineLayout(uint32_t id, CaptureReader& reader) {
+  VulkanPipelineLayoutKey key;
+  const uint32_t range_count = reader.ReadVarint32();
+  for (uint32_t i = 0; i < range_count && !reader.HasError(); ++i) {
+    vk::PushConstantRange& range = key.push_constant_ranges.emplace_back();
+    range.stageFlags = ReadFlags<vk::ShaderStageFlags>(reader);
+    range.offset = reader.ReadVarint32();
+    range.size = reader.ReadVarint32();
+  }
+  if (reader.HasError())
+    AbortMalformedCapture("invalid pipeline layout");
+
+  vk::PipelineLayout layout = object_cache_.GetPipelineLayout(std::move(key));
+  if (!pipeline_layouts_.try_emplace(id, layout).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+void VulkanCapturePlayer::CreateGraphicsPipeline(uint32_t id, CaptureReader& reader) {
+  VulkanPipelineState state;
+  const uint32_t binding_count = reader.ReadVarint32();
+  for (uint32_t i = 0; i < binding_count && !reader.HasError(); ++i) {
+    vk::VertexInputBindingDescription& binding = state.vertex_bindings.emplace_back();
+    binding.binding = reader.ReadVarint32();
+    binding.stride = reader.ReadVarint32();
+    binding.inputRate = ReadEnum<vk::VertexInputRate>(reader);
+  }
+  const uint32_t attribute_count = reader.ReadVarint32();
+  for (uint32_t i = 0; i < attribute_count && !reader.HasError(); ++i) {
+    vk::VertexInputAttributeDescription& attribute = state.vertex_attributes.emplace_back();
+    attribute.location = reader.ReadVarint32();
+    attribute.binding = reader.ReadVarint32();
+    attribute.format = ReadEnum<vk::Format>(reader);
+    attribute.offset = reader.ReadVarint32();
+  }
+  state.topology = ReadEnum<vk::PrimitiveTopology>(reader);
+  state.vertex_shader = FindShaderModule(reader.ReadVarint32());
+  state.polygon_mode = ReadEnum<vk::PolygonMode>(reader);
+  state.cull_mode = ReadFlags<vk::CullModeFlags>(reader);
+  state.front_face = ReadEnum<vk::FrontFace>(reader);
+  state.fragment_shader = FindShaderModule(reader.ReadVarint32());
+  state.samples = ReadEnum<vk::SampleCountFlagBits>(reader);
+  state.color_attachment_count = reader.ReadVarint32();
+  state.blend_enabled = reader.ReadVarint() != 0;
+  state.layout = FindPipelineLayout(reader.ReadVarint32());
+  state.render_pass = FindRenderPass(reader.ReadVarint32());
+  state.subpass = reader.ReadVarint32();
+  if (reader.HasError() || !state.vertex_shader)
+    AbortMalformedCapture("invalid graphics pipeline");
+
+  // The builds overlap with loading the rest of the capture.
+  pipeline_manager_.Prefetch(state);
+  if (!pipeline_states_.try_emplace(id, std::move(state)).second)
+    AbortMalformedCapture("duplicate resource ID");
+}
+
+vk::CommandBuffer VulkanCapturePlayer::BeginCommandBuffer() {
+  vk::CommandBufferAllocateInfo allocate_info;
+  allocate_info
+      .setCommandPool(command_pool_.get())
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+      device_.VulkanHandle().allocateCommandBuffersUnique(allocate_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+  vk::CommandBuffer command_buffer =
+      command_buffers_.emplace_back(std::move(allocate_result.value[0])).get();
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info));
+
+  // The captured frames synchronized with the application's other work, which
+  // isn't replayed. A full barrier stands in for that synchronization.
+  vk::MemoryBarrier barrier(vk::AccessFlagBits::eMemoryWrite,
+                            vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eAllCommands,
+      /*dependencyFlags=*/{}, barrier, /*bufferMemoryBarriers=*/nullptr,
+      /*imageMemoryBarriers=*/nullptr);
+  return command_buffer;
+}
+
+void VulkanCapturePlayer::RecordFrame(CaptureReader& reader) {
+  // Lets the pipelines prefetched so far finish building, so the frames bind
+  // optimized pipelines.
+  if (frame_count_ == 0)
+    pipeline_manager_.WaitIdle();
+
+  const vk::CommandBuffer command_buffer = BeginCommandBuffer();
+  // Created on the first captured host write, and submitted before
+  // `command_buffer`.
+  vk::CommandBuffer upload_command_buffer;
+
+  while (true) {
+    const VulkanCaptureOp op = ReadEnum<VulkanCaptureOp>(reader);
+    if (reader.HasError())
+      AbortMalformedCapture("truncated frame");
+
+    switch (op) {
+      case VulkanCaptureOp::kEndFrame: {
+        if (upload_command_buffer)
+          VulkanCheckResult("vkEndCommandBuffer", upload_command_buffer.end());
+        VulkanCheckResult("vkEndCommandBuffer", command_buffer.end());
+        ++frame_count_;
+        return;
+      }
+      case VulkanCaptureOp::kBeginRenderPass: {
+        vk::RenderPassBeginInfo begin_info;
+        begin_info.setRenderPass(FindRenderPass(reader.ReadVarint32()));
+        begin_info.setFramebuffer(FindFramebuffer(reader.ReadVarint32()));
+        vk::Rect2D render_area;
+        render_area.offset.x = static_cast<int32_t>(reader.ReadSignedVarint());
+        render_area.offset.y = static_cast<int32_t>(reader.ReadSignedVarint());
+        render_area.extent.width = reader.ReadVarint32();
+        render_area.extent.height = reader.ReadVarint32();
+        begin_info.setRenderArea(render_area);
+
+        std::vector<vk::ClearValue> clear_values(reader.ReadVarint32());
+        for (vk::ClearValue& clear_value : clear_values) {
+          std::array<float, 4> color;
+          for (float& component : color)
+            component = reader.ReadFloat();
+          clear_value.setColor(vk::ClearColorValue(color));
+        }
+        begin_info.setClearValues(clear_values);
+        command_buffer.beginRenderPass(begin_info, vk::SubpassContents::eInline);
+        break;
+      }
+      case VulkanCaptureOp::kEndRenderPass:
+        command_buffer.endRenderPass();
+        break;
+      case VulkanCaptureOp::kBindPipeline:
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                    FindPipeline(reader.ReadVarint32()));
+        break;
+      case VulkanCaptureOp::kSetViewport: {
+        vk::Viewport viewport;
+        viewport.x = reader.ReadFloat();
+        viewport.y = reader.ReadFloat();
+        viewport.width = reader.ReadFloat();
+        viewport.height = reader.ReadFloat();
+        viewport.minDepth = reader.ReadFloat();
+        viewport.maxDepth = reader.ReadFloat();
+        command_buffer.setViewport(/*firstViewport=*/0, viewport);
+        break;
+      }
+      case VulkanCaptureOp::kSetScissor: {
+        vk::Rect2D scissor;
+        scissor.offset.x = static_cast<int32_t>(reader.ReadSignedVarint());
+        scissor.offset.y = static_cast<int32_t>(reader.ReadSignedVarint());
+        scissor.extent.width = reader.ReadVarint32();
+        scissor.extent.height = reader.ReadVarint32();
+        command_buffer.setScissor(/*firstScissor=*/0, scissor);
+        break;
+      }
+      case VulkanCaptureOp::kPushConstants: {
+        const vk::PipelineLayout layout = FindPipelineLayout(reader.ReadVarint32());
+        const vk::ShaderStageFlags stages = ReadFlags<vk::ShaderStageFlags>(reader);
+        const uint32_t offset = reader.ReadVarint32();
+        size_t size;
+        const uint8_t* data = reader.ReadBytes(&size);
+        if (reader.HasError())
+          AbortMalformedCapture("truncated frame");
+        command_buffer.pushConstants(layout, stages, offset, static_cast<uint32_t>(size),
+                                     data);
+        break;
+      }
+      case VulkanCaptureOp::kBindVertexBuffers: {
+        const uint32_t first_binding = reader.ReadVarint32();
+        const uint32_t binding_count = reader.ReadVarint32();
+        std::vector<vk::Buffer> buffers;
+        std::vector<vk::DeviceSize> offsets;
+        for (uint32_t i = 0; i < binding_count && !reader.HasError(); ++i) {
+          buffers.push_back(FindBuffer(reader.ReadVarint32()));
+          offsets.push_back(reader.ReadVarint());
+        }
+        command_buffer.bindVertexBuffers(first_binding, buffers, offsets);
+        break;
+      }
+      case VulkanCaptureOp::kBindIndexBuffer: {
+        const vk::Buffer buffer = FindBuffer(reader.ReadVarint32());
+        const vk::DeviceSize offset = reader.ReadVarint();
+        command_buffer.bindIndexBuffer(buffer, offset, ReadEnum<vk::IndexType>(reader));
+        break;
+      }
+      case VulkanCaptureOp::kDraw: {
+        const uint32_t vertex_count = reader.ReadVarint32();
+        const uint32_t instance_count = reader.ReadVarint32();
+        const uint32_t first_vertex = reader.ReadVarint32();
+        const uint32_t first_instance = reader.ReadVarint32();
+        command_buffer.draw(vertex_count, instance_count, first_vertex, first_instance);
+        break;
+      }
+      case VulkanCaptureOp::kDrawIndexed: {
+        const uint32_t index_count = reader.ReadVarint32();
+        const uint32_t instance_count = reader.ReadVarint32();
+        const uint32_t first_index = reader.ReadVarint32();
+        const int32_t vertex_offset = static_cast<int32_t>(reader.ReadSignedVarint());
+        const uint32_t first_instance = reader.ReadVarint32();
+        command_buffer.drawIndexed(index_count, instance_count, first_index, vertex_offset,
+                                   first_instance);
+        break;
+      }
+      case VulkanCaptureOp::kCopyBuffer: {
+        const vk::Buffer source = FindBuffer(reader.ReadVarint32());
+        const vk::Buffer destination = FindBuffer(reader.ReadVarint32());
+        std::vector<vk::BufferCopy> regions(reader.ReadVarint32());
+        for (vk::BufferCopy& region : regions) {
+          region.srcOffset = reader.ReadVarint();
+          region.dstOffset = reader.ReadVarint();
+          region.size = reader.ReadVarint();
+        }
+        command_buffer.copyBuffer(source, destination, regions);
+        break;
+      }
+      case VulkanCaptureOp::kFillBuffer: {
+        const vk::Buffer buffer = FindBuffer(reader.ReadVarint32());
+        const vk::DeviceSize offset = reader.ReadVarint();
+        const vk::DeviceSize size = reader.ReadVarint();
+        command_buffer.fillBuffer(buffer, offset, size, reader.ReadVarint32());
+        break;
+      }
+      case VulkanCaptureOp::kMemoryBarrier: {
+        const vk::PipelineStageFlags source_stages = ReadFlags<vk::PipelineStageFlags>(reader);
+        const vk::PipelineStageFlags destination_stages =
+            ReadFlags<vk::PipelineStageFlags>(reader);
+        const vk::AccessFlags source_access = ReadFlags<vk::AccessFlags>(reader);
+        vk::MemoryBarrier barrier(source_access, ReadFlags<vk::AccessFlags>(reader));
+        command_buffer.pipelineBarrier(source_stages, destination_stages,
+                                       /*dependencyFlags=*/{}, barrier,
+                                       /*bufferMemoryBarriers=*/nullptr,
+                                       /*imageMemoryBarriers=*/nullptr);
+        break;
+      }
+      case VulkanCaptureOp::kWriteBuffer: {
+        const vk::Buffer buffer = FindBuffer(reader.ReadVarint32());
+        vk::DeviceSize offset = reader.ReadVarint();
+        size_t size;
+        const uint8_t* data = reader.ReadBytes(&size);
+        if (reader.HasError())
+          AbortMalformedCapture("truncated frame");
+        if (offset % 4 != 0 || size % 4 != 0) {
+          std::cerr << "Replaying unaligned buffer writes is not supported" << std::endl;
+          std::abort();
+        }
+
+        if (!upload_command_buffer) {
+          upload_command_buffer = BeginCommandBuffer();
+          // Keeps the uploads ahead of the frame's commands.
+          std::swap(command_buffers_[command_buffers_.size() - 1],
+                    command_buffers_[command_buffers_.size() - 2]);
+        }
+        while (size > 0) {
+          const size_t chunk_size = std::min(size, kMaxBufferUpdateSize);
+          upload_command_buffer.updateBuffer(buffer, offset, chunk_size, data);
+          offset += chunk_size;
+          data += chunk_size;
+          size -= chunk_size;
+        }
+        break;
+      }
+      default:
+        AbortMalformedCapture("resource inside a frame");
+    }
+    if (reader.HasError())
+      AbortMalformedCapture("truncated frame");
+  }
+}
+
+vk::Buffer VulkanCapturePlayer::FindBuffer(uint32_t id) const {
+  auto it = buffers_.find(id);
+  if (it == buffers_.end())
+    AbortMalformedCapture("unknown buffer");
+  return it->second.buffer.get();
+}
+
+vk::ImageView VulkanCapturePlayer::FindImageView(uint32_t id) const {
+  auto it = images_.find(id);
+  if (it == images_.end())
+    AbortMalformedCapture("unknown image view");
+  return it->second.View();
+}
+
+vk::RenderPass VulkanCapturePlayer::FindRenderPass(uint32_t id) const {
+  auto it = render_passes_.find(id);
+  if (it == render_passes_.end())
+    AbortMalformedCapture("unknown render pass");
+  return it->second;
+}
+
+vk::Framebuffer VulkanCapturePlayer::FindFramebuffer(uint32_t id) const {
+  auto it = framebuffers_.find(id);
+  if (it == framebuffers_.end())
+    AbortMalformedCapture("unknown framebuffer");
+  return it->second;
+}
+
+vk::PipelineLayout VulkanCapturePlayer::FindPipelineLayout(uint32_t id) const {
+  auto it = pipeline_layouts_.find(id);
+  if (it == pipeline_layouts_.end())
+    AbortMalformedCapture("unknown pipeline layout");
+  return it->second;
+}
+
+vk::ShaderModule VulkanCapturePlayer::FindShaderModule(uint32_t id) const {
+  if (id == 0)
+    return vk::ShaderModule();
+
+  auto it = shader_modules_.find(id);
+  if (it == shader_modules_.end())
+    AbortMalformedCapture("unknown shader module");
+  return it->second.get();
+}
+
+vk::Pipeline VulkanCapturePlayer::FindPipeline(uint32_t id) {
+  auto it = pipelines_.find(id);
+  if (it != pipelines_.end())
+    return it->second;
+
+  auto state_it = pipeline_states_.find(id);
+  if (state_it == pipeline_states_.end())
+    AbortMalformedCapture("unknown graphics pipeline");
+  vk::Pipeline pipeline = pipeline_manager_.GetPipeline(state_it->second);
+  pipelines_.emplace(id, pipeline);
+  return pipeline;
+}
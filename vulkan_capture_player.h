@@ -0,0 +1,106 @@
+#ifndef VULKAN_CAPTURE_PLAYER_H_
+#define VULKAN_CAPTURE_PLAYER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "capture_stream.h"
+#include "vulkan_image.h"
+#include "vulkan_object_cache.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_render_pass_cache.h"
+
+class VulkanDevice;
+
+// Replays a capture written by VulkanCaptureRecorder.
+//
+// All the resources are created and all the frames are recorded when the
+// capture is loaded, so submitting the frames measures GPU work without the
+// application's CPU overhead. Captured host writes are replayed with
+// vkCmdUpdateBuffer() at the start of their frames.
+//
+// Image layouts are not captured, so render passes start their attachments
+// in vk::ImageLayout::eUndefined, and presentation layouts are replaced.
+class VulkanCapturePlayer {
+ public:
+  // Terminates the program if the capture can't be read or is malformed.
+  explicit VulkanCapturePlayer(const VulkanDevice& device, const char* capture_path);
+
+  VulkanCapturePlayer(const VulkanCapturePlayer&) = delete;
+  VulkanCapturePlayer& operator=(const VulkanCapturePlayer&) = delete;
+
+  // The command buffers must not be pending.
+  ~VulkanCapturePlayer();
+
+  [[nodiscard]] size_t FrameCount() const { return frame_count_; }
+
+  // The command buffers for all the captured frames, in submission order.
+  //
+  // The command buffers can be submitted repeatedly, and are ordered by
+  // full memory barriers, so they can all go in one vkQueueSubmit().
+  [[nodiscard]] const std::vector<vk::CommandBuffer>& CommandBuffers() const {
+    return command_buffer_handles_;
+  }
+
+ private:
+  struct Buffer {
+    vk::UniqueBuffer buffer;
+    vk::UniqueDeviceMemory memory;
+  };
+
+  // Resource records.
+  void CreateBuffer(uint32_t id, CaptureReader& reader);
+  void CreateImageView(uint32_t id, CaptureReader& reader);
+  void CreateShaderModule(uint32_t id, CaptureReader& reader);
+  void CreateRenderPass(uint32_t id, CaptureReader& reader);
+  void CreateFramebuffer(uint32_t id, CaptureReader& reader);
+  void CreatePipelineLayout(uint32_t id, CaptureReader& reader);
+  void CreateGraphicsPipeline(uint32_t id, CaptureReader& reader);
+
+  // Records one frame's commands, up to and including its kEndFrame record.
+  void RecordFrame(CaptureReader& reader);
+
+  // Returns a command buffer in the recording state.
+  [[nodiscard]] vk::CommandBuffer BeginCommandBuffer();
+
+  [[nodiscard]] vk::Buffer FindBuffer(uint32_t id) const;
+  [[nodiscard]] vk::ImageView FindImageView(uint32_t id) const;
+  [[nodiscard]] vk::RenderPass FindRenderPass(uint32_t id) const;
+  [[nodiscard]] vk::Framebuffer FindFramebuffer(uint32_t id) const;
+  [[nodiscard]] vk::PipelineLayout FindPipelineLayout(uint32_t id) const;
+  // Returns a null handle for ID 0.
+  [[nodiscard]] vk::ShaderModule FindShaderModule(uint32_t id) const;
+  [[nodiscard]] vk::Pipeline FindPipeline(uint32_t id);
+
+  const VulkanDevice& device_;
+  vk::UniqueCommandPool command_pool_;
+
+  // Indexed by resource ID. The owned resources are declared first, so they
+  // outlive the objects that use them.
+  std::unordered_map<uint32_t, vk::UniqueShaderModule> shader_modules_;
+  std::unordered_map<uint32_t, VulkanImage> images_;
+  std::unordered_map<uint32_t, Buffer> buffers_;
+
+  VulkanObjectCache object_cache_;
+  VulkanRenderPassCache render_pass_cache_;
+  VulkanPipelineManager pipeline_manager_;
+
+  std::unordered_map<uint32_t, vk::PipelineLayout> pipeline_layouts_;
+  std::unordered_map<uint32_t, vk::RenderPass> render_passes_;
+  std::unordered_map<uint32_t, vk::Framebuffer> framebuffers_;
+  std::unordered_map<uint32_t, VulkanPipelineState> pipeline_states_;
+  // Filled in when the pipelines are first bound.
+  std::unordered_map<uint32_t, vk::Pipeline> pipelines_;
+
+  std::vector<vk::UniqueCommandBuffer> command_buffers_;
+  std::vector<vk::CommandBuffer> command_buffer_handles_;
+  size_t frame_count_ = 0;
+};
+
+#endif  // VULKAN_CAPTURE_PLAYER_H_
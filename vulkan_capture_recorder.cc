@@ -0,0 +1,436 @@
+#include "vulkan_capture_recorder.h"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "capture_stream.h"
+#include "vulkan_capture_format.h"
+#include "vulkan_device.h"
+#include "vulkan_object_cache.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_render_pass_cache.h"
+
+namespace {
+
+// Handles are pointers on 64-bit platforms, and integers elsewhere.
+template <typename Handle>
+[[nodiscard]] uint64_t HandleValue(Handle handle) {
+  using CHandle = typename Handle::CType;
+  if constexpr (std::is_pointer_v<CHandle>)
+    return reinterpret_cast<uintptr_t>(static_cast<CHandle>(handle));
+  else
+    return static_cast<uint64_t>(static_cast<CHandle>(handle));
+}
+
+template <typename Flags>
+[[nodiscard]] uint64_t FlagsValue(Flags flags) {
+  return static_cast<uint64_t>(static_cast<typename Flags::MaskType>(flags));
+}
+
+template <typename Enum>
+[[nodiscard]] uint64_t EnumValue(Enum value) {
+  return static_cast<uint64_t>(value);
+}
+
+}  // namespace
+
+VulkanCaptureRecorder::VulkanCaptureRecorder(const VulkanDevice& device, std::string path,
+                                             uint64_t first_frame, uint64_t frame_count)
+    : dispatcher_(device.Dispatcher()),
+      path_(std::move(path)),
+      first_frame_(first_frame),
+      end_frame_(first_frame + frame_count) {
+  assert(first_frame > 0);
+  assert(frame_count > 0);
+}
+
+VulkanCaptureRecorder::~VulkanCaptureRecorder() {
+  if (captured_frame_count_ > 0 && !has_written_file_)
+    WriteFile();
+}
+
+uint32_t VulkanCaptureRecorder::DescribeResource(VulkanCaptureOp op, uint64_t handle_value) {
+  assert(handle_value != 0);
+  const size_t kind = static_cast<size_t>(op);
+  assert(kind < kResourceKindCount);
+
+  auto [it, is_new] = resources_[kind].try_emplace(handle_value);
+  Resource& resource = it->second;
+  if (!is_new && resource.description == description_.Bytes())
+    return resource.id;
+
+  resource.id = next_resource_id_++;
+  resource.description = description_.Bytes();
+
+  resource_log_.WriteVarint(static_cast<uint32_t>(op));
+  resource_log_.WriteVarint(resource.id);
+  resource_log_.Append(description_);
+  return resource.id;
+}
+
+uint32_t VulkanCaptureRecorder::ResourceId(VulkanCaptureOp op, uint64_t handle_value) const {
+  // ID 0 stands for null handles.
+  if (handle_value == 0)
+    return 0;
+
+  const size_t kind = static_cast<size_t>(op);
+  assert(kind < kResourceKindCount);
+  auto it = resources_[kind].find(handle_value);
+  if (it == resources_[kind].end()) {
+    std::cerr << "Captured command uses an undescribed resource" << std::endl;
+    std::abort();
+  }
+  return it->second.id;
+}
+
+void VulkanCaptureRecorder::DescribeBuffer(vk::Buffer buffer, vk::DeviceSize size,
+                                           vk::BufferUsageFlags usage, const void* contents) {
+  description_.Clear();
+  description_.WriteVarint(size);
+  description_.WriteVarint(FlagsValue(usage));
+  if (contents != nullptr) {
+    description_.WriteBytes(contents, size);
+  } else {
+    description_.WriteVarint(0);
+  }
+  DescribeResource(VulkanCaptureOp::kBuffer, HandleValue(buffer));
+}
+
+void VulkanCaptureRecorder::DescribeImageView(vk::ImageView view, vk::Format format,
+                                              vk::Extent2D extent, vk::ImageUsageFlags usage,
+                                              vk::SampleCountFlagBits samples) {
+  description_.Clear();
+  description_.WriteVarint(EnumValue(format));
+  description_.WriteVarint(extent.width);
+  description_.WriteVarint(extent.height);
+  description_.WriteVarint(FlagsValue(usage));
+  description_.WriteVarint(EnumValue(samples));
+  DescribeResource(VulkanCaptureOp::kImageView, HandleValue(view));
+}
+
+void VulkanCaptureRecorder::DescribeShaderModule(vk::ShaderModule shader_module,
+                                                 const void* spirv_code, size_t spirv_size) {
+  description_.Clear();
+  description_.WriteBytes(spirv_code, spirv_size);
+  DescribeResource(VulkanCaptureOp::kShaderModule, HandleValue(shader_module));
+}
+
+void VulkanCaptureRecorder::DescribeRenderPass(vk::RenderPass render_pass,
+                                               const VulkanRenderPassKey& key) {
+  auto write_attachment = [this](const VulkanAttachmentKey& attachment) {
+    description_.WriteVarint(EnumValue(attachment.format));
+    description_.WriteVarint(EnumValue(attachment.samples));
+    description_.WriteVarint(EnumValue(attachment.load_op));
+    description_.WriteVarint(EnumValue(attachment.store_op));
+    description_.WriteVarint(EnumValue(attachment.initial_layout));
+    description_.WriteVarint(EnumValue(attachment.final_layout));
+  };
+
+  description_.Clear();
+  description_.WriteVarint(key.color_attachments.size());
+  for (const VulkanAttachmentKey& attachment : key.color_attachments)
+    write_attachment(attachment);
+  description_.WriteVarint(key.resolve_attachments.size());
+  for (const VulkanAttachmentKey& attachment : key.resolve_attachments)
+    write_attachment(attachment);
+  description_.WriteVarint(key.depth_attachment.has_value() ? 1 : 0);
+  if (key.depth_attachment.has_value())
+    write_attachment(*key.depth_attachment);
+  DescribeResource(VulkanCaptureOp::kRenderPass, HandleValue(render_pass));
+}
+
+void VulkanCaptureRecorder::DescribeFramebuffer(vk::Framebuffer framebuffer,
+                                                const VulkanFramebufferKey& key) {
+  description_.Clear();
+  description_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kRenderPass, HandleValue(key.render_pass)));
+  description_.WriteVarint(key.attachments.size());
+  for (vk::ImageView view : key.attachments)
+    description_.WriteVarint(ResourceId(VulkanCaptureOp::kImageView, HandleValue(view)));
+  description_.WriteVarint(key.extent.width);
+  description_.WriteVarint(key.extent.height);
+  description_.WriteVarint(key.layers);
+  DescribeResource(VulkanCaptureOp::kFramebuffer, HandleValue(framebuffer));
+}
+
+void VulkanCaptureRecorder::DescribePipelineLayout(vk::PipelineLayout pipeline_layout,
+                                                   const VulkanPipelineLayoutKey& key) {
+  assert(key.set_layouts.empty());
+
+  description_.Clear();
+  description_.WriteVarint(key.push_constant_ranges.size());
+  for (const vk::PushConstantRange& range : key.push_constant_ranges) {
+    description_.WriteVarint(FlagsValue(range.stageFlags));
+    description_.WriteVarint(range.offset);
+    description_.WriteVarint(range.size);
+  }
+  DescribeResource(VulkanCaptureOp::kPipelineLayout, HandleValue(pipeline_layout));
+}
+
+void VulkanCaptureRecorder::DescribeGraphicsPipeline(vk::Pipeline pipeline,
+                                                     const VulkanPipelineState& state) {
+  description_.Clear();
+  description_.WriteVarint(state.vertex_bindings.size());
+  for (const vk::VertexInputBindingDescription& binding : state.vertex_bindings) {
+    description_.WriteVarint(binding.binding);
+    description_.WriteVarint(binding.stride);
+    description_.WriteVarint(EnumValue(binding.inputRate));
+  }
+  description_.WriteVarint(state.vertex_attributes.size());
+  for (const vk::VertexInputAttributeDescription& attribute : state.vertex_attributes) {
+    description_.WriteVarint(attribute.location);
+    description_.WriteVarint(attribute.binding);
+    description_.WriteVarint(EnumValue(attribute.format));
+    description_.WriteVarint(attribute.offset);
+  }
+  description_.WriteVarint(EnumValue(state.topology));
+  description_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kShaderModule, HandleValue(state.vertex_shader)));
+  description_.WriteVarint(EnumValue(state.polygon_mode));
+  description_.WriteVarint(FlagsValue(state.cull_mode));
+  description_.WriteVarint(EnumValue(state.front_face));
+  description_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kShaderModule, HandleValue(state.fragment_shader)));
+  description_.WriteVarint(EnumValue(state.samples));
+  description_.WriteVarint(state.color_attachment_count);
+  description_.WriteVarint(state.blend_enabled ? 1 : 0);
+  description_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kPipelineLayout, HandleValue(state.layout)));
+  description_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kRenderPass, HandleValue(state.render_pass)));
+  description_.WriteVarint(state.subpass);
+  DescribeResource(VulkanCaptureOp::kGraphicsPipeline, HandleValue(pipeline));
+}
+
+void VulkanCaptureRecorder::BeginFrame(uint64_t frame_number) {
+  assert(!is_capturing_);
+  if (frame_number < first_frame_ || frame_number >= end_frame_)
+    return;
+
+  is_capturing_ = true;
+  capture_.WriteVarint(static_cast<uint32_t>(VulkanCaptureOp::kBeginFrame));
+  capture_.WriteVarint(frame_number);
+}
+
+void VulkanCaptureRecorder::EndFrame() {
+  if (!is_capturing_)
+    return;
+
+  is_capturing_ = false;
+  capture_.WriteVarint(static_cast<uint32_t>(VulkanCaptureOp::kEndFrame));
+  ++captured_frame_count_;
+  if (captured_frame_count_ == end_frame_ - first_frame_)
+    WriteFile();
+}
+
+bool VulkanCaptureRecorder::BeginCommand(VulkanCaptureOp op) {
+  if (!is_capturing_)
+    return false;
+  capture_.WriteVarint(static_cast<uint32_t>(op));
+  return true;
+}
+
+void VulkanCaptureRecorder::BeginRenderPass(vk::CommandBuffer command_buffer,
+                                            const vk::RenderPassBeginInfo& begin_info) {
+  command_buffer.beginRenderPass(begin_info, vk::SubpassContents::eInline, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kBeginRenderPass))
+    return;
+
+  capture_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kRenderPass, HandleValue(begin_info.renderPass)));
+  capture_.WriteVarint(
+      ResourceId(VulkanCaptureOp::kFramebuffer, HandleValue(begin_info.framebuffer)));
+  capture_.WriteSignedVarint(begin_info.renderArea.offset.x);
+  capture_.WriteSignedVarint(begin_info.renderArea.offset.y);
+  capture_.WriteVarint(begin_info.renderArea.extent.width);
+  capture_.WriteVarint(begin_info.renderArea.extent.height);
+  capture_.WriteVarint(begin_info.clearValueCount);
+  for (uint32_t i = 0; i < begin_info.clearValueCount; ++i) {
+    const std::array<float, 4>& color = begin_info.pClearValues[i].color.float32;
+    for (float component : color)
+      capture_.WriteFloat(component);
+  }
+}
+
+void VulkanCaptureRecorder::EndRenderPass(vk::CommandBuffer command_buffer) {
+  command_buffer.endRenderPass(dispatcher_);
+  BeginCommand(VulkanCaptureOp::kEndRenderPass);
+}
+
+void VulkanCaptureRecorder::BindPipeline(vk::CommandBuffer command_buffer,
+                                         vk::Pipeline pipeline) {
+  command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kBindPipeline))
+    return;
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kGraphicsPipeline, HandleValue(pipeline)));
+}
+
+void VulkanCaptureRecorder::SetViewport(vk::CommandBuffer command_buffer,
+                                        const vk::Viewport& viewport) {
+  command_buffer.setViewport(/*firstViewport=*/0, viewport, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kSetViewport))
+    return;
+  capture_.WriteFloat(viewport.x);
+  capture_.WriteFloat(viewport.y);
+  capture_.WriteFloat(viewport.width);
+  capture_.WriteFloat(viewport.height);
+  capture_.WriteFloat(viewport.minDepth);
+  capture_.WriteFloat(viewport.maxDepth);
+}
+
+void VulkanCaptureRecorder::SetScissor(vk::CommandBuffer command_buffer,
+                                       const vk::Rect2D& scissor) {
+  command_buffer.setScissor(/*firstScissor=*/0, scissor, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kSetScissor))
+    return;
+  capture_.WriteSignedVarint(scissor.offset.x);
+  capture_.WriteSignedVarint(scissor.offset.y);
+  capture_.WriteVarint(scissor.extent.width);
+  capture_.WriteVarint(scissor.extent.height);
+}
+
+void VulkanCaptureRecorder::PushConstants(vk::CommandBuffer command_buffer,
+                                          vk::PipelineLayout layout,
+                                          vk::ShaderStageFlags stages, uint32_t offset,
+                                          uint32_t size, const void* data) {
+  command_buffer.pushConstants(layout, stages, offset, size, data, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kPushConstants))
+    return;
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kPipelineLayout, HandleValue(layout)));
+  capture_.WriteVarint(FlagsValue(stages));
+  capture_.WriteVarint(offset);
+  capture_.WriteBytes(data, size);
+}
+
+void VulkanCaptureRecorder::BindVertexBuffer(vk::CommandBuffer command_buffer,
+                                             uint32_t binding, vk::Buffer buffer,
+                                             vk::DeviceSize offset) {
+  command_buffer.bindVertexBuffers(binding, buffer, offset, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kBindVertexBuffers))
+    return;
+  capture_.WriteVarint(binding);
+  capture_.WriteVarint(1);
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kBuffer, HandleValue(buffer)));
+  capture_.WriteVarint(offset);
+}
+
+void VulkanCaptureRecorder::BindIndexBuffer(vk::CommandBuffer command_buffer,
+                                            vk::Buffer buffer, vk::DeviceSize offset,
+                                            vk::IndexType index_type) {
+  command_buffer.bindIndexBuffer(buffer, offset, index_type, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kBindIndexBuffer))
+    return;
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kBuffer, HandleValue(buffer)));
+  capture_.WriteVarint(offset);
+  capture_.WriteVarint(EnumValue(index_type));
+}
+
+void VulkanCaptureRecorder::Draw(vk::CommandBuffer command_buffer, uint32_t vertex_count,
+                                 uint32_t instance_count, uint32_t first_vertex,
+                                 uint32_t first_instance) {
+  command_buffer.draw(vertex_count, instance_count, first_vertex, first_instance, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kDraw))
+    return;
+  capture_.WriteVarint(vertex_count);
+  capture_.WriteVarint(instance_count);
+  capture_.WriteVarint(first_vertex);
+  capture_.WriteVarint(first_instance);
+}
+
+void VulkanCaptureRecorder::DrawIndexed(vk::CommandBuffer command_buffer, uint32_t index_count,
+                                        uint32_t instance_count, uint32_t first_index,
+                                        int32_t vertex_offset, uint32_t first_instance) {
+  command_buffer.drawIndexed(index_count, instance_count, first_index, vertex_offset,
+                             first_instance, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kDrawIndexed))
+    return;
+  capture_.WriteVarint(index_count);
+  capture_.WriteVarint(instance_count);
+  capture_.WriteVarint(first_index);
+  capture_.WriteSignedVarint(vertex_offset);
+  capture_.WriteVarint(first_instance);
+}
+
+void VulkanCaptureRecorder::CopyBuffer(vk::CommandBuffer command_buffer, vk::Buffer source,
+                                       vk::Buffer destination, const vk::BufferCopy& region) {
+  command_buffer.copyBuffer(source, destination, region, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kCopyBuffer))
+    return;
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kBuffer, HandleValue(source)));
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kBuffer, HandleValue(destination)));
+  capture_.WriteVarint(1);
+  capture_.WriteVarint(region.srcOffset);
+  capture_.WriteVarint(region.dstOffset);
+  capture_.WriteVarint(region.size);
+}
+
+void VulkanCaptureRecorder::FillBuffer(vk::CommandBuffer command_buffer, vk::Buffer buffer,
+                                       vk::DeviceSize offset, vk::DeviceSize size,
+                                       uint32_t data) {
+  command_buffer.fillBuffer(buffer, offset, size, data, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kFillBuffer))
+    return;
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kBuffer, HandleValue(buffer)));
+  capture_.WriteVarint(offset);
+  capture_.WriteVarint(size);
+  capture_.WriteVarint(data);
+}
+
+void VulkanCaptureRecorder::MemoryBarrier(vk::CommandBuffer command_buffer,
+                                          vk::PipelineStageFlags source_stages,
+                                          vk::PipelineStageFlags destination_stages,
+                                          vk::AccessFlags source_access,
+                                          vk::AccessFlags destination_access) {
+  vk::MemoryBarrier barrier(source_access, destination_access);
+  command_buffer.pipelineBarrier(source_stages, destination_stages, /*dependencyFlags=*/{},
+                                 barrier, /*bufferMemoryBarriers=*/nullptr,
+                                 /*imageMemoryBarriers=*/nullptr, dispatcher_);
+  if (!BeginCommand(VulkanCaptureOp::kMemoryBarrier))
+    return;
+  capture_.WriteVarint(FlagsValue(source_stages));
+  capture_.WriteVarint(FlagsValue(destination_stages));
+  capture_.WriteVarint(FlagsValue(source_access));
+  capture_.WriteVarint(FlagsValue(destination_access));
+}
+
+void VulkanCaptureRecorder::CaptureBufferWrite(vk::Buffer buffer, vk::DeviceSize offset,
+                                               const void* data, size_t size) {
+  if (!BeginCommand(VulkanCaptureOp::kWriteBuffer))
+    return;
+  capture_.WriteVarint(ResourceId(VulkanCaptureOp::kBuffer, HandleValue(buffer)));
+  capture_.WriteVarint(offset);
+  capture_.WriteBytes(data, size);
+}
+
+void VulkanCaptureRecorder::WriteFile() {
+  has_written_file_ = true;
+
+  std::ofstream output(path_, std::ios::binary);
+  output.write(kVulkanCaptureMagic, sizeof(kVulkanCaptureMagic));
+  output.write(reinterpret_cast<const char*>(resource_log_.Bytes().data()),
+               static_cast<std::streamsize>(resource_log_.Bytes().size()));
+  output.write(reinterpret_cast<const char*>(capture_.Bytes().data()),
+               static_cast<std::streamsize>(capture_.Bytes().size()));
+  if (!output) {
+    std::cerr << "Failed to write capture file: " << path_ << std::endl;
+    return;
+  }
+
+  std::cout << "Captured " << captured_frame_count_ << " frames ("
+            << resource_log_.Bytes().size() + capture_.Bytes().size() << " bytes) to "
+            << path_ << std::endl;
+}
@@ -0,0 +1,151 @@
+#ifndef VULKAN_CAPTURE_RECORDER_H_
+#define VULKAN_CAPTURE_RECORDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "capture_stream.h"
+#include "vulkan_capture_format.h"
+
+class VulkanDevice;
+struct VulkanFramebufferKey;
+struct VulkanPipelineLayoutKey;
+struct VulkanPipelineState;
+struct VulkanRenderPassKey;
+
+// Captures the commands of a range of frames to a file, for vulkan_replay.
+//
+// The application records the captured commands through the recorder, which
+// forwards them to the command buffer. Resources are described with the
+// Describe*() methods before the commands that use them. Descriptions are
+// cheap to repeat, so render loops can describe the resources they use every
+// frame. A handle that is described differently, for example after it was
+// destroyed and reused by the driver, gets a new resource ID.
+//
+// Every description is kept, so a capture can replay resources created long
+// before the first captured frame. Image layout transitions and descriptor
+// sets are not captured yet. Frames are captured in submission order, and
+// each frame's commands are assumed to go to one command buffer. Not
+// thread-safe.
+class VulkanCaptureRecorder {
+ public:
+  // Captures the frames numbered [first_frame, first_frame + frame_count).
+  explicit VulkanCaptureRecorder(const VulkanDevice& device, std::string path,
+                                 uint64_t first_frame, uint64_t frame_count);
+
+  VulkanCaptureRecorder(const VulkanCaptureRecorder&) = delete;
+  VulkanCaptureRecorder& operator=(const VulkanCaptureRecorder&) = delete;
+
+  // Writes the captured frames, if the capture didn't finish.
+  ~VulkanCaptureRecorder();
+
+  // `contents` has `size` bytes, or is null for buffers that start out
+  // zeroed.
+  void DescribeBuffer(vk::Buffer buffer, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                      const void* contents);
+  // The view must cover a whole 2D image with one mip level and layer.
+  void DescribeImageView(vk::ImageView view, vk::Format format, vk::Extent2D extent,
+                         vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples);
+  void DescribeShaderModule(vk::ShaderModule shader_module, const void* spirv_code,
+                            size_t spirv_size);
+  void DescribeRenderPass(vk::RenderPass render_pass, const VulkanRenderPassKey& key);
+  void DescribeFramebuffer(vk::Framebuffer framebuffer, const VulkanFramebufferKey& key);
+  // The layout must not have descriptor set layouts.
+  void DescribePipelineLayout(vk::PipelineLayout pipeline_layout,
+                              const VulkanPipelineLayoutKey& key);
+  void DescribeGraphicsPipeline(vk::Pipeline pipeline, const VulkanPipelineState& state);
+
+  // Called after VulkanFrameCommands::BeginFrame().
+  void BeginFrame(uint64_t frame_number);
+  // Called after the frame's commands are submitted. Writes the capture file
+  // after the last captured frame.
+  void EndFrame();
+
+  // True between BeginFrame() and EndFrame() calls for captured frames.
+  [[nodiscard]] bool IsCapturing() const { return is_capturing_; }
+
+  void BeginRenderPass(vk::CommandBuffer command_buffer,
+                       const vk::RenderPassBeginInfo& begin_info);
+  void EndRenderPass(vk::CommandBuffer command_buffer);
+  void BindPipeline(vk::CommandBuffer command_buffer, vk::Pipeline pipeline);
+  void SetViewport(vk::CommandBuffer command_buffer, const vk::Viewport& viewport);
+  void SetScissor(vk::CommandBuffer command_buffer, const vk::Rect2D& scissor);
+  void PushConstants(vk::CommandBuffer command_buffer, vk::PipelineLayout layout,
+                     vk::ShaderStageFlags stages, uint32_t offset, uint32_t size,
+                     const void* data);
+  void BindVertexBuffer(vk::CommandBuffer command_buffer, uint32_t binding, vk::Buffer buffer,
+                        vk::DeviceSize offset);
+  void BindIndexBuffer(vk::CommandBuffer command_buffer, vk::Buffer buffer,
+                       vk::DeviceSize offset, vk::IndexType index_type);
+  void Draw(vk::CommandBuffer command_buffer, uint32_t vertex_count, uint32_t instance_count,
+            uint32_t first_vertex, uint32_t first_instance);
+  void DrawIndexed(vk::CommandBuffer command_buffer, uint32_t index_count,
+                   uint32_t instance_count, uint32_t first_index, int32_t vertex_offset,
+                   uint32_t first_instance);
+  void CopyBuffer(vk::CommandBuffer command_buffer, vk::Buffer source, vk::Buffer destination,
+                  const vk::BufferCopy& region);
+  void FillBuffer(vk::CommandBuffer command_buffer, vk::Buffer buffer, vk::DeviceSize offset,
+                  vk::DeviceSize size, uint32_t data);
+  void MemoryBarrier(vk::CommandBuffer command_buffer, vk::PipelineStageFlags source_stages,
+                     vk::PipelineStageFlags destination_stages, vk::AccessFlags source_access,
+                     vk::AccessFlags destination_access);
+
+  // Records a host write to the buffer's mapped memory. The application makes
+  // the write itself.
+  void CaptureBufferWrite(vk::Buffer buffer, vk::DeviceSize offset, const void* data,
+                          size_t size);
+
+ private:
+  struct Resource {
+    uint32_t id;
+    // The fields after the ID.
+    std::vector<uint8_t> description;
+  };
+
+  // Indexed by resource opcode. Maps handle values to their latest
+  // description.
+  static constexpr size_t kResourceKindCount =
+      static_cast<size_t>(VulkanCaptureOp::kGraphicsPipeline) + 1;
+
+  // Returns the ID of the handle's description, which is in `description_`.
+  // Logs a new resource if the handle's description changed.
+  uint32_t DescribeResource(VulkanCaptureOp op, uint64_t handle_value);
+
+  // The ID of a described resource.
+  [[nodiscard]] uint32_t ResourceId(VulkanCaptureOp op, uint64_t handle_value) const;
+
+  // Starts a command record, if capturing. Returns false otherwise.
+  bool BeginCommand(VulkanCaptureOp op);
+
+  // Writes the captured frames to `path_`.
+  void WriteFile();
+
+  const vk::DispatchLoaderDynamic& dispatcher_;
+  const std::string path_;
+  const uint64_t first_frame_;
+  const uint64_t end_frame_;
+
+  std::unordered_map<uint64_t, Resource> resources_[kResourceKindCount];
+  // Every resource record ever described, in ID order.
+  CaptureWriter resource_log_;
+  uint32_t next_resource_id_ = 1;
+
+  // The captured frames. Written after the resource log, so resources
+  // described during the capture are created before replay starts.
+  CaptureWriter capture_;
+  bool is_capturing_ = false;
+  bool has_written_file_ = false;
+  uint64_t captured_frame_count_ = 0;
+
+  // Reused across descriptions to avoid allocations.
+  CaptureWriter description_;
+};
+
+#endif  // VULKAN_CAPTURE_RECORDER_H_
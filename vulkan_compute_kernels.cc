@@ -0,0 +1,336 @@
+#include "vulkan_compute_kernels.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_shader_module.h"
+
+namespace {
+
+// Must match local_size_x in shaders/compute_kernel.glsl.
+constexpr uint32_t kWorkgroupSize = 256;
+
+// Must match kNoBlockSums in shaders/scan.comp.
+constexpr uint32_t kNoBlockSums = 0xFFFFFFFF;
+
+constexpr uint32_t kRadixDigitCount = 256;
+constexpr uint32_t kRadixPassCount = 4;
+
+constexpr vk::SubgroupFeatureFlags kRequiredSubgroupOperations =
+    vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic |
+    vk::SubgroupFeatureFlagBits::eBallot;
+
+[[nodiscard]] uint32_t CeilDivide(uint32_t value, uint32_t divisor) {
+  return (value + divisor - 1) / divisor;
+}
+
+// The shared memory used by shaders/radix_scatter.comp, which uses the most.
+// Smaller subgroups need more per-subgroup digit counts.
+[[nodiscard]] uint32_t RadixScatterSharedMemorySize(uint32_t subgroup_size) {
+  // Must match kSubgroupCountRows in shaders/radix_scatter.comp.
+  const uint32_t subgroup_count_rows = CeilDivide(kWorkgroupSize / subgroup_size, 4);
+  return static_cast<uint32_t>((1 + subgroup_count_rows) * kRadixDigitCount * sizeof(uint32_t));
+}
+
+// Terminates the program if the kernels can't run on the device.
+[[nodiscard]] uint32_t CheckSubgroupSupport(const VulkanDevice& device) {
+  auto properties_chain = device.PhysicalDeviceVulkanHandle().getProperties2<
+      vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>(device.Dispatcher());
+  const vk::PhysicalDeviceSubgroupProperties& subgroup_properties =
+      properties_chain.get<vk::PhysicalDeviceSubgroupProperties>();
+
+  if (!(subgroup_properties.supportedStages & vk::ShaderStageFlagBits::eCompute) ||
+      (subgroup_properties.supportedOperations & kRequiredSubgroupOperations) !=
+          kRequiredSubgroupOperations) {
+    std::cerr << "Compute kernels need subgroup arithmetic and ballot operations" << std::endl;
+    std::abort();
+  }
+  const uint32_t shared_memory_size =
+      RadixScatterSharedMemorySize(subgroup_properties.subgroupSize);
+  if (shared_memory_size > device.Limits().maxComputeSharedMemorySize) {
+    std::cerr << "Compute kernels need " << shared_memory_size
+              << " bytes of shared memory with " << subgroup_properties.subgroupSize
+              << "-invocation subgroups; the device has "
+              << device.Limits().maxComputeSharedMemorySize << std::endl;
+    std::abort();
+  }
+  return subgroup_properties.subgroupSize;
+}
+
+[[nodiscard]] vk::UniqueDescriptorSetLayout CreateDescriptorSetLayout(vk::Device device) {
+  vk::DescriptorSetLayoutBinding binding;
+  binding
+      .setBinding(0)
+      .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+      .setDescriptorCount(1)
+      .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+  vk::DescriptorSetLayoutCreateInfo create_info;
+  create_info.setBindings(binding);
+
+  vk::ResultValue<vk::UniqueDescriptorSetLayout> create_result =
+      device.createDescriptorSetLayoutUnique(create_info);
+  VulkanCheckResult("vkCreateDescriptorSetLayout", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniquePipelineLayout CreatePipelineLayout(
+    vk::Device device, vk::DescriptorSetLayout set_layout, uint32_t push_constant_size) {
+  vk::PushConstantRange push_constant_range;
+  push_constant_range
+      .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+      .setOffset(0)
+      .setSize(push_constant_size);
+
+  vk::PipelineLayoutCreateInfo create_info;
+  create_info
+      .setSetLayouts(set_layout)
+      .setPushConstantRanges(push_constant_range);
+
+  vk::ResultValue<vk::UniquePipelineLayout> create_result =
+      device.createPipelineLayoutUnique(create_info);
+  VulkanCheckResult("vkCreatePipelineLayout", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniqueDescriptorPool CreateDescriptorPool(vk::Device device,
+                                                            uint32_t max_set_count) {
+  vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer, max_set_count);
+
+  vk::DescriptorPoolCreateInfo create_info;
+  create_info
+      .setMaxSets(max_set_count)
+      .setPoolSizes(pool_size);
+
+  vk::ResultValue<vk::UniqueDescriptorPool> create_result =
+      device.createDescriptorPoolUnique(create_info);
+  VulkanCheckResult("vkCreateDescriptorPool", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniquePipeline CreateComputePipeline(vk::Device device,
+                                                       vk::PipelineLayout pipeline_layout,
+                                                       const AssetPack* asset_pack,
+                                                       const char* spirv_name,
+                                                       uint32_t subgroup_size) {
+  vk::UniqueShaderModule shader_module = LoadShaderModule(device, asset_pack, spirv_name);
+
+  // Sets kSubgroupSize in shaders/compute_kernel.glsl.
+  vk::SpecializationMapEntry map_entry(/*constantID=*/0, /*offset=*/0, sizeof(subgroup_size));
+  vk::SpecializationInfo specialization_info;
+  specialization_info
+      .setMapEntries(map_entry)
+      .setDataSize(sizeof(subgroup_size))
+      .setPData(&subgroup_size);
+
+  vk::PipelineShaderStageCreateInfo stage_info;
+  stage_info
+      .setStage(vk::ShaderStageFlagBits::eCompute)
+      .setModule(shader_module.get())
+      .setPName("main")
+      .setPSpecializationInfo(&specialization_info);
+
+  vk::ComputePipelineCreateInfo create_info;
+  create_info
+      .setStage(stage_info)
+      .setLayout(pipeline_layout);
+
+  vk::ResultValue<vk::UniquePipeline> create_result =
+      device.createComputePipelineUnique(/*pipelineCache=*/nullptr, create_info);
+  VulkanCheckResult("vkCreateComputePipelines", create_result.result);
+  return std::move(create_result.value);
+}
+
+}  // namespace
+
+VulkanComputeKernels::VulkanComputeKernels(const VulkanDevice& device,
+                                           const AssetPack* asset_pack)
+    : device_(device.VulkanHandle()),
+      dispatcher_(device.Dispatcher()),
+      max_group_count_(device.Limits().maxComputeWorkGroupCount[0]),
+      subgroup_size_(CheckSubgroupSupport(device)),
+      descriptor_set_layout_(CreateDescriptorSetLayout(device_)),
+      pipeline_layout_(CreatePipelineLayout(device_, descriptor_set_layout_.get(),
+                                            sizeof(Params))),
+      descriptor_pool_(CreateDescriptorPool(device_, kMaxBoundBufferCount)),
+      reduce_pipeline_(CreateComputePipeline(device_, pipeline_layout_.get(), asset_pack,
+                                             "reduce.spv", subgroup_size_)),
+      scan_pipeline_(CreateComputePipeline(device_, pipeline_layout_.get(), asset_pack,
+                                           "scan.spv", subgroup_size_)),
+      scan_add_pipeline_(CreateComputePipeline(device_, pipeline_layout_.get(), asset_pack,
+                                               "scan_add.spv", subgroup_size_)),
+      radix_histogram_pipeline_(CreateComputePipeline(device_, pipeline_layout_.get(),
+                                                      asset_pack, "radix_histogram.spv",
+                                                      subgroup_size_)),
+      radix_scatter_pipeline_(CreateComputePipeline(device_, pipeline_layout_.get(),
+                                                    asset_pack, "radix_scatter.spv",
+                                                    subgroup_size_)) {
+}
+
+VulkanComputeKernels::~VulkanComputeKernels() = default;
+
+uint32_t VulkanComputeKernels::ScanScratchSize(uint32_t count) {
+  // Each level stores the tile totals of the level below.
+  uint32_t scratch_size = 0;
+  for (uint32_t tile_count = CeilDivide(count, kScanTileSize); tile_count > 1;
+       tile_count = CeilDivide(tile_count, kScanTileSize)) {
+    scratch_size += tile_count;
+  }
+  return scratch_size;
+}
+
+uint32_t VulkanComputeKernels::RadixSortScratchSize(uint32_t count) {
+  // Keys ping-pong with a second array. The digit counts and their scan come
+  // after it.
+  const uint32_t histogram_size = kRadixDigitCount * CeilDivide(count, kRadixSortTileSize);
+  return count + histogram_size + ScanScratchSize(histogram_size);
+}
+
+vk::DescriptorSet VulkanComputeKernels::BindBuffer(vk::Buffer buffer) {
+  assert(buffer);
+
+  vk::DescriptorSetLayout set_layout = descriptor_set_layout_.get();
+  vk::DescriptorSetAllocateInfo allocate_info;
+  allocate_info
+      .setDescriptorPool(descriptor_pool_.get())
+      .setSetLayouts(set_layout);
+  vk::ResultValue<std::vector<vk::DescriptorSet>> allocate_result =
+      device_.allocateDescriptorSets(allocate_info);
+  VulkanCheckResult("vkAllocateDescriptorSets", allocate_result.result);
+  vk::DescriptorSet buffer_set = allocate_result.value[0];
+
+  vk::DescriptorBufferInfo buffer_info(buffer, /*offset=*/0, VK_WHOLE_SIZE);
+  vk::WriteDescriptorSet write;
+  write
+      .setDstSet(buffer_set)
+      .setDstBinding(0)
+      .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+      .setBufferInfo(buffer_info);
+  device_.updateDescriptorSets(write, /*descriptorCopies=*/nullptr);
+  return buffer_set;
+}
+
+void VulkanComputeKernels::RecordReduce(vk::CommandBuffer command_buffer,
+                                        vk::DescriptorSet buffer_set, uint32_t input_offset,
+                                        uint32_t count, uint32_t output_offset) const {
+  if (count == 0)
+    return;
+
+  Params params = {
+    .count = count,
+    .input_offset = input_offset,
+    .output_offset = output_offset,
+    .aux_offset = 0,
+    .shift = 0,
+  };
+  Dispatch(command_buffer, buffer_set, reduce_pipeline_.get(), params,
+           CeilDivide(count, kReduceTileSize));
+}
+
+void VulkanComputeKernels::RecordExclusiveScan(vk::CommandBuffer command_buffer,
+                                               vk::DescriptorSet buffer_set, uint32_t offset,
+                                               uint32_t count, uint32_t scratch_offset) const {
+  if (count == 0)
+    return;
+
+  const uint32_t tile_count = CeilDivide(count, kScanTileSize);
+  Params params = {
+    .count = count,
+    .input_offset = offset,
+    .output_offset = 0,
+    .aux_offset = (tile_count > 1) ? scratch_offset : kNoBlockSums,
+    .shift = 0,
+  };
+  Dispatch(command_buffer, buffer_set, scan_pipeline_.get(), params, tile_count);
+  if (tile_count == 1)
+    return;
+
+  // Scans the tile totals, which are stored before the scratch space of
+  // their own scan.
+  RecordDispatchBarrier(command_buffer);
+  RecordExclusiveScan(command_buffer, buffer_set, scratch_offset, tile_count,
+                      scratch_offset + tile_count);
+  RecordDispatchBarrier(command_buffer);
+
+  Dispatch(command_buffer, buffer_set, scan_add_pipeline_.get(), params, tile_count);
+}
+
+void VulkanComputeKernels::RecordRadixSort(vk::CommandBuffer command_buffer,
+                                           vk::DescriptorSet buffer_set, uint32_t offset,
+                                           uint32_t count, uint32_t scratch_offset) const {
+  if (count == 0)
+    return;
+
+  const uint32_t tile_count = CeilDivide(count, kRadixSortTileSize);
+  const uint32_t histogram_offset = scratch_offset + count;
+  const uint32_t histogram_size = kRadixDigitCount * tile_count;
+
+  // An even number of passes leaves the keys in the original array.
+  static_assert(kRadixPassCount % 2 == 0);
+  uint32_t keys_offset = offset;
+  uint32_t other_keys_offset = scratch_offset;
+  for (uint32_t pass = 0; pass < kRadixPassCount; ++pass) {
+    Params params = {
+      .count = count,
+      .input_offset = keys_offset,
+      .output_offset = histogram_offset,
+      .aux_offset = 0,
+      .shift = pass * 8,
+    };
+    Dispatch(command_buffer, buffer_set, radix_histogram_pipeline_.get(), params, tile_count);
+    RecordDispatchBarrier(command_buffer);
+
+    RecordExclusiveScan(command_buffer, buffer_set, histogram_offset, histogram_size,
+                        histogram_offset + histogram_size);
+    RecordDispatchBarrier(command_buffer);
+
+    params.output_offset = other_keys_offset;
+    params.aux_offset = histogram_offset;
+    Dispatch(command_buffer, buffer_set, radix_scatter_pipeline_.get(), params, tile_count);
+    if (pass + 1 < kRadixPassCount)
+      RecordDispatchBarrier(command_buffer);
+
+    std::swap(keys_offset, other_keys_offset);
+  }
+  assert(keys_offset == offset);
+}
+
+void VulkanComputeKernels::Dispatch(vk::CommandBuffer command_buffer,
+                                    vk::DescriptorSet buffer_set, vk::Pipeline pipeline,
+                                    const Params& params, uint32_t group_count) const {
+  assert(group_count > 0);
+  if (group_count > max_group_count_) {
+    std::cerr << "Compute kernel input too large: " << params.count << " words" << std::endl;
+    std::abort();
+  }
+
+  command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline, dispatcher_);
+  command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout_.get(),
+                                    /*firstSet=*/0, buffer_set, /*dynamicOffsets=*/nullptr,
+                                    dispatcher_);
+  command_buffer.pushConstants(pipeline_layout_.get(), vk::ShaderStageFlagBits::eCompute,
+                               /*offset=*/0, sizeof(Params), &params, dispatcher_);
+  command_buffer.dispatch(group_count, /*groupCountY=*/1, /*groupCountZ=*/1, dispatcher_);
+}
+
+void VulkanComputeKernels::RecordDispatchBarrier(vk::CommandBuffer command_buffer) const {
+  vk::MemoryBarrier barrier;
+  barrier
+      .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+      /*dependencyFlags=*/{}, barrier, /*bufferMemoryBarriers=*/nullptr,
+      /*imageMemoryBarriers=*/nullptr, dispatcher_);
+}
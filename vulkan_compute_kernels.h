@@ -0,0 +1,112 @@
+#ifndef VULKAN_COMPUTE_KERNELS_H_
+#define VULKAN_COMPUTE_KERNELS_H_
+
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class AssetPack;
+class VulkanDevice;
+
+// Data-parallel primitives on 32-bit unsigned integers, built on subgroup
+// operations.
+//
+// The kernels operate on words in a storage buffer, bound once with
+// BindBuffer(). Offsets and counts are in 32-bit words. Record*() methods
+// insert the barriers between their own dispatches. Callers synchronize the
+// kernels' reads and writes with surrounding commands using compute shader
+// stage barriers.
+//
+// Works on compute-only devices. Loads the SPIR-V modules built by the
+// spirv_shader() CMake rules from an asset pack, or from the working
+// directory.
+class VulkanComputeKernels {
+ public:
+  // The number of words passed to RecordReduce() that one workgroup sums.
+  static constexpr uint32_t kReduceTileSize = 4096;
+  // The number of words that one workgroup scans before tiles are combined.
+  static constexpr uint32_t kScanTileSize = 1024;
+  // The number of keys that one workgroup counts and moves in a sort pass.
+  static constexpr uint32_t kRadixSortTileSize = 4096;
+  // The number of BindBuffer() calls allowed over the instance's lifetime.
+  static constexpr uint32_t kMaxBoundBufferCount = 16;
+
+  // `asset_pack` may be null, and is only used by the constructor.
+  // Terminates the program if the device's subgroups can't run the kernels.
+  explicit VulkanComputeKernels(const VulkanDevice& device, const AssetPack* asset_pack);
+
+  VulkanComputeKernels(const VulkanComputeKernels&) = delete;
+  VulkanComputeKernels& operator=(const VulkanComputeKernels&) = delete;
+
+  ~VulkanComputeKernels();
+
+  // The scratch words needed by RecordExclusiveScan() for `count` words.
+  [[nodiscard]] static uint32_t ScanScratchSize(uint32_t count);
+
+  // The scratch words needed by RecordRadixSort() for `count` keys.
+  [[nodiscard]] static uint32_t RadixSortScratchSize(uint32_t count);
+
+  // Returns the descriptor set that binds `buffer` for the kernels.
+  //
+  // The buffer needs eStorageBuffer usage, and must outlive the commands
+  // that use the descriptor set. Descriptor sets are freed with this
+  // instance, which binds at most kMaxBoundBufferCount buffers.
+  [[nodiscard]] vk::DescriptorSet BindBuffer(vk::Buffer buffer);
+
+  // Adds `count` words at `input_offset` to the word at `output_offset`.
+  //
+  // The output word must be zeroed before the dispatch, for example with
+  // vkCmdFillBuffer(), to compute the sum. Sums wrap around on overflow.
+  void RecordReduce(vk::CommandBuffer command_buffer, vk::DescriptorSet buffer_set,
+                    uint32_t input_offset, uint32_t count, uint32_t output_offset) const;
+
+  // Replaces `count` words at `offset` with their exclusive prefix sums.
+  //
+  // Uses ScanScratchSize(count) words at `scratch_offset`.
+  void RecordExclusiveScan(vk::CommandBuffer command_buffer, vk::DescriptorSet buffer_set,
+                           uint32_t offset, uint32_t count, uint32_t scratch_offset) const;
+
+  // Sorts `count` keys at `offset` in ascending order.
+  //
+  // Least significant digit radix sort, with 8-bit digits. Uses
+  // RadixSortScratchSize(count) words at `scratch_offset`.
+  void RecordRadixSort(vk::CommandBuffer command_buffer, vk::DescriptorSet buffer_set,
+                       uint32_t offset, uint32_t count, uint32_t scratch_offset) const;
+
+  // The subgroup size reported by the driver.
+  [[nodiscard]] uint32_t SubgroupSize() const { return subgroup_size_; }
+
+ private:
+  // Must match the push constants in shaders/compute_kernel.glsl.
+  struct Params {
+    uint32_t count;
+    uint32_t input_offset;
+    uint32_t output_offset;
+    uint32_t aux_offset;
+    uint32_t shift;
+  };
+
+  // Binds the pipeline and parameters, and dispatches `group_count`
+  // workgroups.
+  void Dispatch(vk::CommandBuffer command_buffer, vk::DescriptorSet buffer_set,
+                vk::Pipeline pipeline, const Params& params, uint32_t group_count) const;
+
+  // Makes the previous dispatches' writes visible to the next dispatches.
+  void RecordDispatchBarrier(vk::CommandBuffer command_buffer) const;
+
+  const vk::Device device_;
+  const vk::DispatchLoaderDynamic& dispatcher_;
+  const uint32_t max_group_count_;
+  const uint32_t subgroup_size_;
+  vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+  vk::UniquePipelineLayout pipeline_layout_;
+  vk::UniqueDescriptorPool descriptor_pool_;
+  vk::UniquePipeline reduce_pipeline_;
+  vk::UniquePipeline scan_pipeline_;
+  vk::UniquePipeline scan_add_pipeline_;
+  vk::UniquePipeline radix_histogram_pipeline_;
+  vk::UniquePipeline radix_scatter_pipeline_;
+};
+
+#endif  // VULKAN_COMPUTE_KERNELS_H_
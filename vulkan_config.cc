@@ -1,62 +1,55 @@
 #include "vulkan_config.h"
 
+#include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 #include <vulkan/vulkan.hpp>
 
+#include "vulkan_config_profile.h"
 #include "vulkan_extension_list.h"
 #include "vulkan_layer_list.h"
 #include "vulkan_presentation_context.h"
 
 namespace {
 
-bool WantVulkanValidation() {
-#if defined(NDEBUG)
-    return false;
-#else
-    return true;
-#endif  // defined(NDEBUG)
-}
-
-[[nodiscard]] std::vector<const char*> RequiredVulkanLayers(bool want_validation) {
-  std::vector<const char*> required_layers;
+[[nodiscard]] std::vector<const char*> RequiredVulkanLayers() {
+  static constexpr auto kProfileLayers = VulkanProfileLayers<VulkanActiveProfile>();
 
-  if (want_validation) {
-    static constexpr char kValidationLayerName[] = "VK_LAYER_KHRONOS_validation";
+  if constexpr (!kProfileLayers.empty()) {
     VulkanLayerList layers;
-    if (!layers.Contains(kValidationLayerName)) {
-      std::cerr << "Validation layer required but not available" << std::endl;
-      std::abort();
+    for (const char* layer_name : kProfileLayers) {
+      if (!layers.Contains(layer_name)) {
+        std::cerr << "Layer required by the " << VulkanActiveProfile::kName
+                  << " profile not available: " << layer_name << std::endl;
+        std::abort();
+      }
     }
-    required_layers.push_back(kValidationLayerName);
   }
 
-  return required_layers;
+  return std::vector<const char*>(kProfileLayers.begin(), kProfileLayers.end());
 }
 
-
+// `required_extensions` is the list of extensions required by the windowing system.
 [[nodiscard]] std::vector<const char*> RequiredVulkanInstanceExtensions(
-    const VulkanPresentationContext& presentation_context, bool want_validation) {
-  std::vector<const char*> required_extensions = presentation_context.RequiredVulkanInstanceExtensions();
-
-  if (want_validation) {
-    static constexpr char kDebugUtilsExtensionName[] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+    std::vector<const char*> required_extensions) {
+  static constexpr auto kProfileExtensions =
+      VulkanProfileInstanceExtensions<VulkanActiveProfile>();
 
+  if constexpr (VulkanActiveProfile::kValidation || VulkanActiveProfile::kProfiling) {
     VulkanExtensionList extension_list;
-    if (!extension_list.Contains(kDebugUtilsExtensionName)) {
-      std::cerr << "Validation layer required but debugging extension not available" << std::endl;
+    if (!extension_list.Contains(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)) {
+      std::cerr << "Debugging extension required by the " << VulkanActiveProfile::kName
+                << " profile not available" << std::endl;
       std::abort();
     }
-    required_extensions.push_back(kDebugUtilsExtensionName);
   }
 
-  // MoltenVK exposes devices with the VK_KHR_portability_subset extension.
-  // Enumerating them requires the VK_KHR_portability_enumeration extension.
-  static constexpr char kPortabilityEnumerationExtensionName[] = "VK_KHR_portability_enumeration";
-  required_extensions.push_back(kPortabilityEnumerationExtensionName);
-
+  required_extensions.insert(required_extensions.end(), kProfileExtensions.begin(),
+                             kProfileExtensions.end());
   return required_extensions;
 }
 
@@ -67,14 +60,39 @@ bool WantVulkanValidation() {
   return required_features;
 }
 
+// Submission thread 0 renders and presents, so its queue gets a higher
+// priority than the other submission threads' queues. That way, background
+// work such as readbacks doesn't delay presentation.
+[[nodiscard]] std::vector<float> DefaultQueuePriorities() {
+  return {1.0f, 0.5f, 0.5f, 0.5f};
+}
+
 }  // namespace
 
 VulkanConfig::VulkanConfig(const VulkanPresentationContext& presentation_context)
-    : want_validation_(WantVulkanValidation()),
-      required_layers_(RequiredVulkanLayers(want_validation_)),
-      required_instance_extensions_(RequiredVulkanInstanceExtensions(presentation_context, want_validation_)),
+    : required_layers_(RequiredVulkanLayers()),
+      required_instance_extensions_(RequiredVulkanInstanceExtensions(
+          presentation_context.RequiredVulkanInstanceExtensions())),
       required_device_extensions_(presentation_context.RequiredVulkanDeviceExtensions()),
-      required_features_(RequiredDeviceFeatures()) {
+      required_features_(RequiredDeviceFeatures()),
+      queue_priorities_(DefaultQueuePriorities()) {
+}
+
+VulkanConfig::VulkanConfig()
+    : required_layers_(RequiredVulkanLayers()),
+      required_instance_extensions_(RequiredVulkanInstanceExtensions({})),
+      required_device_extensions_(),
+      required_features_(RequiredDeviceFeatures()),
+      queue_priorities_(DefaultQueuePriorities()) {
 }
 
 VulkanConfig::~VulkanConfig() = default;
+
+void VulkanConfig::SetQueuePriorities(std::vector<float> queue_priorities) {
+  assert(!queue_priorities.empty());
+  for (float priority : queue_priorities) {
+    assert(priority >= 0.0f && priority <= 1.0f);
+    static_cast<void>(priority);
+  }
+  queue_priorities_ = std::move(queue_priorities);
+}
@@ -6,18 +6,41 @@
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_handles.hpp>
 
+#include "vulkan_config_profile.h"
+
 class VulkanPresentationContext;
 
 // Centralized logic for app-level Vulkan configuration.
+//
+// Settings that don't depend on the machine come from VulkanActiveProfile, and
+// are available at compile time.
 class VulkanConfig {
  public:
+  // Configuration for presenting to surfaces created by `presentation_context`.
+  //
+  // Only usable if WantPresentation() is true.
   explicit VulkanConfig(const VulkanPresentationContext& presentation_context);
+
+  // Configuration for headless (offscreen) use.
+  //
+  // No windowing system extensions are required, so this works on machines
+  // without a display.
+  VulkanConfig();
+
   VulkanConfig(const VulkanConfig&) = delete;
   VulkanConfig& operator=(const VulkanConfig&) = delete;
   ~VulkanConfig();
 
   // True if the app configuration enables Vulkan validation.
-  [[nodiscard]] bool WantValidation() const { return want_validation_; }
+  [[nodiscard]] static constexpr bool WantValidation() { return VulkanActiveProfile::kValidation; }
+
+  // True if the app configuration enables VK_EXT_debug_utils for GPU profilers.
+  [[nodiscard]] static constexpr bool WantProfiling() { return VulkanActiveProfile::kProfiling; }
+
+  // True if the app configuration includes windowing system support.
+  [[nodiscard]] static constexpr bool WantPresentation() {
+    return VulkanActiveProfile::kPresentation;
+  }
 
   // vkCreateInstance()-friendly list of required Vulkan layers.
   [[nodiscard]] const std::vector<const char*>& RequiredLayers() const {
@@ -38,12 +61,25 @@ class VulkanConfig {
     return required_features_;
   }
 
+  // Priorities of the queues created in each of a device's queue families.
+  //
+  // Devices create one queue per priority, capped by the number of queues in
+  // the family. The first queue is used for presentation and by submission
+  // thread 0, and the others are handed out to the other submission threads.
+  // See VulkanDevice::SubmissionQueue().
+  [[nodiscard]] const std::vector<float>& QueuePriorities() const { return queue_priorities_; }
+
+  // `queue_priorities` must not be empty, and its values must be in [0, 1].
+  //
+  // Only affects devices created after the call.
+  void SetQueuePriorities(std::vector<float> queue_priorities);
+
  private:
-  const bool want_validation_;
   const std::vector<const char*> required_layers_;
   const std::vector<const char*> required_instance_extensions_;
   const std::vector<const char*> required_device_extensions_;
   const vk::PhysicalDeviceFeatures required_features_;
+  std::vector<float> queue_priorities_;
 };
 
 #endif  // VULKAN_CONFIG_H_
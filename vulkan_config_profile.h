@@ -0,0 +1,90 @@
+#ifndef VULKAN_CONFIG_PROFILE_H_
+#define VULKAN_CONFIG_PROFILE_H_
+
+#include <array>
+
+#include <vulkan/vulkan.hpp>
+
+// Compile-time configuration profiles.
+//
+// A profile decides which optional Vulkan features a binary uses. Code that
+// depends on a profile setting uses `if constexpr`, so the disabled features
+// are compiled out. The profile is picked by the VULKAN_CONFIG_PROFILE CMake
+// option, and exposed as VulkanActiveProfile.
+
+// Optimized builds for end users.
+struct VulkanReleaseProfile {
+  static constexpr char kName[] = "release";
+  static constexpr bool kValidation = false;
+  static constexpr bool kProfiling = false;
+  static constexpr bool kPresentation = true;
+};
+
+// Validation layer enabled. Validation errors terminate the program.
+struct VulkanValidationProfile {
+  static constexpr char kName[] = "validation";
+  static constexpr bool kValidation = true;
+  static constexpr bool kProfiling = false;
+  static constexpr bool kPresentation = true;
+};
+
+// Optimized builds with VK_EXT_debug_utils enabled, so GPU profilers can show
+// object names and command labels.
+struct VulkanProfilingProfile {
+  static constexpr char kName[] = "profiling";
+  static constexpr bool kValidation = false;
+  static constexpr bool kProfiling = true;
+  static constexpr bool kPresentation = true;
+};
+
+// Offscreen rendering only. The windowing system sources and glfw are left out
+// of the build, so the binaries run on machines without a display server.
+struct VulkanHeadlessProfile {
+  static constexpr char kName[] = "headless";
+  static constexpr bool kValidation = false;
+  static constexpr bool kProfiling = false;
+  static constexpr bool kPresentation = false;
+};
+
+#if defined(VULKAN_CONFIG_PROFILE_RELEASE)
+using VulkanActiveProfile = VulkanReleaseProfile;
+#elif defined(VULKAN_CONFIG_PROFILE_VALIDATION)
+using VulkanActiveProfile = VulkanValidationProfile;
+#elif defined(VULKAN_CONFIG_PROFILE_PROFILING)
+using VulkanActiveProfile = VulkanProfilingProfile;
+#elif defined(VULKAN_CONFIG_PROFILE_HEADLESS)
+using VulkanActiveProfile = VulkanHeadlessProfile;
+#elif defined(NDEBUG)
+using VulkanActiveProfile = VulkanReleaseProfile;
+#else
+using VulkanActiveProfile = VulkanValidationProfile;
+#endif  // defined(VULKAN_CONFIG_PROFILE_RELEASE)
+
+// The Vulkan layers required by a profile.
+template <typename Profile>
+constexpr auto VulkanProfileLayers() {
+  if constexpr (Profile::kValidation)
+    return std::array<const char*, 1>{"VK_LAYER_KHRONOS_validation"};
+  else
+    return std::array<const char*, 0>{};
+}
+
+// The instance-level Vulkan extensions required by a profile.
+//
+// Windowing system extensions are not included, because they are only known
+// at runtime.
+template <typename Profile>
+constexpr auto VulkanProfileInstanceExtensions() {
+  // MoltenVK exposes devices with the VK_KHR_portability_subset extension.
+  // Enumerating them requires the VK_KHR_portability_enumeration extension.
+  constexpr const char* kPortabilityEnumeration = "VK_KHR_portability_enumeration";
+
+  if constexpr (Profile::kValidation || Profile::kProfiling) {
+    return std::array<const char*, 2>{VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+                                      kPortabilityEnumeration};
+  } else {
+    return std::array<const char*, 1>{kPortabilityEnumeration};
+  }
+}
+
+#endif  // VULKAN_CONFIG_PROFILE_H_
@@ -0,0 +1,39 @@
+#include "vulkan_deletion_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+VulkanDeletionQueue::VulkanDeletionQueue() = default;
+
+VulkanDeletionQueue::~VulkanDeletionQueue() = default;
+
+void VulkanDeletionQueue::Push(uint64_t last_use, ObjectPointer object) {
+  ++retired_count_;
+
+  // Objects are usually retired in frame order, so this appends.
+  Entry entry = { .last_use = last_use, .object = std::move(object) };
+  if (entries_.empty() || entries_.back().last_use <= last_use) {
+    entries_.push_back(std::move(entry));
+    return;
+  }
+  auto position = std::upper_bound(
+      entries_.begin(), entries_.end(), last_use,
+      [](uint64_t value, const Entry& other) { return value < other.last_use; });
+  entries_.insert(position, std::move(entry));
+}
+
+void VulkanDeletionQueue::Collect(uint64_t completed_value) {
+  while (!entries_.empty() && entries_.front().last_use <= completed_value) {
+    entries_.pop_front();
+    ++destroyed_count_;
+  }
+}
+
+VulkanDeletionQueue::Stats VulkanDeletionQueue::GetStats() const {
+  return {
+    .pending_count = entries_.size(),
+    .retired_count = retired_count_,
+    .destroyed_count = destroyed_count_,
+  };
+}
@@ -0,0 +1,74 @@
+#ifndef VULKAN_DELETION_QUEUE_H_
+#define VULKAN_DELETION_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Defers destroying objects until the GPU is done with them.
+//
+// Objects are retired with the timeline value of the last submission that
+// used them, such as a VulkanFrameCommands frame number, and are destroyed by
+// the first Collect() call that reports the value as completed. Retiring
+// never waits for the GPU, so resources can be replaced mid-frame without
+// stalling. Not thread-safe.
+//
+// Any movable object can be retired: vk::Unique* handles, device memory, or
+// wrappers such as VulkanImage.
+class VulkanDeletionQueue {
+ public:
+  struct Stats {
+    // Objects retired but not yet destroyed.
+    size_t pending_count;
+    uint64_t retired_count;
+    uint64_t destroyed_count;
+  };
+
+  VulkanDeletionQueue();
+
+  VulkanDeletionQueue(const VulkanDeletionQueue&) = delete;
+  VulkanDeletionQueue& operator=(const VulkanDeletionQueue&) = delete;
+
+  // Destroys the pending objects, which must not be used by pending commands.
+  ~VulkanDeletionQueue();
+
+  // Destroys `object` after the GPU completes timeline value `last_use`.
+  template <typename T>
+  void Retire(uint64_t last_use, T&& object) {
+    using Object = std::remove_cv_t<std::remove_reference_t<T>>;
+    static_assert(!std::is_lvalue_reference_v<T>, "Retired objects must be moved in");
+
+    Push(last_use, ObjectPointer(new Object(std::move(object)), [](void* pointer) {
+      delete static_cast<Object*>(pointer);
+    }));
+  }
+
+  // Destroys the objects whose last use is at or before `completed_value`.
+  //
+  // Called once per frame, with VulkanFrameCommands::CompletedFrameNumber().
+  void Collect(uint64_t completed_value);
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  // Type-erased owner. A function pointer deleter avoids virtual dispatch.
+  using ObjectPointer = std::unique_ptr<void, void (*)(void*)>;
+
+  struct Entry {
+    uint64_t last_use;
+    ObjectPointer object;
+  };
+
+  void Push(uint64_t last_use, ObjectPointer object);
+
+  // Sorted by last use, so Collect() only looks at the front.
+  std::deque<Entry> entries_;
+
+  uint64_t retired_count_ = 0;
+  uint64_t destroyed_count_ = 0;
+};
+
+#endif  // VULKAN_DELETION_QUEUE_H_
@@ -1,11 +1,14 @@
 #include "vulkan_device.h"
 
-#include <array>
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <set>
+#include <vector>
 
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_enums.hpp>
@@ -14,36 +17,58 @@
 
 #include "vulkan_config.h"
 #include "vulkan_errors.h"
-#include "vulkan_presentation_context.h"
 #include "vulkan_physical_device.h"
 #include "vulkan_surface_support.h"
 
 namespace {
 
-[[nodiscard]] vk::UniqueDevice CreateDevice(
-    const VulkanConfig& vulkan_config,
-    const VulkanSurfaceSupport& surface_support,
-    VulkanPhysicalDevice& physical_device) {
+// The share of a heap that can be used when the driver doesn't report a
+// budget. Other processes and the driver's own allocations need the rest.
+constexpr vk::DeviceSize kEstimatedBudgetPercent = 80;
+
+// The queue families used by a device that presents to a surface.
+[[nodiscard]] std::set<uint32_t> SurfaceQueueFamilyIndexes(
+    const VulkanSurfaceSupport& surface_support, const VulkanPhysicalDevice& physical_device) {
   assert(physical_device.VulkanHandle() == surface_support.PhysicalDeviceVulkanHandle());
   assert(surface_support.IsAcceptable());
 
-  vk::PhysicalDeviceFeatures required_features{};
-  required_features.tessellationShader = true;
-
   VulkanSurfaceSupport::Queues queues = surface_support.QueueFamilyIndexes();
-
-  std::set<uint32_t> family_indexes = {
+  return {
       queues.graphics_queue_family_index,
       queues.presentation_queue_family_index,
   };
+}
 
-  static constexpr std::array<float, 1> kQueuePriorities = {1.0};
+// The number of queues created in a queue family.
+[[nodiscard]] uint32_t QueueCountFor(const VulkanConfig& vulkan_config, uint32_t family_index,
+                                     const VulkanPhysicalDevice& physical_device) {
+  uint32_t priority_count = static_cast<uint32_t>(vulkan_config.QueuePriorities().size());
+  assert(priority_count > 0);
+  return std::min(priority_count, physical_device.QueueCount(family_index));
+}
+
+[[nodiscard]] vk::UniqueDevice CreateDevice(
+    const VulkanConfig& vulkan_config,
+    const std::set<uint32_t>& family_indexes,
+    VulkanPhysicalDevice& physical_device, bool compute_only) {
+  assert(!family_indexes.empty());
+
+  // Compute-only devices skip the graphics features, so they can be created
+  // on compute accelerators.
+  vk::PhysicalDeviceFeatures required_features{};
+  required_features.tessellationShader = !compute_only;
+  required_features.pipelineStatisticsQuery = !compute_only;
+  required_features.occlusionQueryPrecise =
+      !compute_only && physical_device.SupportsPreciseOcclusionQueries();
+
+  const std::vector<float>& queue_priorities = vulkan_config.QueuePriorities();
 
   std::vector<vk::DeviceQueueCreateInfo> queue_create_info;
   for (uint32_t family_index : family_indexes) {
     queue_create_info.emplace_back(vk::DeviceQueueCreateInfo()
         .setQueueFamilyIndex(family_index)
-        .setQueuePriorities(kQueuePriorities));
+        .setQueueCount(QueueCountFor(vulkan_config, family_index, physical_device))
+        .setPQueuePriorities(queue_priorities.data()));
   }
 
   const std::vector<const char*>& required_layers = vulkan_config.RequiredLayers();
@@ -59,152 +84,260 @@ namespace {
   if (physical_device.HasExtension({kPortabilityExtensionName}))
     required_extensions.push_back(kPortabilityExtensionName);
 
-  vk::DeviceCreateInfo device_create_info;
-  device_create_info.setQueueCreateInfos(queue_create_info);
-  device_create_info.setPEnabledLayerNames(required_layers);
-  device_create_info.setPEnabledExtensionNames(required_extensions);
-  device_create_info.setPEnabledFeatures(&required_features);
+  // Pipeline libraries are optional. VulkanPipelineManager falls back to
+  // monolithic pipelines on devices that don't support them.
+  const bool use_graphics_pipeline_library =
+      !compute_only && physical_device.SupportsGraphicsPipelineLibrary();
+  if (use_graphics_pipeline_library) {
+    required_extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+    required_extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+  }
+
+  // Memory budgets are optional. VulkanDevice::QueryMemoryBudget() falls back
+  // to estimates on devices that don't support them.
+  if (physical_device.SupportsMemoryBudget())
+    required_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceVulkan12Features,
+                     vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>
+      create_info_chain;
+  create_info_chain.get<vk::DeviceCreateInfo>()
+      .setQueueCreateInfos(queue_create_info)
+      .setPEnabledLayerNames(required_layers)
+      .setPEnabledExtensionNames(required_extensions)
+      .setPEnabledFeatures(&required_features);
+  // Bindless textures are optional. VulkanSpriteBatch falls back to a
+  // descriptor set per texture on devices that don't support them.
+  const bool use_bindless_textures = !compute_only && physical_device.SupportsBindlessTextures();
+  create_info_chain.get<vk::PhysicalDeviceVulkan12Features>()
+      .setTimelineSemaphore(true)
+      .setRuntimeDescriptorArray(use_bindless_textures)
+      .setShaderSampledImageArrayNonUniformIndexing(use_bindless_textures)
+      .setDescriptorBindingPartiallyBound(use_bindless_textures)
+      .setDescriptorBindingSampledImageUpdateAfterBind(use_bindless_textures);
+  create_info_chain.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>()
+      .setGraphicsPipelineLibrary(true);
+  if (!use_graphics_pipeline_library)
+    create_info_chain.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
 
   vk::ResultValue<vk::UniqueDevice> device =
-      physical_device.VulkanHandle().createDeviceUnique(device_create_info);
+      physical_device.VulkanHandle().createDeviceUnique(create_info_chain.get());
   VulkanCheckResult("vkCreateDevice", device.result);
   return std::move(device.value);
 }
 
-[[nodiscard]] vk::UniqueSwapchainKHR CreateSwapChain(
-    const VulkanSurfaceSupport& surface_support,
-    const VulkanPresentationSurface& surface,
-    vk::Device logical_device) {
-  assert(surface.VulkanHandle() == surface_support.SurfaceVulkanHandle());
-  assert(surface_support.IsAcceptable());
-
-  VulkanSurfaceSupport::Queues queues = surface_support.QueueFamilyIndexes();
-  bool is_unified_queue =
-      (queues.graphics_queue_family_index == queues.presentation_queue_family_index);
-  const std::array<uint32_t, 2> queue_family_indexes = {
-    queues.graphics_queue_family_index, queues.presentation_queue_family_index
-  };
+[[nodiscard]] std::unique_ptr<vk::DispatchLoaderDynamic> CreateDispatcher(
+    vk::Instance instance, vk::Device logical_device) {
+  assert(instance);
+  assert(logical_device);
 
-  vk::SurfaceFormatKHR surface_format = surface_support.BestFormat();
-  vk::Extent2D image_extent = surface_support.BestExtentFor(surface.Size());
-  vk::SwapchainCreateInfoKHR create_info;
-  create_info
-      .setMinImageCount(static_cast<uint32_t>(surface_support.BestImageCount()))
-      .setSurface(surface.VulkanHandle())
-      .setImageFormat(surface_format.format)
-      .setImageColorSpace(surface_format.colorSpace)
-      .setImageExtent(image_extent)
-      .setImageArrayLayers(1)
-      .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
-      .setPreTransform(surface_support.CurrentTransform())
-      .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
-      .setPresentMode(surface_support.BestMode())
-      .setClipped(true)
-      .setOldSwapchain(nullptr);  // TODO(pwnall): Change when recreating.
-
-  if (is_unified_queue) {
-    create_info.setImageSharingMode(vk::SharingMode::eExclusive).setQueueFamilyIndices({});
-  } else {
-    create_info
-        .setImageSharingMode(vk::SharingMode::eExclusive)
-        .setQueueFamilyIndices(queue_family_indexes);
+  // Device-level functions are loaded with vkGetDeviceProcAddr(), so they
+  // point directly into the driver, or into the first enabled layer.
+  return std::make_unique<vk::DispatchLoaderDynamic>(
+      static_cast<VkInstance>(instance), vkGetInstanceProcAddr,
+      static_cast<VkDevice>(logical_device), vkGetDeviceProcAddr);
+}
 
+[[nodiscard]] std::vector<vk::Queue> GetGraphicsQueues(uint32_t family_index, uint32_t queue_count,
+                                                      vk::Device logical_device) {
+  assert(logical_device);
+  assert(queue_count > 0);
+
+  std::vector<vk::Queue> queues;
+  queues.reserve(queue_count);
+  for (uint32_t queue_index = 0; queue_index < queue_count; ++queue_index) {
+    vk::Queue queue = logical_device.getQueue(family_index, queue_index);
+    assert(queue);
+    queues.push_back(queue);
   }
-
-  vk::ResultValue<vk::UniqueSwapchainKHR> create_result =
-      logical_device.createSwapchainKHRUnique(create_info);
-  VulkanCheckResult("vkCreateSwapchainKHR", create_result.result);
-  return std::move(create_result.value);
+  return queues;
 }
 
-[[nodiscard]] vk::Queue GetGraphicsQueue(const VulkanSurfaceSupport& surface_support,
-                                         vk::Device logical_device) {
+[[nodiscard]] vk::Queue GetPresentationQueue(uint32_t family_index,
+                                             vk::Device logical_device) {
   assert(logical_device);
 
-  uint32_t family_index = surface_support.QueueFamilyIndexes().graphics_queue_family_index;
-
   vk::Queue queue = logical_device.getQueue(family_index, /*queueIndex=*/0);
   assert(queue);
 
   return queue;
 }
 
-[[nodiscard]] vk::Queue GetPresentationQueue(const VulkanSurfaceSupport& surface_support,
-                                             vk::Device logical_device) {
-  assert(logical_device);
+}  // namespace
 
-  uint32_t family_index = surface_support.QueueFamilyIndexes().presentation_queue_family_index;
 
-  vk::Queue queue = logical_device.getQueue(family_index, /*queueIndex=*/0);
-  assert(queue);
+VulkanDevice::VulkanDevice(
+    vk::Instance instance, const VulkanConfig& vulkan_config,
+    const VulkanSurfaceSupport& surface_support, VulkanPhysicalDevice& physical_device)
+    : physical_device_(physical_device.VulkanHandle()),
+      properties_(physical_device.Properties()),
+      memory_properties_(physical_device.MemoryProperties()),
+      has_graphics_pipeline_library_(physical_device.SupportsGraphicsPipelineLibrary()),
+      has_memory_budget_(physical_device.SupportsMemoryBudget()),
+      has_precise_occlusion_queries_(physical_device.SupportsPreciseOcclusionQueries()),
+      has_bindless_textures_(physical_device.SupportsBindlessTextures()),
+      device_(CreateDevice(vulkan_config,
+                           SurfaceQueueFamilyIndexes(surface_support, physical_device),
+                           physical_device, /*compute_only=*/false)),
+      dispatcher_(CreateDispatcher(instance, device_.get())),
+      timestamp_valid_bits_(physical_device.TimestampValidBits(
+          surface_support.QueueFamilyIndexes().graphics_queue_family_index)),
+      graphics_queue_family_index_(
+          surface_support.QueueFamilyIndexes().graphics_queue_family_index),
+      presentation_queue_family_index_(
+          surface_support.QueueFamilyIndexes().presentation_queue_family_index),
+      graphics_queues_(GetGraphicsQueues(
+          graphics_queue_family_index_,
+          QueueCountFor(vulkan_config, graphics_queue_family_index_, physical_device),
+          device_.get())),
+      presentation_queue_(
+          GetPresentationQueue(presentation_queue_family_index_, device_.get())),
+      compute_queue_family_index_(graphics_queue_family_index_),
+      compute_queue_(graphics_queues_[0]) {
+}
 
-  return queue;
+VulkanDevice::VulkanDevice(
+    vk::Instance instance, const VulkanConfig& vulkan_config,
+    uint32_t graphics_queue_family_index, VulkanPhysicalDevice& physical_device)
+    : physical_device_(physical_device.VulkanHandle()),
+      properties_(physical_device.Properties()),
+      memory_properties_(physical_device.MemoryProperties()),
+      has_graphics_pipeline_library_(physical_device.SupportsGraphicsPipelineLibrary()),
+      has_memory_budget_(physical_device.SupportsMemoryBudget()),
+      has_precise_occlusion_queries_(physical_device.SupportsPreciseOcclusionQueries()),
+      has_bindless_textures_(physical_device.SupportsBindlessTextures()),
+      device_(CreateDevice(vulkan_config, {graphics_queue_family_index}, physical_device,
+                           /*compute_only=*/false)),
+      dispatcher_(CreateDispatcher(instance, device_.get())),
+      timestamp_valid_bits_(physical_device.TimestampValidBits(graphics_queue_family_index)),
+      graphics_queue_family_index_(graphics_queue_family_index),
+      presentation_queue_family_index_(graphics_queue_family_index),
+      graphics_queues_(GetGraphicsQueues(
+          graphics_queue_family_index_,
+          QueueCountFor(vulkan_config, graphics_queue_family_index_, physical_device),
+          device_.get())),
+      presentation_queue_(graphics_queues_[0]),
+      compute_queue_family_index_(graphics_queue_family_index),
+      compute_queue_(graphics_queues_[0]) {
+  assert(physical_device.GraphicsQueueFamilyIndices().count(graphics_queue_family_index));
 }
 
-[[nodiscard]] std::vector<vk::Image> GetSwapChainImages(
-    vk::Device logical_device, vk::SwapchainKHR swap_chain) {
-  assert(logical_device);
-  assert(swap_chain);
-
-  vk::ResultValue<std::vector<vk::Image>> get_images_result =
-      logical_device.getSwapchainImagesKHR(swap_chain);
-  VulkanCheckResult("vkGetSwapchainImagesKHR", get_images_result.result);
-
-  return std::move(get_images_result.value);
-}
-
-[[nodiscard]] vk::UniqueImageView CreateImageView(
-    vk::Format image_format, vk::Device logical_device, vk::Image image) {
-  vk::ImageViewCreateInfo create_info;
-  create_info
-    .setImage(image)
-    .setViewType(vk::ImageViewType::e2D)
-    .setFormat(image_format)
-    .setComponents(vk::ComponentMapping(
-        vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity,
-        vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity))
-    .setSubresourceRange(vk::ImageSubresourceRange()
-        .setAspectMask(vk::ImageAspectFlagBits::eColor)
-        .setBaseMipLevel(0)
-        .setLevelCount(1)
-        .setBaseArrayLayer(0)
-        .setLayerCount(1));
-
-  vk::ResultValue<vk::UniqueImageView> create_result =
-      logical_device.createImageViewUnique(create_info);
-  VulkanCheckResult("vkCreateImageView", create_result.result);
+VulkanDevice::VulkanDevice(
+    vk::Instance instance, const VulkanConfig& vulkan_config,
+    ComputeQueueFamily compute_queue_family, VulkanPhysicalDevice& physical_device)
+    : physical_device_(physical_device.VulkanHandle()),
+      properties_(physical_device.Properties()),
+      memory_properties_(physical_device.MemoryProperties()),
+      has_graphics_pipeline_library_(false),
+      has_memory_budget_(physical_device.SupportsMemoryBudget()),
+      has_precise_occlusion_queries_(false),
+      has_bindless_textures_(false),
+      device_(CreateDevice(vulkan_config, {compute_queue_family.index}, physical_device,
+                           /*compute_only=*/true)),
+      dispatcher_(CreateDispatcher(instance, device_.get())),
+      timestamp_valid_bits_(physical_device.TimestampValidBits(compute_queue_family.index)),
+      graphics_queue_family_index_(VK_QUEUE_FAMILY_IGNORED),
+      presentation_queue_family_index_(VK_QUEUE_FAMILY_IGNORED),
+      compute_queue_family_index_(compute_queue_family.index),
+      compute_queue_(device_->getQueue(compute_queue_family.index, /*queueIndex=*/0)) {
+  assert(physical_device.ComputeQueueFamilyIndex().has_value());
+  assert(compute_queue_);
+}
+
+VulkanDevice::VulkanDevice(VulkanDevice&& rhs) noexcept = default;
+VulkanDevice& VulkanDevice::operator=(VulkanDevice&& rhs) noexcept = default;
 
+vk::UniqueSemaphore VulkanDevice::CreateTimelineSemaphore(uint64_t initial_value) const {
+  assert(device_);
+
+  vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> create_info_chain;
+  create_info_chain.get<vk::SemaphoreTypeCreateInfo>()
+      .setSemaphoreType(vk::SemaphoreType::eTimeline)
+      .setInitialValue(initial_value);
+
+  vk::ResultValue<vk::UniqueSemaphore> create_result =
+      device_->createSemaphoreUnique(create_info_chain.get());
+  VulkanCheckResult("vkCreateSemaphore", create_result.result);
   return std::move(create_result.value);
 }
 
-[[nodiscard]] std::vector<vk::UniqueImageView> CreateImageViews(
-    vk::Format image_format, vk::Device logical_device, const std::vector<vk::Image>& images) {
-  std::vector<vk::UniqueImageView> image_views;
-  image_views.reserve(images.size());
+vk::SampleCountFlagBits VulkanDevice::FramebufferSampleCount(
+    vk::SampleCountFlagBits max_samples) const {
+  const vk::SampleCountFlags supported = properties_.limits.framebufferColorSampleCounts &
+                                         properties_.limits.framebufferDepthSampleCounts;
 
-  for (vk::Image image : images)
-    image_views.push_back(CreateImageView(image_format, logical_device, image));
-  return image_views;
+  // Sample counts are powers of two, so halving steps through the flag bits.
+  for (uint32_t samples = static_cast<uint32_t>(max_samples); samples > 1; samples /= 2) {
+    if (supported & static_cast<vk::SampleCountFlagBits>(samples))
+      return static_cast<vk::SampleCountFlagBits>(samples);
+  }
+  return vk::SampleCountFlagBits::e1;
 }
 
-}  // namespace
+vk::Format VulkanDevice::FindDepthFormat() const {
+  // eD16Unorm support is required by the Vulkan specification.
+  static constexpr vk::Format kDepthFormats[] = {
+    vk::Format::eD32Sfloat, vk::Format::eX8D24UnormPack32, vk::Format::eD16Unorm,
+  };
+  for (vk::Format format : kDepthFormats) {
+    vk::FormatProperties properties = physical_device_.getFormatProperties(format);
+    if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+      return format;
+  }
+  return vk::Format::eD16Unorm;
+}
 
+std::optional<uint32_t> VulkanDevice::FindMemoryType(
+    uint32_t memory_type_bits, vk::MemoryPropertyFlags properties) const {
+  for (uint32_t type_index = 0; type_index < memory_properties_.memoryTypeCount; ++type_index) {
+    if ((memory_type_bits & (uint32_t{1} << type_index)) == 0)
+      continue;
+    if ((memory_properties_.memoryTypes[type_index].propertyFlags & properties) != properties)
+      continue;
+    return type_index;
+  }
+  return std::nullopt;
+}
 
-VulkanDevice::VulkanDevice(
-    const VulkanConfig& vulkan_config, const VulkanSurfaceSupport& surface_support,
-    const VulkanPresentationSurface& surface, VulkanPhysicalDevice& physical_device)
-    : device_(CreateDevice(vulkan_config, surface_support, physical_device)),
-      swap_chain_(CreateSwapChain(surface_support, surface, device_.get())),
-      swap_chain_format_(surface_support.BestFormat()),
-      graphics_queue_(GetGraphicsQueue(surface_support, device_.get())),
-      presentation_queue_(GetPresentationQueue(surface_support, device_.get())),
-      swap_chain_images_(GetSwapChainImages(device_.get(), swap_chain_.get())),
-      swap_chain_image_views_(CreateImageViews(
-          swap_chain_format_.format, device_.get(), swap_chain_images_)) {
+std::vector<VulkanDevice::HeapBudget> VulkanDevice::QueryMemoryBudget() const {
+  std::vector<HeapBudget> heap_budgets(memory_properties_.memoryHeapCount);
+
+  if (!has_memory_budget_) {
+    for (uint32_t heap_index = 0; heap_index < memory_properties_.memoryHeapCount;
+         ++heap_index) {
+      heap_budgets[heap_index] = {
+        .budget = memory_properties_.memoryHeaps[heap_index].size * kEstimatedBudgetPercent / 100,
+        .usage = 0,
+      };
+    }
+    return heap_budgets;
+  }
+
+  // The budget changes as memory is allocated, so it is queried every time.
+  auto properties_chain = physical_device_.getMemoryProperties2<
+      vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>(
+          *dispatcher_);
+  const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budget_properties =
+      properties_chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+  for (uint32_t heap_index = 0; heap_index < memory_properties_.memoryHeapCount; ++heap_index) {
+    heap_budgets[heap_index] = {
+      .budget = budget_properties.heapBudget[heap_index],
+      .usage = budget_properties.heapUsage[heap_index],
+    };
+  }
+  return heap_budgets;
 }
 
-VulkanDevice::VulkanDevice(VulkanDevice&& rhs) noexcept = default;
-VulkanDevice& VulkanDevice::operator=(VulkanDevice&& rhs) noexcept = default;
+void VulkanDevice::SetDebugUtilsObjectName(vk::ObjectType object_type, uint64_t object_handle,
+                                           const char* name) const {
+  assert(device_);
+  assert(name != nullptr);
+
+  vk::DebugUtilsObjectNameInfoEXT name_info;
+  name_info.setObjectType(object_type).setObjectHandle(object_handle).setPObjectName(name);
+  vk::Result result = device_->setDebugUtilsObjectNameEXT(name_info, *dispatcher_);
+  VulkanCheckResult("vkSetDebugUtilsObjectNameEXT", result);
+}
 
 VulkanDevice::~VulkanDevice() {
   // This class supports move construction and assignment.
@@ -2,23 +2,62 @@
 #define VULKAN_DEVICE_H_
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_handles.hpp>
 #include <vulkan/vulkan_structs.hpp>
 
-class VulkanConfig;
+#include "vulkan_config.h"
+
 class VulkanPhysicalDevice;
-class VulkanPresentationSurface;
 class VulkanSurfaceSupport;
 
 class VulkanDevice {
  public:
+  struct HeapBudget {
+    // How much memory the process can allocate from the heap without
+    // degrading performance, including the memory it already uses.
+    vk::DeviceSize budget;
+    // The heap memory used by the process. Zero without VK_EXT_memory_budget.
+    vk::DeviceSize usage;
+  };
+
+  // Selects the compute-only constructor.
+  struct ComputeQueueFamily {
+    uint32_t index;
+  };
+
   // Creates a new logical device connected to the given physical device.
+  //
+  // `instance` must be the instance that enumerated `physical_device`.
+  //
+  // The device can present to the surface described by `surface_support`, and
+  // to any other surface supported by its presentation queue family. Use
+  // VulkanSwapChain to present.
+  explicit VulkanDevice(
+      vk::Instance instance, const VulkanConfig& vulkan_config,
+      const VulkanSurfaceSupport& surface_support, VulkanPhysicalDevice& physical_device);
+
+  // Creates a new logical device for offscreen rendering.
+  //
+  // The graphics queue doubles as the presentation queue.
+  explicit VulkanDevice(
+      vk::Instance instance, const VulkanConfig& vulkan_config,
+      uint32_t graphics_queue_family_index, VulkanPhysicalDevice& physical_device);
+
+  // Creates a new logical device that only runs compute work.
+  //
+  // The device has no graphics or presentation queues, so it works without a
+  // window system, and on physical devices without graphics support. Graphics
+  // queue accessors must not be called.
   explicit VulkanDevice(
-      const VulkanConfig& vulkan_config, const VulkanSurfaceSupport& surface_support,
-      const VulkanPresentationSurface& surface, VulkanPhysicalDevice& physical_device);
+      vk::Instance instance, const VulkanConfig& vulkan_config,
+      ComputeQueueFamily compute_queue_family, VulkanPhysicalDevice& physical_device);
 
   // Moving supported so instances can be returned.
   VulkanDevice(const VulkanDevice&) = delete;
@@ -34,26 +73,171 @@ class VulkanDevice {
     return device_.get();
   }
 
-  vk::Queue GraphicsQueue() const {
+  // Device-level function pointers for this device.
+  //
+  // Calls made through the dispatcher skip the loader's trampolines, which
+  // look up the device's dispatch table on every call. Pass the dispatcher to
+  // vulkan.hpp methods on hot paths, such as command recording. The reference
+  // remains valid when the VulkanDevice is moved.
+  const vk::DispatchLoaderDynamic& Dispatcher() const {
+    assert(dispatcher_);
+    return *dispatcher_;
+  }
+
+  vk::PhysicalDevice PhysicalDeviceVulkanHandle() const {
+    assert(physical_device_);
+    return physical_device_;
+  }
+
+  // The number of queues created in the graphics queue family.
+  //
+  // Capped by both VulkanConfig::QueuePriorities() and the queue family's size.
+  size_t GraphicsQueueCount() const {
+    assert(device_);
+    return graphics_queues_.size();
+  }
+
+  // The graphics queue used by the submission thread at `thread_index`.
+  //
+  // Thread index 0 is the thread that presents, because its queue doubles as
+  // the presentation queue when the queue families match. Vulkan requires
+  // external synchronization for queue submissions, so each thread gets its own
+  // queue while there are enough queues. Threads that end up sharing a queue
+  // must serialize their submissions.
+  vk::Queue SubmissionQueue(size_t thread_index) const {
+    assert(device_);
+    assert(!IsComputeOnly());
+    return graphics_queues_[thread_index % graphics_queues_.size()];
+  }
+
+  // True if SubmissionQueue() returns a different queue for every thread
+  // index below `thread_count`.
+  bool HasDedicatedSubmissionQueues(size_t thread_count) const {
     assert(device_);
-    assert(graphics_queue_);
-    return graphics_queue_;
+    return thread_count <= graphics_queues_.size();
   }
+
   vk::Queue PresentationQueue() const {
     assert(device_);
     assert(presentation_queue_);
     return presentation_queue_;
   }
+  uint32_t GraphicsQueueFamilyIndex() const {
+    assert(device_);
+    assert(!IsComputeOnly());
+    return graphics_queue_family_index_;
+  }
+  uint32_t PresentationQueueFamilyIndex() const {
+    assert(device_);
+    assert(!IsComputeOnly());
+    return presentation_queue_family_index_;
+  }
+
+  // The queue used for compute work.
+  //
+  // On graphics devices, this is the graphics queue of submission thread 0.
+  vk::Queue ComputeQueue() const {
+    assert(device_);
+    assert(compute_queue_);
+    return compute_queue_;
+  }
+  uint32_t ComputeQueueFamilyIndex() const {
+    assert(device_);
+    return compute_queue_family_index_;
+  }
+
+  // True if the device was created without graphics and presentation queues.
+  bool IsComputeOnly() const {
+    assert(device_);
+    return graphics_queues_.empty();
+  }
+
+  const vk::PhysicalDeviceLimits& Limits() const { return properties_.limits; }
+
+  // The highest sample count, up to `max_samples`, supported by framebuffers
+  // with color and depth attachments.
+  [[nodiscard]] vk::SampleCountFlagBits FramebufferSampleCount(
+      vk::SampleCountFlagBits max_samples) const;
+
+  // The most precise depth format that can be used as an optimally tiled
+  // depth attachment.
+  [[nodiscard]] vk::Format FindDepthFormat() const;
+
+  // Human-readable name of the physical device.
+  const char* Name() const { return properties_.deviceName.data(); }
+
+  // True if VK_EXT_graphics_pipeline_library is enabled on the device.
+  bool HasGraphicsPipelineLibrary() const { return has_graphics_pipeline_library_; }
+
+  // True if VK_EXT_memory_budget is enabled on the device.
+  bool HasMemoryBudget() const { return has_memory_budget_; }
+
+  // True if occlusion queries can use vk::QueryControlFlagBits::ePrecise.
+  bool HasPreciseOcclusionQueries() const { return has_precise_occlusion_queries_; }
+
+  // True if shaders can index arrays of sampled images that are partially
+  // bound and updated after binding.
+  bool HasBindlessTextures() const { return has_bindless_textures_; }
+
+  // The number of meaningful bits in timestamps written on the graphics
+  // queues, or on the compute queue of compute-only devices. Zero if the
+  // queues don't support timestamps.
+  uint32_t TimestampValidBits() const { return timestamp_valid_bits_; }
+
+  const vk::PhysicalDeviceMemoryProperties& MemoryProperties() const {
+    return memory_properties_;
+  }
+
+  // Indexed by memory heap index.
+  //
+  // Without VK_EXT_memory_budget, the budget is estimated from the heap size,
+  // and callers must track their own usage.
+  [[nodiscard]] std::vector<HeapBudget> QueryMemoryBudget() const;
+
+  // Creates a timeline semaphore, whose payload starts at `initial_value`.
+  [[nodiscard]] vk::UniqueSemaphore CreateTimelineSemaphore(uint64_t initial_value) const;
+
+  // Finds a memory type allowed by `memory_type_bits` that has all `properties`.
+  //
+  // `memory_type_bits` is usually vk::MemoryRequirements::memoryTypeBits.
+  [[nodiscard]] std::optional<uint32_t> FindMemoryType(
+      uint32_t memory_type_bits, vk::MemoryPropertyFlags properties) const;
+
+  // Names the object in GPU profilers and debuggers.
+  //
+  // Compiled out unless the config profile enables profiling.
+  template <typename Handle>
+  void SetObjectName(Handle handle, const char* name) const {
+    if constexpr (VulkanConfig::WantProfiling()) {
+      SetDebugUtilsObjectName(
+          Handle::objectType,
+          reinterpret_cast<uint64_t>(static_cast<typename Handle::CType>(handle)), name);
+    }
+  }
 
  private:
+  void SetDebugUtilsObjectName(vk::ObjectType object_type, uint64_t object_handle,
+                               const char* name) const;
+
+  vk::PhysicalDevice physical_device_;
+  vk::PhysicalDeviceProperties properties_;
+  vk::PhysicalDeviceMemoryProperties memory_properties_;
+  bool has_graphics_pipeline_library_;
+  bool has_memory_budget_;
+  bool has_precise_occlusion_queries_;
+  bool has_bindless_textures_;
   vk::UniqueDevice device_;
-  vk::UniqueSwapchainKHR swap_chain_;
-  vk::SurfaceFormatKHR swap_chain_format_;
-  // TODO(costan): Add vk::Extent2D swap_chain_extent_;
-  vk::Queue graphics_queue_;
+  // Heap-allocated, so the address is stable. The table is also too large to
+  // be copied around cheaply.
+  std::unique_ptr<vk::DispatchLoaderDynamic> dispatcher_;
+  uint32_t timestamp_valid_bits_;
+  uint32_t graphics_queue_family_index_;
+  uint32_t presentation_queue_family_index_;
+  // Indexed by queue index. Empty on compute-only devices.
+  std::vector<vk::Queue> graphics_queues_;
   vk::Queue presentation_queue_;
-  std::vector<vk::Image> swap_chain_images_;
-  std::vector<vk::UniqueImageView> swap_chain_image_views_;
+  uint32_t compute_queue_family_index_;
+  vk::Queue compute_queue_;
 };
 
 #endif  // VULKAN_DEVICE_H_
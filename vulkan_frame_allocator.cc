@@ -0,0 +1,160 @@
+#include "vulkan_frame_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <utility>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_frame_commands.h"
+
+namespace {
+
+// The unit in which cursors reserve space. Large enough that the atomic
+// operation is amortized over many allocations, and small enough that the
+// unused chunk ends don't waste much of a frame's region.
+constexpr vk::DeviceSize kChunkSize = 64 * 1024;
+
+[[nodiscard]] vk::DeviceSize RoundUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+  assert((alignment & (alignment - 1)) == 0);
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// The offset alignment required by all the buffer's uses.
+[[nodiscard]] vk::DeviceSize OffsetAlignment(const VulkanDevice& device,
+                                             vk::BufferUsageFlags usage) {
+  const vk::PhysicalDeviceLimits& limits = device.Limits();
+
+  // Vertex and index data only need the alignment of their largest component.
+  vk::DeviceSize alignment = 16;
+  if (usage & vk::BufferUsageFlagBits::eUniformBuffer)
+    alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+  if (usage & vk::BufferUsageFlagBits::eStorageBuffer)
+    alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+  return alignment;
+}
+
+[[nodiscard]] vk::UniqueBuffer CreateBuffer(vk::Device device, vk::DeviceSize size,
+                                            vk::BufferUsageFlags usage) {
+  vk::BufferCreateInfo create_info;
+  create_info
+      .setSize(size)
+      .setUsage(usage)
+      .setSharingMode(vk::SharingMode::eExclusive);
+
+  vk::ResultValue<vk::UniqueBuffer> create_result = device.createBufferUnique(create_info);
+  VulkanCheckResult("vkCreateBuffer", create_result.result);
+  return std::move(create_result.value);
+}
+
+// Device-local host-visible memory is read by the GPU at full speed. Otherwise,
+// the GPU reads the data over the bus.
+[[nodiscard]] uint32_t FindFrameMemoryType(const VulkanDevice& device,
+                                           uint32_t memory_type_bits) {
+  static constexpr vk::MemoryPropertyFlags kHostVisibleCoherent =
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+  std::optional<uint32_t> memory_type = device.FindMemoryType(
+      memory_type_bits, kHostVisibleCoherent | vk::MemoryPropertyFlagBits::eDeviceLocal);
+  if (memory_type.has_value())
+    return *memory_type;
+
+  memory_type = device.FindMemoryType(memory_type_bits, kHostVisibleCoherent);
+  if (memory_type.has_value())
+    return *memory_type;
+
+  std::cerr << "No host-coherent memory type for frame allocations" << std::endl;
+  std::abort();
+}
+
+}  // namespace
+
+VulkanFrameAllocator::Allocation VulkanFrameAllocator::Cursor::Allocate(vk::DeviceSize size) {
+  assert(size > 0);
+  assert(allocator_.frame_number_ != 0);  // BeginFrame() was never called.
+
+  const vk::DeviceSize aligned_size = RoundUp(size, allocator_.alignment_);
+  if (frame_number_ != allocator_.frame_number_ || chunk_offset_ + aligned_size > chunk_end_)
+    Refill(aligned_size);
+
+  const vk::DeviceSize offset = chunk_offset_;
+  chunk_offset_ += aligned_size;
+  return {
+    .buffer = allocator_.buffer_.get(),
+    .offset = static_cast<uint32_t>(offset),
+    .data = allocator_.mapped_data_ + offset,
+  };
+}
+
+void VulkanFrameAllocator::Cursor::Refill(vk::DeviceSize min_size) {
+  const vk::DeviceSize chunk_size = std::max(kChunkSize, min_size);
+  const vk::DeviceSize region_chunk_offset =
+      allocator_.next_chunk_offset_.fetch_add(chunk_size, std::memory_order_relaxed);
+  if (region_chunk_offset + chunk_size > allocator_.bytes_per_frame_) {
+    std::cerr << "Frame allocator out of memory. Increase bytes_per_frame." << std::endl;
+    std::abort();
+  }
+
+  frame_number_ = allocator_.frame_number_;
+  chunk_offset_ = allocator_.region_offset_ + region_chunk_offset;
+  chunk_end_ = chunk_offset_ + chunk_size;
+}
+
+VulkanFrameAllocator::VulkanFrameAllocator(const VulkanDevice& device, int frames_in_flight,
+                                           vk::DeviceSize bytes_per_frame,
+                                           vk::BufferUsageFlags usage)
+    : alignment_(OffsetAlignment(device, usage)),
+      bytes_per_frame_(RoundUp(bytes_per_frame, kChunkSize)),
+      frames_in_flight_(frames_in_flight) {
+  assert(frames_in_flight > 0);
+  assert(bytes_per_frame > 0);
+  assert(kChunkSize % alignment_ == 0);
+
+  // Dynamic offsets are 32-bit.
+  const vk::DeviceSize buffer_size = bytes_per_frame_ * frames_in_flight;
+  assert(buffer_size <= std::numeric_limits<uint32_t>::max());
+
+  vk::Device device_handle = device.VulkanHandle();
+  buffer_ = CreateBuffer(device_handle, buffer_size, usage);
+
+  vk::MemoryRequirements requirements =
+      device_handle.getBufferMemoryRequirements(buffer_.get());
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info
+      .setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(FindFrameMemoryType(device, requirements.memoryTypeBits));
+  vk::ResultValue<vk::UniqueDeviceMemory> allocate_result =
+      device_handle.allocateMemoryUnique(allocate_info);
+  VulkanCheckResult("vkAllocateMemory", allocate_result.result);
+  memory_ = std::move(allocate_result.value);
+
+  VulkanCheckResult("vkBindBufferMemory",
+                    device_handle.bindBufferMemory(buffer_.get(), memory_.get(), 0));
+
+  // The memory stays mapped until it is freed.
+  vk::ResultValue<void*> map_result =
+      device_handle.mapMemory(memory_.get(), /*offset=*/0, VK_WHOLE_SIZE);
+  VulkanCheckResult("vkMapMemory", map_result.result);
+  mapped_data_ = static_cast<uint8_t*>(map_result.value);
+}
+
+VulkanFrameAllocator::~VulkanFrameAllocator() = default;
+
+void VulkanFrameAllocator::BeginFrame(const VulkanFrameCommands& frame_commands) {
+  assert(frame_commands.FrameNumber() > frame_number_);
+
+  frame_number_ = frame_commands.FrameNumber();
+  region_offset_ = (frame_number_ % frames_in_flight_) * bytes_per_frame_;
+  next_chunk_offset_.store(0, std::memory_order_relaxed);
+}
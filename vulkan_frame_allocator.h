@@ -0,0 +1,109 @@
+#ifndef VULKAN_FRAME_ALLOCATOR_H_
+#define VULKAN_FRAME_ALLOCATOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class VulkanDevice;
+class VulkanFrameCommands;
+
+// Sub-allocates short-lived uniform, storage and vertex data for each frame.
+//
+// The allocator owns one persistently mapped buffer, split into a region for
+// each frame in flight. Allocations are bound with dynamic offsets into the
+// buffer, so per-draw data doesn't need its own buffer or descriptor set.
+// A frame's region is reused once the GPU completes the frame that last used
+// it.
+//
+// Each recording thread allocates through its own Cursor. Cursors reserve
+// large chunks of the frame's region with one atomic operation, and then
+// bump-allocate inside the chunk without synchronization.
+class VulkanFrameAllocator {
+ public:
+  struct Allocation {
+    vk::Buffer buffer;
+    // Passed to vkCmdBindDescriptorSets() as a dynamic offset.
+    uint32_t offset;
+    // Host-coherent, so writes don't need to be flushed.
+    void* data;
+  };
+
+  // Allocates for a single thread.
+  class Cursor {
+   public:
+    explicit Cursor(VulkanFrameAllocator& allocator) : allocator_(allocator) {}
+
+    Cursor(const Cursor&) = delete;
+    Cursor& operator=(const Cursor&) = delete;
+
+    // The data is valid until the GPU completes the current frame.
+    [[nodiscard]] Allocation Allocate(vk::DeviceSize size);
+
+   private:
+    // Reserves a new chunk from the current frame's region.
+    void Refill(vk::DeviceSize min_size);
+
+    VulkanFrameAllocator& allocator_;
+    // The chunk is only valid during this frame.
+    uint64_t frame_number_ = 0;
+    // Relative to the buffer's start.
+    vk::DeviceSize chunk_offset_ = 0;
+    vk::DeviceSize chunk_end_ = 0;
+  };
+
+  // `frames_in_flight` must match the VulkanFrameCommands passed to
+  // BeginFrame(). `usage` selects the offset alignment.
+  explicit VulkanFrameAllocator(const VulkanDevice& device, int frames_in_flight,
+                                vk::DeviceSize bytes_per_frame, vk::BufferUsageFlags usage);
+
+  VulkanFrameAllocator(const VulkanFrameAllocator&) = delete;
+  VulkanFrameAllocator& operator=(const VulkanFrameAllocator&) = delete;
+
+  // The buffer must not be used by pending commands.
+  ~VulkanFrameAllocator();
+
+  // Reuses the region of the frame started by the last
+  // `frame_commands.BeginFrame()` call, which waited for the region's
+  // previous frame to complete.
+  //
+  // Allocations from other threads must not overlap this call.
+  void BeginFrame(const VulkanFrameCommands& frame_commands);
+
+  [[nodiscard]] vk::Buffer Buffer() const {
+    assert(buffer_);
+    return buffer_.get();
+  }
+
+  // Every allocation's offset is a multiple of this alignment.
+  [[nodiscard]] vk::DeviceSize Alignment() const { return alignment_; }
+
+  // The bytes reserved from the current frame's region, including the unused
+  // ends of the cursors' chunks.
+  [[nodiscard]] vk::DeviceSize ReservedBytes() const {
+    return std::min(next_chunk_offset_.load(std::memory_order_relaxed), bytes_per_frame_);
+  }
+
+ private:
+  const vk::DeviceSize alignment_;
+  const vk::DeviceSize bytes_per_frame_;
+  const int frames_in_flight_;
+  vk::UniqueBuffer buffer_;
+  vk::UniqueDeviceMemory memory_;
+  uint8_t* mapped_data_ = nullptr;
+
+  // Set by BeginFrame().
+  uint64_t frame_number_ = 0;
+  vk::DeviceSize region_offset_ = 0;
+
+  // Relative to the current frame's region. May exceed the region's size
+  // when a chunk doesn't fit.
+  std::atomic<vk::DeviceSize> next_chunk_offset_ = 0;
+};
+
+#endif  // VULKAN_FRAME_ALLOCATOR_H_
@@ -0,0 +1,141 @@
+#include "vulkan_frame_commands.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+
+namespace {
+
+[[nodiscard]] vk::UniqueCommandPool CreateCommandPool(const VulkanDevice& device) {
+  vk::CommandPoolCreateInfo create_info;
+  create_info
+      .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+      .setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+
+  vk::ResultValue<vk::UniqueCommandPool> create_result =
+      device.VulkanHandle().createCommandPoolUnique(create_info);
+  VulkanCheckResult("vkCreateCommandPool", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniqueCommandBuffer AllocateCommandBuffer(vk::Device device,
+                                                            vk::CommandPool command_pool) {
+  vk::CommandBufferAllocateInfo allocate_info;
+  allocate_info
+      .setCommandPool(command_pool)
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+      device.allocateCommandBuffersUnique(allocate_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+  return std::move(allocate_result.value[0]);
+}
+
+}  // namespace
+
+VulkanFrameCommands::VulkanFrameCommands(const VulkanDevice& device, int frames_in_flight,
+                                         size_t submission_thread_index)
+    : device_(device.VulkanHandle()),
+      dispatcher_(device.Dispatcher()),
+      queue_(device.SubmissionQueue(submission_thread_index)),
+      timeline_semaphore_(device.CreateTimelineSemaphore(/*initial_value=*/0)) {
+  assert(frames_in_flight > 0);
+
+  command_pools_.reserve(frames_in_flight);
+  command_buffers_.reserve(frames_in_flight);
+  for (int i = 0; i < frames_in_flight; ++i) {
+    command_pools_.push_back(CreateCommandPool(device));
+    command_buffers_.push_back(AllocateCommandBuffer(device_, command_pools_.back().get()));
+    device.SetObjectName(command_buffers_.back().get(), "Frame commands");
+  }
+}
+
+VulkanFrameCommands::~VulkanFrameCommands() {
+  assert(!is_recording_);
+  WaitForFrame(frame_number_);
+}
+
+vk::CommandBuffer VulkanFrameCommands::BeginFrame() {
+  assert(!is_recording_);
+
+  ++frame_number_;
+  const uint64_t frames_in_flight = command_buffers_.size();
+  if (frame_number_ > frames_in_flight)
+    WaitForFrame(frame_number_ - frames_in_flight);
+
+  size_t slot = frame_number_ % frames_in_flight;
+  VulkanCheckResult("vkResetCommandPool",
+                    device_.resetCommandPool(command_pools_[slot].get(), {}, dispatcher_));
+
+  vk::CommandBuffer command_buffer = command_buffers_[slot].get();
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info, dispatcher_));
+
+  is_recording_ = true;
+  return command_buffer;
+}
+
+void VulkanFrameCommands::SubmitFrame(const std::vector<vk::Semaphore>& wait_semaphores,
+                                      const std::vector<vk::PipelineStageFlags>& wait_stages,
+                                      const std::vector<vk::Semaphore>& signal_semaphores) {
+  assert(is_recording_);
+  assert(wait_semaphores.size() == wait_stages.size());
+
+  size_t slot = frame_number_ % command_buffers_.size();
+  vk::CommandBuffer command_buffer = command_buffers_[slot].get();
+  VulkanCheckResult("vkEndCommandBuffer", command_buffer.end(dispatcher_));
+  is_recording_ = false;
+
+  // The timeline semaphore is signaled after the caller's binary semaphores.
+  // Values are ignored for binary semaphores, but must be present.
+  signal_semaphores_ = signal_semaphores;
+  signal_semaphores_.push_back(timeline_semaphore_.get());
+  wait_values_.assign(wait_semaphores.size(), 0);
+  signal_values_.assign(signal_semaphores.size(), 0);
+  signal_values_.push_back(frame_number_);
+
+  vk::TimelineSemaphoreSubmitInfo timeline_submit_info;
+  timeline_submit_info
+      .setWaitSemaphoreValues(wait_values_)
+      .setSignalSemaphoreValues(signal_values_);
+  vk::SubmitInfo submit_info;
+  submit_info
+      .setPNext(&timeline_submit_info)
+      .setWaitSemaphores(wait_semaphores)
+      .setWaitDstStageMask(wait_stages)
+      .setCommandBuffers(command_buffer)
+      .setSignalSemaphores(signal_semaphores_);
+  VulkanCheckResult("vkQueueSubmit", queue_.submit(submit_info, nullptr, dispatcher_));
+}
+
+uint64_t VulkanFrameCommands::CompletedFrameNumber() const {
+  vk::ResultValue<uint64_t> value_result =
+      device_.getSemaphoreCounterValue(timeline_semaphore_.get(), dispatcher_);
+  VulkanCheckResult("vkGetSemaphoreCounterValue", value_result.result);
+  return value_result.value;
+}
+
+void VulkanFrameCommands::WaitForFrame(uint64_t frame_number) const {
+  if (frame_number == 0)
+    return;
+
+  vk::Semaphore timeline_semaphore = timeline_semaphore_.get();
+  vk::SemaphoreWaitInfo wait_info;
+  wait_info
+      .setSemaphores(timeline_semaphore)
+      .setValues(frame_number);
+  VulkanCheckResult("vkWaitSemaphores",
+                    device_.waitSemaphores(wait_info, UINT64_MAX, dispatcher_));
+}
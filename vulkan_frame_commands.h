@@ -0,0 +1,75 @@
+#ifndef VULKAN_FRAME_COMMANDS_H_
+#define VULKAN_FRAME_COMMANDS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class VulkanDevice;
+
+// Command buffers for the frames in flight on one of a device's graphics queues.
+//
+// Each frame gets its own command pool. Frame completion is tracked with a
+// timeline semaphore, whose payload is the number of the last completed frame.
+class VulkanFrameCommands {
+ public:
+  // `frames_in_flight` is the number of frames the CPU can record ahead of the GPU.
+  //
+  // Frames are submitted to VulkanDevice::SubmissionQueue(submission_thread_index),
+  // so the instance must only be used by that submission thread.
+  explicit VulkanFrameCommands(const VulkanDevice& device, int frames_in_flight,
+                               size_t submission_thread_index);
+
+  VulkanFrameCommands(const VulkanFrameCommands&) = delete;
+  VulkanFrameCommands& operator=(const VulkanFrameCommands&) = delete;
+
+  // Blocks until all the submitted frames complete.
+  ~VulkanFrameCommands();
+
+  // Starts recording the next frame's commands.
+  //
+  // Blocks until the GPU completes the frame that previously used the command
+  // buffer, which was submitted `frames_in_flight` frames ago.
+  [[nodiscard]] vk::CommandBuffer BeginFrame();
+
+  // Submits the commands recorded since BeginFrame() to the submission thread's queue.
+  //
+  // `wait_stages` must have one entry for each semaphore in `wait_semaphores`.
+  void SubmitFrame(const std::vector<vk::Semaphore>& wait_semaphores,
+                   const std::vector<vk::PipelineStageFlags>& wait_stages,
+                   const std::vector<vk::Semaphore>& signal_semaphores);
+
+  // The number of the frame started by the last BeginFrame() call.
+  //
+  // Frame numbers start at 1, so 0 can be used to indicate "no frame".
+  [[nodiscard]] uint64_t FrameNumber() const { return frame_number_; }
+
+  // The number of the last frame whose commands completed on the GPU.
+  [[nodiscard]] uint64_t CompletedFrameNumber() const;
+
+  // Signaled with each frame's number when the frame's commands complete.
+  [[nodiscard]] vk::Semaphore TimelineSemaphore() const { return timeline_semaphore_.get(); }
+
+  // Blocks until the given frame completes.
+  void WaitForFrame(uint64_t frame_number) const;
+
+ private:
+  vk::Device device_;
+  const vk::DispatchLoaderDynamic& dispatcher_;
+  vk::Queue queue_;
+  vk::UniqueSemaphore timeline_semaphore_;
+  std::vector<vk::UniqueCommandPool> command_pools_;
+  std::vector<vk::UniqueCommandBuffer> command_buffers_;
+  uint64_t frame_number_ = 0;
+  bool is_recording_ = false;
+
+  // Reused across SubmitFrame() calls to avoid allocations.
+  std::vector<vk::Semaphore> signal_semaphores_;
+  std::vector<uint64_t> wait_values_;
+  std::vector<uint64_t> signal_values_;
+};
+
+#endif  // VULKAN_FRAME_COMMANDS_H_
@@ -0,0 +1,22 @@
+#ifndef VULKAN_HASH_H_
+#define VULKAN_HASH_H_
+
+#include <cstddef>
+#include <functional>
+
+#include <vulkan/vulkan.hpp>
+
+// Helpers for hashing the keys of Vulkan object caches.
+
+[[nodiscard]] constexpr size_t HashCombine(size_t seed, size_t value) {
+  // From boost::hash_combine().
+  return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+template <typename Handle>
+[[nodiscard]] size_t HashHandle(Handle handle) {
+  using CHandle = typename Handle::CType;
+  return std::hash<CHandle>()(static_cast<CHandle>(handle));
+}
+
+#endif  // VULKAN_HASH_H_
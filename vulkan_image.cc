@@ -0,0 +1,156 @@
+#include "vulkan_image.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+
+namespace {
+
+[[nodiscard]] vk::UniqueImage CreateImage(const VulkanDevice& device, vk::Extent2D extent,
+                                          vk::Format format, vk::ImageUsageFlags usage,
+                                          vk::SampleCountFlagBits samples) {
+  assert(extent.width > 0 && extent.height > 0);
+
+  vk::ImageCreateInfo create_info;
+  create_info
+      .setImageType(vk::ImageType::e2D)
+      .setFormat(format)
+      .setExtent(vk::Extent3D(extent.width, extent.height, 1))
+      .setMipLevels(1)
+      .setArrayLayers(1)
+      .setSamples(samples)
+      .setTiling(vk::ImageTiling::eOptimal)
+      .setUsage(usage)
+      .setSharingMode(vk::SharingMode::eExclusive)
+      .setInitialLayout(vk::ImageLayout::eUndefined);
+
+  vk::ResultValue<vk::UniqueImage> create_result =
+      device.VulkanHandle().createImageUnique(create_info);
+  VulkanCheckResult("vkCreateImage", create_result.result);
+  return std::move(create_result.value);
+}
+
+struct ImageMemory {
+  vk::UniqueDeviceMemory memory;
+  vk::DeviceSize size;
+  bool is_lazily_allocated;
+};
+
+[[nodiscard]] ImageMemory AllocateImageMemory(const VulkanDevice& device, vk::Image image,
+                                              vk::ImageUsageFlags usage) {
+  vk::Device logical_device = device.VulkanHandle();
+  vk::MemoryRequirements requirements = logical_device.getImageMemoryRequirements(image);
+
+  // Tile-based GPUs keep transient attachments in on-chip memory, and only
+  // commit lazily allocated memory if they run out.
+  std::optional<uint32_t> memory_type;
+  bool is_lazily_allocated = false;
+  if (usage & vk::ImageUsageFlagBits::eTransientAttachment) {
+    memory_type = device.FindMemoryType(requirements.memoryTypeBits,
+                                        vk::MemoryPropertyFlagBits::eLazilyAllocated);
+    is_lazily_allocated = memory_type.has_value();
+  }
+  if (!memory_type.has_value()) {
+    memory_type = device.FindMemoryType(requirements.memoryTypeBits,
+                                        vk::MemoryPropertyFlagBits::eDeviceLocal);
+  }
+  if (!memory_type.has_value()) {
+    std::cerr << "No device-local memory type for image" << std::endl;
+    std::abort();
+  }
+
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info
+      .setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(*memory_type);
+  vk::ResultValue<vk::UniqueDeviceMemory> allocate_result =
+      logical_device.allocateMemoryUnique(allocate_info);
+  VulkanCheckResult("vkAllocateMemory", allocate_result.result);
+
+  VulkanCheckResult("vkBindImageMemory",
+                    logical_device.bindImageMemory(image, allocate_result.value.get(), 0));
+  return {
+    .memory = std::move(allocate_result.value),
+    .size = requirements.size,
+    .is_lazily_allocated = is_lazily_allocated,
+  };
+}
+
+[[nodiscard]] vk::ImageAspectFlags AspectsFor(vk::Format format) {
+  switch (format) {
+    case vk::Format::eD16Unorm:
+    case vk::Format::eX8D24UnormPack32:
+    case vk::Format::eD32Sfloat:
+      return vk::ImageAspectFlagBits::eDepth;
+    case vk::Format::eS8Uint:
+      return vk::ImageAspectFlagBits::eStencil;
+    case vk::Format::eD16UnormS8Uint:
+    case vk::Format::eD24UnormS8Uint:
+    case vk::Format::eD32SfloatS8Uint:
+      return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+    default:
+      return vk::ImageAspectFlagBits::eColor;
+  }
+}
+
+[[nodiscard]] vk::UniqueImageView CreateImageView(const VulkanDevice& device, vk::Image image,
+                                                  vk::Format format) {
+  vk::ImageViewCreateInfo create_info;
+  create_info
+      .setImage(image)
+      .setViewType(vk::ImageViewType::e2D)
+      .setFormat(format)
+      .setSubresourceRange(vk::ImageSubresourceRange()
+          .setAspectMask(AspectsFor(format))
+          .setBaseMipLevel(0)
+          .setLevelCount(1)
+          .setBaseArrayLayer(0)
+          .setLayerCount(1));
+
+  vk::ResultValue<vk::UniqueImageView> create_result =
+      device.VulkanHandle().createImageViewUnique(create_info);
+  VulkanCheckResult("vkCreateImageView", create_result.result);
+  return std::move(create_result.value);
+}
+
+}  // namespace
+
+VulkanImage::VulkanImage(const VulkanDevice& device, vk::Extent2D extent, vk::Format format,
+                         vk::ImageUsageFlags usage)
+    : VulkanImage(device, extent, format, usage, vk::SampleCountFlagBits::e1) {}
+
+VulkanImage::VulkanImage(const VulkanDevice& device, vk::Extent2D extent, vk::Format format,
+                         vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples)
+    : extent_(extent),
+      format_(format),
+      usage_(usage),
+      samples_(samples),
+      image_(CreateImage(device, extent, format, usage, samples)) {
+  ImageMemory memory = AllocateImageMemory(device, image_.get(), usage);
+  memory_ = std::move(memory.memory);
+  memory_size_ = memory.size;
+  is_lazily_allocated_ = memory.is_lazily_allocated;
+  view_ = CreateImageView(device, image_.get(), format);
+}
+
+VulkanImage::VulkanImage(VulkanImage&&) noexcept = default;
+VulkanImage& VulkanImage::operator=(VulkanImage&&) noexcept = default;
+
+VulkanImage::~VulkanImage() = default;
+
+vk::DeviceSize VulkanImage::CommittedMemorySize() const {
+  assert(memory_);
+  if (!is_lazily_allocated_)
+    return memory_size_;
+  return memory_.getOwner().getMemoryCommitment(memory_.get());
+}
@@ -0,0 +1,65 @@
+#ifndef VULKAN_IMAGE_H_
+#define VULKAN_IMAGE_H_
+
+#include <cassert>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+class VulkanDevice;
+
+// 2D image with dedicated memory and a view covering the whole image.
+//
+// Used for offscreen render targets. Images with eTransientAttachment usage
+// are placed in lazily allocated memory, if the device has it.
+class VulkanImage {
+ public:
+  // The image is created with optimal tiling, and placed in device-local memory.
+  explicit VulkanImage(const VulkanDevice& device, vk::Extent2D extent, vk::Format format,
+                       vk::ImageUsageFlags usage);
+  // Depth and stencil formats get views of their depth and stencil aspects.
+  explicit VulkanImage(const VulkanDevice& device, vk::Extent2D extent, vk::Format format,
+                       vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples);
+
+  // Moving supported so instances can be stored in vectors.
+  VulkanImage(const VulkanImage&) = delete;
+  VulkanImage(VulkanImage&&) noexcept;
+  VulkanImage& operator=(const VulkanImage&) = delete;
+  VulkanImage& operator=(VulkanImage&&) noexcept;
+
+  ~VulkanImage();
+
+  [[nodiscard]] vk::Image VulkanHandle() const {
+    assert(image_);
+    return image_.get();
+  }
+  [[nodiscard]] vk::ImageView View() const {
+    assert(view_);
+    return view_.get();
+  }
+  [[nodiscard]] vk::Extent2D Extent() const { return extent_; }
+  [[nodiscard]] vk::Format Format() const { return format_; }
+  [[nodiscard]] vk::ImageUsageFlags Usage() const { return usage_; }
+  [[nodiscard]] vk::SampleCountFlagBits Samples() const { return samples_; }
+
+  // The size of the image's memory allocation.
+  [[nodiscard]] vk::DeviceSize MemorySize() const { return memory_size_; }
+  [[nodiscard]] bool IsLazilyAllocated() const { return is_lazily_allocated_; }
+  // The memory the driver actually committed, which is smaller than
+  // MemorySize() for lazily allocated images that stayed on-chip.
+  [[nodiscard]] vk::DeviceSize CommittedMemorySize() const;
+
+ private:
+  vk::Extent2D extent_;
+  vk::Format format_;
+  vk::ImageUsageFlags usage_;
+  vk::SampleCountFlagBits samples_;
+  vk::UniqueImage image_;
+  vk::UniqueDeviceMemory memory_;
+  vk::DeviceSize memory_size_;
+  bool is_lazily_allocated_;
+  vk::UniqueImageView view_;
+};
+
+#endif  // VULKAN_IMAGE_H_
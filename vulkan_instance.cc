@@ -0,0 +1,129 @@
+#include "vulkan_instance.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_config.h"
+#include "vulkan_errors.h"
+
+namespace {
+
+// Dispatches messages from the Vulkan validation layer to a VulkanInstance.
+VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugCallbackThunk(
+    VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+    VkDebugUtilsMessageTypeFlagsEXT message_type,
+    const VkDebugUtilsMessengerCallbackDataEXT* message_data,
+    void *user_data) {
+  assert(user_data);
+  VulkanInstance* instance = static_cast<VulkanInstance*>(user_data);
+
+  instance->OnVulkanDebugMessage(message_severity, message_type, message_data);
+  return VK_FALSE;
+}
+
+}  // namespace
+
+VulkanInstance::VulkanInstance(const VulkanConfig& vulkan_config, const char* application_name)
+    : vulkan_config_(vulkan_config) {
+  CreateVulkanInstance(application_name);
+  SetupVulkanDebugMessenger();
+}
+
+VulkanInstance::~VulkanInstance() {
+  TeardownVulkanDebugMessenger();
+}
+
+void VulkanInstance::OnVulkanDebugMessage(
+    VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+    VkDebugUtilsMessageTypeFlagsEXT message_type,
+    const VkDebugUtilsMessengerCallbackDataEXT* message_data) {
+  if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT ||
+      message_type != VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT) {
+    std::cerr << "Vulkan validation message: " << message_data->pMessage << std::endl;
+
+    if (message_severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
+      std::abort();
+  }
+}
+
+void VulkanInstance::CreateVulkanInstance(const char* application_name) {
+  vk::ApplicationInfo application_info;
+  application_info
+      .setPApplicationName(application_name)
+      .setApplicationVersion(VK_MAKE_VERSION(1, 0, 0))
+      .setPEngineName("No engine")
+      .setEngineVersion(VK_MAKE_VERSION(1, 0, 0))
+      .setApiVersion(VK_API_VERSION_1_2);
+
+  vk::StructureChain<vk::InstanceCreateInfo, vk::DebugUtilsMessengerCreateInfoEXT>
+      create_info_chain;
+  create_info_chain.get<vk::InstanceCreateInfo>()
+      .setFlags(vk::InstanceCreateFlagBits::eEnumeratePortabilityKHR)
+      .setPApplicationInfo(&application_info)
+      .setPEnabledLayerNames(vulkan_config_.RequiredLayers())
+      .setPEnabledExtensionNames(vulkan_config_.RequiredInstanceExtensions());
+
+  // This mildly duplicates SetupVulkanDebugMessenger().
+  if constexpr (VulkanConfig::WantValidation()) {
+    create_info_chain.get<vk::DebugUtilsMessengerCreateInfoEXT>()
+        .setMessageSeverity(vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning |
+                            vk::DebugUtilsMessageSeverityFlagBitsEXT::eError)
+        .setMessageType(vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation |
+                        vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance)
+        .setPfnUserCallback(&VulkanDebugCallbackThunk)
+        .setPUserData(static_cast<void*>(this));
+  } else {
+    create_info_chain.unlink<vk::DebugUtilsMessengerCreateInfoEXT>();
+  }
+
+  vk::ResultValue<vk::UniqueInstance> create_result =
+      vk::createInstanceUnique(create_info_chain.get());
+
+  VulkanCheckResult("vkCreateInstance", create_result.result);
+  instance_ = std::move(create_result.value);
+  dispatcher_.init(instance_.get(), vkGetInstanceProcAddr);
+}
+
+void VulkanInstance::SetupVulkanDebugMessenger() {
+  assert(instance_);
+
+  if constexpr (VulkanConfig::WantValidation()) {
+    // vkCreateDebugUtilsMessengerEXT() isn't available for static linking, so
+    // it's loaded by the instance dispatcher.
+    vk::DebugUtilsMessengerCreateInfoEXT create_info;
+    create_info
+        .setMessageSeverity(vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose |
+                            vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo |
+                            vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning |
+                            vk::DebugUtilsMessageSeverityFlagBitsEXT::eError)
+        .setMessageType(vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral |
+                        vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation |
+                        vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance)
+        .setPfnUserCallback(&VulkanDebugCallbackThunk)
+        .setPUserData(static_cast<void*>(this));
+    assert(dispatcher_.vkCreateDebugUtilsMessengerEXT);
+    vk::ResultValue<vk::DebugUtilsMessengerEXT> create_result =
+        instance_->createDebugUtilsMessengerEXT(create_info, /*allocator=*/nullptr, dispatcher_);
+    VulkanCheckResult("vkCreateDebugUtilsMessengerEXT", create_result.result);
+    debug_messenger_ = create_result.value;
+  }
+}
+
+void VulkanInstance::TeardownVulkanDebugMessenger() {
+  assert(instance_);
+
+  if constexpr (VulkanConfig::WantValidation()) {
+    assert(debug_messenger_);
+    instance_->destroyDebugUtilsMessengerEXT(debug_messenger_, /*allocator=*/nullptr,
+                                             dispatcher_);
+    debug_messenger_ = nullptr;
+  } else {
+    assert(!debug_messenger_);
+  }
+}
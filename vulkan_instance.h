@@ -0,0 +1,48 @@
+#ifndef VULKAN_INSTANCE_H_
+#define VULKAN_INSTANCE_H_
+
+#include <cassert>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class VulkanConfig;
+
+// Vulkan instance, plus the debug messenger used when validation is enabled.
+//
+// Validation warnings and errors terminate the program.
+class VulkanInstance {
+ public:
+  // `application_name` must point to a string that outlives the constructor call.
+  explicit VulkanInstance(const VulkanConfig& vulkan_config, const char* application_name);
+
+  // Moving is not supported because the debug messenger points to the instance.
+  VulkanInstance(const VulkanInstance&) = delete;
+  VulkanInstance& operator=(const VulkanInstance&) = delete;
+
+  ~VulkanInstance();
+
+  [[nodiscard]] vk::Instance VulkanHandle() const {
+    assert(instance_);
+    return instance_.get();
+  }
+
+  // Instance-level entry points, loaded once. Bypasses the loader trampolines.
+  [[nodiscard]] const vk::DispatchLoaderDynamic& Dispatcher() const { return dispatcher_; }
+
+  void OnVulkanDebugMessage(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+                            VkDebugUtilsMessageTypeFlagsEXT message_type,
+                            const VkDebugUtilsMessengerCallbackDataEXT* message_data);
+
+ private:
+  void CreateVulkanInstance(const char* application_name);
+  void SetupVulkanDebugMessenger();
+  void TeardownVulkanDebugMessenger();
+
+  const VulkanConfig& vulkan_config_;
+  vk::UniqueInstance instance_;
+  vk::DispatchLoaderDynamic dispatcher_;
+  vk::DebugUtilsMessengerEXT debug_messenger_;
+};
+
+#endif  // VULKAN_INSTANCE_H_
@@ -0,0 +1,151 @@
+#include "vulkan_multi_device_scheduler.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "task_pool.h"
+#include "vulkan_device.h"
+
+namespace {
+
+// Weight of the most recent job in a device's average job duration.
+//
+// Higher values adapt faster to changes in device load, at the cost of noisier
+// scheduling decisions.
+constexpr double kJobDurationSmoothing = 0.25;
+
+}  // namespace
+
+VulkanMultiDeviceScheduler::VulkanMultiDeviceScheduler(std::vector<VulkanDevice>& devices,
+                                                       ResultConsumer consumer)
+    : consumer_(std::move(consumer)) {
+  assert(!devices.empty());
+  assert(consumer_);
+
+  devices_.resize(devices.size());
+  for (size_t i = 0; i < devices.size(); ++i) {
+    devices_[i].device = &devices[i];
+    devices_[i].worker = std::make_unique<TaskPool>(1);
+  }
+}
+
+VulkanMultiDeviceScheduler::~VulkanMultiDeviceScheduler() {
+  WaitIdle();
+}
+
+uint64_t VulkanMultiDeviceScheduler::Submit(Job job) {
+  assert(job);
+
+  uint64_t job_id;
+  size_t device_index;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_id = next_job_id_;
+    ++next_job_id_;
+
+    device_index = PickDevice();
+    ++devices_[device_index].queued_job_count;
+  }
+
+  devices_[device_index].worker->Post([this, device_index, job_id, job = std::move(job)]() {
+    RunJob(device_index, job_id, job);
+  });
+  return job_id;
+}
+
+void VulkanMultiDeviceScheduler::WaitIdle() {
+  for (DeviceState& device_state : devices_)
+    device_state.worker->WaitIdle();
+}
+
+std::vector<VulkanMultiDeviceScheduler::DeviceStats> VulkanMultiDeviceScheduler::GetStats()
+    const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::vector<DeviceStats> stats;
+  stats.reserve(devices_.size());
+  for (const DeviceState& device_state : devices_) {
+    double jobs_per_second = 0;
+    if (device_state.busy_seconds > 0) {
+      jobs_per_second =
+          static_cast<double>(device_state.completed_job_count) / device_state.busy_seconds;
+    }
+
+    stats.push_back({
+      .name = device_state.device->Name(),
+      .completed_job_count = device_state.completed_job_count,
+      .average_job_seconds = device_state.average_job_seconds,
+      .jobs_per_second = jobs_per_second,
+    });
+  }
+  return stats;
+}
+
+size_t VulkanMultiDeviceScheduler::PickDevice() const {
+  // Idle devices without measurements get a job, so they can be measured.
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    if (devices_[i].completed_job_count == 0 && devices_[i].queued_job_count == 0)
+      return i;
+  }
+
+  // Busy devices without measurements are assumed to be as fast as the
+  // average measured device.
+  double measured_seconds_sum = 0;
+  int measured_device_count = 0;
+  for (const DeviceState& device_state : devices_) {
+    if (device_state.completed_job_count == 0)
+      continue;
+    measured_seconds_sum += device_state.average_job_seconds;
+    ++measured_device_count;
+  }
+  double unmeasured_job_seconds =
+      (measured_device_count == 0) ? 1.0 : measured_seconds_sum / measured_device_count;
+
+  size_t best_device_index = 0;
+  double best_finish_seconds = std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < devices_.size(); ++i) {
+    const DeviceState& device_state = devices_[i];
+    double job_seconds = (device_state.completed_job_count == 0)
+                             ? unmeasured_job_seconds
+                             : device_state.average_job_seconds;
+    double finish_seconds = (device_state.queued_job_count + 1) * job_seconds;
+    if (finish_seconds < best_finish_seconds) {
+      best_finish_seconds = finish_seconds;
+      best_device_index = i;
+    }
+  }
+  return best_device_index;
+}
+
+void VulkanMultiDeviceScheduler::RunJob(size_t device_index, uint64_t job_id, const Job& job) {
+  DeviceState& device_state = devices_[device_index];
+
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+  std::vector<uint8_t> result = job(device_index, *device_state.device);
+  std::chrono::duration<double> job_duration = std::chrono::steady_clock::now() - start_time;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(device_state.queued_job_count > 0);
+    --device_state.queued_job_count;
+
+    double job_seconds = job_duration.count();
+    if (device_state.completed_job_count == 0) {
+      device_state.average_job_seconds = job_seconds;
+    } else {
+      device_state.average_job_seconds +=
+          kJobDurationSmoothing * (job_seconds - device_state.average_job_seconds);
+    }
+    ++device_state.completed_job_count;
+    device_state.busy_seconds += job_seconds;
+  }
+
+  consumer_(job_id, device_index, std::move(result));
+}
@@ -0,0 +1,102 @@
+#ifndef VULKAN_MULTI_DEVICE_SCHEDULER_H_
+#define VULKAN_MULTI_DEVICE_SCHEDULER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "task_pool.h"
+
+class VulkanDevice;
+
+// Splits independent offscreen jobs across several logical devices.
+//
+// Each device has a dedicated worker thread, so a device's queues are only
+// used by one job at a time. Submit() sends each job to the device expected
+// to finish it first, based on the device's queue length and on the measured
+// durations of the jobs it completed. Devices that haven't completed a job yet
+// are tried out as soon as they are idle.
+//
+// Jobs return their results as host memory copies, so the results of jobs run
+// on different devices can be combined without sharing device memory.
+class VulkanMultiDeviceScheduler {
+ public:
+  // Runs on the worker thread of the device at `device_index`.
+  //
+  // The job must wait for its GPU work to complete before returning.
+  using Job = std::function<std::vector<uint8_t>(size_t device_index, VulkanDevice& device)>;
+
+  // Receives a job's result. Called on the worker thread that ran the job.
+  //
+  // Results may be delivered out of order.
+  using ResultConsumer =
+      std::function<void(uint64_t job_id, size_t device_index, std::vector<uint8_t> result)>;
+
+  struct DeviceStats {
+    std::string name;
+    uint64_t completed_job_count;
+    // Exponentially weighted moving average of the job durations.
+    double average_job_seconds;
+    // Completed jobs per second spent running jobs.
+    double jobs_per_second;
+  };
+
+  // `devices` must not be empty, and must outlive the scheduler.
+  explicit VulkanMultiDeviceScheduler(std::vector<VulkanDevice>& devices,
+                                      ResultConsumer consumer);
+
+  VulkanMultiDeviceScheduler(const VulkanMultiDeviceScheduler&) = delete;
+  VulkanMultiDeviceScheduler& operator=(const VulkanMultiDeviceScheduler&) = delete;
+
+  // Blocks until all the submitted jobs are delivered to the consumer.
+  ~VulkanMultiDeviceScheduler();
+
+  [[nodiscard]] size_t DeviceCount() const { return devices_.size(); }
+
+  // Queues up a job on the device expected to complete it first. Returns the job's ID.
+  uint64_t Submit(Job job);
+
+  // Blocks until all the submitted jobs are delivered to the consumer.
+  void WaitIdle();
+
+  // Indexed by device index.
+  [[nodiscard]] std::vector<DeviceStats> GetStats() const;
+
+ private:
+  struct DeviceState {
+    VulkanDevice* device = nullptr;
+
+    // Guarded by the scheduler's `mutex_`.
+    int queued_job_count = 0;
+    uint64_t completed_job_count = 0;
+    double average_job_seconds = 0;
+    double busy_seconds = 0;
+
+    // Must be the last member, so the worker is stopped before the state above
+    // is destroyed.
+    std::unique_ptr<TaskPool> worker;
+  };
+
+  // Returns the index of the device expected to complete a new job first.
+  //
+  // Must be called with `mutex_` held.
+  [[nodiscard]] size_t PickDevice() const;
+
+  // Runs on a device's worker thread.
+  void RunJob(size_t device_index, uint64_t job_id, const Job& job);
+
+  const ResultConsumer consumer_;
+
+  mutable std::mutex mutex_;
+
+  // Guarded by `mutex_`.
+  uint64_t next_job_id_ = 0;
+
+  std::vector<DeviceState> devices_;
+};
+
+#endif  // VULKAN_MULTI_DEVICE_SCHEDULER_H_
@@ -0,0 +1,143 @@
+#include "vulkan_object_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_hash.h"
+
+namespace {
+
+[[nodiscard]] size_t HashFloat(float value) {
+  return std::hash<float>()(value);
+}
+
+}  // namespace
+
+size_t VulkanSamplerKeyHash::operator()(const vk::SamplerCreateInfo& create_info) const {
+  size_t hash = static_cast<VkSamplerCreateFlags>(create_info.flags);
+  hash = HashCombine(hash, static_cast<size_t>(create_info.magFilter));
+  hash = HashCombine(hash, static_cast<size_t>(create_info.minFilter));
+  hash = HashCombine(hash, static_cast<size_t>(create_info.mipmapMode));
+  hash = HashCombine(hash, static_cast<size_t>(create_info.addressModeU));
+  hash = HashCombine(hash, static_cast<size_t>(create_info.addressModeV));
+  hash = HashCombine(hash, static_cast<size_t>(create_info.addressModeW));
+  hash = HashCombine(hash, HashFloat(create_info.mipLodBias));
+  hash = HashCombine(hash, create_info.anisotropyEnable);
+  hash = HashCombine(hash, HashFloat(create_info.maxAnisotropy));
+  hash = HashCombine(hash, create_info.compareEnable);
+  hash = HashCombine(hash, static_cast<size_t>(create_info.compareOp));
+  hash = HashCombine(hash, HashFloat(create_info.minLod));
+  hash = HashCombine(hash, HashFloat(create_info.maxLod));
+  hash = HashCombine(hash, static_cast<size_t>(create_info.borderColor));
+  hash = HashCombine(hash, create_info.unnormalizedCoordinates);
+  return hash;
+}
+
+size_t VulkanDescriptorSetLayoutKeyHash::operator()(
+    const VulkanDescriptorSetLayoutKey& key) const {
+  size_t hash = static_cast<VkDescriptorSetLayoutCreateFlags>(key.flags);
+  for (const vk::DescriptorSetLayoutBinding& binding : key.bindings) {
+    hash = HashCombine(hash, binding.binding);
+    hash = HashCombine(hash, static_cast<size_t>(binding.descriptorType));
+    hash = HashCombine(hash, binding.descriptorCount);
+    hash = HashCombine(hash, static_cast<VkShaderStageFlags>(binding.stageFlags));
+  }
+  return hash;
+}
+
+size_t VulkanPipelineLayoutKeyHash::operator()(const VulkanPipelineLayoutKey& key) const {
+  size_t hash = 0;
+  for (vk::DescriptorSetLayout set_layout : key.set_layouts)
+    hash = HashCombine(hash, HashHandle(set_layout));
+  for (const vk::PushConstantRange& range : key.push_constant_ranges) {
+    hash = HashCombine(hash, static_cast<VkShaderStageFlags>(range.stageFlags));
+    hash = HashCombine(hash, range.offset);
+    hash = HashCombine(hash, range.size);
+  }
+  return hash;
+}
+
+VulkanObjectCache::VulkanObjectCache(const VulkanDevice& device)
+    : device_(device.VulkanHandle()) {
+}
+
+VulkanObjectCache::~VulkanObjectCache() = default;
+
+vk::Sampler VulkanObjectCache::GetSampler(const vk::SamplerCreateInfo& create_info) {
+  assert(create_info.pNext == nullptr);
+
+  return samplers_.FindOrInsert(create_info, [this, &create_info]() {
+    vk::ResultValue<vk::UniqueSampler> create_result =
+        device_.createSamplerUnique(create_info);
+    VulkanCheckResult("vkCreateSampler", create_result.result);
+    return std::move(create_result.value);
+  }).get();
+}
+
+vk::DescriptorSetLayout VulkanObjectCache::GetDescriptorSetLayout(
+    VulkanDescriptorSetLayoutKey key) {
+  // Binding numbers are unique, so sorting by them gives a canonical order.
+  std::sort(key.bindings.begin(), key.bindings.end(),
+            [](const vk::DescriptorSetLayoutBinding& lhs,
+               const vk::DescriptorSetLayoutBinding& rhs) {
+              return lhs.binding < rhs.binding;
+            });
+  for (const vk::DescriptorSetLayoutBinding& binding : key.bindings)
+    assert(binding.pImmutableSamplers == nullptr);
+
+  return descriptor_set_layouts_.FindOrInsert(key, [this, &key]() {
+    vk::DescriptorSetLayoutCreateInfo create_info;
+    create_info
+        .setFlags(key.flags)
+        .setBindings(key.bindings);
+
+    vk::ResultValue<vk::UniqueDescriptorSetLayout> create_result =
+        device_.createDescriptorSetLayoutUnique(create_info);
+    VulkanCheckResult("vkCreateDescriptorSetLayout", create_result.result);
+    return std::move(create_result.value);
+  }).get();
+}
+
+vk::PipelineLayout VulkanObjectCache::GetPipelineLayout(VulkanPipelineLayoutKey key) {
+  // The order of push constant ranges doesn't matter. Set layouts are ordered
+  // by set number, so they're already canonical.
+  std::sort(key.push_constant_ranges.begin(), key.push_constant_ranges.end(),
+            [](const vk::PushConstantRange& lhs, const vk::PushConstantRange& rhs) {
+              return std::make_tuple(lhs.offset, lhs.size,
+                                     static_cast<VkShaderStageFlags>(lhs.stageFlags)) <
+                     std::make_tuple(rhs.offset, rhs.size,
+                                     static_cast<VkShaderStageFlags>(rhs.stageFlags));
+            });
+
+  return pipeline_layouts_.FindOrInsert(key, [this, &key]() {
+    vk::PipelineLayoutCreateInfo create_info;
+    create_info
+        .setSetLayouts(key.set_layouts)
+        .setPushConstantRanges(key.push_constant_ranges);
+
+    vk::ResultValue<vk::UniquePipelineLayout> create_result =
+        device_.createPipelineLayoutUnique(create_info);
+    VulkanCheckResult("vkCreatePipelineLayout", create_result.result);
+    return std::move(create_result.value);
+  }).get();
+}
+
+VulkanObjectCache::Stats VulkanObjectCache::GetStats() const {
+  return {
+    .sampler_count = samplers_.Size(),
+    .descriptor_set_layout_count = descriptor_set_layouts_.Size(),
+    .pipeline_layout_count = pipeline_layouts_.Size(),
+  };
+}
@@ -0,0 +1,102 @@
+#ifndef VULKAN_OBJECT_CACHE_H_
+#define VULKAN_OBJECT_CACHE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "intern_table.h"
+
+class VulkanDevice;
+
+// Immutable samplers are not supported, so `pImmutableSamplers` must be null.
+struct VulkanDescriptorSetLayoutKey {
+  vk::DescriptorSetLayoutCreateFlags flags;
+  std::vector<vk::DescriptorSetLayoutBinding> bindings;
+
+  [[nodiscard]] bool operator==(const VulkanDescriptorSetLayoutKey& other) const {
+    return flags == other.flags && bindings == other.bindings;
+  }
+  [[nodiscard]] bool operator!=(const VulkanDescriptorSetLayoutKey& other) const {
+    return !(*this == other);
+  }
+};
+
+// The set layouts usually come from a VulkanObjectCache, so equal handles
+// mean equal layouts.
+struct VulkanPipelineLayoutKey {
+  std::vector<vk::DescriptorSetLayout> set_layouts;
+  std::vector<vk::PushConstantRange> push_constant_ranges;
+
+  [[nodiscard]] bool operator==(const VulkanPipelineLayoutKey& other) const {
+    return set_layouts == other.set_layouts &&
+           push_constant_ranges == other.push_constant_ranges;
+  }
+  [[nodiscard]] bool operator!=(const VulkanPipelineLayoutKey& other) const {
+    return !(*this == other);
+  }
+};
+
+struct VulkanSamplerKeyHash {
+  [[nodiscard]] size_t operator()(const vk::SamplerCreateInfo& create_info) const;
+};
+
+struct VulkanDescriptorSetLayoutKeyHash {
+  [[nodiscard]] size_t operator()(const VulkanDescriptorSetLayoutKey& key) const;
+};
+
+struct VulkanPipelineLayoutKeyHash {
+  [[nodiscard]] size_t operator()(const VulkanPipelineLayoutKey& key) const;
+};
+
+// Creates one sampler, descriptor set layout or pipeline layout for each
+// distinct description.
+//
+// Descriptions are put in a canonical form before lookup, so descriptions
+// that only differ in the order of bindings or push constant ranges share a
+// handle. Sharing saves driver memory, and lets code compare layouts by
+// comparing handles.
+//
+// Thread-safe. Looking up an existing object doesn't take locks.
+class VulkanObjectCache {
+ public:
+  struct Stats {
+    size_t sampler_count;
+    size_t descriptor_set_layout_count;
+    size_t pipeline_layout_count;
+  };
+
+  explicit VulkanObjectCache(const VulkanDevice& device);
+
+  VulkanObjectCache(const VulkanObjectCache&) = delete;
+  VulkanObjectCache& operator=(const VulkanObjectCache&) = delete;
+
+  // The cached objects must not be used by pending commands.
+  ~VulkanObjectCache();
+
+  // `create_info` must not have extension structures.
+  //
+  // The returned objects remain valid until the cache is destroyed.
+  [[nodiscard]] vk::Sampler GetSampler(const vk::SamplerCreateInfo& create_info);
+  [[nodiscard]] vk::DescriptorSetLayout GetDescriptorSetLayout(
+      VulkanDescriptorSetLayoutKey key);
+  [[nodiscard]] vk::PipelineLayout GetPipelineLayout(VulkanPipelineLayoutKey key);
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  vk::Device device_;
+
+  // Pipeline layouts are declared last, so they are destroyed before the set
+  // layouts they use.
+  InternTable<vk::SamplerCreateInfo, vk::UniqueSampler, VulkanSamplerKeyHash> samplers_;
+  InternTable<VulkanDescriptorSetLayoutKey, vk::UniqueDescriptorSetLayout,
+              VulkanDescriptorSetLayoutKeyHash> descriptor_set_layouts_;
+  InternTable<VulkanPipelineLayoutKey, vk::UniquePipelineLayout, VulkanPipelineLayoutKeyHash>
+      pipeline_layouts_;
+};
+
+#endif  // VULKAN_OBJECT_CACHE_H_
@@ -26,15 +26,61 @@ namespace {
   return graphics_queue_family_indexes;
 }
 
+[[nodiscard]] vk::PhysicalDeviceVulkan12Features GetVulkan12Features(
+    vk::PhysicalDevice physical_device, uint32_t api_version) {
+  // The structure can only be chained on devices that support Vulkan 1.2.
+  if (api_version < VK_API_VERSION_1_2)
+    return vk::PhysicalDeviceVulkan12Features();
+
+  auto features_chain = physical_device.getFeatures2<
+      vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+  return features_chain.get<vk::PhysicalDeviceVulkan12Features>().setPNext(nullptr);
+}
+
+// True if the device can link pipelines from VK_EXT_graphics_pipeline_library parts.
+[[nodiscard]] bool GetGraphicsPipelineLibrarySupport(vk::PhysicalDevice physical_device,
+                                                     uint32_t api_version) {
+  // The feature can only be queried on devices that support Vulkan 1.1.
+  if (api_version < VK_API_VERSION_1_1)
+    return false;
+
+  VulkanExtensionList device_extensions(physical_device);
+  if (!device_extensions.Contains(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) ||
+      !device_extensions.Contains(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+    return false;
+  }
+
+  auto features_chain = physical_device.getFeatures2<
+      vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+  return features_chain.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>()
+             .graphicsPipelineLibrary == VK_TRUE;
+}
+
+// True if the device reports per-heap budgets via VK_EXT_memory_budget.
+[[nodiscard]] bool GetMemoryBudgetSupport(vk::PhysicalDevice physical_device,
+                                          uint32_t api_version) {
+  // The budget is queried with vkGetPhysicalDeviceMemoryProperties2(), which
+  // is core in Vulkan 1.1.
+  if (api_version < VK_API_VERSION_1_1)
+    return false;
+
+  VulkanExtensionList device_extensions(physical_device);
+  return device_extensions.Contains(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+}
+
 }  // namespace
 
 VulkanPhysicalDevice::VulkanPhysicalDevice(vk::PhysicalDevice physical_device_handle)
     : physical_device_(physical_device_handle),
       properties_(physical_device_.getProperties()),
       features_(physical_device_.getFeatures()),
+      vulkan12_features_(GetVulkan12Features(physical_device_, properties_.apiVersion)),
       memory_properties_(physical_device_.getMemoryProperties()),
       queue_families_(physical_device_.getQueueFamilyProperties()),
-      graphics_queue_family_indices_(GetGraphicsQueueFamilyIndexes(queue_families_)) {
+      graphics_queue_family_indices_(GetGraphicsQueueFamilyIndexes(queue_families_)),
+      supports_graphics_pipeline_library_(
+          GetGraphicsPipelineLibrarySupport(physical_device_, properties_.apiVersion)),
+      supports_memory_budget_(GetMemoryBudgetSupport(physical_device_, properties_.apiVersion)) {
   assert(physical_device_handle);
 }
 
@@ -50,7 +96,29 @@ void VulkanPhysicalDevice::Print() const {
 }
 
 bool VulkanPhysicalDevice::HasRequiredFeatures() const {
-  return features_.tessellationShader == VK_TRUE;
+  // Timeline semaphores are used to track GPU progress. Pipeline statistics
+  // are collected by VulkanQueryRing.
+  return features_.tessellationShader == VK_TRUE &&
+         features_.pipelineStatisticsQuery == VK_TRUE &&
+         vulkan12_features_.timelineSemaphore == VK_TRUE;
+}
+
+bool VulkanPhysicalDevice::HasRequiredComputeFeatures() const {
+  return vulkan12_features_.timelineSemaphore == VK_TRUE;
+}
+
+std::optional<uint32_t> VulkanPhysicalDevice::ComputeQueueFamilyIndex() const {
+  std::optional<uint32_t> shared_family_index;
+  for (uint32_t family_index = 0; family_index < queue_families_.size(); ++family_index) {
+    vk::QueueFlags flags = queue_families_[family_index].queueFlags;
+    if (!(flags & vk::QueueFlagBits::eCompute))
+      continue;
+    if (!(flags & vk::QueueFlagBits::eGraphics))
+      return family_index;
+    if (!shared_family_index.has_value())
+      shared_family_index = family_index;
+  }
+  return shared_family_index;
 }
 
 bool VulkanPhysicalDevice::HasLayers(const std::vector<const char*>& layer_names) const {
@@ -3,6 +3,8 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <set>
 #include <string_view>
 #include <vector>
@@ -32,18 +34,69 @@ class VulkanPhysicalDevice {
   void Print() const;
 
   [[nodiscard]] bool HasRequiredFeatures() const;
+  // The features needed by compute-only devices, which are a subset of the
+  // features checked by HasRequiredFeatures().
+  [[nodiscard]] bool HasRequiredComputeFeatures() const;
   [[nodiscard]] bool HasLayers(const std::vector<const char*>& layer_names) const;
   [[nodiscard]] bool HasExtension(std::string_view extension_name) const;
   [[nodiscard]] bool HasExtensions(const std::vector<const char*>& extension_names) const;
 
   [[nodiscard]] size_t QueueFamilyCount() const { return queue_families_.size(); }
 
+  // The number of queues that can be created in a queue family.
+  [[nodiscard]] uint32_t QueueCount(uint32_t queue_family_index) const {
+    assert(queue_family_index < queue_families_.size());
+    return queue_families_[queue_family_index].queueCount;
+  }
+
+  [[nodiscard]] const vk::PhysicalDeviceProperties& Properties() const { return properties_; }
+  [[nodiscard]] const vk::PhysicalDeviceMemoryProperties& MemoryProperties() const {
+    return memory_properties_;
+  }
+
   // The set is empty on devices that don't have any graphics command queues.
   [[nodiscard]] const std::set<uint32_t> GraphicsQueueFamilyIndices() const {
     assert(physical_device_);
     return graphics_queue_family_indices_;
   }
 
+  // The queue family used by compute-only devices.
+  //
+  // Families without graphics support are preferred, because they usually map
+  // to dedicated compute hardware queues. Returns nullopt if no family
+  // supports compute.
+  [[nodiscard]] std::optional<uint32_t> ComputeQueueFamilyIndex() const;
+
+  // True if VK_EXT_graphics_pipeline_library can be enabled on the device.
+  [[nodiscard]] bool SupportsGraphicsPipelineLibrary() const {
+    return supports_graphics_pipeline_library_;
+  }
+
+  // True if VK_EXT_memory_budget can be enabled on the device.
+  [[nodiscard]] bool SupportsMemoryBudget() const { return supports_memory_budget_; }
+
+  // True if occlusion queries can count the passing samples, instead of only
+  // reporting whether any sample passed.
+  [[nodiscard]] bool SupportsPreciseOcclusionQueries() const {
+    return features_.occlusionQueryPrecise == VK_TRUE;
+  }
+
+  // True if shaders can index arrays of sampled images with non-uniform
+  // indexes, and the arrays can be partially bound and updated after binding.
+  [[nodiscard]] bool SupportsBindlessTextures() const {
+    return vulkan12_features_.runtimeDescriptorArray == VK_TRUE &&
+           vulkan12_features_.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+           vulkan12_features_.descriptorBindingPartiallyBound == VK_TRUE &&
+           vulkan12_features_.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE;
+  }
+
+  // The number of meaningful bits in the family's timestamps. Zero if the
+  // family doesn't support timestamps.
+  [[nodiscard]] uint32_t TimestampValidBits(uint32_t family_index) const {
+    assert(family_index < queue_families_.size());
+    return queue_families_[family_index].timestampValidBits;
+  }
+
   [[nodiscard]] vk::PhysicalDevice VulkanHandle() const {
     assert(physical_device_);
     return physical_device_;
@@ -53,10 +106,14 @@ class VulkanPhysicalDevice {
   vk::PhysicalDevice physical_device_;
   vk::PhysicalDeviceProperties properties_;
   vk::PhysicalDeviceFeatures features_;
+  // Zeroed out on devices that don't support Vulkan 1.2.
+  vk::PhysicalDeviceVulkan12Features vulkan12_features_;
   vk::PhysicalDeviceMemoryProperties memory_properties_;
   std::vector<vk::QueueFamilyProperties> queue_families_;
 
   std::set<uint32_t> graphics_queue_family_indices_;
+  bool supports_graphics_pipeline_library_;
+  bool supports_memory_budget_;
 };
 
 #endif  // VULKAN_PHYSICAL_DEVICE_H_
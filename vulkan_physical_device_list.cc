@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <string_view>
 #include <vector>
@@ -9,6 +11,7 @@
 #include <vulkan/vulkan.hpp>
 
 #include "vulkan_config.h"
+#include "vulkan_config_profile.h"
 #include "vulkan_device.h"
 #include "vulkan_errors.h"
 #include "vulkan_presentation_context.h"
@@ -31,10 +34,34 @@ namespace {
   return devices;
 }
 
+// True if a logical device for offscreen rendering can be created on the device.
+[[nodiscard]] bool IsSuitableForOffscreen(const VulkanConfig& vulkan_config,
+                                          const VulkanPhysicalDevice& physical_device) {
+  if (!physical_device.HasRequiredFeatures())
+    return false;
+  if (!physical_device.HasLayers(vulkan_config.RequiredLayers()))
+    return false;
+  if (!physical_device.HasExtensions(vulkan_config.RequiredDeviceExtensions()))
+    return false;
+  return !physical_device.GraphicsQueueFamilyIndices().empty();
+}
+
+// True if a compute-only logical device can be created on the device.
+[[nodiscard]] bool IsSuitableForCompute(const VulkanConfig& vulkan_config,
+                                        const VulkanPhysicalDevice& physical_device) {
+  if (!physical_device.HasRequiredComputeFeatures())
+    return false;
+  if (!physical_device.HasLayers(vulkan_config.RequiredLayers()))
+    return false;
+  if (!physical_device.HasExtensions(vulkan_config.RequiredDeviceExtensions()))
+    return false;
+  return physical_device.ComputeQueueFamilyIndex().has_value();
+}
+
 }  // namespace
 
 VulkanPhysicalDeviceList::VulkanPhysicalDeviceList(vk::Instance instance) :
-  devices_(CreateVulkanPhysicalDevices(instance)) {}
+  instance_(instance), devices_(CreateVulkanPhysicalDevices(instance)) {}
 
 VulkanPhysicalDeviceList::~VulkanPhysicalDeviceList() = default;
 
@@ -48,26 +75,100 @@ void VulkanPhysicalDeviceList::Print() const {
 
 VulkanDevice VulkanPhysicalDeviceList::CreateLogicalDevice(
     const VulkanConfig& vulkan_config, const VulkanPresentationSurface& surface) {
-  const std::vector<const char*>& required_layers = vulkan_config.RequiredLayers();
-  const std::vector<const char*>& required_extensions = vulkan_config.RequiredDeviceExtensions();
+  return CreateLogicalDevice(vulkan_config,
+                             std::vector<const VulkanPresentationSurface*>{&surface});
+}
+
+VulkanDevice VulkanPhysicalDeviceList::CreateLogicalDevice(
+    const VulkanConfig& vulkan_config,
+    const std::vector<const VulkanPresentationSurface*>& surfaces) {
+  // Headless builds don't link the windowing system sources that create
+  // surfaces.
+  if constexpr (!VulkanConfig::WantPresentation()) {
+    std::cerr << "The " << VulkanActiveProfile::kName
+              << " config profile doesn't support presentation" << std::endl;
+    std::abort();
+  } else {
+    assert(!surfaces.empty());
+
+    const std::vector<const char*>& required_layers = vulkan_config.RequiredLayers();
+    const std::vector<const char*>& required_extensions =
+        vulkan_config.RequiredDeviceExtensions();
+
+    for (VulkanPhysicalDevice& physical_device : devices_) {
+      if (!physical_device.HasRequiredFeatures())
+        continue;
+      if (!physical_device.HasLayers(required_layers))
+        continue;
+      if (!physical_device.HasExtensions(required_extensions))
+        continue;
+      if (physical_device.GraphicsQueueFamilyIndices().empty())
+        continue;
+
+      // The queues are chosen based on the first surface.
+      VulkanSurfaceSupport surface_support(physical_device, surfaces[0]->VulkanHandle());
+      if (!surface_support.IsAcceptable())
+        continue;
+
+      uint32_t presentation_queue_family_index =
+          surface_support.QueueFamilyIndexes().presentation_queue_family_index;
+      bool supports_all_surfaces = std::all_of(
+          surfaces.begin() + 1, surfaces.end(),
+          [&](const VulkanPresentationSurface* surface) {
+            VulkanSurfaceSupport other_surface_support(physical_device, surface->VulkanHandle());
+            return other_surface_support.IsAcceptable() &&
+                   other_surface_support.CanPresentFrom(presentation_queue_family_index);
+          });
+      if (!supports_all_surfaces)
+        continue;
+
+      return VulkanDevice(instance_, vulkan_config, surface_support, physical_device);
+    }
+  }
 
+  std::cerr << "No suitable Vulkan device attached" << std::endl;
+  std::abort();
+}
+
+VulkanDevice VulkanPhysicalDeviceList::CreateOffscreenDevice(const VulkanConfig& vulkan_config) {
   for (VulkanPhysicalDevice& physical_device : devices_) {
-    if (!physical_device.HasRequiredFeatures())
-      continue;
-    if (!physical_device.HasLayers(required_layers))
-      continue;
-    if (!physical_device.HasExtensions(required_extensions))
+    if (!IsSuitableForOffscreen(vulkan_config, physical_device))
       continue;
-    if (physical_device.GraphicsQueueFamilyIndices().empty())
+
+    uint32_t graphics_queue_family_index = *physical_device.GraphicsQueueFamilyIndices().begin();
+    return VulkanDevice(instance_, vulkan_config, graphics_queue_family_index,
+                        physical_device);
+  }
+
+  std::cerr << "No suitable Vulkan device attached" << std::endl;
+  std::abort();
+}
+
+std::vector<VulkanDevice> VulkanPhysicalDeviceList::CreateOffscreenDevices(
+    const VulkanConfig& vulkan_config) {
+  std::vector<VulkanDevice> devices;
+  for (VulkanPhysicalDevice& physical_device : devices_) {
+    if (!IsSuitableForOffscreen(vulkan_config, physical_device))
       continue;
 
-    VulkanSurfaceSupport surface_support(physical_device, surface.VulkanHandle());
-    if (!surface_support.IsAcceptable())
+    uint32_t graphics_queue_family_index = *physical_device.GraphicsQueueFamilyIndices().begin();
+    devices.emplace_back(instance_, vulkan_config, graphics_queue_family_index,
+                         physical_device);
+  }
+  return devices;
+}
+
+VulkanDevice VulkanPhysicalDeviceList::CreateComputeDevice(const VulkanConfig& vulkan_config) {
+  for (VulkanPhysicalDevice& physical_device : devices_) {
+    if (!IsSuitableForCompute(vulkan_config, physical_device))
       continue;
 
-    return VulkanDevice(vulkan_config, surface_support, surface, physical_device);
+    VulkanDevice::ComputeQueueFamily compute_queue_family = {
+      .index = *physical_device.ComputeQueueFamilyIndex(),
+    };
+    return VulkanDevice(instance_, vulkan_config, compute_queue_family, physical_device);
   }
 
-  std::cerr << "No suitable Vulkan device attached" << std::endl;
+  std::cerr << "No Vulkan device with compute support attached" << std::endl;
   std::abort();
 }
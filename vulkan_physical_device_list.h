@@ -25,7 +25,30 @@ class VulkanPhysicalDeviceList {
   VulkanDevice CreateLogicalDevice(const VulkanConfig& vulkan_config,
                                    const VulkanPresentationSurface& surface);
 
+  // Finds a physical device that can present to all the given surfaces.
+  //
+  // The logical device uses the same presentation queue for all surfaces.
+  // Aborts if VulkanConfig::WantPresentation() is false.
+  VulkanDevice CreateLogicalDevice(
+      const VulkanConfig& vulkan_config,
+      const std::vector<const VulkanPresentationSurface*>& surfaces);
+
+  // Finds a suitable physical device and creates a logical device for offscreen rendering.
+  VulkanDevice CreateOffscreenDevice(const VulkanConfig& vulkan_config);
+
+  // Creates a logical device for offscreen rendering on every suitable physical device.
+  //
+  // Returns an empty vector if no physical device is suitable.
+  std::vector<VulkanDevice> CreateOffscreenDevices(const VulkanConfig& vulkan_config);
+
+  // Finds a physical device that can run compute work, and creates a
+  // compute-only logical device on it.
+  //
+  // `vulkan_config` must not require presentation extensions.
+  VulkanDevice CreateComputeDevice(const VulkanConfig& vulkan_config);
+
  private:
+  vk::Instance instance_;
   std::vector<VulkanPhysicalDevice> devices_;
 };
 
@@ -0,0 +1,441 @@
+#include "vulkan_pipeline_manager.h"
+
+#include <array>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "task_pool.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_hash.h"
+
+namespace {
+
+// The pipeline state that goes into a VK_EXT_graphics_pipeline_library part.
+//
+// The other members are reset to their default values, so states that only
+// differ in other parts map to the same library.
+[[nodiscard]] VulkanPipelineState LibraryKey(const VulkanPipelineState& state,
+                                             vk::GraphicsPipelineLibraryFlagBitsEXT part) {
+  VulkanPipelineState key;
+  switch (part) {
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface:
+      key.vertex_bindings = state.vertex_bindings;
+      key.vertex_attributes = state.vertex_attributes;
+      key.topology = state.topology;
+      return key;
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders:
+      key.vertex_shader = state.vertex_shader;
+      key.polygon_mode = state.polygon_mode;
+      key.cull_mode = state.cull_mode;
+      key.front_face = state.front_face;
+      break;
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader:
+      key.fragment_shader = state.fragment_shader;
+      key.samples = state.samples;
+      break;
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface:
+      key.samples = state.samples;
+      key.color_attachment_count = state.color_attachment_count;
+      key.blend_enabled = state.blend_enabled;
+      key.render_pass = state.render_pass;
+      key.subpass = state.subpass;
+      return key;
+  }
+
+  // The shader parts also depend on the layout and the render pass.
+  key.layout = state.layout;
+  key.render_pass = state.render_pass;
+  key.subpass = state.subpass;
+  return key;
+}
+
+// The create info structures for all of a pipeline's state.
+//
+// Not copyable, because the structures point to each other.
+class PipelineCreateInfos {
+ public:
+  explicit PipelineCreateInfos(const VulkanPipelineState& state) {
+    vertex_input
+        .setVertexBindingDescriptions(state.vertex_bindings)
+        .setVertexAttributeDescriptions(state.vertex_attributes);
+    input_assembly
+        .setTopology(state.topology)
+        .setPrimitiveRestartEnable(false);
+
+    vertex_stage
+        .setStage(vk::ShaderStageFlagBits::eVertex)
+        .setModule(state.vertex_shader)
+        .setPName("main");
+    fragment_stage
+        .setStage(vk::ShaderStageFlagBits::eFragment)
+        .setModule(state.fragment_shader)
+        .setPName("main");
+
+    // The viewport and scissor are dynamic state.
+    viewport
+        .setViewportCount(1)
+        .setScissorCount(1);
+    rasterization
+        .setDepthClampEnable(false)
+        .setRasterizerDiscardEnable(false)
+        .setPolygonMode(state.polygon_mode)
+        .setCullMode(state.cull_mode)
+        .setFrontFace(state.front_face)
+        .setDepthBiasEnable(false)
+        .setLineWidth(1.0f);
+    multisample
+        .setRasterizationSamples(state.samples)
+        .setSampleShadingEnable(false);
+
+    vk::PipelineColorBlendAttachmentState blend_attachment;
+    blend_attachment
+        .setBlendEnable(state.blend_enabled)
+        .setSrcColorBlendFactor(vk::BlendFactor::eSrcAlpha)
+        .setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha)
+        .setColorBlendOp(vk::BlendOp::eAdd)
+        .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
+        .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
+        .setAlphaBlendOp(vk::BlendOp::eAdd)
+        .setColorWriteMask(
+            vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+    blend_attachments.assign(state.color_attachment_count, blend_attachment);
+    color_blend
+        .setLogicOpEnable(false)
+        .setAttachments(blend_attachments);
+
+    dynamic.setDynamicStates(kDynamicStates);
+  }
+
+  PipelineCreateInfos(const PipelineCreateInfos&) = delete;
+  PipelineCreateInfos& operator=(const PipelineCreateInfos&) = delete;
+
+  static constexpr std::array<vk::DynamicState, 2> kDynamicStates = {
+    vk::DynamicState::eViewport, vk::DynamicState::eScissor,
+  };
+
+  vk::PipelineVertexInputStateCreateInfo vertex_input;
+  vk::PipelineInputAssemblyStateCreateInfo input_assembly;
+  vk::PipelineShaderStageCreateInfo vertex_stage;
+  vk::PipelineShaderStageCreateInfo fragment_stage;
+  vk::PipelineViewportStateCreateInfo viewport;
+  vk::PipelineRasterizationStateCreateInfo rasterization;
+  vk::PipelineMultisampleStateCreateInfo multisample;
+  std::vector<vk::PipelineColorBlendAttachmentState> blend_attachments;
+  vk::PipelineColorBlendStateCreateInfo color_blend;
+  vk::PipelineDynamicStateCreateInfo dynamic;
+};
+
+[[nodiscard]] vk::UniquePipeline CreatePipeline(vk::Device device,
+                                                vk::PipelineCache pipeline_cache,
+                                                const vk::GraphicsPipelineCreateInfo& create_info) {
+  vk::ResultValue<vk::UniquePipeline> create_result =
+      device.createGraphicsPipelineUnique(pipeline_cache, create_info);
+  VulkanCheckResult("vkCreateGraphicsPipelines", create_result.result);
+  return std::move(create_result.value);
+}
+
+// Indexed by the manager's part indexes, in linking order.
+constexpr std::array<vk::GraphicsPipelineLibraryFlagBitsEXT, 4> kLibraryParts = {
+  vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface,
+  vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders,
+  vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader,
+  vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface,
+};
+
+// Builds a pipeline library from `key`, which only has `part`'s subset of the
+// pipeline state.
+[[nodiscard]] vk::UniquePipeline CreateLibrary(vk::Device device,
+                                               vk::PipelineCache pipeline_cache,
+                                               const VulkanPipelineState& key,
+                                               vk::GraphicsPipelineLibraryFlagBitsEXT part) {
+  PipelineCreateInfos infos(key);
+
+  vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::GraphicsPipelineLibraryCreateInfoEXT>
+      create_info_chain;
+  create_info_chain.get<vk::GraphicsPipelineLibraryCreateInfoEXT>().setFlags(part);
+  vk::GraphicsPipelineCreateInfo& create_info =
+      create_info_chain.get<vk::GraphicsPipelineCreateInfo>();
+  create_info.setFlags(vk::PipelineCreateFlagBits::eLibraryKHR);
+
+  switch (part) {
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface:
+      create_info
+          .setPVertexInputState(&infos.vertex_input)
+          .setPInputAssemblyState(&infos.input_assembly);
+      break;
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders:
+      create_info
+          .setStageCount(1)
+          .setPStages(&infos.vertex_stage)
+          .setPViewportState(&infos.viewport)
+          .setPRasterizationState(&infos.rasterization)
+          .setPDynamicState(&infos.dynamic)
+          .setLayout(key.layout)
+          .setRenderPass(key.render_pass)
+          .setSubpass(key.subpass);
+      break;
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader:
+      create_info
+          .setStageCount(1)
+          .setPStages(&infos.fragment_stage)
+          .setPMultisampleState(&infos.multisample)
+          .setLayout(key.layout)
+          .setRenderPass(key.render_pass)
+          .setSubpass(key.subpass);
+      break;
+    case vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface:
+      create_info
+          .setPMultisampleState(&infos.multisample)
+          .setPColorBlendState(&infos.color_blend)
+          .setRenderPass(key.render_pass)
+          .setSubpass(key.subpass);
+      break;
+  }
+  return CreatePipeline(device, pipeline_cache, create_info);
+}
+
+[[nodiscard]] vk::UniquePipelineCache CreatePipelineCache(vk::Device device) {
+  vk::ResultValue<vk::UniquePipelineCache> create_result =
+      device.createPipelineCacheUnique(vk::PipelineCacheCreateInfo());
+  VulkanCheckResult("vkCreatePipelineCache", create_result.result);
+  return std::move(create_result.value);
+}
+
+}  // namespace
+
+bool VulkanPipelineState::operator==(const VulkanPipelineState& other) const {
+  return vertex_bindings == other.vertex_bindings &&
+         vertex_attributes == other.vertex_attributes && topology == other.topology &&
+         vertex_shader == other.vertex_shader && polygon_mode == other.polygon_mode &&
+         cull_mode == other.cull_mode && front_face == other.front_face &&
+         fragment_shader == other.fragment_shader && samples == other.samples &&
+         color_attachment_count == other.color_attachment_count &&
+         blend_enabled == other.blend_enabled && layout == other.layout &&
+         render_pass == other.render_pass && subpass == other.subpass;
+}
+
+size_t VulkanPipelineStateHash::operator()(const VulkanPipelineState& state) const {
+  size_t hash = 0;
+  for (const vk::VertexInputBindingDescription& binding : state.vertex_bindings) {
+    hash = HashCombine(hash, binding.binding);
+    hash = HashCombine(hash, binding.stride);
+    hash = HashCombine(hash, static_cast<size_t>(binding.inputRate));
+  }
+  for (const vk::VertexInputAttributeDescription& attribute : state.vertex_attributes) {
+    hash = HashCombine(hash, attribute.location);
+    hash = HashCombine(hash, attribute.binding);
+    hash = HashCombine(hash, static_cast<size_t>(attribute.format));
+    hash = HashCombine(hash, attribute.offset);
+  }
+  hash = HashCombine(hash, static_cast<size_t>(state.topology));
+  hash = HashCombine(hash, HashHandle(state.vertex_shader));
+  hash = HashCombine(hash, static_cast<size_t>(state.polygon_mode));
+  hash = HashCombine(hash, static_cast<VkCullModeFlags>(state.cull_mode));
+  hash = HashCombine(hash, static_cast<size_t>(state.front_face));
+  hash = HashCombine(hash, HashHandle(state.fragment_shader));
+  hash = HashCombine(hash, static_cast<size_t>(state.samples));
+  hash = HashCombine(hash, state.color_attachment_count);
+  hash = HashCombine(hash, state.blend_enabled);
+  hash = HashCombine(hash, HashHandle(state.layout));
+  hash = HashCombine(hash, HashHandle(state.render_pass));
+  hash = HashCombine(hash, state.subpass);
+  return hash;
+}
+
+VulkanPipelineManager::VulkanPipelineManager(const VulkanDevice& device, int worker_count)
+    : device_(device.VulkanHandle()),
+      use_pipeline_libraries_(device.HasGraphicsPipelineLibrary()),
+      pipeline_cache_(CreatePipelineCache(device_)),
+      library_task_pool_(std::make_unique<TaskPool>(worker_count)),
+      task_pool_(std::make_unique<TaskPool>(worker_count)) {
+  static_assert(kLibraryParts.size() == kLibraryPartCount);
+}
+
+VulkanPipelineManager::~VulkanPipelineManager() = default;
+
+vk::Pipeline VulkanPipelineManager::GetPipeline(const VulkanPipelineState& state) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  Entry& entry = FindOrQueueEntry(state);
+
+  // Waits for the optimized pipeline, or for the parts of the fast-linked
+  // pipeline, whichever is built first.
+  bool stalled = false;
+  while (!entry.optimized_pipeline && !entry.fast_linked_pipeline) {
+    if (use_pipeline_libraries_ && !entry.is_linking && AreLibrariesBuilt(entry)) {
+      LinkPipeline(lock, state, entry);
+      break;
+    }
+    stalled = true;
+    pipeline_built_.wait(lock);
+  }
+  if (stalled)
+    ++stall_count_;
+
+  if (entry.optimized_pipeline) {
+    ++optimized_hit_count_;
+    return entry.optimized_pipeline.get();
+  }
+  ++fast_linked_hit_count_;
+  return entry.fast_linked_pipeline.get();
+}
+
+void VulkanPipelineManager::Prefetch(const VulkanPipelineState& state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ignore = FindOrQueueEntry(state);
+}
+
+void VulkanPipelineManager::WaitIdle() {
+  library_task_pool_->WaitIdle();
+  task_pool_->WaitIdle();
+}
+
+VulkanPipelineManager::Stats VulkanPipelineManager::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return {
+    .optimized_hit_count = optimized_hit_count_,
+    .fast_linked_hit_count = fast_linked_hit_count_,
+    .stall_count = stall_count_,
+    .optimized_pipeline_count = optimized_pipeline_count_,
+    .fast_linked_pipeline_count = fast_linked_pipeline_count_,
+    .library_count = library_count_,
+  };
+}
+
+VulkanPipelineManager::Entry& VulkanPipelineManager::FindOrQueueEntry(
+    const VulkanPipelineState& state) {
+  assert(state.vertex_shader);
+  assert(state.fragment_shader);
+  assert(state.layout);
+  assert(state.render_pass);
+
+  auto [it, inserted] = entries_.try_emplace(state);
+  Entry& entry = it->second;
+  if (!inserted)
+    return entry;
+
+  if (use_pipeline_libraries_) {
+    for (size_t part_index = 0; part_index < kLibraryPartCount; ++part_index)
+      entry.libraries[part_index] = &FindOrQueueLibrary(state, part_index);
+  }
+
+  const VulkanPipelineState* entry_state = &it->first;
+  Entry* entry_pointer = &entry;
+  task_pool_->Post([this, entry_state, entry_pointer]() {
+    BuildOptimizedPipeline(*entry_state, *entry_pointer);
+  });
+  return entry;
+}
+
+const VulkanPipelineManager::Library& VulkanPipelineManager::FindOrQueueLibrary(
+    const VulkanPipelineState& state, size_t part_index) {
+  assert(part_index < kLibraryPartCount);
+
+  auto [it, inserted] =
+      libraries_[part_index].try_emplace(LibraryKey(state, kLibraryParts[part_index]));
+  if (inserted) {
+    const VulkanPipelineState* key = &it->first;
+    Library* library = &it->second;
+    library_task_pool_->Post([this, key, part_index, library]() {
+      BuildLibrary(*key, part_index, *library);
+    });
+  }
+  return it->second;
+}
+
+void VulkanPipelineManager::BuildOptimizedPipeline(const VulkanPipelineState& state,
+                                                   Entry& entry) {
+  // A monolithic pipeline gets the same optimizations as a pipeline linked
+  // with VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT, and doesn't wait
+  // for the libraries.
+  PipelineCreateInfos infos(state);
+  const std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+    infos.vertex_stage, infos.fragment_stage,
+  };
+
+  vk::GraphicsPipelineCreateInfo create_info;
+  create_info
+      .setStages(stages)
+      .setPVertexInputState(&infos.vertex_input)
+      .setPInputAssemblyState(&infos.input_assembly)
+      .setPViewportState(&infos.viewport)
+      .setPRasterizationState(&infos.rasterization)
+      .setPMultisampleState(&infos.multisample)
+      .setPColorBlendState(&infos.color_blend)
+      .setPDynamicState(&infos.dynamic)
+      .setLayout(state.layout)
+      .setRenderPass(state.render_pass)
+      .setSubpass(state.subpass);
+  vk::UniquePipeline pipeline = CreatePipeline(device_, pipeline_cache_.get(), create_info);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry.optimized_pipeline = std::move(pipeline);
+    ++optimized_pipeline_count_;
+  }
+  pipeline_built_.notify_all();
+}
+
+void VulkanPipelineManager::BuildLibrary(const VulkanPipelineState& key, size_t part_index,
+                                         Library& library) {
+  vk::UniquePipeline pipeline =
+      CreateLibrary(device_, pipeline_cache_.get(), key, kLibraryParts[part_index]);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    library.pipeline = std::move(pipeline);
+    ++library_count_;
+  }
+  pipeline_built_.notify_all();
+}
+
+bool VulkanPipelineManager::AreLibrariesBuilt(const Entry& entry) const {
+  for (const Library* library : entry.libraries) {
+    assert(library != nullptr);
+    if (!library->pipeline)
+      return false;
+  }
+  return true;
+}
+
+void VulkanPipelineManager::LinkPipeline(std::unique_lock<std::mutex>& lock,
+                                         const VulkanPipelineState& state, Entry& entry) {
+  assert(use_pipeline_libraries_);
+  assert(lock.owns_lock());
+  assert(!entry.is_linking);
+
+  std::array<vk::Pipeline, kLibraryPartCount> libraries;
+  for (size_t part_index = 0; part_index < kLibraryPartCount; ++part_index)
+    libraries[part_index] = entry.libraries[part_index]->pipeline.get();
+
+  // Other callers wait for the link instead of starting their own.
+  entry.is_linking = true;
+  lock.unlock();
+
+  // Linking without VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT is fast.
+  vk::StructureChain<vk::GraphicsPipelineCreateInfo, vk::PipelineLibraryCreateInfoKHR>
+      create_info_chain;
+  create_info_chain.get<vk::PipelineLibraryCreateInfoKHR>().setLibraries(libraries);
+  create_info_chain.get<vk::GraphicsPipelineCreateInfo>().setLayout(state.layout);
+  vk::UniquePipeline pipeline = CreatePipeline(
+      device_, pipeline_cache_.get(), create_info_chain.get<vk::GraphicsPipelineCreateInfo>());
+
+  lock.lock();
+  entry.fast_linked_pipeline = std::move(pipeline);
+  entry.is_linking = false;
+  ++fast_linked_pipeline_count_;
+  pipeline_built_.notify_all();
+}
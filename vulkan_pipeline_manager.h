@@ -0,0 +1,197 @@
+#ifndef VULKAN_PIPELINE_MANAGER_H_
+#define VULKAN_PIPELINE_MANAGER_H_
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "task_pool.h"
+
+class VulkanDevice;
+
+// The state that determines a graphics pipeline.
+//
+// Viewports and scissors are always dynamic state, so pipelines don't depend
+// on the framebuffer size. Depth and stencil tests are not supported yet. The
+// handles are owned by the caller, and must outlive the VulkanPipelineManager
+// that uses them.
+struct VulkanPipelineState {
+  // Vertex input interface.
+  std::vector<vk::VertexInputBindingDescription> vertex_bindings;
+  std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
+  vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+
+  // Pre-rasterization shaders.
+  vk::ShaderModule vertex_shader;
+  vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+  vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eNone;
+  vk::FrontFace front_face = vk::FrontFace::eClockwise;
+
+  // Fragment shader.
+  vk::ShaderModule fragment_shader;
+  vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+
+  // Fragment output interface. All the subpass' color attachments share the
+  // same blending state.
+  uint32_t color_attachment_count = 1;
+  bool blend_enabled = false;
+
+  vk::PipelineLayout layout;
+  vk::RenderPass render_pass;
+  uint32_t subpass = 0;
+
+  [[nodiscard]] bool operator==(const VulkanPipelineState& other) const;
+  [[nodiscard]] bool operator!=(const VulkanPipelineState& other) const {
+    return !(*this == other);
+  }
+};
+
+struct VulkanPipelineStateHash {
+  [[nodiscard]] size_t operator()(const VulkanPipelineState& state) const;
+};
+
+// Creates graphics pipelines without stalling the render loop.
+//
+// Pipelines are deduplicated by their state. The first Prefetch() or
+// GetPipeline() call for a state queues up an optimized pipeline build on a
+// worker thread. Until the build completes, GetPipeline() returns a pipeline
+// linked from VK_EXT_graphics_pipeline_library parts. The parts are also built
+// on worker threads, and are shared by all the pipelines whose states match
+// the parts' subset of the state. Linking pre-built parts takes a fraction of
+// the time needed to build a pipeline.
+//
+// GetPipeline() waits if the parts are still building. On devices without
+// pipeline libraries, it waits for the optimized pipeline instead. Prefetch()
+// starts the builds before the pipelines are needed, to avoid the waits.
+class VulkanPipelineManager {
+ public:
+  struct Stats {
+    // GetPipeline() calls that returned an optimized pipeline.
+    uint64_t optimized_hit_count;
+    // GetPipeline() calls that returned a fast-linked pipeline.
+    uint64_t fast_linked_hit_count;
+    // GetPipeline() calls that waited for a pipeline or library build.
+    uint64_t stall_count;
+    uint64_t optimized_pipeline_count;
+    uint64_t fast_linked_pipeline_count;
+    uint64_t library_count;
+  };
+
+  // `worker_count` must be positive.
+  //
+  // Library parts are built on their own `worker_count` threads, so they
+  // don't wait behind the slower optimized builds.
+  explicit VulkanPipelineManager(const VulkanDevice& device, int worker_count);
+
+  VulkanPipelineManager(const VulkanPipelineManager&) = delete;
+  VulkanPipelineManager& operator=(const VulkanPipelineManager&) = delete;
+
+  // Waits for the queued pipeline builds to complete.
+  //
+  // The pipelines are destroyed, so they must not be used by pending commands.
+  ~VulkanPipelineManager();
+
+  // True if fast-linked pipelines are used while optimized pipelines build.
+  [[nodiscard]] bool UsesPipelineLibraries() const { return use_pipeline_libraries_; }
+
+  // Returns a pipeline that can be bound right away.
+  //
+  // The returned pipeline remains valid until the manager is destroyed, even
+  // after an optimized pipeline replaces it in future GetPipeline() calls.
+  [[nodiscard]] vk::Pipeline GetPipeline(const VulkanPipelineState& state);
+
+  // Queues up the builds of an optimized pipeline and of its library parts,
+  // if they aren't built or queued already.
+  void Prefetch(const VulkanPipelineState& state);
+
+  // Blocks until all the queued pipeline builds complete.
+  void WaitIdle();
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  // The number of VK_EXT_graphics_pipeline_library parts linked into a pipeline.
+  static constexpr size_t kLibraryPartCount = 4;
+
+  struct Library {
+    // Guarded by `mutex_`. Null until the worker finishes the build.
+    vk::UniquePipeline pipeline;
+  };
+
+  struct Entry {
+    // Guarded by `mutex_`. Set when the worker finishes the build.
+    vk::UniquePipeline optimized_pipeline;
+
+    // The parts linked into `fast_linked_pipeline`. Null without pipeline
+    // libraries.
+    std::array<const Library*, kLibraryPartCount> libraries = {};
+    // Guarded by `mutex_`.
+    vk::UniquePipeline fast_linked_pipeline;
+    // Guarded by `mutex_`. True while a GetPipeline() call links the parts.
+    bool is_linking = false;
+  };
+
+  using LibraryMap = std::unordered_map<VulkanPipelineState, Library, VulkanPipelineStateHash>;
+
+  // Returns the state's entry, and queues up builds if the entry is new.
+  //
+  // Must be called with `mutex_` held.
+  Entry& FindOrQueueEntry(const VulkanPipelineState& state);
+
+  // Returns the library with the part of `state` at `part_index`, and queues
+  // up its build if the library is new.
+  //
+  // Must be called with `mutex_` held.
+  const Library& FindOrQueueLibrary(const VulkanPipelineState& state, size_t part_index);
+
+  // Run on worker threads.
+  void BuildOptimizedPipeline(const VulkanPipelineState& state, Entry& entry);
+  void BuildLibrary(const VulkanPipelineState& key, size_t part_index, Library& library);
+
+  // True if all the parts of the entry's fast-linked pipeline are built.
+  //
+  // Must be called with `mutex_` held.
+  [[nodiscard]] bool AreLibrariesBuilt(const Entry& entry) const;
+
+  // Links the entry's fast-linked pipeline from its parts.
+  //
+  // `lock` must hold `mutex_`. The lock is released while linking.
+  void LinkPipeline(std::unique_lock<std::mutex>& lock, const VulkanPipelineState& state,
+                    Entry& entry);
+
+  vk::Device device_;
+  const bool use_pipeline_libraries_;
+  vk::UniquePipelineCache pipeline_cache_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable pipeline_built_;
+
+  // Guarded by `mutex_`.
+  //
+  // Entries and libraries are never removed, so references to them remain
+  // valid.
+  std::unordered_map<VulkanPipelineState, Entry, VulkanPipelineStateHash> entries_;
+  // Indexed by part index.
+  std::array<LibraryMap, kLibraryPartCount> libraries_;
+  uint64_t optimized_hit_count_ = 0;
+  uint64_t fast_linked_hit_count_ = 0;
+  uint64_t stall_count_ = 0;
+  uint64_t optimized_pipeline_count_ = 0;
+  uint64_t fast_linked_pipeline_count_ = 0;
+  uint64_t library_count_ = 0;
+
+  // Destroyed first, so the workers don't outlive the state they use.
+  std::unique_ptr<TaskPool> library_task_pool_;
+  std::unique_ptr<TaskPool> task_pool_;
+};
+
+#endif  // VULKAN_PIPELINE_MANAGER_H_
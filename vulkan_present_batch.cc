@@ -0,0 +1,66 @@
+#include "vulkan_present_batch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_errors.h"
+#include "vulkan_swap_chain.h"
+
+VulkanPresentBatch::VulkanPresentBatch() = default;
+
+VulkanPresentBatch::~VulkanPresentBatch() {
+  assert(IsEmpty());
+}
+
+void VulkanPresentBatch::Add(VulkanSwapChain& swap_chain, uint32_t image_index,
+                             vk::Semaphore wait_semaphore) {
+  assert(std::find(swap_chains_.begin(), swap_chains_.end(), &swap_chain) ==
+         swap_chains_.end());
+  assert(image_index < swap_chain.ImageCount());
+  assert(wait_semaphore);
+
+  swap_chains_.push_back(&swap_chain);
+  swap_chain_handles_.push_back(swap_chain.VulkanHandle());
+  image_indexes_.push_back(image_index);
+  wait_semaphores_.push_back(wait_semaphore);
+}
+
+void VulkanPresentBatch::Present(vk::Queue presentation_queue,
+                                 const vk::DispatchLoaderDynamic& dispatcher) {
+  assert(presentation_queue);
+
+  if (IsEmpty())
+    return;
+
+  results_.assign(swap_chains_.size(), vk::Result::eSuccess);
+
+  vk::PresentInfoKHR present_info;
+  present_info
+      .setWaitSemaphores(wait_semaphores_)
+      .setSwapchains(swap_chain_handles_)
+      .setImageIndices(image_indexes_)
+      .setResults(results_);
+
+  // The C API is used because vulkan.hpp asserts on eErrorOutOfDateKHR when
+  // exceptions are disabled. Out-of-date swap chains are reported below.
+  vk::Result result = static_cast<vk::Result>(dispatcher.vkQueuePresentKHR(
+      presentation_queue, reinterpret_cast<const VkPresentInfoKHR*>(&present_info)));
+  if (result != vk::Result::eSuboptimalKHR && result != vk::Result::eErrorOutOfDateKHR)
+    VulkanCheckResult("vkQueuePresentKHR", result);
+
+  for (size_t i = 0; i < swap_chains_.size(); ++i)
+    swap_chains_[i]->OnPresentResult(results_[i]);
+
+  swap_chains_.clear();
+  swap_chain_handles_.clear();
+  image_indexes_.clear();
+  wait_semaphores_.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef VULKAN_PRESENT_BATCH_H_
+#define VULKAN_PRESENT_BATCH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class VulkanSwapChain;
+
+// Collects images from many swap chains, and presents them in one call.
+//
+// A single vkQueuePresentKHR() call is cheaper than one call per swap chain,
+// and lets the presentation engine flip all the displays together.
+class VulkanPresentBatch {
+ public:
+  VulkanPresentBatch();
+
+  VulkanPresentBatch(const VulkanPresentBatch&) = delete;
+  VulkanPresentBatch& operator=(const VulkanPresentBatch&) = delete;
+
+  ~VulkanPresentBatch();
+
+  [[nodiscard]] bool IsEmpty() const { return swap_chains_.empty(); }
+
+  // Adds an image acquired from `swap_chain` to the batch.
+  //
+  // Each swap chain can contribute at most one image to a batch. `swap_chain`
+  // must outlive the next Present() call.
+  void Add(VulkanSwapChain& swap_chain, uint32_t image_index, vk::Semaphore wait_semaphore);
+
+  // Presents all the images in the batch, then empties the batch.
+  //
+  // Each swap chain is notified of the outcome of presenting its image.
+  // `dispatcher` must belong to the device that owns `presentation_queue`.
+  void Present(vk::Queue presentation_queue, const vk::DispatchLoaderDynamic& dispatcher);
+
+ private:
+  std::vector<VulkanSwapChain*> swap_chains_;
+  std::vector<vk::SwapchainKHR> swap_chain_handles_;
+  std::vector<uint32_t> image_indexes_;
+  std::vector<vk::Semaphore> wait_semaphores_;
+  std::vector<vk::Result> results_;
+};
+
+#endif  // VULKAN_PRESENT_BATCH_H_
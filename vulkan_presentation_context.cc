@@ -2,9 +2,12 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <vulkan/vulkan.h>
@@ -31,6 +34,32 @@ namespace {
   return std::vector<const char*>(glfw_extensions, glfw_extensions + glfw_extension_count);
 }
 
+// Events that may change a window's content mark the window as needing a
+// redraw.
+void MarkNeedsRedraw(GLFWwindow* window);
+
+void OnWindowRefresh(GLFWwindow* window) {
+  MarkNeedsRedraw(window);
+}
+
+void OnFramebufferSize(GLFWwindow* window, int width, int height);
+
+void OnKey(GLFWwindow* window, int /*key*/, int /*scancode*/, int /*action*/, int /*mods*/) {
+  MarkNeedsRedraw(window);
+}
+
+void OnMouseButton(GLFWwindow* window, int /*button*/, int /*action*/, int /*mods*/) {
+  MarkNeedsRedraw(window);
+}
+
+void OnCursorPosition(GLFWwindow* window, double /*x*/, double /*y*/) {
+  MarkNeedsRedraw(window);
+}
+
+void OnScroll(GLFWwindow* window, double /*x_offset*/, double /*y_offset*/) {
+  MarkNeedsRedraw(window);
+}
+
 [[nodiscard]] std::vector<const char*> KhrSwapchainExtensionList() {
   static constexpr char kKhrSwapchainExtensionName[] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
 
@@ -42,8 +71,38 @@ namespace {
 struct VulkanPresentationSurface::State {
   GLFWwindow* window = nullptr;
   vk::UniqueSurfaceKHR surface;
+  // Set by GLFW callbacks, which run on the main thread.
+  bool needs_redraw = false;
+
+  // Cached, because glfwGetFramebufferSize() must be called on the main
+  // thread, and swap chains are created on the render thread.
+  mutable std::mutex size_mutex;
+  vk::Extent2D size;  // Guarded by `size_mutex`.
 };
 
+namespace {
+
+[[nodiscard]] VulkanPresentationSurface::State& WindowState(GLFWwindow* window) {
+  auto* state = static_cast<VulkanPresentationSurface::State*>(glfwGetWindowUserPointer(window));
+  assert(state != nullptr);
+  return *state;
+}
+
+void MarkNeedsRedraw(GLFWwindow* window) {
+  WindowState(window).needs_redraw = true;
+}
+
+void OnFramebufferSize(GLFWwindow* window, int width, int height) {
+  VulkanPresentationSurface::State& state = WindowState(window);
+  {
+    std::lock_guard<std::mutex> lock(state.size_mutex);
+    state.size = vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+  }
+  state.needs_redraw = true;
+}
+
+}  // namespace
+
 VulkanPresentationSurface::VulkanPresentationSurface(std::unique_ptr<State> state)
     : state_(std::move(state)) {
   assert(state_ != nullptr);
@@ -71,10 +130,8 @@ VulkanPresentationSurface::~VulkanPresentationSurface() {
 vk::Extent2D VulkanPresentationSurface::Size() const {
   assert(state_);
 
-  int width = 0, height = 0;
-  glfwGetFramebufferSize(state_->window, &width, &height);
-
-  return vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+  std::lock_guard<std::mutex> lock(state_->size_mutex);
+  return state_->size;
 }
 
 vk::SurfaceKHR VulkanPresentationSurface::VulkanHandle() const {
@@ -84,12 +141,25 @@ vk::SurfaceKHR VulkanPresentationSurface::VulkanHandle() const {
   return state_->surface.get();
 }
 
-void VulkanPresentationSurface::MainLoop() {
+bool VulkanPresentationSurface::TakeNeedsRedraw() {
+  assert(state_ != nullptr);
+
+  const bool needs_redraw = state_->needs_redraw;
+  state_->needs_redraw = false;
+  return needs_redraw;
+}
+
+void VulkanPresentationSurface::EventLoop(std::chrono::milliseconds timeout,
+                                          const std::function<void()>& on_events) {
   assert(state_ != nullptr);
   assert(state_->window != nullptr);
+  assert(timeout.count() > 0);
 
-  while (!glfwWindowShouldClose(state_->window))
-    glfwPollEvents();
+  const double timeout_seconds = std::chrono::duration<double>(timeout).count();
+  while (!glfwWindowShouldClose(state_->window)) {
+    glfwWaitEventsTimeout(timeout_seconds);
+    on_events();
+  }
 }
 
 VulkanPresentationContext::VulkanPresentationContext()
@@ -100,6 +170,10 @@ VulkanPresentationContext::~VulkanPresentationContext() {
   glfwTerminate();
 }
 
+void VulkanPresentationContext::WakeEventLoop() {
+  glfwPostEmptyEvent();
+}
+
 VulkanPresentationSurface VulkanPresentationContext::CreateSurface(vk::Instance instance,
                                                                    int width, int height) {
   assert(instance);
@@ -121,7 +195,22 @@ VulkanPresentationSurface VulkanPresentationContext::CreateSurface(vk::Instance
   }
   assert(raw_surface != VK_NULL_HANDLE);
 
-  auto state = std::make_unique<VulkanPresentationSurface::State>(VulkanPresentationSurface::State{
-      .window = window, .surface = vk::UniqueSurfaceKHR(raw_surface, instance) });
+  auto state = std::make_unique<VulkanPresentationSurface::State>();
+  state->window = window;
+  state->surface = vk::UniqueSurfaceKHR(raw_surface, instance);
+
+  int framebuffer_width = 0, framebuffer_height = 0;
+  glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+  state->size = vk::Extent2D(static_cast<uint32_t>(framebuffer_width),
+                             static_cast<uint32_t>(framebuffer_height));
+
+  // The state is heap-allocated, so its address survives moves.
+  glfwSetWindowUserPointer(window, state.get());
+  glfwSetWindowRefreshCallback(window, &OnWindowRefresh);
+  glfwSetFramebufferSizeCallback(window, &OnFramebufferSize);
+  glfwSetKeyCallback(window, &OnKey);
+  glfwSetMouseButtonCallback(window, &OnMouseButton);
+  glfwSetCursorPosCallback(window, &OnCursorPosition);
+  glfwSetScrollCallback(window, &OnScroll);
   return VulkanPresentationSurface(std::move(state));
 }
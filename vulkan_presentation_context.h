@@ -1,6 +1,8 @@
 #ifndef VULKAN_PRESENTATION_CONTEXT_H_
 #define VULKAN_PRESENTATION_CONTEXT_H_
 
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -23,12 +25,22 @@ class VulkanPresentationSurface {
 
   ~VulkanPresentationSurface();
 
-  // The surface's dimensions, in pixels.
+  // The surface's dimensions, in pixels. Thread-safe.
   vk::Extent2D Size() const;
 
   vk::SurfaceKHR VulkanHandle() const;
 
-  void MainLoop();
+  // True if the window got events that may change its content, such as
+  // input, resizing or exposure, since the last call. Main thread only.
+  [[nodiscard]] bool TakeNeedsRedraw();
+
+  // Processes window events until the window is closed.
+  //
+  // Blocks between batches of events, for at most `timeout`, so an idle
+  // window doesn't use any CPU time. `on_events` is called after each batch.
+  // Rendering belongs on another thread, which can call
+  // VulkanPresentationContext::WakeEventLoop().
+  void EventLoop(std::chrono::milliseconds timeout, const std::function<void()>& on_events);
 
  private:
   std::unique_ptr<State> state_;
@@ -60,6 +72,9 @@ class VulkanPresentationContext {
   // scope.
   [[nodiscard]] VulkanPresentationSurface CreateSurface(vk::Instance instance, int width, int height);
 
+  // Wakes up VulkanPresentationSurface::EventLoop() early. Thread-safe.
+  static void WakeEventLoop();
+
  private:
   const std::vector<const char*> required_instance_extensions_;
   const std::vector<const char*> required_device_extensions_;
@@ -0,0 +1,255 @@
+#include "vulkan_query_ring.h"
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_frame_commands.h"
+
+namespace {
+
+// Results are written in the order of the flag bits, so the order matches
+// the fields of VulkanQueryRing::PassResult.
+constexpr vk::QueryPipelineStatisticFlags kPipelineStatistics =
+    vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+    vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+    vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+    vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+    vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+    vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+constexpr uint32_t kPipelineStatisticCount = 6;
+
+[[nodiscard]] vk::UniqueQueryPool CreateQueryPool(
+    vk::Device device, vk::QueryType query_type, uint32_t query_count,
+    vk::QueryPipelineStatisticFlags pipeline_statistics = {}) {
+  // Vulkan doesn't allow empty query pools.
+  if (query_count == 0)
+    return {};
+
+  vk::QueryPoolCreateInfo create_info;
+  create_info
+      .setQueryType(query_type)
+      .setQueryCount(query_count)
+      .setPipelineStatistics(pipeline_statistics);
+
+  vk::ResultValue<vk::UniqueQueryPool> create_result = device.createQueryPoolUnique(create_info);
+  VulkanCheckResult("vkCreateQueryPool", create_result.result);
+  return std::move(create_result.value);
+}
+
+}  // namespace
+
+VulkanQueryRing::VulkanQueryRing(const VulkanDevice& device, int frames_in_flight,
+                                 uint32_t max_passes, uint32_t max_draw_groups,
+                                 ResultsCallback results_callback)
+    : device_(device.VulkanHandle()),
+      dispatcher_(device.Dispatcher()),
+      max_passes_(max_passes),
+      max_draw_groups_(max_draw_groups),
+      has_timestamps_(device.TimestampValidBits() != 0),
+      timestamp_mask_((device.TimestampValidBits() >= 64)
+                          ? ~uint64_t{0}
+                          : (uint64_t{1} << device.TimestampValidBits()) - 1),
+      timestamp_period_(device.Limits().timestampPeriod),
+      occlusion_flags_(device.HasPreciseOcclusionQueries() ? vk::QueryControlFlagBits::ePrecise
+                                                           : vk::QueryControlFlags()),
+      results_callback_(std::move(results_callback)) {
+  assert(frames_in_flight > 0);
+  assert(max_passes > 0 || max_draw_groups > 0);
+  assert(!device.IsComputeOnly());
+  assert(results_callback_);
+
+  slots_.resize(frames_in_flight);
+  for (FrameSlot& slot : slots_) {
+    if (has_timestamps_) {
+      slot.timestamp_pool =
+          CreateQueryPool(device_, vk::QueryType::eTimestamp, 2 * max_passes);
+    }
+    slot.statistics_pool = CreateQueryPool(device_, vk::QueryType::ePipelineStatistics,
+                                           max_passes, kPipelineStatistics);
+    slot.occlusion_pool = CreateQueryPool(device_, vk::QueryType::eOcclusion, max_draw_groups);
+    slot.pass_names.reserve(max_passes);
+    slot.draw_group_ids.reserve(max_draw_groups);
+  }
+  results_.passes.reserve(max_passes);
+  results_.draw_groups.reserve(max_draw_groups);
+}
+
+VulkanQueryRing::~VulkanQueryRing() = default;
+
+void VulkanQueryRing::BeginFrame(const VulkanFrameCommands& frame_commands,
+                                 vk::CommandBuffer command_buffer) {
+  assert(!is_in_pass_);
+  assert(!is_in_draw_group_);
+
+  current_slot_ = frame_commands.FrameNumber() % slots_.size();
+  FrameSlot& slot = CurrentSlot();
+  assert(slot.frame_number < frame_commands.FrameNumber());
+
+  if (slot.frame_number != 0)
+    ReportResults(slot);
+
+  slot.frame_number = frame_commands.FrameNumber();
+  slot.pass_names.clear();
+  slot.draw_group_ids.clear();
+
+  // Queries must be reset before they are reused.
+  if (slot.timestamp_pool) {
+    command_buffer.resetQueryPool(slot.timestamp_pool.get(), /*firstQuery=*/0,
+                                  2 * max_passes_, dispatcher_);
+  }
+  if (slot.statistics_pool) {
+    command_buffer.resetQueryPool(slot.statistics_pool.get(), /*firstQuery=*/0, max_passes_,
+                                  dispatcher_);
+  }
+  if (slot.occlusion_pool) {
+    command_buffer.resetQueryPool(slot.occlusion_pool.get(), /*firstQuery=*/0,
+                                  max_draw_groups_, dispatcher_);
+  }
+}
+
+void VulkanQueryRing::BeginPass(vk::CommandBuffer command_buffer, const char* name) {
+  assert(!is_in_pass_);
+  assert(name != nullptr);
+
+  FrameSlot& slot = CurrentSlot();
+  assert(slot.frame_number != 0);  // BeginFrame() was never called.
+  assert(slot.pass_names.size() < max_passes_);
+
+  const uint32_t pass_index = static_cast<uint32_t>(slot.pass_names.size());
+  slot.pass_names.push_back(name);
+  is_in_pass_ = true;
+
+  if constexpr (VulkanConfig::WantProfiling()) {
+    vk::DebugUtilsLabelEXT label;
+    label.setPLabelName(name);
+    command_buffer.beginDebugUtilsLabelEXT(label, dispatcher_);
+  }
+  if (slot.timestamp_pool) {
+    command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                                  slot.timestamp_pool.get(), 2 * pass_index, dispatcher_);
+  }
+  command_buffer.beginQuery(slot.statistics_pool.get(), pass_index, /*flags=*/{},
+                            dispatcher_);
+}
+
+void VulkanQueryRing::EndPass(vk::CommandBuffer command_buffer) {
+  assert(is_in_pass_);
+
+  FrameSlot& slot = CurrentSlot();
+  const uint32_t pass_index = static_cast<uint32_t>(slot.pass_names.size() - 1);
+  is_in_pass_ = false;
+
+  command_buffer.endQuery(slot.statistics_pool.get(), pass_index, dispatcher_);
+  if (slot.timestamp_pool) {
+    command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                                  slot.timestamp_pool.get(), 2 * pass_index + 1, dispatcher_);
+  }
+  if constexpr (VulkanConfig::WantProfiling())
+    command_buffer.endDebugUtilsLabelEXT(dispatcher_);
+}
+
+void VulkanQueryRing::BeginDrawGroup(vk::CommandBuffer command_buffer,
+                                     uint32_t draw_group_id) {
+  assert(!is_in_draw_group_);
+
+  FrameSlot& slot = CurrentSlot();
+  assert(slot.frame_number != 0);  // BeginFrame() was never called.
+  assert(slot.draw_group_ids.size() < max_draw_groups_);
+
+  const uint32_t query_index = static_cast<uint32_t>(slot.draw_group_ids.size());
+  slot.draw_group_ids.push_back(draw_group_id);
+  is_in_draw_group_ = true;
+
+  command_buffer.beginQuery(slot.occlusion_pool.get(), query_index, occlusion_flags_,
+                            dispatcher_);
+}
+
+void VulkanQueryRing::EndDrawGroup(vk::CommandBuffer command_buffer) {
+  assert(is_in_draw_group_);
+
+  FrameSlot& slot = CurrentSlot();
+  const uint32_t query_index = static_cast<uint32_t>(slot.draw_group_ids.size() - 1);
+  is_in_draw_group_ = false;
+
+  command_buffer.endQuery(slot.occlusion_pool.get(), query_index, dispatcher_);
+}
+
+void VulkanQueryRing::ReportResults(const FrameSlot& slot) {
+  // The frame completed, so waiting for the results doesn't block.
+  static constexpr vk::QueryResultFlags kResultFlags =
+      vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait;
+
+  results_.frame_number = slot.frame_number;
+  results_.passes.clear();
+  results_.draw_groups.clear();
+
+  const uint32_t pass_count = static_cast<uint32_t>(slot.pass_names.size());
+  if (pass_count > 0) {
+    query_data_.resize(size_t{kPipelineStatisticCount} * pass_count);
+    VulkanCheckResult(
+        "vkGetQueryPoolResults",
+        device_.getQueryPoolResults(
+            slot.statistics_pool.get(), /*firstQuery=*/0, pass_count,
+            query_data_.size() * sizeof(uint64_t), query_data_.data(),
+            /*stride=*/kPipelineStatisticCount * sizeof(uint64_t), kResultFlags, dispatcher_));
+    for (uint32_t pass_index = 0; pass_index < pass_count; ++pass_index) {
+      const uint64_t* statistics = &query_data_[size_t{kPipelineStatisticCount} * pass_index];
+      results_.passes.push_back({
+        .name = slot.pass_names[pass_index],
+        .gpu_time_ms = 0.0,
+        .input_assembly_vertices = statistics[0],
+        .vertex_shader_invocations = statistics[1],
+        .clipping_invocations = statistics[2],
+        .clipping_primitives = statistics[3],
+        .fragment_shader_invocations = statistics[4],
+        .compute_shader_invocations = statistics[5],
+      });
+    }
+
+    if (slot.timestamp_pool) {
+      query_data_.resize(size_t{2} * pass_count);
+      VulkanCheckResult(
+          "vkGetQueryPoolResults",
+          device_.getQueryPoolResults(
+              slot.timestamp_pool.get(), /*firstQuery=*/0, 2 * pass_count,
+              query_data_.size() * sizeof(uint64_t), query_data_.data(),
+              /*stride=*/sizeof(uint64_t), kResultFlags, dispatcher_));
+      for (uint32_t pass_index = 0; pass_index < pass_count; ++pass_index) {
+        // Masking handles timestamps that wrapped around during the pass.
+        uint64_t ticks =
+            (query_data_[2 * pass_index + 1] - query_data_[2 * pass_index]) & timestamp_mask_;
+        results_.passes[pass_index].gpu_time_ms =
+            static_cast<double>(ticks) * timestamp_period_ / 1e6;
+      }
+    }
+  }
+
+  const uint32_t draw_group_count = static_cast<uint32_t>(slot.draw_group_ids.size());
+  if (draw_group_count > 0) {
+    query_data_.resize(draw_group_count);
+    VulkanCheckResult(
+        "vkGetQueryPoolResults",
+        device_.getQueryPoolResults(
+            slot.occlusion_pool.get(), /*firstQuery=*/0, draw_group_count,
+            query_data_.size() * sizeof(uint64_t), query_data_.data(),
+            /*stride=*/sizeof(uint64_t), kResultFlags, dispatcher_));
+    for (uint32_t query_index = 0; query_index < draw_group_count; ++query_index) {
+      results_.draw_groups.push_back({
+        .draw_group_id = slot.draw_group_ids[query_index],
+        .samples_passed = query_data_[query_index],
+      });
+    }
+  }
+
+  results_callback_(results_);
+}
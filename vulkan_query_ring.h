@@ -0,0 +1,127 @@
+#ifndef VULKAN_QUERY_RING_H_
+#define VULKAN_QUERY_RING_H_
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class VulkanDevice;
+class VulkanFrameCommands;
+
+// Collects GPU timings, pipeline statistics and occlusion counts for each frame.
+//
+// Each frame in flight gets its own set of query pools. A frame's results are
+// read when its pools are reused, after VulkanFrameCommands::BeginFrame()
+// waited for the frame to complete, so reading them never stalls. Results
+// arrive `frames_in_flight` frames after they were recorded. The results of
+// the last frames in flight are dropped when the ring is destroyed.
+//
+// Passes measure time and pipeline statistics, and must not be nested. Draw
+// groups count the samples that pass the depth and stencil tests, and must
+// begin and end in the same subpass. Not thread-safe.
+class VulkanQueryRing {
+ public:
+  struct PassResult {
+    // The name passed to BeginPass().
+    const char* name;
+    // Zero if the queue doesn't support timestamps.
+    double gpu_time_ms;
+    uint64_t input_assembly_vertices;
+    uint64_t vertex_shader_invocations;
+    uint64_t clipping_invocations;
+    uint64_t clipping_primitives;
+    uint64_t fragment_shader_invocations;
+    uint64_t compute_shader_invocations;
+  };
+
+  struct DrawGroupResult {
+    // The ID passed to BeginDrawGroup().
+    uint32_t draw_group_id;
+    // Without precise occlusion queries, any non-zero count means that some
+    // samples passed.
+    uint64_t samples_passed;
+  };
+
+  struct FrameResults {
+    uint64_t frame_number;
+    // In recording order.
+    std::vector<PassResult> passes;
+    std::vector<DrawGroupResult> draw_groups;
+  };
+
+  // Called by BeginFrame() with the results of a completed frame.
+  using ResultsCallback = std::function<void(const FrameResults& results)>;
+
+  // `frames_in_flight` must match the VulkanFrameCommands passed to
+  // BeginFrame(). Each frame can have up to `max_passes` passes and
+  // `max_draw_groups` draw groups.
+  explicit VulkanQueryRing(const VulkanDevice& device, int frames_in_flight,
+                           uint32_t max_passes, uint32_t max_draw_groups,
+                           ResultsCallback results_callback);
+
+  VulkanQueryRing(const VulkanQueryRing&) = delete;
+  VulkanQueryRing& operator=(const VulkanQueryRing&) = delete;
+
+  // The query pools must not be used by pending commands.
+  ~VulkanQueryRing();
+
+  // Reports the results of the frame that last used the current frame's
+  // pools, and resets the pools.
+  //
+  // `command_buffer` must be the one returned by the last
+  // `frame_commands.BeginFrame()` call, and must be outside a render pass.
+  void BeginFrame(const VulkanFrameCommands& frame_commands, vk::CommandBuffer command_buffer);
+
+  // `name` must outlive the ring, such as a string literal. Profiling builds
+  // also label the pass' commands with `name`, for GPU profilers.
+  void BeginPass(vk::CommandBuffer command_buffer, const char* name);
+  void EndPass(vk::CommandBuffer command_buffer);
+
+  void BeginDrawGroup(vk::CommandBuffer command_buffer, uint32_t draw_group_id);
+  void EndDrawGroup(vk::CommandBuffer command_buffer);
+
+ private:
+  // The queries of one frame in flight.
+  struct FrameSlot {
+    vk::UniqueQueryPool timestamp_pool;
+    vk::UniqueQueryPool statistics_pool;
+    vk::UniqueQueryPool occlusion_pool;
+    // Zero if no frame used the slot.
+    uint64_t frame_number = 0;
+    std::vector<const char*> pass_names;
+    std::vector<uint32_t> draw_group_ids;
+  };
+
+  // Reads the completed queries of the slot's frame.
+  void ReportResults(const FrameSlot& slot);
+
+  FrameSlot& CurrentSlot() {
+    assert(current_slot_ < slots_.size());
+    return slots_[current_slot_];
+  }
+
+  const vk::Device device_;
+  const vk::DispatchLoaderDynamic& dispatcher_;
+  const uint32_t max_passes_;
+  const uint32_t max_draw_groups_;
+  const bool has_timestamps_;
+  const uint64_t timestamp_mask_;
+  // Nanoseconds per timestamp tick.
+  const double timestamp_period_;
+  const vk::QueryControlFlags occlusion_flags_;
+  ResultsCallback results_callback_;
+  std::vector<FrameSlot> slots_;
+  size_t current_slot_ = 0;
+  bool is_in_pass_ = false;
+  bool is_in_draw_group_ = false;
+
+  // Reused across frames to avoid allocations.
+  std::vector<uint64_t> query_data_;
+  FrameResults results_;
+};
+
+#endif  // VULKAN_QUERY_RING_H_
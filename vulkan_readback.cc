@@ -0,0 +1,345 @@
+#include "vulkan_readback.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "image_encoding.h"
+#include "task_pool.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+
+namespace {
+
+[[nodiscard]] PixelLayout PixelLayoutFor(vk::Format format) {
+  switch (format) {
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+      return PixelLayout::kRgba8;
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+      return PixelLayout::kBgra8;
+    default:
+      std::cerr << "Unsupported readback format: " << vk::to_string(format) << std::endl;
+      std::abort();
+  }
+}
+
+[[nodiscard]] vk::UniqueCommandPool CreateCommandPool(const VulkanDevice& device) {
+  vk::CommandPoolCreateInfo create_info;
+  create_info
+      .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+      .setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+
+  vk::ResultValue<vk::UniqueCommandPool> create_result =
+      device.VulkanHandle().createCommandPoolUnique(create_info);
+  VulkanCheckResult("vkCreateCommandPool", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniqueBuffer CreateReadbackBuffer(vk::Device device, vk::DeviceSize size) {
+  vk::BufferCreateInfo create_info;
+  create_info
+      .setSize(size)
+      .setUsage(vk::BufferUsageFlagBits::eTransferDst)
+      .setSharingMode(vk::SharingMode::eExclusive);
+
+  vk::ResultValue<vk::UniqueBuffer> create_result = device.createBufferUnique(create_info);
+  VulkanCheckResult("vkCreateBuffer", create_result.result);
+  return std::move(create_result.value);
+}
+
+struct ReadbackMemoryType {
+  uint32_t index;
+  bool is_coherent;
+};
+
+// Host-cached memory makes CPU reads fast. Coherent memory doesn't need to be
+// invalidated before reading.
+[[nodiscard]] ReadbackMemoryType FindReadbackMemoryType(const VulkanDevice& device,
+                                                        uint32_t memory_type_bits) {
+  static constexpr vk::MemoryPropertyFlags kHostVisibleCached =
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+  static constexpr vk::MemoryPropertyFlags kHostVisibleCoherent =
+      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+  std::optional<uint32_t> memory_type = device.FindMemoryType(
+      memory_type_bits, kHostVisibleCached | vk::MemoryPropertyFlagBits::eHostCoherent);
+  if (memory_type.has_value())
+    return {.index = *memory_type, .is_coherent = true};
+
+  memory_type = device.FindMemoryType(memory_type_bits, kHostVisibleCached);
+  if (memory_type.has_value())
+    return {.index = *memory_type, .is_coherent = false};
+
+  memory_type = device.FindMemoryType(memory_type_bits, kHostVisibleCoherent);
+  if (memory_type.has_value())
+    return {.index = *memory_type, .is_coherent = true};
+
+  std::cerr << "No host-visible memory type for readback buffers" << std::endl;
+  std::abort();
+}
+
+}  // namespace
+
+VulkanReadbackRing::VulkanReadbackRing(
+    VulkanDevice& device, size_t submission_thread_index, vk::Extent2D extent,
+    vk::Format format, int slot_count, int worker_count, Encoding encoding,
+    FrameConsumer consumer)
+    : device_(device.VulkanHandle()),
+      dispatcher_(device.Dispatcher()),
+      queue_(device.SubmissionQueue(submission_thread_index)),
+      extent_(extent),
+      format_(format),
+      encoding_(encoding),
+      consumer_(std::move(consumer)),
+      timeline_semaphore_(device.CreateTimelineSemaphore(/*initial_value=*/0)),
+      command_pool_(CreateCommandPool(device)),
+      task_pool_(std::make_unique<TaskPool>(worker_count)) {
+  assert(slot_count > 0);
+  assert(extent.width > 0 && extent.height > 0);
+  assert(consumer_);
+  std::ignore = PixelLayoutFor(format);  // Aborts early on unsupported formats.
+
+  vk::CommandBufferAllocateInfo allocate_info;
+  allocate_info
+      .setCommandPool(command_pool_.get())
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(static_cast<uint32_t>(slot_count));
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+      device_.allocateCommandBuffersUnique(allocate_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+
+  const vk::DeviceSize buffer_size = vk::DeviceSize{extent.width} * extent.height * 4;
+  std::optional<ReadbackMemoryType> memory_type;
+
+  slots_.reserve(slot_count);
+  for (int i = 0; i < slot_count; ++i) {
+    Slot& slot = slots_.emplace_back();
+    slot.buffer = CreateReadbackBuffer(device_, buffer_size);
+    slot.command_buffer = std::move(allocate_result.value[i]);
+
+    vk::MemoryRequirements requirements =
+        device_.getBufferMemoryRequirements(slot.buffer.get());
+    if (!memory_type.has_value()) {
+      memory_type = FindReadbackMemoryType(device, requirements.memoryTypeBits);
+      memory_is_coherent_ = memory_type->is_coherent;
+    }
+
+    vk::MemoryAllocateInfo allocate_memory_info;
+    allocate_memory_info
+        .setAllocationSize(requirements.size)
+        .setMemoryTypeIndex(memory_type->index);
+    vk::ResultValue<vk::UniqueDeviceMemory> allocate_memory_result =
+        device_.allocateMemoryUnique(allocate_memory_info);
+    VulkanCheckResult("vkAllocateMemory", allocate_memory_result.result);
+    slot.memory = std::move(allocate_memory_result.value);
+
+    VulkanCheckResult("vkBindBufferMemory",
+                      device_.bindBufferMemory(slot.buffer.get(), slot.memory.get(), 0));
+
+    // The memory stays mapped until it is freed.
+    vk::ResultValue<void*> map_result =
+        device_.mapMemory(slot.memory.get(), /*offset=*/0, VK_WHOLE_SIZE);
+    VulkanCheckResult("vkMapMemory", map_result.result);
+    slot.mapped_pixels = static_cast<const uint8_t*>(map_result.value);
+  }
+}
+
+VulkanReadbackRing::~VulkanReadbackRing() {
+  WaitIdle();
+  task_pool_.reset();
+}
+
+uint64_t VulkanReadbackRing::ReadbackImage(vk::Image image, vk::ImageLayout layout) {
+  assert(image);
+  assert(layout != vk::ImageLayout::eUndefined);
+
+  Slot& slot = slots_[next_slot_index_];
+  next_slot_index_ = (next_slot_index_ + 1) % slots_.size();
+
+  uint64_t frame_number;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (slot.in_use) {
+      ++stall_count_;
+      slot_released_.wait(lock, [&slot]() { return !slot.in_use; });
+    }
+    slot.in_use = true;
+
+    if (submitted_frame_count_ == 0)
+      first_submission_time_ = std::chrono::steady_clock::now();
+    ++submitted_frame_count_;
+    frame_number = submitted_frame_count_;
+  }
+
+  RecordCopy(slot, image, layout);
+
+  // The semaphore's payload reaches the frame number when the copy completes.
+  vk::CommandBuffer command_buffer = slot.command_buffer.get();
+  vk::Semaphore timeline_semaphore = timeline_semaphore_.get();
+  vk::TimelineSemaphoreSubmitInfo timeline_submit_info;
+  timeline_submit_info.setSignalSemaphoreValues(frame_number);
+  vk::SubmitInfo submit_info;
+  submit_info
+      .setPNext(&timeline_submit_info)
+      .setCommandBuffers(command_buffer)
+      .setSignalSemaphores(timeline_semaphore);
+  VulkanCheckResult("vkQueueSubmit", queue_.submit(submit_info, /*fence=*/nullptr, dispatcher_));
+
+  task_pool_->Post([this, &slot, frame_number]() { CompleteFrame(slot, frame_number); });
+  return frame_number;
+}
+
+void VulkanReadbackRing::WaitIdle() {
+  task_pool_->WaitIdle();
+}
+
+VulkanReadbackRing::Stats VulkanReadbackRing::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  double frames_per_second = 0;
+  if (submitted_frame_count_ != 0) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - first_submission_time_;
+    if (elapsed.count() > 0)
+      frames_per_second = static_cast<double>(completed_frame_count_) / elapsed.count();
+  }
+
+  return {
+    .submitted_frame_count = submitted_frame_count_,
+    .completed_frame_count = completed_frame_count_,
+    .stall_count = stall_count_,
+    .frames_per_second = frames_per_second,
+  };
+}
+
+void VulkanReadbackRing::RecordCopy(Slot& slot, vk::Image image, vk::ImageLayout layout) {
+  vk::CommandBuffer command_buffer = slot.command_buffer.get();
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info, dispatcher_));
+
+  const vk::ImageSubresourceRange color_range(
+      vk::ImageAspectFlagBits::eColor, /*baseMipLevel=*/0, /*levelCount=*/1,
+      /*baseArrayLayer=*/0, /*layerCount=*/1);
+
+  // Waits for the rendering commands submitted earlier to finish writing.
+  vk::ImageMemoryBarrier to_transfer_source;
+  to_transfer_source
+      .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite |
+                        vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+      .setOldLayout(layout)
+      .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image)
+      .setSubresourceRange(color_range);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eTransfer, /*dependencyFlags=*/{},
+      /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr, to_transfer_source,
+      dispatcher_);
+
+  vk::BufferImageCopy region;
+  region
+      .setBufferOffset(0)
+      .setBufferRowLength(0)
+      .setBufferImageHeight(0)
+      .setImageSubresource(vk::ImageSubresourceLayers(
+          vk::ImageAspectFlagBits::eColor, /*mipLevel=*/0, /*baseArrayLayer=*/0,
+          /*layerCount=*/1))
+      .setImageOffset(vk::Offset3D(0, 0, 0))
+      .setImageExtent(vk::Extent3D(extent_.width, extent_.height, 1));
+  command_buffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal,
+                                   slot.buffer.get(), region, dispatcher_);
+
+  // Makes the copied pixels visible to the host.
+  vk::BufferMemoryBarrier to_host;
+  to_host
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eHostRead)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setBuffer(slot.buffer.get())
+      .setOffset(0)
+      .setSize(VK_WHOLE_SIZE);
+  vk::ImageMemoryBarrier to_original_layout;
+  to_original_layout
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferRead)
+      .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead |
+                        vk::AccessFlagBits::eColorAttachmentWrite |
+                        vk::AccessFlagBits::eTransferRead |
+                        vk::AccessFlagBits::eTransferWrite)
+      .setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setNewLayout(layout)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image)
+      .setSubresourceRange(color_range);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eAllCommands,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, to_host, to_original_layout,
+      dispatcher_);
+
+  VulkanCheckResult("vkEndCommandBuffer", command_buffer.end(dispatcher_));
+}
+
+void VulkanReadbackRing::CompleteFrame(Slot& slot, uint64_t frame_number) {
+  vk::Semaphore timeline_semaphore = timeline_semaphore_.get();
+  vk::SemaphoreWaitInfo wait_info;
+  wait_info
+      .setSemaphores(timeline_semaphore)
+      .setValues(frame_number);
+  VulkanCheckResult("vkWaitSemaphores", device_.waitSemaphores(wait_info, UINT64_MAX, dispatcher_));
+
+  if (!memory_is_coherent_) {
+    vk::MappedMemoryRange range(slot.memory.get(), /*offset=*/0, VK_WHOLE_SIZE);
+    VulkanCheckResult("vkInvalidateMappedMemoryRanges",
+                      device_.invalidateMappedMemoryRanges(range, dispatcher_));
+  }
+
+  std::vector<uint8_t> encoded_frame;
+  switch (encoding_) {
+    case Encoding::kRaw:
+      encoded_frame = EncodeRaw(slot.mapped_pixels, extent_.width, extent_.height);
+      break;
+    case Encoding::kPpm:
+      encoded_frame = EncodePpm(slot.mapped_pixels, extent_.width, extent_.height,
+                                PixelLayoutFor(format_));
+      break;
+    case Encoding::kPng:
+      encoded_frame = EncodePng(slot.mapped_pixels, extent_.width, extent_.height,
+                                PixelLayoutFor(format_));
+      break;
+  }
+
+  // The slot can be reused as soon as its pixels are encoded.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot.in_use = false;
+  }
+  slot_released_.notify_one();
+
+  consumer_(frame_number, std::move(encoded_frame));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++completed_frame_count_;
+}
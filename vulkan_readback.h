@@ -0,0 +1,133 @@
+#ifndef VULKAN_READBACK_H_
+#define VULKAN_READBACK_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "image_encoding.h"
+#include "task_pool.h"
+
+class VulkanDevice;
+
+// Copies rendered images to host memory without stalling the render loop.
+//
+// Each ReadbackImage() call records a copy into the next slot of a ring of
+// persistently mapped host buffers, and submits it to a graphics queue. The
+// copy signals a timeline semaphore whose value is the frame number. Worker
+// threads wait for the copies to complete, encode the pixels, and hand the
+// encoded frames to a consumer.
+//
+// ReadbackImage() only blocks when all the ring's slots are still waiting for
+// their frames to be encoded. Sizing the ring to cover the GPU and encoding
+// latency avoids these stalls.
+class VulkanReadbackRing {
+ public:
+  enum class Encoding {
+    kRaw,
+    kPpm,
+    kPng,
+  };
+
+  // Receives an encoded frame. Called on a worker thread.
+  //
+  // Frames may be delivered out of order when there are multiple workers.
+  using FrameConsumer =
+      std::function<void(uint64_t frame_number, std::vector<uint8_t> encoded_frame)>;
+
+  struct Stats {
+    uint64_t submitted_frame_count;
+    uint64_t completed_frame_count;
+    // The number of ReadbackImage() calls that had to wait for a free slot.
+    uint64_t stall_count;
+    // Completed frames per second since the first ReadbackImage() call.
+    double frames_per_second;
+  };
+
+  // `format` must be an 8-bit RGBA or BGRA format. The images passed to
+  // ReadbackImage() must have the given format and extent, and must have been
+  // created with vk::ImageUsageFlagBits::eTransferSrc.
+  //
+  // Copies are submitted to VulkanDevice::SubmissionQueue(submission_thread_index),
+  // which should be the queue that renders the images.
+  explicit VulkanReadbackRing(VulkanDevice& device, size_t submission_thread_index,
+                              vk::Extent2D extent, vk::Format format, int slot_count,
+                              int worker_count, Encoding encoding, FrameConsumer consumer);
+
+  VulkanReadbackRing(const VulkanReadbackRing&) = delete;
+  VulkanReadbackRing& operator=(const VulkanReadbackRing&) = delete;
+
+  // Blocks until all the submitted frames are delivered to the consumer.
+  ~VulkanReadbackRing();
+
+  // Queues up a copy of `image` to host memory. Returns the frame's number.
+  //
+  // `image` must be in `layout` when the copy executes, and is returned to
+  // `layout` after the copy. The copy is ordered after all the commands
+  // previously submitted to the submission thread's queue.
+  //
+  // Must be called on the submission thread, or serialized with its other
+  // uses of the queue.
+  uint64_t ReadbackImage(vk::Image image, vk::ImageLayout layout);
+
+  // Blocks until all the submitted frames are delivered to the consumer.
+  void WaitIdle();
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  struct Slot {
+    vk::UniqueBuffer buffer;
+    vk::UniqueDeviceMemory memory;
+    const uint8_t* mapped_pixels = nullptr;
+    vk::UniqueCommandBuffer command_buffer;
+
+    // Guarded by the ring's `mutex_`.
+    bool in_use = false;
+  };
+
+  void RecordCopy(Slot& slot, vk::Image image, vk::ImageLayout layout);
+
+  // Runs on a worker thread.
+  void CompleteFrame(Slot& slot, uint64_t frame_number);
+
+  vk::Device device_;
+  // Owned by the VulkanDevice. Used for the per-frame calls.
+  const vk::DispatchLoaderDynamic& dispatcher_;
+  vk::Queue queue_;
+  const vk::Extent2D extent_;
+  const vk::Format format_;
+  const Encoding encoding_;
+  const FrameConsumer consumer_;
+
+  // False if the mapped memory must be invalidated before it is read.
+  bool memory_is_coherent_ = false;
+
+  vk::UniqueSemaphore timeline_semaphore_;
+  vk::UniqueCommandPool command_pool_;
+  std::vector<Slot> slots_;
+  size_t next_slot_index_ = 0;
+
+  mutable std::mutex mutex_;
+  std::condition_variable slot_released_;
+
+  // Guarded by `mutex_`.
+  uint64_t submitted_frame_count_ = 0;
+  std::chrono::steady_clock::time_point first_submission_time_;
+  uint64_t completed_frame_count_ = 0;
+  uint64_t stall_count_ = 0;
+
+  // Destroyed first, so the workers don't outlive the state they use.
+  std::unique_ptr<TaskPool> task_pool_;
+};
+
+#endif  // VULKAN_READBACK_H_
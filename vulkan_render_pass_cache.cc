@@ -0,0 +1,243 @@
+#include "vulkan_render_pass_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_hash.h"
+
+namespace {
+
+// Adds `attachment` to `attachments`, and returns a reference to it.
+[[nodiscard]] vk::AttachmentReference AddAttachment(
+    const VulkanAttachmentKey& attachment, vk::ImageLayout subpass_layout,
+    std::vector<vk::AttachmentDescription>& attachments) {
+  assert(attachment.format != vk::Format::eUndefined);
+
+  vk::AttachmentReference reference(static_cast<uint32_t>(attachments.size()), subpass_layout);
+  attachments.push_back(vk::AttachmentDescription()
+      .setFormat(attachment.format)
+      .setSamples(attachment.samples)
+      .setLoadOp(attachment.load_op)
+      .setStoreOp(attachment.store_op)
+      .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+      .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+      .setInitialLayout(attachment.initial_layout)
+      .setFinalLayout(attachment.final_layout));
+  return reference;
+}
+
+[[nodiscard]] vk::UniqueRenderPass CreateRenderPass(vk::Device device,
+                                                    const VulkanRenderPassKey& key) {
+  assert(!key.color_attachments.empty());
+  assert(key.resolve_attachments.empty() ||
+         key.resolve_attachments.size() == key.color_attachments.size());
+
+  std::vector<vk::AttachmentDescription> attachments;
+  std::vector<vk::AttachmentReference> color_references;
+  std::vector<vk::AttachmentReference> resolve_references;
+  attachments.reserve(key.color_attachments.size() + key.resolve_attachments.size() + 1);
+  color_references.reserve(key.color_attachments.size());
+  resolve_references.reserve(key.resolve_attachments.size());
+  for (const VulkanAttachmentKey& attachment : key.color_attachments) {
+    color_references.push_back(
+        AddAttachment(attachment, vk::ImageLayout::eColorAttachmentOptimal, attachments));
+  }
+  for (const VulkanAttachmentKey& attachment : key.resolve_attachments) {
+    assert(attachment.samples == vk::SampleCountFlagBits::e1);
+    resolve_references.push_back(
+        AddAttachment(attachment, vk::ImageLayout::eColorAttachmentOptimal, attachments));
+  }
+
+  vk::SubpassDescription subpass;
+  subpass
+      .setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
+      .setColorAttachments(color_references)
+      .setResolveAttachments(resolve_references);
+
+  vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  vk::AccessFlags access =
+      vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+  vk::AttachmentReference depth_reference;
+  if (key.depth_attachment.has_value()) {
+    depth_reference = AddAttachment(*key.depth_attachment,
+                                    vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                                    attachments);
+    subpass.setPDepthStencilAttachment(&depth_reference);
+    stages |= vk::PipelineStageFlagBits::eEarlyFragmentTests |
+              vk::PipelineStageFlagBits::eLateFragmentTests;
+    access |= vk::AccessFlagBits::eDepthStencilAttachmentRead |
+              vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+  }
+
+  // Orders the layout transitions after the commands that used the
+  // attachments before the render pass, including swap chain image acquires
+  // and previous frames' passes.
+  vk::SubpassDependency dependency;
+  dependency
+      .setSrcSubpass(VK_SUBPASS_EXTERNAL)
+      .setDstSubpass(0)
+      .setSrcStageMask(stages)
+      .setDstStageMask(stages)
+      .setSrcAccessMask({})
+      .setDstAccessMask(access);
+
+  vk::RenderPassCreateInfo create_info;
+  create_info
+      .setAttachments(attachments)
+      .setSubpasses(subpass)
+      .setDependencies(dependency);
+
+  vk::ResultValue<vk::UniqueRenderPass> create_result =
+      device.createRenderPassUnique(create_info);
+  VulkanCheckResult("vkCreateRenderPass", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniqueFramebuffer CreateFramebuffer(vk::Device device,
+                                                      const VulkanFramebufferKey& key) {
+  assert(key.render_pass);
+  assert(!key.attachments.empty());
+  assert(key.extent.width > 0 && key.extent.height > 0);
+
+  vk::FramebufferCreateInfo create_info;
+  create_info
+      .setRenderPass(key.render_pass)
+      .setAttachments(key.attachments)
+      .setWidth(key.extent.width)
+      .setHeight(key.extent.height)
+      .setLayers(key.layers);
+
+  vk::ResultValue<vk::UniqueFramebuffer> create_result =
+      device.createFramebufferUnique(create_info);
+  VulkanCheckResult("vkCreateFramebuffer", create_result.result);
+  return std::move(create_result.value);
+}
+
+}  // namespace
+
+bool VulkanAttachmentKey::operator==(const VulkanAttachmentKey& other) const {
+  return format == other.format && samples == other.samples && load_op == other.load_op &&
+         store_op == other.store_op && initial_layout == other.initial_layout &&
+         final_layout == other.final_layout;
+}
+
+size_t VulkanRenderPassKeyHash::operator()(const VulkanRenderPassKey& key) const {
+  auto hash_attachment = [](size_t hash, const VulkanAttachmentKey& attachment) {
+    hash = HashCombine(hash, static_cast<size_t>(attachment.format));
+    hash = HashCombine(hash, static_cast<size_t>(attachment.samples));
+    hash = HashCombine(hash, static_cast<size_t>(attachment.load_op));
+    hash = HashCombine(hash, static_cast<size_t>(attachment.store_op));
+    hash = HashCombine(hash, static_cast<size_t>(attachment.initial_layout));
+    hash = HashCombine(hash, static_cast<size_t>(attachment.final_layout));
+    return hash;
+  };
+
+  size_t hash = 0;
+  for (const VulkanAttachmentKey& attachment : key.color_attachments)
+    hash = hash_attachment(hash, attachment);
+  hash = HashCombine(hash, key.resolve_attachments.size());
+  for (const VulkanAttachmentKey& attachment : key.resolve_attachments)
+    hash = hash_attachment(hash, attachment);
+  if (key.depth_attachment.has_value())
+    hash = hash_attachment(HashCombine(hash, 1), *key.depth_attachment);
+  return hash;
+}
+
+size_t VulkanFramebufferKeyHash::operator()(const VulkanFramebufferKey& key) const {
+  size_t hash = HashHandle(key.render_pass);
+  for (vk::ImageView attachment : key.attachments)
+    hash = HashCombine(hash, HashHandle(attachment));
+  hash = HashCombine(hash, key.extent.width);
+  hash = HashCombine(hash, key.extent.height);
+  hash = HashCombine(hash, key.layers);
+  return hash;
+}
+
+VulkanRenderPassCache::VulkanRenderPassCache(const VulkanDevice& device)
+    : device_(device.VulkanHandle()) {
+}
+
+VulkanRenderPassCache::~VulkanRenderPassCache() {
+  // Framebuffers must be destroyed before the render passes they use.
+  framebuffers_.clear();
+}
+
+vk::RenderPass VulkanRenderPassCache::GetRenderPass(const VulkanRenderPassKey& key) {
+  auto it = render_passes_.find(key);
+  if (it != render_passes_.end()) {
+    ++render_pass_hit_count_;
+    return it->second.get();
+  }
+
+  ++render_pass_miss_count_;
+  vk::UniqueRenderPass& render_pass = render_passes_[key];
+  render_pass = CreateRenderPass(device_, key);
+  return render_pass.get();
+}
+
+vk::Framebuffer VulkanRenderPassCache::GetFramebuffer(const VulkanFramebufferKey& key) {
+  auto it = framebuffers_.find(key);
+  if (it != framebuffers_.end()) {
+    ++framebuffer_hit_count_;
+    return it->second.get();
+  }
+
+  ++framebuffer_miss_count_;
+  vk::UniqueFramebuffer& framebuffer = framebuffers_[key];
+  framebuffer = CreateFramebuffer(device_, key);
+  return framebuffer.get();
+}
+
+template <typename OnEvict>
+void VulkanRenderPassCache::EvictImageView(vk::ImageView image_view, const OnEvict& on_evict) {
+  assert(image_view);
+
+  // Eviction happens when views are destroyed, which is rare enough that a
+  // scan is cheaper than maintaining a reverse index.
+  for (auto it = framebuffers_.begin(); it != framebuffers_.end();) {
+    const std::vector<vk::ImageView>& attachments = it->first.attachments;
+    if (std::find(attachments.begin(), attachments.end(), image_view) == attachments.end()) {
+      ++it;
+      continue;
+    }
+    on_evict(std::move(it->second));
+    it = framebuffers_.erase(it);
+    ++framebuffer_eviction_count_;
+  }
+}
+
+void VulkanRenderPassCache::EvictImageView(vk::ImageView image_view) {
+  EvictImageView(image_view, [](vk::UniqueFramebuffer) {});
+}
+
+void VulkanRenderPassCache::EvictImageView(vk::ImageView image_view,
+                                           VulkanDeletionQueue& deletion_queue,
+                                           uint64_t last_use) {
+  EvictImageView(image_view, [&](vk::UniqueFramebuffer framebuffer) {
+    deletion_queue.Retire(last_use, std::move(framebuffer));
+  });
+}
+
+VulkanRenderPassCache::Stats VulkanRenderPassCache::GetStats() const {
+  return {
+    .render_pass_hit_count = render_pass_hit_count_,
+    .render_pass_miss_count = render_pass_miss_count_,
+    .framebuffer_hit_count = framebuffer_hit_count_,
+    .framebuffer_miss_count = framebuffer_miss_count_,
+    .framebuffer_eviction_count = framebuffer_eviction_count_,
+    .render_pass_count = render_passes_.size(),
+    .framebuffer_count = framebuffers_.size(),
+  };
+}
@@ -0,0 +1,151 @@
+#ifndef VULKAN_RENDER_PASS_CACHE_H_
+#define VULKAN_RENDER_PASS_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+class VulkanDeletionQueue;
+class VulkanDevice;
+
+// An attachment of a single-subpass render pass.
+struct VulkanAttachmentKey {
+  vk::Format format = vk::Format::eUndefined;
+  vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+  vk::AttachmentLoadOp load_op = vk::AttachmentLoadOp::eDontCare;
+  vk::AttachmentStoreOp store_op = vk::AttachmentStoreOp::eStore;
+  vk::ImageLayout initial_layout = vk::ImageLayout::eUndefined;
+  vk::ImageLayout final_layout = vk::ImageLayout::eColorAttachmentOptimal;
+
+  [[nodiscard]] bool operator==(const VulkanAttachmentKey& other) const;
+  [[nodiscard]] bool operator!=(const VulkanAttachmentKey& other) const {
+    return !(*this == other);
+  }
+};
+
+// The state that determines a render pass.
+//
+// The render pass has one subpass, which writes all the color attachments,
+// and uses the optional depth attachment. Multisampled color attachments can
+// be resolved in the subpass, into the single-sampled resolve attachments.
+//
+// Framebuffer attachments are ordered as the color attachments, then the
+// resolve attachments, then the depth attachment.
+struct VulkanRenderPassKey {
+  std::vector<VulkanAttachmentKey> color_attachments;
+  // Empty, or one for each color attachment.
+  std::vector<VulkanAttachmentKey> resolve_attachments;
+  std::optional<VulkanAttachmentKey> depth_attachment;
+
+  [[nodiscard]] bool operator==(const VulkanRenderPassKey& other) const {
+    return color_attachments == other.color_attachments &&
+           resolve_attachments == other.resolve_attachments &&
+           depth_attachment == other.depth_attachment;
+  }
+  [[nodiscard]] bool operator!=(const VulkanRenderPassKey& other) const {
+    return !(*this == other);
+  }
+};
+
+struct VulkanRenderPassKeyHash {
+  [[nodiscard]] size_t operator()(const VulkanRenderPassKey& key) const;
+};
+
+// The state that determines a framebuffer.
+//
+// The handles are owned by the caller. `render_pass` usually comes from a
+// VulkanRenderPassCache.
+struct VulkanFramebufferKey {
+  vk::RenderPass render_pass;
+  std::vector<vk::ImageView> attachments;
+  vk::Extent2D extent;
+  uint32_t layers = 1;
+
+  [[nodiscard]] bool operator==(const VulkanFramebufferKey& other) const {
+    return render_pass == other.render_pass && attachments == other.attachments &&
+           extent == other.extent && layers == other.layers;
+  }
+  [[nodiscard]] bool operator!=(const VulkanFramebufferKey& other) const {
+    return !(*this == other);
+  }
+};
+
+struct VulkanFramebufferKeyHash {
+  [[nodiscard]] size_t operator()(const VulkanFramebufferKey& key) const;
+};
+
+// Creates each render pass and framebuffer once.
+//
+// Render loops look up the objects they need every frame. Objects are only
+// created on the first lookup, so steady-state frames don't create any.
+// Framebuffers must be evicted before the image views they use are
+// destroyed, for example when a swap chain is recreated.
+//
+// Not thread-safe. Each recording thread should use its own cache.
+class VulkanRenderPassCache {
+ public:
+  struct Stats {
+    uint64_t render_pass_hit_count;
+    uint64_t render_pass_miss_count;
+    uint64_t framebuffer_hit_count;
+    uint64_t framebuffer_miss_count;
+    uint64_t framebuffer_eviction_count;
+    size_t render_pass_count;
+    size_t framebuffer_count;
+  };
+
+  explicit VulkanRenderPassCache(const VulkanDevice& device);
+
+  VulkanRenderPassCache(const VulkanRenderPassCache&) = delete;
+  VulkanRenderPassCache& operator=(const VulkanRenderPassCache&) = delete;
+
+  // The cached objects must not be used by pending commands.
+  ~VulkanRenderPassCache();
+
+  // The returned render pass remains valid until the cache is destroyed.
+  [[nodiscard]] vk::RenderPass GetRenderPass(const VulkanRenderPassKey& key);
+
+  // The returned framebuffer remains valid until one of its image views is
+  // evicted, or the cache is destroyed.
+  [[nodiscard]] vk::Framebuffer GetFramebuffer(const VulkanFramebufferKey& key);
+
+  // Destroys the framebuffers that use `image_view`.
+  //
+  // The framebuffers must not be used by pending commands.
+  void EvictImageView(vk::ImageView image_view);
+
+  // Removes the framebuffers that use `image_view` from the cache, and
+  // retires them to `deletion_queue`, which destroys them after `last_use`.
+  //
+  // Used when the view is replaced while frames that use it are in flight.
+  void EvictImageView(vk::ImageView image_view, VulkanDeletionQueue& deletion_queue,
+                      uint64_t last_use);
+
+  [[nodiscard]] Stats GetStats() const;
+
+ private:
+  // Calls `on_evict` with each evicted framebuffer.
+  template <typename OnEvict>
+  void EvictImageView(vk::ImageView image_view, const OnEvict& on_evict);
+
+  vk::Device device_;
+
+  std::unordered_map<VulkanRenderPassKey, vk::UniqueRenderPass, VulkanRenderPassKeyHash>
+      render_passes_;
+  std::unordered_map<VulkanFramebufferKey, vk::UniqueFramebuffer, VulkanFramebufferKeyHash>
+      framebuffers_;
+
+  uint64_t render_pass_hit_count_ = 0;
+  uint64_t render_pass_miss_count_ = 0;
+  uint64_t framebuffer_hit_count_ = 0;
+  uint64_t framebuffer_miss_count_ = 0;
+  uint64_t framebuffer_eviction_count_ = 0;
+};
+
+#endif  // VULKAN_RENDER_PASS_CACHE_H_
@@ -0,0 +1,64 @@
+// Replays a command stream capture as fast as the GPU executes it.
+//
+// Usage: vulkan_replay capture_path [loop_count]
+//
+// Captures are written by hello_triangle when it is given a capture path.
+// Each loop submits all the captured frames back-to-back, so the results
+// measure GPU throughput without the application's CPU overhead.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include <vulkan/vulkan.hpp>
+
+#include "vulkan_capture_player.h"
+#include "vulkan_config.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_instance.h"
+#include "vulkan_physical_device_list.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: vulkan_replay capture_path [loop_count]" << std::endl;
+    return 1;
+  }
+  const char* capture_path = argv[1];
+  int loop_count = (argc > 2) ? std::atoi(argv[2]) : 100;
+  if (loop_count <= 0) {
+    std::cerr << "Invalid loop count: " << loop_count << std::endl;
+    return 1;
+  }
+
+  VulkanConfig vulkan_config;
+  VulkanInstance instance(vulkan_config, "Vulkan Replay");
+  VulkanDevice device =
+      VulkanPhysicalDeviceList(instance.VulkanHandle()).CreateOffscreenDevice(vulkan_config);
+
+  VulkanCapturePlayer player(device, capture_path);
+  if (player.FrameCount() == 0) {
+    std::cerr << "The capture has no frames: " << capture_path << std::endl;
+    return 1;
+  }
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(player.CommandBuffers());
+  vk::Queue queue = device.SubmissionQueue(/*thread_index=*/0);
+
+  // The first loop warms up caches and clocks, and isn't measured.
+  VulkanCheckResult("vkQueueSubmit", queue.submit(submit_info));
+  VulkanCheckResult("vkQueueWaitIdle", queue.waitIdle());
+
+  auto start_time = std::chrono::steady_clock::now();
+  for (int loop = 0; loop < loop_count; ++loop)
+    VulkanCheckResult("vkQueueSubmit", queue.submit(submit_info));
+  VulkanCheckResult("vkQueueWaitIdle", queue.waitIdle());
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+  const double frame_count = static_cast<double>(player.FrameCount()) * loop_count;
+  std::cout << player.FrameCount() << " frames x " << loop_count << " loops\n"
+            << "  " << frame_count / elapsed.count() << " frames/sec\n"
+            << "  " << elapsed.count() * 1000.0 / frame_count << " ms/frame\n";
+  return 0;
+}
@@ -0,0 +1,366 @@
+#include "vulkan_residency_manager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_frame_commands.h"
+
+namespace {
+
+[[nodiscard]] std::optional<uint32_t> FindDeviceLocalHeap(const VulkanDevice& device) {
+  const vk::PhysicalDeviceMemoryProperties& memory_properties = device.MemoryProperties();
+  for (uint32_t type_index = 0; type_index < memory_properties.memoryTypeCount; ++type_index) {
+    const vk::MemoryType& memory_type = memory_properties.memoryTypes[type_index];
+    if (memory_type.propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)
+      return memory_type.heapIndex;
+  }
+  return std::nullopt;
+}
+
+[[nodiscard]] uint32_t RequireDeviceLocalHeap(const VulkanDevice& device) {
+  std::optional<uint32_t> heap_index = FindDeviceLocalHeap(device);
+  if (!heap_index.has_value()) {
+    std::cerr << "Device has no device-local memory" << std::endl;
+    std::abort();
+  }
+  return *heap_index;
+}
+
+// Finds a host-visible memory type outside the device-local heaps.
+[[nodiscard]] std::optional<uint32_t> FindHostMemoryType(const VulkanDevice& device,
+                                                         uint32_t memory_type_bits) {
+  const vk::PhysicalDeviceMemoryProperties& memory_properties = device.MemoryProperties();
+  for (uint32_t type_index = 0; type_index < memory_properties.memoryTypeCount; ++type_index) {
+    if ((memory_type_bits & (uint32_t{1} << type_index)) == 0)
+      continue;
+
+    const vk::MemoryType& memory_type = memory_properties.memoryTypes[type_index];
+    if (!(memory_type.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible))
+      continue;
+    const vk::MemoryHeap& heap = memory_properties.memoryHeaps[memory_type.heapIndex];
+    if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+      continue;
+    return type_index;
+  }
+  return std::nullopt;
+}
+
+[[nodiscard]] bool HasHostHeap(const VulkanDevice& device) {
+  return FindHostMemoryType(device, /*memory_type_bits=*/~uint32_t{0}).has_value();
+}
+
+[[nodiscard]] vk::UniqueCommandPool CreateCommandPool(const VulkanDevice& device) {
+  vk::CommandPoolCreateInfo create_info;
+  create_info
+      .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+      .setQueueFamilyIndex(device.GraphicsQueueFamilyIndex());
+
+  vk::ResultValue<vk::UniqueCommandPool> create_result =
+      device.VulkanHandle().createCommandPoolUnique(create_info);
+  VulkanCheckResult("vkCreateCommandPool", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniqueCommandBuffer AllocateCommandBuffer(vk::Device device,
+                                                            vk::CommandPool command_pool) {
+  vk::CommandBufferAllocateInfo allocate_info;
+  allocate_info
+      .setCommandPool(command_pool)
+      .setLevel(vk::CommandBufferLevel::ePrimary)
+      .setCommandBufferCount(1);
+
+  vk::ResultValue<std::vector<vk::UniqueCommandBuffer>> allocate_result =
+      device.allocateCommandBuffersUnique(allocate_info);
+  VulkanCheckResult("vkAllocateCommandBuffers", allocate_result.result);
+  return std::move(allocate_result.value[0]);
+}
+
+[[nodiscard]] vk::UniqueFence CreateFence(vk::Device device) {
+  vk::ResultValue<vk::UniqueFence> create_result =
+      device.createFenceUnique(vk::FenceCreateInfo());
+  VulkanCheckResult("vkCreateFence", create_result.result);
+  return std::move(create_result.value);
+}
+
+}  // namespace
+
+VulkanResidencyManager::VulkanResidencyManager(const VulkanDevice& device,
+                                               VulkanDeletionQueue& deletion_queue,
+                                               size_t submission_thread_index)
+    : device_(device),
+      deletion_queue_(deletion_queue),
+      queue_(device.SubmissionQueue(submission_thread_index)),
+      device_local_heap_index_(RequireDeviceLocalHeap(device)),
+      has_host_heap_(HasHostHeap(device)),
+      command_pool_(CreateCommandPool(device)),
+      command_buffer_(AllocateCommandBuffer(device.VulkanHandle(), command_pool_.get())),
+      move_fence_(CreateFence(device.VulkanHandle())),
+      managed_bytes_(device.MemoryProperties().memoryHeapCount, 0) {}
+
+VulkanResidencyManager::~VulkanResidencyManager() = default;
+
+VulkanResidencyManager::BufferId VulkanResidencyManager::CreateBuffer(
+    vk::DeviceSize size, vk::BufferUsageFlags usage, int priority) {
+  assert(size > 0);
+
+  bool device_local = true;
+  if (has_host_heap_) {
+    std::vector<VulkanDevice::HeapBudget> heap_budgets = device_.QueryMemoryBudget();
+    vk::DeviceSize budget = heap_budgets[device_local_heap_index_].budget;
+    device_local = (DeviceLocalUsage(heap_budgets) + size) * 100 <= budget * kDemoteAbovePercent;
+  }
+
+  ManagedBuffer managed_buffer = AllocateBuffer(size, usage, device_local);
+  managed_buffer.priority = priority;
+  managed_buffer.last_used_frame = frame_number_;
+  managed_bytes_[managed_buffer.heap_index] += managed_buffer.allocation_size;
+
+  BufferId buffer_id;
+  if (free_buffer_ids_.empty()) {
+    buffer_id = static_cast<BufferId>(buffers_.size());
+    buffers_.push_back(std::move(managed_buffer));
+  } else {
+    buffer_id = free_buffer_ids_.back();
+    free_buffer_ids_.pop_back();
+    buffers_[buffer_id] = std::move(managed_buffer);
+  }
+  return buffer_id;
+}
+
+void VulkanResidencyManager::DestroyBuffer(BufferId buffer_id) {
+  assert(buffer_id < buffers_.size());
+  ManagedBuffer& managed_buffer = buffers_[buffer_id];
+  assert(managed_buffer.buffer);
+
+  managed_bytes_[managed_buffer.heap_index] -= managed_buffer.allocation_size;
+  managed_buffer = ManagedBuffer();
+  free_buffer_ids_.push_back(buffer_id);
+}
+
+void VulkanResidencyManager::BeginFrame(const VulkanFrameCommands& frame_commands) {
+  assert(frame_commands.FrameNumber() > frame_number_);
+  frame_number_ = frame_commands.FrameNumber();
+
+  // The deletion queue already freed the memory of completed frames.
+  const uint64_t completed_frame_number = frame_commands.CompletedFrameNumber();
+  retired_allocations_.erase(
+      std::remove_if(retired_allocations_.begin(), retired_allocations_.end(),
+                     [&](const RetiredAllocation& retired_allocation) {
+                       if (retired_allocation.last_use > completed_frame_number)
+                         return false;
+                       retired_device_local_bytes_ -= retired_allocation.size;
+                       return true;
+                     }),
+      retired_allocations_.end());
+
+  std::vector<VulkanDevice::HeapBudget> heap_budgets = device_.QueryMemoryBudget();
+  last_frame_stats_ = {};
+  last_frame_stats_.frame_number = frame_number_;
+  last_frame_stats_.heaps.reserve(heap_budgets.size());
+  for (size_t heap_index = 0; heap_index < heap_budgets.size(); ++heap_index) {
+    last_frame_stats_.heaps.push_back({
+      .budget = heap_budgets[heap_index].budget,
+      .usage = device_.HasMemoryBudget() ? heap_budgets[heap_index].usage
+                                         : managed_bytes_[heap_index],
+      .managed_bytes = managed_bytes_[heap_index],
+    });
+  }
+
+  if (!has_host_heap_)
+    return;
+
+  const vk::DeviceSize budget = heap_budgets[device_local_heap_index_].budget;
+  const vk::DeviceSize usage = DeviceLocalUsage(heap_budgets);
+
+  std::vector<BufferId> candidate_ids;
+  if (usage * 100 > budget * kDemoteAbovePercent) {
+    // Least important first. Among equals, least recently used first.
+    for (BufferId buffer_id = 0; buffer_id < buffers_.size(); ++buffer_id) {
+      if (buffers_[buffer_id].buffer && buffers_[buffer_id].is_device_local)
+        candidate_ids.push_back(buffer_id);
+    }
+    std::sort(candidate_ids.begin(), candidate_ids.end(), [this](BufferId lhs, BufferId rhs) {
+      return std::make_pair(buffers_[lhs].priority, buffers_[lhs].last_used_frame) <
+             std::make_pair(buffers_[rhs].priority, buffers_[rhs].last_used_frame);
+    });
+
+    std::vector<BufferId> demoted_ids;
+    vk::DeviceSize remaining_usage = usage;
+    for (BufferId buffer_id : candidate_ids) {
+      if (remaining_usage * 100 <= budget * kDemoteTargetPercent)
+        break;
+      demoted_ids.push_back(buffer_id);
+      remaining_usage -= std::min(remaining_usage, buffers_[buffer_id].allocation_size);
+    }
+
+    last_frame_stats_.demoted_buffer_count = demoted_ids.size();
+    last_frame_stats_.demoted_bytes = MoveBuffers(demoted_ids, /*to_device_local=*/false);
+    return;
+  }
+
+  if (usage * 100 < budget * kPromoteBelowPercent) {
+    // Most important first. Among equals, most recently used first.
+    for (BufferId buffer_id = 0; buffer_id < buffers_.size(); ++buffer_id) {
+      if (buffers_[buffer_id].buffer && !buffers_[buffer_id].is_device_local)
+        candidate_ids.push_back(buffer_id);
+    }
+    if (candidate_ids.empty())
+      return;
+    std::sort(candidate_ids.begin(), candidate_ids.end(), [this](BufferId lhs, BufferId rhs) {
+      return std::make_pair(buffers_[lhs].priority, buffers_[lhs].last_used_frame) >
+             std::make_pair(buffers_[rhs].priority, buffers_[rhs].last_used_frame);
+    });
+
+    std::vector<BufferId> promoted_ids;
+    vk::DeviceSize projected_usage = usage;
+    for (BufferId buffer_id : candidate_ids) {
+      vk::DeviceSize size = buffers_[buffer_id].allocation_size;
+      if ((projected_usage + size) * 100 >= budget * kPromoteBelowPercent)
+        break;
+      promoted_ids.push_back(buffer_id);
+      projected_usage += size;
+    }
+
+    last_frame_stats_.promoted_buffer_count = promoted_ids.size();
+    last_frame_stats_.promoted_bytes = MoveBuffers(promoted_ids, /*to_device_local=*/true);
+  }
+}
+
+VulkanResidencyManager::ManagedBuffer VulkanResidencyManager::AllocateBuffer(
+    vk::DeviceSize size, vk::BufferUsageFlags usage, bool device_local) const {
+  vk::Device device = device_.VulkanHandle();
+
+  // Transfer usage allows moving the buffer's contents to another heap.
+  vk::BufferCreateInfo create_info;
+  create_info
+      .setSize(size)
+      .setUsage(usage | vk::BufferUsageFlagBits::eTransferSrc |
+                vk::BufferUsageFlagBits::eTransferDst)
+      .setSharingMode(vk::SharingMode::eExclusive);
+  vk::ResultValue<vk::UniqueBuffer> create_result = device.createBufferUnique(create_info);
+  VulkanCheckResult("vkCreateBuffer", create_result.result);
+
+  ManagedBuffer managed_buffer;
+  managed_buffer.buffer = std::move(create_result.value);
+  managed_buffer.size = size;
+  managed_buffer.usage = usage;
+  managed_buffer.is_device_local = device_local;
+
+  vk::MemoryRequirements requirements =
+      device.getBufferMemoryRequirements(managed_buffer.buffer.get());
+  std::optional<uint32_t> memory_type =
+      device_local ? device_.FindMemoryType(requirements.memoryTypeBits,
+                                            vk::MemoryPropertyFlagBits::eDeviceLocal)
+                   : FindHostMemoryType(device_, requirements.memoryTypeBits);
+  if (!memory_type.has_value()) {
+    std::cerr << "No memory type for managed buffer" << std::endl;
+    std::abort();
+  }
+  managed_buffer.allocation_size = requirements.size;
+  managed_buffer.heap_index = device_.MemoryProperties().memoryTypes[*memory_type].heapIndex;
+
+  vk::MemoryAllocateInfo allocate_info;
+  allocate_info
+      .setAllocationSize(requirements.size)
+      .setMemoryTypeIndex(*memory_type);
+  vk::ResultValue<vk::UniqueDeviceMemory> allocate_result =
+      device.allocateMemoryUnique(allocate_info);
+  VulkanCheckResult("vkAllocateMemory", allocate_result.result);
+  managed_buffer.memory = std::move(allocate_result.value);
+
+  VulkanCheckResult("vkBindBufferMemory",
+                    device.bindBufferMemory(managed_buffer.buffer.get(),
+                                            managed_buffer.memory.get(), 0));
+  return managed_buffer;
+}
+
+vk::DeviceSize VulkanResidencyManager::DeviceLocalUsage(
+    const std::vector<VulkanDevice::HeapBudget>& heap_budgets) const {
+  // Without VK_EXT_memory_budget, only the manager's own usage is known.
+  if (!device_.HasMemoryBudget())
+    return managed_bytes_[device_local_heap_index_];
+  const vk::DeviceSize usage = heap_budgets[device_local_heap_index_].usage;
+  return usage - std::min(usage, retired_device_local_bytes_);
+}
+
+vk::DeviceSize VulkanResidencyManager::MoveBuffers(const std::vector<BufferId>& buffer_ids,
+                                                   bool to_device_local) {
+  if (buffer_ids.empty())
+    return 0;
+
+  vk::CommandBuffer command_buffer = command_buffer_.get();
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+  VulkanCheckResult("vkBeginCommandBuffer", command_buffer.begin(begin_info));
+
+  // Waits for the earlier frames' writes to the buffers.
+  vk::MemoryBarrier before_copy(vk::AccessFlagBits::eMemoryWrite,
+                                vk::AccessFlagBits::eTransferRead);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+      /*dependencyFlags=*/{}, before_copy, /*bufferMemoryBarriers=*/nullptr,
+      /*imageMemoryBarriers=*/nullptr);
+
+  std::vector<ManagedBuffer> new_buffers;
+  new_buffers.reserve(buffer_ids.size());
+  vk::DeviceSize moved_bytes = 0;
+  for (BufferId buffer_id : buffer_ids) {
+    const ManagedBuffer& old_buffer = buffers_[buffer_id];
+    assert(old_buffer.is_device_local != to_device_local);
+
+    ManagedBuffer& new_buffer = new_buffers.emplace_back(
+        AllocateBuffer(old_buffer.size, old_buffer.usage, to_device_local));
+    vk::BufferCopy region(/*srcOffset=*/0, /*dstOffset=*/0, old_buffer.size);
+    command_buffer.copyBuffer(old_buffer.buffer.get(), new_buffer.buffer.get(), region);
+    moved_bytes += old_buffer.size;
+  }
+
+  VulkanCheckResult("vkEndCommandBuffer", command_buffer.end());
+
+  vk::SubmitInfo submit_info;
+  submit_info.setCommandBuffers(command_buffer);
+  VulkanCheckResult("vkQueueSubmit", queue_.submit(submit_info, move_fence_.get()));
+  vk::Device device = device_.VulkanHandle();
+  vk::Fence move_fence = move_fence_.get();
+  VulkanCheckResult("vkWaitForFences",
+                    device.waitForFences(move_fence, /*waitAll=*/true, UINT64_MAX));
+  VulkanCheckResult("vkResetFences", device.resetFences(move_fence));
+
+  // This frame looks up the new handles after BeginFrame(), so the previous
+  // frame is the last one that may use the old buffers.
+  const uint64_t last_use = frame_number_ - 1;
+  for (size_t i = 0; i < buffer_ids.size(); ++i) {
+    ManagedBuffer& old_buffer = buffers_[buffer_ids[i]];
+    ManagedBuffer& new_buffer = new_buffers[i];
+    new_buffer.priority = old_buffer.priority;
+    new_buffer.last_used_frame = old_buffer.last_used_frame;
+
+    managed_bytes_[old_buffer.heap_index] -= old_buffer.allocation_size;
+    managed_bytes_[new_buffer.heap_index] += new_buffer.allocation_size;
+    if (old_buffer.is_device_local) {
+      retired_allocations_.push_back(
+          { .last_use = last_use, .size = old_buffer.allocation_size });
+      retired_device_local_bytes_ += old_buffer.allocation_size;
+    }
+    // The buffer is destroyed before its memory.
+    deletion_queue_.Retire(last_use, std::move(old_buffer.buffer));
+    deletion_queue_.Retire(last_use, std::move(old_buffer.memory));
+    old_buffer = std::move(new_buffer);
+  }
+  return moved_bytes;
+}
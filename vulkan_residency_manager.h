@@ -0,0 +1,184 @@
+#ifndef VULKAN_RESIDENCY_MANAGER_H_
+#define VULKAN_RESIDENCY_MANAGER_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+
+class VulkanDeletionQueue;
+class VulkanFrameCommands;
+
+// Keeps the device-local memory usage within the budget reported by the driver.
+//
+// Exceeding the budget makes the driver page memory in and out, which causes
+// long stalls. Instead, BeginFrame() moves the least important buffers to
+// host memory when device-local usage nears the budget. The GPU can still
+// read them over the bus, at lower bandwidth. Buffers move back to
+// device-local memory when enough budget frees up.
+//
+// Moving a buffer changes its handle, so callers must look up handles with
+// Buffer() every frame, after BeginFrame(). Replaced buffers are retired to a
+// VulkanDeletionQueue, so earlier frames can keep using them. Not thread-safe.
+class VulkanResidencyManager {
+ public:
+  using BufferId = uint32_t;
+
+  // Buffers are demoted when the device-local heap's usage goes above this
+  // share of its budget, until the usage drops below the target.
+  static constexpr vk::DeviceSize kDemoteAbovePercent = 95;
+  static constexpr vk::DeviceSize kDemoteTargetPercent = 85;
+
+  // Buffers are promoted while the usage stays below this share of the budget.
+  // The gap to kDemoteAbovePercent keeps buffers from moving back and forth.
+  static constexpr vk::DeviceSize kPromoteBelowPercent = 70;
+
+  struct HeapStats {
+    vk::DeviceSize budget;
+    vk::DeviceSize usage;
+    // The part of `usage` that belongs to buffers created by this manager.
+    vk::DeviceSize managed_bytes;
+  };
+
+  // Reported by BeginFrame().
+  struct FrameStats {
+    uint64_t frame_number;
+    // Indexed by memory heap index. Sampled before buffers are moved.
+    std::vector<HeapStats> heaps;
+    uint64_t demoted_buffer_count;
+    vk::DeviceSize demoted_bytes;
+    uint64_t promoted_buffer_count;
+    vk::DeviceSize promoted_bytes;
+  };
+
+  // Replaced buffers are retired to `deletion_queue`, tagged with the last
+  // frame that may use their handles.
+  //
+  // Moves are submitted to VulkanDevice::SubmissionQueue(submission_thread_index).
+  // This must be the queue that renders with the buffers, so the moves are
+  // ordered after the earlier frames' writes.
+  explicit VulkanResidencyManager(const VulkanDevice& device,
+                                  VulkanDeletionQueue& deletion_queue,
+                                  size_t submission_thread_index);
+
+  VulkanResidencyManager(const VulkanResidencyManager&) = delete;
+  VulkanResidencyManager& operator=(const VulkanResidencyManager&) = delete;
+
+  // The buffers must not be used by pending commands.
+  ~VulkanResidencyManager();
+
+  // Creates a buffer in device-local memory, if the budget allows.
+  //
+  // Buffers with higher `priority` are moved to host memory last.
+  [[nodiscard]] BufferId CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
+                                      int priority);
+
+  // The buffer must not be used by pending commands.
+  void DestroyBuffer(BufferId buffer_id);
+
+  // Valid until the next BeginFrame() call.
+  [[nodiscard]] vk::Buffer Buffer(BufferId buffer_id) const {
+    assert(buffer_id < buffers_.size());
+    assert(buffers_[buffer_id].buffer);
+    return buffers_[buffer_id].buffer.get();
+  }
+
+  [[nodiscard]] bool IsDeviceLocal(BufferId buffer_id) const {
+    assert(buffer_id < buffers_.size());
+    return buffers_[buffer_id].is_device_local;
+  }
+
+  // Records that the current frame uses the buffer.
+  //
+  // Among buffers with the same priority, the least recently used buffers
+  // are moved to host memory first.
+  void MarkUsed(BufferId buffer_id) {
+    assert(buffer_id < buffers_.size());
+    buffers_[buffer_id].last_used_frame = frame_number_;
+  }
+
+  // Samples the memory budget, and moves buffers between heaps if needed.
+  //
+  // Must be called after `frame_commands.BeginFrame()` and the frame's
+  // deletion queue Collect() call, before the frame looks up buffer handles.
+  // Blocks until the moves complete. Moves are rare, and a short stall is
+  // much cheaper than paging.
+  void BeginFrame(const VulkanFrameCommands& frame_commands);
+
+  [[nodiscard]] const FrameStats& LastFrameStats() const { return last_frame_stats_; }
+
+  // The heap that buffers are demoted from and promoted to.
+  [[nodiscard]] uint32_t DeviceLocalHeapIndex() const { return device_local_heap_index_; }
+
+  // False if buffers never move, because the device has no host heap.
+  [[nodiscard]] bool CanMoveBuffers() const { return has_host_heap_; }
+
+ private:
+  struct ManagedBuffer {
+    vk::UniqueBuffer buffer;
+    vk::UniqueDeviceMemory memory;
+    vk::DeviceSize size = 0;
+    vk::DeviceSize allocation_size = 0;
+    vk::BufferUsageFlags usage;
+    uint32_t heap_index = 0;
+    int priority = 0;
+    uint64_t last_used_frame = 0;
+    bool is_device_local = false;
+  };
+
+  // Device-local memory retired to the deletion queue, which frees it after
+  // the GPU completes frame `last_use`.
+  struct RetiredAllocation {
+    uint64_t last_use;
+    vk::DeviceSize size;
+  };
+
+  // Allocates a buffer in device-local or host memory.
+  [[nodiscard]] ManagedBuffer AllocateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
+                                             bool device_local) const;
+
+  // The device-local heap's usage, including memory not owned by the manager.
+  //
+  // Retired buffers are left out. Their memory is freed after the pending
+  // frames complete, and moving more buffers wouldn't free it sooner.
+  [[nodiscard]] vk::DeviceSize DeviceLocalUsage(
+      const std::vector<VulkanDevice::HeapBudget>& heap_budgets) const;
+
+  // Moves the buffers to the other kind of memory. Returns the moved bytes.
+  vk::DeviceSize MoveBuffers(const std::vector<BufferId>& buffer_ids, bool to_device_local);
+
+  const VulkanDevice& device_;
+  VulkanDeletionQueue& deletion_queue_;
+  const vk::Queue queue_;
+  // The heap of the first device-local memory type. Managed buffers are moved
+  // out of this heap when it nears its budget.
+  const uint32_t device_local_heap_index_;
+  // False on devices whose host-visible memory is all device-local, such as
+  // integrated GPUs. Buffers are never moved on these devices.
+  const bool has_host_heap_;
+  vk::UniqueCommandPool command_pool_;
+  vk::UniqueCommandBuffer command_buffer_;
+  vk::UniqueFence move_fence_;
+
+  // Indexed by BufferId. Destroyed buffers leave null entries, which are reused.
+  std::vector<ManagedBuffer> buffers_;
+  std::vector<BufferId> free_buffer_ids_;
+  std::vector<RetiredAllocation> retired_allocations_;
+  // The sum of `retired_allocations_` sizes.
+  vk::DeviceSize retired_device_local_bytes_ = 0;
+
+  // Indexed by memory heap index.
+  std::vector<vk::DeviceSize> managed_bytes_;
+
+  // The VulkanFrameCommands number of the frame passed to BeginFrame().
+  uint64_t frame_number_ = 0;
+  FrameStats last_frame_stats_{};
+};
+
+#endif  // VULKAN_RESIDENCY_MANAGER_H_
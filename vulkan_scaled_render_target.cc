@@ -0,0 +1,224 @@
+#include "vulkan_scaled_render_target.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_deletion_queue.h"
+#include "vulkan_device.h"
+#include "vulkan_frame_commands.h"
+#include "vulkan_image.h"
+#include "vulkan_render_pass_cache.h"
+
+namespace {
+
+constexpr vk::ImageSubresourceRange kColorRange(
+    vk::ImageAspectFlagBits::eColor, /*baseMipLevel=*/0, /*levelCount=*/1,
+    /*baseArrayLayer=*/0, /*layerCount=*/1);
+
+[[nodiscard]] vk::Filter UpscaleFilterFor(const VulkanDevice& device, vk::Format format) {
+  vk::FormatProperties properties =
+      device.PhysicalDeviceVulkanHandle().getFormatProperties(format);
+  if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)
+    return vk::Filter::eLinear;
+  return vk::Filter::eNearest;
+}
+
+[[nodiscard]] std::array<vk::Offset3D, 2> BlitBounds(vk::Extent2D extent) {
+  return {vk::Offset3D(0, 0, 0), vk::Offset3D(static_cast<int32_t>(extent.width),
+                                              static_cast<int32_t>(extent.height), 1)};
+}
+
+[[nodiscard]] VulkanScaledRenderTarget::TransientMemory AddTransientMemory(
+    VulkanScaledRenderTarget::TransientMemory total, const VulkanImage& image) {
+  return {
+    .allocated_size = total.allocated_size + image.MemorySize(),
+    .committed_size = total.committed_size + image.CommittedMemorySize(),
+    .is_lazily_allocated = total.is_lazily_allocated || image.IsLazilyAllocated(),
+  };
+}
+
+}  // namespace
+
+VulkanScaledRenderTarget::VulkanScaledRenderTarget(const VulkanDevice& device,
+                                                   VulkanRenderPassCache& render_pass_cache,
+                                                   VulkanDeletionQueue& deletion_queue,
+                                                   vk::Format format,
+                                                   vk::SampleCountFlagBits samples,
+                                                   vk::Format depth_format)
+    : device_(device),
+      render_pass_cache_(render_pass_cache),
+      deletion_queue_(deletion_queue),
+      format_(format),
+      samples_(samples),
+      depth_format_(depth_format),
+      upscale_filter_(UpscaleFilterFor(device, format)) {}
+
+VulkanScaledRenderTarget::~VulkanScaledRenderTarget() {
+  if (attachments_.has_value())
+    EvictImageViews(*attachments_);
+}
+
+void VulkanScaledRenderTarget::EvictImageViews(const Attachments& attachments) {
+  render_pass_cache_.EvictImageView(attachments.color.View());
+  if (attachments.multisampled_color.has_value())
+    render_pass_cache_.EvictImageView(attachments.multisampled_color->View());
+  if (attachments.depth.has_value())
+    render_pass_cache_.EvictImageView(attachments.depth->View());
+}
+
+void VulkanScaledRenderTarget::RetireAttachments() {
+  const uint64_t last_use = attachments_frame_number_;
+  render_pass_cache_.EvictImageView(attachments_->color.View(), deletion_queue_, last_use);
+  if (attachments_->multisampled_color.has_value()) {
+    render_pass_cache_.EvictImageView(attachments_->multisampled_color->View(),
+                                      deletion_queue_, last_use);
+  }
+  if (attachments_->depth.has_value())
+    render_pass_cache_.EvictImageView(attachments_->depth->View(), deletion_queue_, last_use);
+  deletion_queue_.Retire(last_use, std::move(*attachments_));
+  attachments_.reset();
+}
+
+vk::Extent2D VulkanScaledRenderTarget::ScaledExtent(vk::Extent2D output_extent, double scale) {
+  assert(scale > 0 && scale <= 1);
+
+  return vk::Extent2D(
+      std::max(1u, static_cast<uint32_t>(std::ceil(output_extent.width * scale))),
+      std::max(1u, static_cast<uint32_t>(std::ceil(output_extent.height * scale))));
+}
+
+const VulkanScaledRenderTarget::Attachments& VulkanScaledRenderTarget::BeginFrame(
+    const VulkanFrameCommands& frame_commands, vk::CommandBuffer command_buffer,
+    vk::Extent2D output_extent, double scale) {
+  const vk::Extent2D extent = ScaledExtent(output_extent, scale);
+  if (!attachments_.has_value() || attachments_->color.Extent() != extent) {
+    if (attachments_.has_value()) {
+      RetireAttachments();
+      ++reallocation_count_;
+    }
+    attachments_.emplace(Attachments{
+      .color = VulkanImage(device_, extent, format_, kImageUsage),
+    });
+    if (samples_ != vk::SampleCountFlagBits::e1) {
+      attachments_->multisampled_color.emplace(device_, extent, format_,
+                                               kMultisampledImageUsage, samples_);
+    }
+    device_.SetObjectName(attachments_->color.VulkanHandle(), "Scaled render target");
+    if (depth_format_ != vk::Format::eUndefined)
+      attachments_->depth.emplace(device_, extent, depth_format_, kDepthImageUsage, samples_);
+  }
+  attachments_frame_number_ = frame_commands.FrameNumber();
+  const VulkanImage& image = attachments_->color;
+
+  // The previous frame's upscale must finish reading the image before it is
+  // overwritten. The contents are discarded, so no memory dependency is needed.
+  vk::ImageMemoryBarrier to_color_attachment;
+  to_color_attachment
+      .setSrcAccessMask({})
+      .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+      .setOldLayout(vk::ImageLayout::eUndefined)
+      .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image.VulkanHandle())
+      .setSubresourceRange(kColorRange);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      to_color_attachment, device_.Dispatcher());
+  return *attachments_;
+}
+
+void VulkanScaledRenderTarget::RecordUpscale(vk::CommandBuffer command_buffer,
+                                             vk::Image destination,
+                                             vk::Extent2D destination_extent,
+                                             vk::ImageLayout final_layout) const {
+  assert(attachments_.has_value());
+  assert(destination);
+  const vk::DispatchLoaderDynamic& dispatcher = device_.Dispatcher();
+  const VulkanImage& image = attachments_->color;
+
+  // The render passes wrote the source. The destination's previous contents
+  // are discarded, but the transition must wait for the acquire semaphore,
+  // which is waited on in the transfer stage.
+  std::array<vk::ImageMemoryBarrier, 2> to_transfer;
+  to_transfer[0]
+      .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite)
+      .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+      .setOldLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(image.VulkanHandle())
+      .setSubresourceRange(kColorRange);
+  to_transfer[1]
+      .setSrcAccessMask({})
+      .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setOldLayout(vk::ImageLayout::eUndefined)
+      .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(destination)
+      .setSubresourceRange(kColorRange);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer,
+      vk::PipelineStageFlagBits::eTransfer, /*dependencyFlags=*/{},
+      /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr, to_transfer, dispatcher);
+
+  const vk::ImageSubresourceLayers color_layers(vk::ImageAspectFlagBits::eColor,
+                                                /*mipLevel=*/0, /*baseArrayLayer=*/0,
+                                                /*layerCount=*/1);
+  vk::ImageBlit region;
+  region
+      .setSrcSubresource(color_layers)
+      .setSrcOffsets(BlitBounds(image.Extent()))
+      .setDstSubresource(color_layers)
+      .setDstOffsets(BlitBounds(destination_extent));
+  command_buffer.blitImage(image.VulkanHandle(), vk::ImageLayout::eTransferSrcOptimal,
+                           destination, vk::ImageLayout::eTransferDstOptimal, region,
+                           upscale_filter_, dispatcher);
+
+  if (final_layout == vk::ImageLayout::eTransferDstOptimal)
+    return;
+
+  // Presentation is ordered by semaphores, so only the layout transition is
+  // needed.
+  vk::ImageMemoryBarrier to_final_layout;
+  to_final_layout
+      .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+      .setDstAccessMask({})
+      .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+      .setNewLayout(final_layout)
+      .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+      .setImage(destination)
+      .setSubresourceRange(kColorRange);
+  command_buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+      /*dependencyFlags=*/{}, /*memoryBarriers=*/nullptr, /*bufferMemoryBarriers=*/nullptr,
+      to_final_layout, dispatcher);
+}
+
+VulkanScaledRenderTarget::TransientMemory VulkanScaledRenderTarget::GetTransientMemory() const {
+  TransientMemory total = {
+    .allocated_size = 0,
+    .committed_size = 0,
+    .is_lazily_allocated = false,
+  };
+  if (!attachments_.has_value())
+    return total;
+  if (attachments_->multisampled_color.has_value())
+    total = AddTransientMemory(total, *attachments_->multisampled_color);
+  if (attachments_->depth.has_value())
+    total = AddTransientMemory(total, *attachments_->depth);
+  return total;
+}
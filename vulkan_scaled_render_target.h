@@ -0,0 +1,135 @@
+#ifndef VULKAN_SCALED_RENDER_TARGET_H_
+#define VULKAN_SCALED_RENDER_TARGET_H_
+
+#include <cstdint>
+#include <optional>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_image.h"
+
+class VulkanDeletionQueue;
+class VulkanDevice;
+class VulkanFrameCommands;
+class VulkanRenderPassCache;
+
+// An offscreen render target whose resolution is a fraction of its output's.
+//
+// Frames are rendered at the reduced resolution, then upscaled to the output
+// image with a filtered blit. The images are reallocated when the render
+// extent changes. Replaced images are retired to a VulkanDeletionQueue, so
+// reallocating never stalls. Not thread-safe.
+//
+// Multisampled targets render to a transient color image, which is resolved
+// into the single-sampled color image at the end of the render pass. The
+// multisampled color image and the depth image are never stored, so they are
+// placed in lazily allocated memory. On tiled GPUs, they stay on-chip.
+class VulkanScaledRenderTarget {
+ public:
+  static constexpr vk::ImageUsageFlags kImageUsage =
+      vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+  static constexpr vk::ImageUsageFlags kMultisampledImageUsage =
+      vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransientAttachment;
+  static constexpr vk::ImageUsageFlags kDepthImageUsage =
+      vk::ImageUsageFlagBits::eDepthStencilAttachment |
+      vk::ImageUsageFlagBits::eTransientAttachment;
+
+  // The images used by one frame.
+  struct Attachments {
+    // Single-sampled. Read by the upscale.
+    VulkanImage color;
+    // Present when the target is multisampled. Resolves into `color`.
+    std::optional<VulkanImage> multisampled_color;
+    // Present when the target has a depth format. Has the same sample count
+    // as the rendered color image.
+    std::optional<VulkanImage> depth;
+  };
+
+  // Memory used by the transient attachments.
+  struct TransientMemory {
+    // The sizes of the allocations.
+    vk::DeviceSize allocated_size;
+    // The memory committed by the driver. Equal to the allocated size, unless
+    // the allocations are lazy.
+    vk::DeviceSize committed_size;
+    bool is_lazily_allocated;
+  };
+
+  // `samples` is the sample count of the rendered color and depth images.
+  // vk::Format::eUndefined as `depth_format` means no depth attachment.
+  //
+  // Framebuffers that use the target's images are evicted from
+  // `render_pass_cache` before the images are destroyed, so the cache must
+  // outlive the target. Replaced images and their framebuffers are retired
+  // to `deletion_queue`, tagged with the last frame that rendered to them.
+  explicit VulkanScaledRenderTarget(const VulkanDevice& device,
+                                    VulkanRenderPassCache& render_pass_cache,
+                                    VulkanDeletionQueue& deletion_queue, vk::Format format,
+                                    vk::SampleCountFlagBits samples, vk::Format depth_format);
+
+  VulkanScaledRenderTarget(const VulkanScaledRenderTarget&) = delete;
+  VulkanScaledRenderTarget& operator=(const VulkanScaledRenderTarget&) = delete;
+
+  // The images must not be used by pending commands.
+  ~VulkanScaledRenderTarget();
+
+  // The render extent for an output extent. Each dimension is rounded up,
+  // and is at least 1.
+  [[nodiscard]] static vk::Extent2D ScaledExtent(vk::Extent2D output_extent, double scale);
+
+  // Returns the images that the frame renders to, sized for `output_extent`
+  // scaled by `scale`.
+  //
+  // Records a barrier that discards the color image's contents and
+  // transitions it to eColorAttachmentOptimal, after the previous frame's
+  // upscale finished reading it. The frame's render passes must leave the
+  // color image in eTransferSrcOptimal. The transient images are not
+  // transitioned, so render passes must load them with eClear or eDontCare.
+  // `command_buffer` must be the one returned by the last
+  // `frame_commands.BeginFrame()` call, and must be outside a render pass.
+  const Attachments& BeginFrame(const VulkanFrameCommands& frame_commands,
+                                vk::CommandBuffer command_buffer, vk::Extent2D output_extent,
+                                double scale);
+
+  // Blits the rendered image to `destination`, which covers
+  // `destination_extent` and must have been created with eTransferDst usage.
+  //
+  // `destination`'s contents are discarded, and it ends up in `final_layout`.
+  // The blit runs in the transfer stage, so semaphores guarding
+  // `destination` must be waited on in that stage.
+  void RecordUpscale(vk::CommandBuffer command_buffer, vk::Image destination,
+                     vk::Extent2D destination_extent, vk::ImageLayout final_layout) const;
+
+  [[nodiscard]] uint64_t ReallocationCount() const { return reallocation_count_; }
+
+  [[nodiscard]] vk::SampleCountFlagBits Samples() const { return samples_; }
+
+  // Covers the current frame's attachments. All zeros before the first frame.
+  [[nodiscard]] TransientMemory GetTransientMemory() const;
+
+ private:
+  // Evicts the framebuffers that use `attachments`' images.
+  void EvictImageViews(const Attachments& attachments);
+
+  // Hands the current images and their framebuffers to the deletion queue.
+  void RetireAttachments();
+
+  const VulkanDevice& device_;
+  VulkanRenderPassCache& render_pass_cache_;
+  VulkanDeletionQueue& deletion_queue_;
+  const vk::Format format_;
+  const vk::SampleCountFlagBits samples_;
+  const vk::Format depth_format_;
+  // Linear filtering when the format supports it.
+  const vk::Filter upscale_filter_;
+
+  std::optional<Attachments> attachments_;
+  // The last frame that rendered to `attachments_`.
+  uint64_t attachments_frame_number_ = 0;
+
+  uint64_t reallocation_count_ = 0;
+};
+
+#endif  // VULKAN_SCALED_RENDER_TARGET_H_
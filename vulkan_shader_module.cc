@@ -0,0 +1,85 @@
+#include "vulkan_shader_module.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "asset_pack.h"
+#include "asset_pack_format.h"
+#include "vulkan_errors.h"
+
+namespace {
+
+// The first word of every SPIR-V module.
+constexpr uint32_t kSpirvMagicNumber = 0x07230203;
+
+[[nodiscard]] std::vector<uint32_t> ReadSpirvFile(const char* spirv_path) {
+  std::ifstream file(spirv_path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Failed to open SPIR-V module: " << spirv_path << std::endl;
+    std::abort();
+  }
+
+  std::streamsize file_size = file.tellg();
+  if (file_size <= 0 || file_size % sizeof(uint32_t) != 0) {
+    std::cerr << "Invalid SPIR-V module size: " << spirv_path << std::endl;
+    std::abort();
+  }
+
+  std::vector<uint32_t> words(static_cast<size_t>(file_size) / sizeof(uint32_t));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(words.data()), file_size);
+  if (!file || words[0] != kSpirvMagicNumber) {
+    std::cerr << "Invalid SPIR-V module: " << spirv_path << std::endl;
+    std::abort();
+  }
+  return words;
+}
+
+[[nodiscard]] std::vector<uint32_t> ReadSpirvEntry(const AssetPack& asset_pack,
+                                                   const char* spirv_name) {
+  const AssetPackEntry* entry = asset_pack.Find(spirv_name);
+  if (entry == nullptr) {
+    std::cerr << "SPIR-V module missing from asset pack: " << spirv_name << std::endl;
+    std::abort();
+  }
+  if (entry->size == 0 || entry->size % sizeof(uint32_t) != 0) {
+    std::cerr << "Invalid SPIR-V module size: " << spirv_name << std::endl;
+    std::abort();
+  }
+
+  std::vector<uint32_t> words(static_cast<size_t>(entry->size) / sizeof(uint32_t));
+  asset_pack.Read(*entry, words.data());
+  if (words[0] != kSpirvMagicNumber) {
+    std::cerr << "Invalid SPIR-V module: " << spirv_name << std::endl;
+    std::abort();
+  }
+  return words;
+}
+
+}  // namespace
+
+vk::UniqueShaderModule LoadShaderModule(vk::Device device, const AssetPack* asset_pack,
+                                        const char* spirv_name) {
+  assert(device);
+  assert(spirv_name != nullptr);
+
+  std::vector<uint32_t> spirv_words = (asset_pack != nullptr)
+                                          ? ReadSpirvEntry(*asset_pack, spirv_name)
+                                          : ReadSpirvFile(spirv_name);
+  vk::ShaderModuleCreateInfo create_info;
+  create_info.setCode(spirv_words);
+
+  vk::ResultValue<vk::UniqueShaderModule> create_result =
+      device.createShaderModuleUnique(create_info);
+  VulkanCheckResult("vkCreateShaderModule", create_result.result);
+  return std::move(create_result.value);
+}
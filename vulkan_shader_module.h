@@ -0,0 +1,18 @@
+#ifndef VULKAN_SHADER_MODULE_H_
+#define VULKAN_SHADER_MODULE_H_
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+class AssetPack;
+
+// Creates a shader module from a SPIR-V module built by the spirv_shader() CMake rule.
+//
+// The module is read from `asset_pack` if it's not null, and from the working
+// directory otherwise. Terminates the program if the module can't be read or
+// isn't valid SPIR-V.
+[[nodiscard]] vk::UniqueShaderModule LoadShaderModule(vk::Device device,
+                                                      const AssetPack* asset_pack,
+                                                      const char* spirv_name);
+
+#endif  // VULKAN_SHADER_MODULE_H_
@@ -0,0 +1,28 @@
+#include "vulkan_shader_variant_cache.h"
+
+#include <cassert>
+#include <string>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_shader_module.h"
+
+VulkanShaderVariantCache::VulkanShaderVariantCache(const VulkanDevice& device,
+                                                   const AssetPack* asset_pack)
+    : device_(device.VulkanHandle()), asset_pack_(asset_pack) {
+}
+
+VulkanShaderVariantCache::~VulkanShaderVariantCache() = default;
+
+vk::ShaderModule VulkanShaderVariantCache::GetModule(const VulkanShaderVariantKey& key) {
+  assert(key.module_prefix != nullptr);
+
+  return modules_.FindOrInsert(key, [&]() {
+    // Matches the module names produced by spirv_shader_variants().
+    const std::string spirv_name =
+        std::string(key.module_prefix) + "_" + std::to_string(key.feature_bits) + ".spv";
+    return LoadShaderModule(device_, asset_pack_, spirv_name.c_str());
+  }).get();
+}
@@ -0,0 +1,154 @@
+#ifndef VULKAN_SHADER_VARIANT_CACHE_H_
+#define VULKAN_SHADER_VARIANT_CACHE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+
+#include "intern_table.h"
+#include "vulkan_hash.h"
+
+class AssetPack;
+class VulkanDevice;
+
+// A set of shader features, used to pick one of a shader's variants.
+//
+// `Feature` is an enum whose values are the feature indexes, starting at 0,
+// in the order passed to spirv_shader_variants() in CMakeLists.txt. The
+// set's bits are the variant's index.
+template <typename Feature, uint32_t FeatureCount>
+class ShaderFeatureSet {
+ public:
+  // Every variant is built ahead of time, so this keeps the build small.
+  static_assert(FeatureCount <= 8, "Too many shader features");
+
+  static constexpr uint32_t kVariantCount = uint32_t{1} << FeatureCount;
+
+  constexpr ShaderFeatureSet() = default;
+  constexpr ShaderFeatureSet(std::initializer_list<Feature> features) {
+    for (Feature feature : features)
+      bits_ |= Bit(feature);
+  }
+
+  [[nodiscard]] constexpr ShaderFeatureSet With(Feature feature, bool enabled) const {
+    ShaderFeatureSet result = *this;
+    if (enabled)
+      result.bits_ |= Bit(feature);
+    else
+      result.bits_ &= ~Bit(feature);
+    return result;
+  }
+
+  [[nodiscard]] constexpr bool Has(Feature feature) const { return (bits_ & Bit(feature)) != 0; }
+
+  [[nodiscard]] constexpr uint32_t Bits() const { return bits_; }
+
+ private:
+  [[nodiscard]] static constexpr uint32_t Bit(Feature feature) {
+    assert(static_cast<uint32_t>(feature) < FeatureCount);
+    return uint32_t{1} << static_cast<uint32_t>(feature);
+  }
+
+  uint32_t bits_ = 0;
+};
+
+// Identifies one variant of a shader.
+struct VulkanShaderVariantKey {
+  // Combines the family and feature bits. Computed at compile time when the
+  // features are constants.
+  size_t hash;
+  size_t family_hash;
+  // The module prefix passed to spirv_shader_variants(). Must be a string
+  // literal, or otherwise outlive the caches that use the key.
+  const char* module_prefix;
+  uint32_t feature_bits;
+
+  [[nodiscard]] constexpr bool operator==(const VulkanShaderVariantKey& other) const {
+    return family_hash == other.family_hash && feature_bits == other.feature_bits;
+  }
+  [[nodiscard]] constexpr bool operator!=(const VulkanShaderVariantKey& other) const {
+    return !(*this == other);
+  }
+};
+
+struct VulkanShaderVariantKeyHash {
+  [[nodiscard]] size_t operator()(const VulkanShaderVariantKey& key) const { return key.hash; }
+};
+
+// A shader whose variants are built by spirv_shader_variants().
+//
+// Meant to be declared as a constexpr, next to the code that uses the shader.
+template <typename FeatureSet>
+class VulkanShaderVariantFamily {
+ public:
+  // `module_prefix` is the module prefix passed to spirv_shader_variants().
+  constexpr explicit VulkanShaderVariantFamily(const char* module_prefix)
+      : module_prefix_(module_prefix), family_hash_(HashModulePrefix(module_prefix)) {}
+
+  [[nodiscard]] constexpr VulkanShaderVariantKey Key(FeatureSet features) const {
+    return {
+      .hash = HashCombine(family_hash_, features.Bits()),
+      .family_hash = family_hash_,
+      .module_prefix = module_prefix_,
+      .feature_bits = features.Bits(),
+    };
+  }
+
+ private:
+  // FNV-1a.
+  [[nodiscard]] static constexpr size_t HashModulePrefix(const char* module_prefix) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (const char* c = module_prefix; *c != '\0'; ++c) {
+      hash ^= static_cast<uint8_t>(*c);
+      hash *= 0x100000001B3;
+    }
+    return static_cast<size_t>(hash);
+  }
+
+  const char* module_prefix_;
+  size_t family_hash_;
+};
+
+// Creates shader modules for the variants that are used, on first use.
+//
+// Every variant is compiled to SPIR-V at build time, so nothing is compiled
+// at runtime, and only the variants that are used pay for
+// vkCreateShaderModule().
+//
+// Thread-safe. Looking up an existing module doesn't take locks.
+class VulkanShaderVariantCache {
+ public:
+  struct Stats {
+    // Variants whose modules have been created.
+    size_t module_count;
+  };
+
+  // `asset_pack` may be null, in which case the modules are read from the
+  // working directory. Otherwise, it must outlive the cache.
+  explicit VulkanShaderVariantCache(const VulkanDevice& device, const AssetPack* asset_pack);
+
+  VulkanShaderVariantCache(const VulkanShaderVariantCache&) = delete;
+  VulkanShaderVariantCache& operator=(const VulkanShaderVariantCache&) = delete;
+
+  // The modules must not be used by pipelines that are still being built.
+  ~VulkanShaderVariantCache();
+
+  // The module remains valid until the cache is destroyed. Terminates the
+  // program if the variant's module can't be loaded.
+  [[nodiscard]] vk::ShaderModule GetModule(const VulkanShaderVariantKey& key);
+
+  [[nodiscard]] Stats GetStats() const { return { .module_count = modules_.Size() }; }
+
+ private:
+  const vk::Device device_;
+  const AssetPack* const asset_pack_;
+
+  InternTable<VulkanShaderVariantKey, vk::UniqueShaderModule, VulkanShaderVariantKeyHash>
+      modules_;
+};
+
+#endif  // VULKAN_SHADER_VARIANT_CACHE_H_
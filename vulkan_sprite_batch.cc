@@ -0,0 +1,413 @@
+#include "vulkan_sprite_batch.h"
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_shader_module.h"
+#include "vulkan_shader_variant_cache.h"
+
+namespace {
+
+// Sort key layout, from the most significant bits: 8 bits of layer, 8 bits
+// of pipeline, 16 bits of texture and 32 bits of depth.
+constexpr int kLayerShift = 56;
+constexpr int kPipelineShift = 48;
+constexpr int kTextureShift = 32;
+
+constexpr int kRadixDigitBits = 8;
+constexpr size_t kRadixDigitCount = 1 << kRadixDigitBits;
+constexpr int kRadixPassCount = 64 / kRadixDigitBits;
+
+// Non-negative floats compare like their bit patterns.
+[[nodiscard]] uint32_t DepthBits(float depth) {
+  assert(depth >= 0.0f);
+
+  // Negative zero would sort after every positive depth.
+  if (depth == 0.0f)
+    return 0;
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(bits));
+  return bits;
+}
+
+[[nodiscard]] uint64_t SortKey(const VulkanSpriteBatch::Sprite& sprite) {
+  return (uint64_t{sprite.layer} << kLayerShift) |
+         (uint64_t{sprite.pipeline} << kPipelineShift) |
+         (uint64_t{sprite.texture} << kTextureShift) | DepthBits(sprite.depth);
+}
+
+[[nodiscard]] vk::UniqueDescriptorSetLayout CreateDescriptorSetLayout(
+    vk::Device device, bool is_bindless, uint32_t max_texture_count) {
+  vk::DescriptorSetLayoutBinding binding;
+  binding
+      .setBinding(0)
+      .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+      .setDescriptorCount(is_bindless ? max_texture_count : 1)
+      .setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+  // Bindless textures are added while the array is bound, and unused
+  // elements are never written.
+  const vk::DescriptorBindingFlags binding_flags =
+      vk::DescriptorBindingFlagBits::ePartiallyBound |
+      vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+  vk::StructureChain<vk::DescriptorSetLayoutCreateInfo,
+                     vk::DescriptorSetLayoutBindingFlagsCreateInfo>
+      create_info_chain;
+  create_info_chain.get<vk::DescriptorSetLayoutCreateInfo>().setBindings(binding);
+  create_info_chain.get<vk::DescriptorSetLayoutBindingFlagsCreateInfo>()
+      .setBindingFlags(binding_flags);
+  if (is_bindless) {
+    create_info_chain.get<vk::DescriptorSetLayoutCreateInfo>()
+        .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool);
+  } else {
+    create_info_chain.unlink<vk::DescriptorSetLayoutBindingFlagsCreateInfo>();
+  }
+
+  vk::ResultValue<vk::UniqueDescriptorSetLayout> create_result =
+      device.createDescriptorSetLayoutUnique(create_info_chain.get());
+  VulkanCheckResult("vkCreateDescriptorSetLayout", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::UniquePipelineLayout CreatePipelineLayout(
+    vk::Device device, vk::DescriptorSetLayout set_layout, uint32_t push_constant_size) {
+  vk::PushConstantRange push_constant_range;
+  push_constant_range
+      .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+      .setOffset(0)
+      .setSize(push_constant_size);
+
+  vk::PipelineLayoutCreateInfo create_info;
+  create_info
+      .setSetLayouts(set_layout)
+      .setPushConstantRanges(push_constant_range);
+
+  vk::ResultValue<vk::UniquePipelineLayout> create_result =
+      device.createPipelineLayoutUnique(create_info);
+  VulkanCheckResult("vkCreatePipelineLayout", create_result.result);
+  return std::move(create_result.value);
+}
+
+// Bindless textures share one set. Otherwise, each texture gets a set.
+[[nodiscard]] vk::UniqueDescriptorPool CreateDescriptorPool(
+    vk::Device device, bool is_bindless, uint32_t max_texture_count) {
+  vk::DescriptorPoolSize pool_size(vk::DescriptorType::eCombinedImageSampler,
+                                   max_texture_count);
+
+  vk::DescriptorPoolCreateInfo create_info;
+  create_info
+      .setMaxSets(is_bindless ? 1 : max_texture_count)
+      .setPoolSizes(pool_size);
+  if (is_bindless)
+    create_info.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind);
+
+  vk::ResultValue<vk::UniqueDescriptorPool> create_result =
+      device.createDescriptorPoolUnique(create_info);
+  VulkanCheckResult("vkCreateDescriptorPool", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] vk::DescriptorSet AllocateDescriptorSet(vk::Device device,
+                                                      vk::DescriptorPool pool,
+                                                      vk::DescriptorSetLayout set_layout) {
+  vk::DescriptorSetAllocateInfo allocate_info;
+  allocate_info
+      .setDescriptorPool(pool)
+      .setSetLayouts(set_layout);
+  vk::ResultValue<std::vector<vk::DescriptorSet>> allocate_result =
+      device.allocateDescriptorSets(allocate_info);
+  VulkanCheckResult("vkAllocateDescriptorSets", allocate_result.result);
+  return allocate_result.value[0];
+}
+
+}  // namespace
+
+VulkanSpriteBatch::VulkanSpriteBatch(const VulkanDevice& device, const AssetPack* asset_pack,
+                                     VulkanShaderVariantCache& shader_cache,
+                                     uint32_t max_texture_count)
+    : device_(device.VulkanHandle()),
+      dispatcher_(device.Dispatcher()),
+      is_bindless_(device.HasBindlessTextures()),
+      max_texture_count_(max_texture_count),
+      shader_cache_(shader_cache),
+      vertex_shader_(LoadShaderModule(device_, asset_pack, "sprite_vert.spv")),
+      descriptor_set_layout_(
+          CreateDescriptorSetLayout(device_, is_bindless_, max_texture_count)),
+      pipeline_layout_(CreatePipelineLayout(device_, descriptor_set_layout_.get(),
+                                            sizeof(PushConstants))),
+      descriptor_pool_(CreateDescriptorPool(device_, is_bindless_, max_texture_count)) {
+  assert(max_texture_count > 0 && max_texture_count <= kMaxTextureCount);
+
+  if (is_bindless_) {
+    descriptor_sets_.push_back(AllocateDescriptorSet(device_, descriptor_pool_.get(),
+                                                     descriptor_set_layout_.get()));
+  }
+}
+
+VulkanSpriteBatch::~VulkanSpriteBatch() = default;
+
+VulkanPipelineState VulkanSpriteBatch::PipelineState(vk::RenderPass render_pass,
+                                                     vk::SampleCountFlagBits samples,
+                                                     bool blend_enabled,
+                                                     bool alpha_test_enabled) const {
+  assert(render_pass);
+
+  VulkanPipelineState state;
+  state.vertex_bindings.emplace_back(/*binding=*/0, sizeof(Instance),
+                                     vk::VertexInputRate::eInstance);
+  state.vertex_attributes = {
+    vk::VertexInputAttributeDescription(/*location=*/0, /*binding=*/0,
+                                        vk::Format::eR32G32B32A32Sfloat,
+                                        offsetof(Instance, rect)),
+    vk::VertexInputAttributeDescription(/*location=*/1, /*binding=*/0,
+                                        vk::Format::eR32G32B32A32Sfloat,
+                                        offsetof(Instance, texture_rect)),
+    vk::VertexInputAttributeDescription(/*location=*/2, /*binding=*/0,
+                                        vk::Format::eR8G8B8A8Unorm, offsetof(Instance, color)),
+    vk::VertexInputAttributeDescription(/*location=*/3, /*binding=*/0, vk::Format::eR32Uint,
+                                        offsetof(Instance, texture_index)),
+  };
+  // Each instance is a quad, whose corners come from gl_VertexIndex.
+  state.topology = vk::PrimitiveTopology::eTriangleStrip;
+  state.vertex_shader = vertex_shader_.get();
+  state.fragment_shader = shader_cache_.GetModule(kFragmentShader.Key(FragmentFeatures()
+      .With(FragmentFeature::kBindless, is_bindless_)
+      .With(FragmentFeature::kAlphaTest, alpha_test_enabled)));
+  state.samples = samples;
+  state.blend_enabled = blend_enabled;
+  state.layout = pipeline_layout_.get();
+  state.render_pass = render_pass;
+  return state;
+}
+
+uint32_t VulkanSpriteBatch::AddPipeline(vk::Pipeline pipeline) {
+  assert(pipeline);
+  assert(pipelines_.size() < kMaxPipelineCount);
+
+  pipelines_.push_back(pipeline);
+  return static_cast<uint32_t>(pipelines_.size() - 1);
+}
+
+uint32_t VulkanSpriteBatch::AddTexture(vk::ImageView view, vk::Sampler sampler) {
+  assert(view);
+  assert(sampler);
+  assert(texture_count_ < max_texture_count_);
+
+  const uint32_t texture = texture_count_++;
+  if (!is_bindless_) {
+    descriptor_sets_.push_back(AllocateDescriptorSet(device_, descriptor_pool_.get(),
+                                                     descriptor_set_layout_.get()));
+  }
+
+  vk::DescriptorImageInfo image_info(sampler, view, vk::ImageLayout::eShaderReadOnlyOptimal);
+  vk::WriteDescriptorSet write;
+  write
+      .setDstSet(is_bindless_ ? descriptor_sets_[0] : descriptor_sets_[texture])
+      .setDstBinding(0)
+      .setDstArrayElement(is_bindless_ ? texture : 0)
+      .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+      .setImageInfo(image_info);
+  device_.updateDescriptorSets(write, /*descriptorCopies=*/nullptr);
+  return texture;
+}
+
+void VulkanSpriteBatch::Add(const Sprite& sprite) {
+  assert(sprite.texture < texture_count_);
+  assert(sprite.pipeline < pipelines_.size());
+
+  sprites_.push_back(sprite);
+}
+
+void VulkanSpriteBatch::AddText(const MonospaceFont& font, std::string_view text, float x,
+                                float y, uint8_t layer, float depth, uint32_t color) {
+  assert(font.column_count > 0 && font.row_count > 0);
+
+  const int glyph_count = static_cast<int>(font.column_count * font.row_count);
+  const float glyph_u = 1.0f / static_cast<float>(font.column_count);
+  const float glyph_v = 1.0f / static_cast<float>(font.row_count);
+
+  Sprite sprite;
+  sprite.width = font.glyph_width;
+  sprite.height = font.glyph_height;
+  sprite.color = color;
+  sprite.texture = font.texture;
+  sprite.pipeline = font.pipeline;
+  sprite.layer = layer;
+  sprite.depth = depth;
+
+  float pen_x = x;
+  float pen_y = y;
+  for (char character : text) {
+    if (character == '\n') {
+      pen_x = x;
+      pen_y += font.glyph_height;
+      continue;
+    }
+
+    const int glyph = static_cast<unsigned char>(character) -
+                      static_cast<unsigned char>(font.first_character);
+    if (character != ' ' && glyph >= 0 && glyph < glyph_count) {
+      const uint32_t column = static_cast<uint32_t>(glyph) % font.column_count;
+      const uint32_t row = static_cast<uint32_t>(glyph) / font.column_count;
+      sprite.x = pen_x;
+      sprite.y = pen_y;
+      sprite.u0 = static_cast<float>(column) * glyph_u;
+      sprite.v0 = static_cast<float>(row) * glyph_v;
+      sprite.u1 = sprite.u0 + glyph_u;
+      sprite.v1 = sprite.v0 + glyph_v;
+      Add(sprite);
+    }
+    pen_x += font.glyph_width;
+  }
+}
+
+uint64_t VulkanSpriteBatch::SortEntries() {
+  const size_t count = sort_entries_.size();
+
+  // One read of the keys counts the digits for all the passes.
+  std::array<std::array<uint32_t, kRadixDigitCount>, kRadixPassCount> digit_counts = {};
+  for (const SortEntry& entry : sort_entries_) {
+    for (int pass = 0; pass < kRadixPassCount; ++pass)
+      ++digit_counts[pass][(entry.key >> (pass * kRadixDigitBits)) & (kRadixDigitCount - 1)];
+  }
+
+  sort_scratch_.resize(count);
+  uint64_t pass_count = 0;
+  for (int pass = 0; pass < kRadixPassCount; ++pass) {
+    std::array<uint32_t, kRadixDigitCount>& counts = digit_counts[pass];
+
+    // Digits shared by all keys don't change the order. Layers, pipelines and
+    // textures usually have few distinct values, so most of their passes are
+    // skipped.
+    const int shift = pass * kRadixDigitBits;
+    if (counts[(sort_entries_[0].key >> shift) & (kRadixDigitCount - 1)] == count)
+      continue;
+
+    // Turns the counts into the digits' starting offsets.
+    uint32_t offset = 0;
+    for (uint32_t& digit_count : counts) {
+      const uint32_t digit_offset = offset;
+      offset += digit_count;
+      digit_count = digit_offset;
+    }
+
+    for (const SortEntry& entry : sort_entries_)
+      sort_scratch_[counts[(entry.key >> shift) & (kRadixDigitCount - 1)]++] = entry;
+    sort_entries_.swap(sort_scratch_);
+    ++pass_count;
+  }
+  return pass_count;
+}
+
+void VulkanSpriteBatch::Record(vk::CommandBuffer command_buffer,
+                               VulkanFrameAllocator::Cursor& cursor,
+                               vk::Extent2D framebuffer_extent) {
+  assert(framebuffer_extent.width > 0 && framebuffer_extent.height > 0);
+
+  stats_ = {};
+  stats_.sprite_count = sprites_.size();
+  if (sprites_.empty())
+    return;
+
+  const uint32_t sprite_count = static_cast<uint32_t>(sprites_.size());
+  sort_entries_.clear();
+  for (uint32_t i = 0; i < sprite_count; ++i)
+    sort_entries_.push_back({.key = SortKey(sprites_[i]), .sprite_index = i});
+  std::chrono::steady_clock::time_point sort_start_time = std::chrono::steady_clock::now();
+  stats_.sort_pass_count = SortEntries();
+  stats_.sort_time_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - sort_start_time).count();
+
+  // The instances are written in order, which suits write-combined memory.
+  VulkanFrameAllocator::Allocation allocation =
+      cursor.Allocate(vk::DeviceSize{sizeof(Instance)} * sprite_count);
+  Instance* instances = static_cast<Instance*>(allocation.data);
+  for (uint32_t i = 0; i < sprite_count; ++i) {
+    const Sprite& sprite = sprites_[sort_entries_[i].sprite_index];
+    instances[i] = {
+      .rect = {sprite.x, sprite.y, sprite.width, sprite.height},
+      .texture_rect = {sprite.u0, sprite.v0, sprite.u1, sprite.v1},
+      .color = sprite.color,
+      .texture_index = sprite.texture,
+    };
+  }
+  sprites_.clear();
+
+  const vk::DeviceSize vertex_offset = allocation.offset;
+  command_buffer.bindVertexBuffers(/*firstBinding=*/0, allocation.buffer, vertex_offset,
+                                   dispatcher_);
+  const float width = static_cast<float>(framebuffer_extent.width);
+  const float height = static_cast<float>(framebuffer_extent.height);
+  command_buffer.setViewport(/*firstViewport=*/0,
+                             vk::Viewport(0.0f, 0.0f, width, height, 0.0f, 1.0f),
+                             dispatcher_);
+  command_buffer.setScissor(/*firstScissor=*/0,
+                            vk::Rect2D(vk::Offset2D(0, 0), framebuffer_extent), dispatcher_);
+  const PushConstants push_constants = {.pixel_scale = {2.0f / width, 2.0f / height}};
+  command_buffer.pushConstants(pipeline_layout_.get(), vk::ShaderStageFlagBits::eVertex,
+                               /*offset=*/0, sizeof(push_constants), &push_constants,
+                               dispatcher_);
+  if (is_bindless_) {
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout_.get(),
+                                      /*firstSet=*/0, descriptor_sets_[0],
+                                      /*dynamicOffsets=*/nullptr, dispatcher_);
+    ++stats_.descriptor_set_bind_count;
+  }
+
+  // Each run of instances that shares state becomes one draw. Bindless
+  // textures don't end runs.
+  constexpr uint32_t kNoState = ~uint32_t{0};
+  uint32_t bound_pipeline = kNoState;
+  uint32_t bound_texture = kNoState;
+  uint32_t run_start = 0;
+  auto draw_run = [&](uint32_t run_end) {
+    if (run_end == run_start)
+      return;
+    command_buffer.draw(/*vertexCount=*/4, /*instanceCount=*/run_end - run_start,
+                        /*firstVertex=*/0, /*firstInstance=*/run_start, dispatcher_);
+    ++stats_.draw_count;
+    run_start = run_end;
+  };
+  for (uint32_t i = 0; i < sprite_count; ++i) {
+    const uint64_t key = sort_entries_[i].key;
+    const uint32_t pipeline = static_cast<uint32_t>(key >> kPipelineShift) & 0xFF;
+    const uint32_t texture = static_cast<uint32_t>(key >> kTextureShift) & 0xFFFF;
+    const bool pipeline_changed = pipeline != bound_pipeline;
+    const bool texture_changed = !is_bindless_ && texture != bound_texture;
+    if (!pipeline_changed && !texture_changed)
+      continue;
+
+    draw_run(i);
+    if (pipeline_changed) {
+      command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines_[pipeline],
+                                  dispatcher_);
+      bound_pipeline = pipeline;
+      ++stats_.pipeline_bind_count;
+    }
+    if (texture_changed) {
+      command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                        pipeline_layout_.get(), /*firstSet=*/0,
+                                        descriptor_sets_[texture],
+                                        /*dynamicOffsets=*/nullptr, dispatcher_);
+      bound_texture = texture;
+      ++stats_.descriptor_set_bind_count;
+    }
+  }
+  draw_run(sprite_count);
+}
@@ -0,0 +1,202 @@
+#ifndef VULKAN_SPRITE_BATCH_H_
+#define VULKAN_SPRITE_BATCH_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_frame_allocator.h"
+#include "vulkan_pipeline_manager.h"
+#include "vulkan_shader_variant_cache.h"
+
+class AssetPack;
+class VulkanDevice;
+
+// Draws large numbers of textured 2D quads, such as UI elements and glyphs.
+//
+// Sprites are collected during the frame, then sorted by a 64-bit key made of
+// their layer, pipeline, texture and depth, so sprites that share state end
+// up next to each other. Each run of sprites that shares state becomes one
+// instanced draw, which reads the sprites from a VulkanFrameAllocator
+// buffer.
+//
+// On devices with bindless textures, all the textures live in one descriptor
+// array, and sprites select their texture by index. Texture changes don't
+// break draws, so only pipeline changes do. Other devices bind a descriptor
+// set per texture.
+//
+// Sprites in the same layer are reordered, so they must not overlap unless
+// they share the pipeline and texture, in which case they are drawn in depth
+// order. Not thread-safe.
+class VulkanSpriteBatch {
+ public:
+  // The largest number of textures and pipelines. Limited by the bits
+  // reserved in the sort key.
+  static constexpr uint32_t kMaxTextureCount = 1 << 16;
+  static constexpr uint32_t kMaxPipelineCount = 1 << 8;
+
+  struct Sprite {
+    // The top-left corner and the size, in framebuffer pixels.
+    float x;
+    float y;
+    float width;
+    float height;
+    // The texture coordinates of the top-left and bottom-right corners.
+    float u0 = 0.0f;
+    float v0 = 0.0f;
+    float u1 = 1.0f;
+    float v1 = 1.0f;
+    // Multiplied with the texture. RGBA with 8 bits per channel, and red in
+    // the lowest byte.
+    uint32_t color = 0xFFFFFFFF;
+    // Returned by AddTexture() and AddPipeline().
+    uint32_t texture = 0;
+    uint32_t pipeline = 0;
+    // Higher layers are drawn over lower layers.
+    uint8_t layer = 0;
+    // Sprites that share a layer, pipeline and texture are drawn in
+    // increasing depth order. Must not be negative.
+    float depth = 0.0f;
+  };
+
+  // A monospace bitmap font, whose glyphs are laid out on the texture in a
+  // grid, in character code order.
+  struct MonospaceFont {
+    uint32_t texture;
+    uint32_t pipeline;
+    char first_character;
+    uint32_t column_count;
+    uint32_t row_count;
+    // The size of each glyph on screen, in framebuffer pixels.
+    float glyph_width;
+    float glyph_height;
+  };
+
+  // The features of shaders/sprite.frag, in spirv_shader_variants() order.
+  enum class FragmentFeature : uint32_t {
+    kBindless = 0,
+    kAlphaTest = 1,
+  };
+  using FragmentFeatures = ShaderFeatureSet<FragmentFeature, 2>;
+  static constexpr VulkanShaderVariantFamily<FragmentFeatures> kFragmentShader{"sprite_frag"};
+
+  // Covers the last Record() call.
+  struct Stats {
+    uint64_t sprite_count;
+    uint64_t draw_count;
+    uint64_t pipeline_bind_count;
+    uint64_t descriptor_set_bind_count;
+    // Sort passes run. Passes over digits shared by all keys are skipped.
+    uint64_t sort_pass_count;
+    double sort_time_ms;
+  };
+
+  // `max_texture_count` must not exceed kMaxTextureCount. Loads the SPIR-V
+  // modules built by the spirv_shader() CMake rules from `asset_pack`, or
+  // from the working directory if it's null. Fragment shader variants come
+  // from `shader_cache`, which must outlive the batch.
+  explicit VulkanSpriteBatch(const VulkanDevice& device, const AssetPack* asset_pack,
+                             VulkanShaderVariantCache& shader_cache,
+                             uint32_t max_texture_count);
+
+  VulkanSpriteBatch(const VulkanSpriteBatch&) = delete;
+  VulkanSpriteBatch& operator=(const VulkanSpriteBatch&) = delete;
+
+  // The descriptor sets must not be used by pending commands.
+  ~VulkanSpriteBatch();
+
+  [[nodiscard]] bool IsBindless() const { return is_bindless_; }
+
+  // The state of pipelines that draw sprites into `render_pass`. Callers may
+  // change the blending, rasterization and multisampling state. Alpha-tested
+  // pipelines discard fragments whose alpha is below 0.5, which draws
+  // cutouts without blending.
+  //
+  // The state references the batch's shaders and layout, so the batch and
+  // its shader cache must outlive the VulkanPipelineManager that builds the
+  // pipelines.
+  [[nodiscard]] VulkanPipelineState PipelineState(vk::RenderPass render_pass,
+                                                  vk::SampleCountFlagBits samples,
+                                                  bool blend_enabled,
+                                                  bool alpha_test_enabled) const;
+
+  // `pipeline` must have been built from a PipelineState() state, and must
+  // outlive the commands recorded by Record(). At most kMaxPipelineCount
+  // pipelines can be added.
+  [[nodiscard]] uint32_t AddPipeline(vk::Pipeline pipeline);
+
+  // The image must be in eShaderReadOnlyOptimal when the sprites are drawn.
+  // The view and sampler must outlive the commands that draw the sprites.
+  // At most `max_texture_count` textures can be added.
+  [[nodiscard]] uint32_t AddTexture(vk::ImageView view, vk::Sampler sampler);
+
+  void Add(const Sprite& sprite);
+
+  // Adds a sprite for each glyph in `text`, starting at (`x`, `y`).
+  // Newlines start a new line, and characters outside the font are skipped.
+  void AddText(const MonospaceFont& font, std::string_view text, float x, float y,
+               uint8_t layer, float depth, uint32_t color);
+
+  // Draws the sprites added since the last call, and clears the batch.
+  //
+  // The sprites are written with `cursor`, whose allocator needs
+  // eVertexBuffer usage. Must be called inside a render pass that's
+  // compatible with the pipelines. Sets the viewport and scissor to cover
+  // `framebuffer_extent`.
+  void Record(vk::CommandBuffer command_buffer, VulkanFrameAllocator::Cursor& cursor,
+              vk::Extent2D framebuffer_extent);
+
+  [[nodiscard]] Stats GetStats() const { return stats_; }
+
+ private:
+  // Must match the vertex inputs in shaders/sprite.vert.
+  struct Instance {
+    float rect[4];
+    float texture_rect[4];
+    uint32_t color;
+    uint32_t texture_index;
+  };
+
+  // Must match the push constants in shaders/sprite.vert.
+  struct PushConstants {
+    float pixel_scale[2];
+  };
+
+  struct SortEntry {
+    uint64_t key;
+    uint32_t sprite_index;
+  };
+
+  // Sorts `sort_entries_` by key. Returns the number of passes run.
+  uint64_t SortEntries();
+
+  const vk::Device device_;
+  const vk::DispatchLoaderDynamic& dispatcher_;
+  const bool is_bindless_;
+  const uint32_t max_texture_count_;
+
+  VulkanShaderVariantCache& shader_cache_;
+  vk::UniqueShaderModule vertex_shader_;
+  vk::UniqueDescriptorSetLayout descriptor_set_layout_;
+  vk::UniquePipelineLayout pipeline_layout_;
+  vk::UniqueDescriptorPool descriptor_pool_;
+
+  // With bindless textures, the only descriptor set, which holds all the
+  // textures. Otherwise, one descriptor set per texture.
+  std::vector<vk::DescriptorSet> descriptor_sets_;
+  uint32_t texture_count_ = 0;
+  std::vector<vk::Pipeline> pipelines_;
+
+  // Reused across frames to avoid allocations.
+  std::vector<Sprite> sprites_;
+  std::vector<SortEntry> sort_entries_;
+  std::vector<SortEntry> sort_scratch_;
+
+  Stats stats_ = {};
+};
+
+#endif  // VULKAN_SPRITE_BATCH_H_
@@ -0,0 +1,115 @@
+// Prints the frame statistics published by a running renderer.
+//
+// Usage: vulkan_stats [--follow] [segment_name]
+//
+// Reads the shared-memory segment written by FrameMetrics, so it never
+// interrupts the render thread. --follow keeps printing the window
+// percentiles every second, along with new hitch reports.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "frame_stats_segment.h"
+
+namespace {
+
+void PrintWindow(const char* label, const FrameStatsWindow& window) {
+  std::cout << label << " window, " << window.frame_count << " frames\n"
+            << "  " << std::left << std::setw(14) << "metric" << std::right << std::setw(10)
+            << "p50 ms" << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms"
+            << std::setw(10) << "max ms" << "\n";
+  for (size_t i = 0; i < kFrameMetricCount; ++i) {
+    const FrameMetricSummary& summary = window.metrics[i];
+    std::cout << "  " << std::left << std::setw(14) << FrameMetricName(static_cast<FrameMetric>(i))
+              << std::right << std::setw(10) << summary.p50_ms << std::setw(10)
+              << summary.p95_ms << std::setw(10) << summary.p99_ms << std::setw(10)
+              << summary.max_ms << "\n";
+  }
+}
+
+void PrintSnapshot(const FrameStatsSegment& segment) {
+  FrameStatsSnapshot snapshot;
+  if (!segment.ReadSnapshot(snapshot)) {
+    std::cout << "No frame statistics published yet\n";
+    return;
+  }
+  std::cout << snapshot.frame_count << " frames, " << snapshot.hitch_count
+            << " hitches over " << snapshot.hitch_threshold_ms << " ms\n";
+  PrintWindow("Short", snapshot.short_window);
+  PrintWindow("Long", snapshot.long_window);
+}
+
+void PrintHitchReport(const HitchReport& report) {
+  std::cout << "Hitch in frame " << report.frame_number << ":";
+  for (size_t i = 0; i < kFrameMetricCount; ++i) {
+    std::cout << " " << FrameMetricName(static_cast<FrameMetric>(i)) << " "
+              << report.metric_ms[i] << " ms";
+  }
+  std::cout << ", " << report.allocation_count << " allocations\n";
+
+  const uint64_t zone_count = std::min<uint64_t>(report.zone_count, kMaxHitchZones);
+  for (uint64_t i = 0; i < zone_count; ++i) {
+    const HitchZone& zone = report.zones[i];
+    // The name is null-terminated by the writer, unless the read was torn.
+    const size_t name_length = strnlen(zone.name, sizeof(zone.name));
+    std::cout << "  " << (zone.is_gpu_pass ? "gpu " : "cpu ") << std::string(zone.depth * 2, ' ')
+              << std::string(zone.name, name_length) << ": " << zone.duration_ms
+              << " ms at +" << zone.start_ms << " ms\n";
+  }
+}
+
+// Prints the reports published since `next_index`, and returns the index
+// after the last one.
+[[nodiscard]] uint64_t PrintHitchReports(const FrameStatsSegment& segment,
+                                         uint64_t next_index) {
+  const uint64_t report_count = segment.HitchReportCount();
+  if (report_count - next_index > FrameStatsSegment::kHitchReportCapacity) {
+    const uint64_t first_index = report_count - FrameStatsSegment::kHitchReportCapacity;
+    std::cout << (first_index - next_index) << " hitch reports were overwritten\n";
+    next_index = first_index;
+  }
+  HitchReport report;
+  for (; next_index < report_count; ++next_index) {
+    if (segment.ReadHitchReport(next_index, report))
+      PrintHitchReport(report);
+    else
+      std::cout << "Hitch report " << next_index << " was overwritten\n";
+  }
+  return next_index;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool follow = false;
+  const char* segment_name = FrameStatsSegment::kDefaultName;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--follow") == 0)
+      follow = true;
+    else
+      segment_name = argv[i];
+  }
+
+  std::optional<FrameStatsSegment> segment = FrameStatsSegment::Open(segment_name);
+  if (!segment.has_value())
+    return 1;
+  std::cout << "Renderer process " << segment->WriterProcessId() << "\n";
+
+  uint64_t next_hitch_index = 0;
+  while (true) {
+    PrintSnapshot(*segment);
+    next_hitch_index = PrintHitchReports(*segment, next_hitch_index);
+    std::cout << std::flush;
+    if (!follow)
+      return 0;
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+}
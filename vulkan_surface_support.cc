@@ -177,3 +177,12 @@ VulkanSurfaceSupport::Queues VulkanSurfaceSupport::QueueFamilyIndexes() const {
     .presentation_queue_family_index = *graphics_queue_family_indexes_.begin(),
   };
 }
+
+vk::ImageUsageFlags VulkanSurfaceSupport::SupportedImageUsage() const {
+  assert(IsAcceptable());
+  return capabilities_.supportedUsageFlags;
+}
+
+bool VulkanSurfaceSupport::CanPresentFrom(uint32_t queue_family_index) const {
+  return presentation_queue_family_indexes_.count(queue_family_index) != 0;
+}
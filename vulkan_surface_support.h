@@ -38,6 +38,10 @@ class VulkanSurfaceSupport {
   [[nodiscard]] vk::Extent2D BestExtentFor(vk::Extent2D surface_size) const;
   [[nodiscard]] int BestImageCount() const;
   [[nodiscard]] Queues QueueFamilyIndexes() const;
+  [[nodiscard]] vk::ImageUsageFlags SupportedImageUsage() const;
+
+  // True if the given queue family can present to the surface.
+  [[nodiscard]] bool CanPresentFrom(uint32_t queue_family_index) const;
 
 #if !defined(NDEBUG)
   vk::PhysicalDevice PhysicalDeviceVulkanHandle() const {
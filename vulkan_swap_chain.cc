@@ -0,0 +1,229 @@
+#include "vulkan_swap_chain.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_enums.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+#include "vulkan_device.h"
+#include "vulkan_errors.h"
+#include "vulkan_physical_device.h"
+#include "vulkan_presentation_context.h"
+#include "vulkan_surface_support.h"
+
+namespace {
+
+[[nodiscard]] vk::ImageUsageFlags SwapChainImageUsage(
+    const VulkanSurfaceSupport& surface_support) {
+  // Transfer usage allows clearing and blitting into the images.
+  return vk::ImageUsageFlagBits::eColorAttachment |
+      (surface_support.SupportedImageUsage() & vk::ImageUsageFlagBits::eTransferDst);
+}
+
+[[nodiscard]] vk::UniqueSwapchainKHR CreateSwapChain(
+    const VulkanDevice& device,
+    const VulkanSurfaceSupport& surface_support,
+    const VulkanPresentationSurface& surface,
+    vk::SwapchainKHR old_swap_chain) {
+  assert(surface.VulkanHandle() == surface_support.SurfaceVulkanHandle());
+  assert(surface_support.IsAcceptable());
+
+  uint32_t graphics_queue_family_index = device.GraphicsQueueFamilyIndex();
+  uint32_t presentation_queue_family_index = device.PresentationQueueFamilyIndex();
+  if (!surface_support.CanPresentFrom(presentation_queue_family_index)) {
+    std::cerr << "Device's presentation queue can't present to the surface" << std::endl;
+    std::abort();
+  }
+
+  bool is_unified_queue = (graphics_queue_family_index == presentation_queue_family_index);
+  const std::array<uint32_t, 2> queue_family_indexes = {
+    graphics_queue_family_index, presentation_queue_family_index
+  };
+
+  vk::SurfaceFormatKHR surface_format = surface_support.BestFormat();
+  vk::Extent2D image_extent = surface_support.BestExtentFor(surface.Size());
+  vk::SwapchainCreateInfoKHR create_info;
+  create_info
+      .setMinImageCount(static_cast<uint32_t>(surface_support.BestImageCount()))
+      .setSurface(surface.VulkanHandle())
+      .setImageFormat(surface_format.format)
+      .setImageColorSpace(surface_format.colorSpace)
+      .setImageExtent(image_extent)
+      .setImageArrayLayers(1)
+      .setImageUsage(SwapChainImageUsage(surface_support))
+      .setPreTransform(surface_support.CurrentTransform())
+      .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
+      .setPresentMode(surface_support.BestMode())
+      .setClipped(true)
+      .setOldSwapchain(old_swap_chain);
+
+  if (is_unified_queue) {
+    create_info.setImageSharingMode(vk::SharingMode::eExclusive).setQueueFamilyIndices({});
+  } else {
+    create_info
+        .setImageSharingMode(vk::SharingMode::eExclusive)
+        .setQueueFamilyIndices(queue_family_indexes);
+  }
+
+  vk::ResultValue<vk::UniqueSwapchainKHR> create_result =
+      device.VulkanHandle().createSwapchainKHRUnique(create_info);
+  VulkanCheckResult("vkCreateSwapchainKHR", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] std::vector<vk::Image> GetSwapChainImages(
+    vk::Device logical_device, vk::SwapchainKHR swap_chain) {
+  assert(logical_device);
+  assert(swap_chain);
+
+  vk::ResultValue<std::vector<vk::Image>> get_images_result =
+      logical_device.getSwapchainImagesKHR(swap_chain);
+  VulkanCheckResult("vkGetSwapchainImagesKHR", get_images_result.result);
+
+  return std::move(get_images_result.value);
+}
+
+[[nodiscard]] vk::UniqueImageView CreateImageView(
+    vk::Format image_format, vk::Device logical_device, vk::Image image) {
+  vk::ImageViewCreateInfo create_info;
+  create_info
+    .setImage(image)
+    .setViewType(vk::ImageViewType::e2D)
+    .setFormat(image_format)
+    .setComponents(vk::ComponentMapping(
+        vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity,
+        vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity))
+    .setSubresourceRange(vk::ImageSubresourceRange()
+        .setAspectMask(vk::ImageAspectFlagBits::eColor)
+        .setBaseMipLevel(0)
+        .setLevelCount(1)
+        .setBaseArrayLayer(0)
+        .setLayerCount(1));
+
+  vk::ResultValue<vk::UniqueImageView> create_result =
+      logical_device.createImageViewUnique(create_info);
+  VulkanCheckResult("vkCreateImageView", create_result.result);
+
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] std::vector<vk::UniqueImageView> CreateImageViews(
+    vk::Format image_format, vk::Device logical_device, const std::vector<vk::Image>& images) {
+  std::vector<vk::UniqueImageView> image_views;
+  image_views.reserve(images.size());
+
+  for (vk::Image image : images)
+    image_views.push_back(CreateImageView(image_format, logical_device, image));
+  return image_views;
+}
+
+[[nodiscard]] vk::UniqueSemaphore CreateSemaphore(vk::Device logical_device) {
+  vk::ResultValue<vk::UniqueSemaphore> create_result =
+      logical_device.createSemaphoreUnique(vk::SemaphoreCreateInfo());
+  VulkanCheckResult("vkCreateSemaphore", create_result.result);
+  return std::move(create_result.value);
+}
+
+[[nodiscard]] std::vector<vk::UniqueSemaphore> CreateSemaphores(vk::Device logical_device,
+                                                                size_t count) {
+  std::vector<vk::UniqueSemaphore> semaphores;
+  semaphores.reserve(count);
+
+  for (size_t i = 0; i < count; ++i)
+    semaphores.push_back(CreateSemaphore(logical_device));
+  return semaphores;
+}
+
+}  // namespace
+
+VulkanSwapChain::VulkanSwapChain(const VulkanDevice& device,
+                                 const VulkanPresentationSurface& surface,
+                                 vk::SwapchainKHR old_swap_chain)
+    : device_(device.VulkanHandle()), dispatcher_(&device.Dispatcher()) {
+  // Surface properties are only needed while the swap chain is created.
+  VulkanPhysicalDevice physical_device(device.PhysicalDeviceVulkanHandle());
+  VulkanSurfaceSupport surface_support(physical_device, surface.VulkanHandle());
+  if (!surface_support.IsAcceptable()) {
+    std::cerr << "Device can't present to the surface" << std::endl;
+    std::abort();
+  }
+
+  format_ = surface_support.BestFormat();
+  extent_ = surface_support.BestExtentFor(surface.Size());
+  image_usage_ = SwapChainImageUsage(surface_support);
+  swap_chain_ = CreateSwapChain(device, surface_support, surface, old_swap_chain);
+  images_ = GetSwapChainImages(device_, swap_chain_.get());
+  for (vk::Image image : images_)
+    device.SetObjectName(image, "Swap chain image");
+  image_views_ = CreateImageViews(format_.format, device_, images_);
+
+  acquired_semaphores_ = CreateSemaphores(device_, images_.size());
+  render_finished_semaphores_ = CreateSemaphores(device_, images_.size());
+  spare_acquired_semaphore_ = CreateSemaphore(device_);
+}
+
+VulkanSwapChain::VulkanSwapChain(VulkanSwapChain&&) noexcept = default;
+VulkanSwapChain& VulkanSwapChain::operator=(VulkanSwapChain&&) noexcept = default;
+
+VulkanSwapChain::~VulkanSwapChain() = default;
+
+std::optional<VulkanSwapChain::AcquiredImage> VulkanSwapChain::AcquireNextImage(
+    uint64_t timeout_ns) {
+  assert(swap_chain_);
+
+  if (is_out_of_date_)
+    return std::nullopt;
+
+  // The C API is used because vulkan.hpp asserts on eErrorOutOfDateKHR when
+  // exceptions are disabled.
+  uint32_t image_index = 0;
+  vk::Result result = static_cast<vk::Result>(dispatcher_->vkAcquireNextImageKHR(
+      device_, swap_chain_.get(), timeout_ns, spare_acquired_semaphore_.get(),
+      /*fence=*/VK_NULL_HANDLE, &image_index));
+  switch (result) {
+    case vk::Result::eSuccess:
+    case vk::Result::eSuboptimalKHR:
+      break;
+    case vk::Result::eTimeout:
+    case vk::Result::eNotReady:
+      ++skipped_acquire_count_;
+      return std::nullopt;
+    case vk::Result::eErrorOutOfDateKHR:
+      is_out_of_date_ = true;
+      return std::nullopt;
+    default:
+      VulkanCheckResult("vkAcquireNextImageKHR", result);
+  }
+  assert(image_index < images_.size());
+
+  std::swap(spare_acquired_semaphore_, acquired_semaphores_[image_index]);
+  return AcquiredImage{
+    .index = image_index,
+    .image = images_[image_index],
+    .view = image_views_[image_index].get(),
+    .acquired_semaphore = acquired_semaphores_[image_index].get(),
+    .render_finished_semaphore = render_finished_semaphores_[image_index].get(),
+  };
+}
+
+void VulkanSwapChain::OnPresentResult(vk::Result result) {
+  switch (result) {
+    case vk::Result::eSuccess:
+    case vk::Result::eSuboptimalKHR:
+      return;
+    case vk::Result::eErrorOutOfDateKHR:
+      is_out_of_date_ = true;
+      return;
+    default:
+      VulkanCheckResult("vkQueuePresentKHR", result);
+  }
+}
@@ -0,0 +1,116 @@
+#ifndef VULKAN_SWAP_CHAIN_H_
+#define VULKAN_SWAP_CHAIN_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
+#include <vulkan/vulkan_structs.hpp>
+
+class VulkanDevice;
+class VulkanPresentationSurface;
+
+// The images presented to a surface.
+//
+// A logical device can have one swap chain for each surface it presents to.
+// Each swap chain acquires images independently, so a display that's slow to
+// release images doesn't hold back the others. Use VulkanPresentBatch to
+// present images from many swap chains at once.
+class VulkanSwapChain {
+ public:
+  struct AcquiredImage {
+    uint32_t index;
+    vk::Image image;
+    vk::ImageView view;
+
+    // Signaled when the presentation engine stops reading the image.
+    //
+    // Rendering commands must wait on this semaphore before writing to the image.
+    vk::Semaphore acquired_semaphore;
+
+    // Must be signaled by the commands that render to the image.
+    //
+    // Presenting the image waits on this semaphore.
+    vk::Semaphore render_finished_semaphore;
+  };
+
+  // `device` must be able to present to `surface`.
+  //
+  // `old_swap_chain` is null, or the swap chain being replaced on `surface`.
+  // The old swap chain can't acquire images anymore, but may be destroyed
+  // after the new one, once the frames that use its images complete.
+  explicit VulkanSwapChain(const VulkanDevice& device, const VulkanPresentationSurface& surface,
+                           vk::SwapchainKHR old_swap_chain);
+
+  // Moving supported so instances can be stored in vectors.
+  VulkanSwapChain(const VulkanSwapChain&) = delete;
+  VulkanSwapChain(VulkanSwapChain&&) noexcept;
+  VulkanSwapChain& operator=(const VulkanSwapChain&) = delete;
+  VulkanSwapChain& operator=(VulkanSwapChain&&) noexcept;
+
+  ~VulkanSwapChain();
+
+  [[nodiscard]] vk::SwapchainKHR VulkanHandle() const {
+    assert(swap_chain_);
+    return swap_chain_.get();
+  }
+
+  [[nodiscard]] vk::SurfaceFormatKHR Format() const { return format_; }
+  [[nodiscard]] vk::Extent2D Extent() const { return extent_; }
+  // Always includes eColorAttachment. Includes eTransferDst if the surface
+  // supports it.
+  [[nodiscard]] vk::ImageUsageFlags ImageUsage() const { return image_usage_; }
+  [[nodiscard]] size_t ImageCount() const { return images_.size(); }
+
+  // Destroyed with the swap chain. Caches that use the view must evict it first.
+  [[nodiscard]] vk::ImageView ImageView(size_t index) const {
+    assert(index < image_views_.size());
+    return image_views_[index].get();
+  }
+
+  // The number of AcquireNextImage() calls that didn't get an image in time.
+  [[nodiscard]] uint64_t SkippedAcquireCount() const { return skipped_acquire_count_; }
+
+  // True after the surface changed in a way that requires a new swap chain.
+  [[nodiscard]] bool IsOutOfDate() const { return is_out_of_date_; }
+
+  // Acquires the next image that can be rendered to.
+  //
+  // Returns nullopt if no image becomes available within `timeout_ns`. A zero
+  // timeout never blocks. The caller must present the returned image.
+  [[nodiscard]] std::optional<AcquiredImage> AcquireNextImage(uint64_t timeout_ns);
+
+  // Called by VulkanPresentBatch with the outcome of presenting an image.
+  void OnPresentResult(vk::Result result);
+
+ private:
+  vk::Device device_;
+  // Owned by the VulkanDevice. A pointer so the swap chain stays movable.
+  const vk::DispatchLoaderDynamic* dispatcher_;
+  vk::SurfaceFormatKHR format_;
+  vk::Extent2D extent_;
+  vk::ImageUsageFlags image_usage_;
+  vk::UniqueSwapchainKHR swap_chain_;
+  std::vector<vk::Image> images_;
+  std::vector<vk::UniqueImageView> image_views_;
+
+  // Indexed by image index.
+  std::vector<vk::UniqueSemaphore> acquired_semaphores_;
+  std::vector<vk::UniqueSemaphore> render_finished_semaphores_;
+
+  // Passed to the next vkAcquireNextImageKHR() call.
+  //
+  // The semaphore is swapped with the acquired image's entry in
+  // `acquired_semaphores_`. The swapped out semaphore is no longer in use,
+  // because the image was presented after the commands waiting on it.
+  vk::UniqueSemaphore spare_acquired_semaphore_;
+
+  uint64_t skipped_acquire_count_ = 0;
+  bool is_out_of_date_ = false;
+};
+
+#endif  // VULKAN_SWAP_CHAIN_H_